@@ -0,0 +1,147 @@
+/*
+ * arena.c - Bump allocator for cJSON
+ */
+
+#include "arena.h"
+#include "pool.h"
+
+#define ARENA_ALIGN 8
+
+static DWORD s_tls = TLS_OUT_OF_INDEXES;
+
+/* Written only before other threads start, so frees can read it unlocked */
+static JsonArena *s_arenas[ARENA_MAX];
+static int s_arena_count = 0;
+
+static void *CJSON_CDECL arena_malloc(size_t size)
+{
+    JsonArena *arena = (JsonArena *)TlsGetValue(s_tls);
+    size_t need = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    if (arena) {
+        if (need >= size && need <= arena->size - arena->used) {
+            void *p = arena->base + arena->used;
+
+            arena->used += need;
+            if (arena->used > arena->high_water) {
+                arena->high_water = arena->used;
+            }
+            arena->allocs++;
+            return p;
+        }
+        arena->fallbacks++;
+    }
+    return malloc(size);
+}
+
+/* Arena memory is only taken back by arena_reset */
+static void CJSON_CDECL arena_free(void *p)
+{
+    int i;
+
+    for (i = 0; i < s_arena_count; i++) {
+        const JsonArena *arena = s_arenas[i];
+
+        if ((char *)p >= arena->base && (char *)p < arena->base + arena->size) {
+            return;
+        }
+    }
+    free(p);
+}
+
+void arena_install(void)
+{
+    cJSON_Hooks hooks;
+
+    s_tls = TlsAlloc();
+    if (s_tls == TLS_OUT_OF_INDEXES) {
+        return;
+    }
+
+    hooks.malloc_fn = arena_malloc;
+    hooks.free_fn = arena_free;
+    cJSON_InitHooks(&hooks);
+}
+
+void arena_cleanup(void)
+{
+    int i;
+
+    if (s_tls == TLS_OUT_OF_INDEXES) {
+        return;
+    }
+
+    cJSON_InitHooks(NULL);
+    TlsFree(s_tls);
+    s_tls = TLS_OUT_OF_INDEXES;
+
+    for (i = 0; i < s_arena_count; i++) {
+        pool_put(s_arenas[i]->base);
+        s_arenas[i]->base = NULL;
+        s_arenas[i]->size = 0;
+    }
+    s_arena_count = 0;
+}
+
+int arena_init(JsonArena *arena, size_t size)
+{
+    memset(arena, 0, sizeof(*arena));
+
+    if (s_tls == TLS_OUT_OF_INDEXES || s_arena_count == ARENA_MAX) {
+        return -1;
+    }
+
+    arena->base = pool_get(size);
+    if (!arena->base) {
+        return -1;
+    }
+    arena->size = size;
+    s_arenas[s_arena_count++] = arena;
+    return 0;
+}
+
+JsonArena *arena_enter(JsonArena *arena)
+{
+    JsonArena *prev;
+
+    if (s_tls == TLS_OUT_OF_INDEXES) {
+        return NULL;
+    }
+
+    prev = (JsonArena *)TlsGetValue(s_tls);
+    TlsSetValue(s_tls, arena);
+    return prev;
+}
+
+void arena_reset(void)
+{
+    JsonArena *arena;
+
+    if (s_tls == TLS_OUT_OF_INDEXES) {
+        return;
+    }
+
+    arena = (JsonArena *)TlsGetValue(s_tls);
+    if (arena) {
+        arena->used = 0;
+    }
+}
+
+void arena_get_stats(long *high_water, long *size, long *fallbacks)
+{
+    int i;
+
+    *high_water = 0;
+    *size = 0;
+    *fallbacks = 0;
+
+    for (i = 0; i < s_arena_count; i++) {
+        if ((long)s_arenas[i]->high_water > *high_water) {
+            *high_water = (long)s_arenas[i]->high_water;
+        }
+        if ((long)s_arenas[i]->size > *size) {
+            *size = (long)s_arenas[i]->size;
+        }
+        *fallbacks += s_arenas[i]->fallbacks;
+    }
+}
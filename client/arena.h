@@ -0,0 +1,60 @@
+/*
+ * arena.h - Bump allocator for cJSON
+ *
+ * Every poll parses a reply into a tree of small nodes and strings and
+ * frees it again a moment later. Installed as cJSON's hooks, the arena
+ * hands those out from one block per thread and takes them all back at
+ * once when the cycle ends, so the Win9x heap never sees them. Anything
+ * that does not fit goes to the heap as before.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "claude.h"
+
+#define ARENA_SIZE 32768
+#define ARENA_MAX 4
+
+typedef struct {
+    char *base;
+    size_t size;
+    size_t used;
+    size_t high_water;
+    long allocs;
+    long fallbacks;
+} JsonArena;
+
+/*
+ * Install the hooks. Call once from the main thread before any other
+ * thread uses cJSON; arena_cleanup restores the heap.
+ */
+void arena_install(void);
+void arena_cleanup(void);
+
+/*
+ * Take size bytes for arena from the buffer pool and register it. Also
+ * from the main thread before other threads start. Returns 0, or -1 if the
+ * budget is spent, in which case everything it would have held goes to
+ * the heap.
+ */
+int arena_init(JsonArena *arena, size_t size);
+
+/*
+ * Make arena the calling thread's cJSON allocator (NULL for the heap) and
+ * return the one it replaces, for handing back when done. Trees that must
+ * outlive the cycle are built with the heap selected.
+ */
+JsonArena *arena_enter(JsonArena *arena);
+
+/*
+ * End of a request/response cycle: take back everything the calling
+ * thread's arena handed out. No tree allocated since the last reset may
+ * still be in use.
+ */
+void arena_reset(void);
+
+/* Peak bytes used in any one cycle, arena size, and heap fallbacks */
+void arena_get_stats(long *high_water, long *size, long *fallbacks);
+
+#endif /* ARENA_H */
@@ -3,10 +3,14 @@
  */
 
 #include "claude.h"
+#include "arena.h"
 #include "commands.h"
 #include "session.h"
+#include "frame.h"
 #include "handlers.h"
 #include "http.h"
+#include "pool.h"
+#include "sched.h"
 #include "util.h"
 #include <conio.h>
 #include <process.h>
@@ -22,24 +26,94 @@ ClientState g_state = {.server_ip = "192.168.2.1",
                        .logpath = "claude.log",
                        .last_heartbeat = 0,
                        .poll_thread = NULL,
-                       .has_pending_output = 0,
+                       .output_event = NULL,
                        .session_stopped = 0,
                        .has_pending_approval = 0,
                        .approval_in_progress = 0,
                        .approval_id = "",
                        .approval_tool_name = "",
-                       .approval_tool_input = "",
-                       .skip_permissions = 0};
+                       .approval_tool_input = NULL,
+                       .lease_cmd_id = "",
+                       .lease_ms = 0,
+                       .lease_renewed = 0,
+                       .skip_permissions = 0,
+                       .max_response_kb = MAX_RESPONSE_KB,
+                       .memory_budget_kb = MEMORY_BUDGET_KB,
+                       .frame_protocol = 0,
+                       .turn_state = TURN_UNKNOWN,
+                       .turn_seq = 0,
+                       .turns_sent = 0,
+                       .output_next = 0};
+
+/* cJSON allocations of the main and poll thread */
+static JsonArena s_main_arena;
+static JsonArena s_poll_arena;
+
+/* Sleep until the next poll is due, moving posted results along meanwhile */
+static void poll_wait(EvLoop *loop, DWORD ms)
+{
+    if (ev_active(loop) == 0) {
+        sched_wait(ms);
+    } else {
+        ev_run(loop, ms < POLL_SLEEP_MS ? (long)ms : POLL_SLEEP_MS);
+    }
+}
+
+/*
+ * Hand text to the main thread through the output ring. While the ring is
+ * full no further polls go out: wait for the screen to catch up, keeping
+ * posted results moving, rather than drop any of it.
+ */
+static void queue_output(EvLoop *loop, const char *text)
+{
+    size_t len = strlen(text);
+
+    while (len > 0 && g_state.running) {
+        size_t n = ring_write(&g_state.output_ring, text, len);
+
+        if (n == 0) {
+            SetEvent(g_state.output_event);
+            poll_wait(loop, INPUT_SLEEP_MS);
+            continue;
+        }
+        text += n;
+        len -= n;
+    }
+}
+
+/* Print everything the poll thread queued; main thread only */
+static int print_queued_output(void)
+{
+    const char *text;
+    int printed = 0;
+
+    while ((text = ring_peek(&g_state.output_ring)) != NULL) {
+        if (!printed) {
+            printf("\r                              \r");
+            printed = 1;
+        }
+        print_output(text);
+        ring_release(&g_state.output_ring);
+    }
+    return printed;
+}
 
 static unsigned __stdcall poll_thread_func(void *param)
 {
-    static char response[BUFFER_SIZE];
-    char path[256];
     char local_session_id[64];
+    EvLoop loop;
     cJSON *json;
+    DWORD delay;
+    int did_work;
 
     (void)param;
 
+    /* Syncs and result posts from this thread share one select() loop */
+    ev_init(&loop, g_state.server_ip, g_state.server_port,
+            (size_t)g_state.max_response_kb * 1024);
+    handlers_set_loop(&loop);
+    arena_enter(&s_poll_arena);
+
     while (g_state.running) {
         EnterCriticalSection(&g_state.output_lock);
         strncpy(local_session_id, g_state.session_id, sizeof(local_session_id));
@@ -47,51 +121,73 @@ static unsigned __stdcall poll_thread_func(void *param)
         LeaveCriticalSection(&g_state.output_lock);
 
         if (!local_session_id[0]) {
-            Sleep(POLL_SLEEP_MS);
+            poll_wait(&loop, POLL_SLEEP_MS);
+            continue;
+        }
+
+        /* Idle or server down: sit out the gap unless the user types */
+        delay = sched_poll_delay(0);
+        if (delay > 0) {
+            poll_wait(&loop, delay);
             continue;
         }
 
-        handle_fileop();
-        handle_command();
-        poll_approval();
+        /* Server holds the request until there is something to do */
+        json = handle_sync(local_session_id, 0, sched_poll_wait_ms(),
+                           &did_work);
+        if (json) {
+            const cJSON *output = cJSON_GetObjectItem(json, "output");
+            const cJSON *status = cJSON_GetObjectItem(json, "status");
+            int seq;
+            TurnState turn = sync_turn_state(json, &seq);
 
-        snprintf(path, sizeof(path), "/output?session_id=%s", local_session_id);
+            /* Queued before the state below, so "done" never overtakes it */
+            if (cJSON_IsString(output) && output->valuestring[0]) {
+                queue_output(&loop, output->valuestring);
+                did_work = 1;
+            }
 
-        if (http_request("GET", path, NULL, response, sizeof(response)) ==
-            HTTP_OK) {
-            json = cJSON_Parse(response);
-            if (json) {
-                const cJSON *output = cJSON_GetObjectItem(json, "output");
-                const cJSON *status = cJSON_GetObjectItem(json, "status");
+            EnterCriticalSection(&g_state.output_lock);
 
-                EnterCriticalSection(&g_state.output_lock);
+            if (turn != g_state.turn_state || seq != g_state.turn_seq) {
+                g_state.turn_state = turn;
+                g_state.turn_seq = seq;
+                did_work = 1;
+            }
 
-                if (cJSON_IsString(output) && output->valuestring[0]) {
-                    strncpy(g_state.pending_output, output->valuestring,
-                            BUFFER_SIZE - 1);
-                    g_state.pending_output[BUFFER_SIZE - 1] = '\0';
-                    g_state.has_pending_output = 1;
-                }
+            if (cJSON_IsString(status) &&
+                strcmp(status->valuestring, "stopped") == 0) {
+                g_state.session_stopped = 1;
+                did_work = 1;
+            }
 
-                if (cJSON_IsString(status) &&
-                    strcmp(status->valuestring, "stopped") == 0) {
-                    g_state.session_stopped = 1;
-                }
+            LeaveCriticalSection(&g_state.output_lock);
+            cJSON_Delete(json);
+            arena_reset();
 
-                LeaveCriticalSection(&g_state.output_lock);
-                cJSON_Delete(json);
+            if (did_work) {
+                SetEvent(g_state.output_event);
             }
         }
+    }
 
-        Sleep(POLL_SLEEP_MS);
+    /* Let results still in flight land; each is bounded by its timeout */
+    while (ev_active(&loop) > 0) {
+        ev_run(&loop, POLL_SLEEP_MS);
     }
+    handlers_set_loop(NULL);
+    ev_close(&loop);
+    arena_enter(NULL);
 
+    http_release_thread();
     return 0;
 }
 
 static void start_poll_thread(void)
 {
     unsigned thread_id;
+    size_t ring_size = OUTPUT_RING_SIZE;
+    char *ring_buf;
     HANDLE h;
 
     if (g_state.poll_thread != NULL) {
@@ -100,9 +196,27 @@ static void start_poll_thread(void)
 
     InitializeCriticalSection(&g_state.output_lock);
 
-    h = (HANDLE)_beginthreadex(NULL, 0, poll_thread_func, NULL, 0, &thread_id);
+    /* Output is split over several segments if the budget allows less */
+    ring_buf = pool_get_upto(&ring_size);
+    ring_init(&g_state.output_ring, ring_buf, ring_size);
+
+    /* Auto-reset; signalled by the poll thread when it has stored output */
+    g_state.output_event =
+        ring_buf ? CreateEvent(NULL, FALSE, FALSE, NULL) : NULL;
+    if (g_state.output_event != NULL) {
+        h = (HANDLE)_beginthreadex(NULL, 0, poll_thread_func, NULL, 0,
+                                   &thread_id);
+    } else {
+        h = NULL;
+    }
 
     if (h == NULL) {
+        if (g_state.output_event != NULL) {
+            CloseHandle(g_state.output_event);
+            g_state.output_event = NULL;
+        }
+        pool_put(ring_buf);
+        g_state.output_ring.base = NULL;
         DeleteCriticalSection(&g_state.output_lock);
         printf("[Note: Using synchronous polling mode]\n");
     } else {
@@ -118,14 +232,16 @@ static void stop_poll_thread(void)
         CloseHandle(g_state.poll_thread);
         g_state.poll_thread = NULL;
 
+        CloseHandle(g_state.output_event);
+        g_state.output_event = NULL;
+        pool_put(g_state.output_ring.base);
+        g_state.output_ring.base = NULL;
         DeleteCriticalSection(&g_state.output_lock);
     }
 }
 
 static int poll_sync(void)
 {
-    static char response[BUFFER_SIZE];
-    char path[256];
     cJSON *json;
     int had_output = 0;
 
@@ -133,24 +249,16 @@ static int poll_sync(void)
         return 0;
     }
 
-    handle_fileop();
-    handle_command();
-    handle_approval();
-
-    snprintf(path, sizeof(path), "/output?session_id=%s", g_state.session_id);
-
-    if (http_request("GET", path, NULL, response, sizeof(response)) ==
-        HTTP_OK) {
-        json = cJSON_Parse(response);
-        if (json) {
-            const cJSON *output = cJSON_GetObjectItem(json, "output");
-            if (cJSON_IsString(output) && output->valuestring[0]) {
-                printf("\r                              \r");
-                print_output(output->valuestring);
-                had_output = 1;
-            }
-            cJSON_Delete(json);
+    json = handle_sync(g_state.session_id, 1, 0, NULL);
+    if (json) {
+        const cJSON *output = cJSON_GetObjectItem(json, "output");
+        if (cJSON_IsString(output) && output->valuestring[0]) {
+            printf("\r                              \r");
+            print_output(output->valuestring);
+            had_output = 1;
         }
+        cJSON_Delete(json);
+        arena_reset();
     }
 
     return had_output;
@@ -166,12 +274,6 @@ static int check_pending_output(void)
     }
 
     EnterCriticalSection(&g_state.output_lock);
-    if (g_state.has_pending_output) {
-        printf("\r                              \r");
-        print_output(g_state.pending_output);
-        g_state.has_pending_output = 0;
-        had_output = 1;
-    }
     if (g_state.session_stopped) {
         g_state.session_stopped = 0;
         g_state.session_id[0] = '\0';
@@ -180,6 +282,9 @@ static int check_pending_output(void)
     }
     LeaveCriticalSection(&g_state.output_lock);
 
+    /* After the flag: output queued before the session ended is all here */
+    had_output = print_queued_output();
+
     if (session_ended) {
         printf("\n[Session ended]\n");
     }
@@ -191,7 +296,6 @@ static void read_input_line(char *input, size_t input_size)
 {
     int pos = 0;
     int prompted = 0;
-    int poll_counter = 0;
     int ch;
 
     while (g_state.running) {
@@ -208,12 +312,9 @@ static void read_input_line(char *input, size_t input_size)
             if (check_pending_output()) {
                 prompted = 0;
             }
-        } else {
-            if (++poll_counter >= POLL_INTERVAL_CYCLES) {
-                poll_counter = 0;
-                if (check_pending_output()) {
-                    prompted = 0;
-                }
+        } else if (sched_poll_delay(POLL_SLEEP_MS) == 0) {
+            if (check_pending_output()) {
+                prompted = 0;
             }
         }
 
@@ -263,6 +364,9 @@ static void print_banner(void)
 static void cleanup(void)
 {
     g_state.running = 0;
+    /* Fails a long poll in flight on the link so the thread can exit */
+    frame_close();
+    sched_kick();
     stop_poll_thread();
 
     if (g_state.logfile) {
@@ -271,7 +375,13 @@ static void cleanup(void)
         g_state.logfile = NULL;
     }
 
+    frame_cleanup();
+    handlers_cleanup();
+    http_cleanup();
+    sched_cleanup();
     WSACleanup();
+    arena_cleanup();
+    pool_cleanup();
 }
 
 int main(int argc, char *argv[])
@@ -287,8 +397,19 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    sched_init();
+    http_init();
+    handlers_init();
+    frame_init();
     config_load("client.ini");
 
+    /* Before the poll thread exists; it registers both arenas */
+    pool_init(g_state.memory_budget_kb);
+    arena_install();
+    arena_init(&s_main_arena, ARENA_SIZE);
+    arena_init(&s_poll_arena, ARENA_SIZE);
+    arena_enter(&s_main_arena);
+
     print_banner();
 
     start_poll_thread();
@@ -297,6 +418,7 @@ int main(int argc, char *argv[])
         read_input_line(input, sizeof(input));
 
         if (input[0] != '\0') {
+            sched_kick();
             process_input(input);
         }
     }
@@ -11,6 +11,7 @@
 #include <winsock2.h>
 #include <windows.h>
 #include "third_party/cJSON.h"
+#include "ring.h"
 
 #define BUFFER_SIZE 32768
 #define MAX_INPUT 1024
@@ -25,12 +26,28 @@
 
 #define HEARTBEAT_INTERVAL_MS 30000
 #define HTTP_TIMEOUT_SEC 10
+#define HTTP_MAX_CONNS 4
+#define HTTP_HEADER_MAX 4096
+#define HTTP_CHUNK_SIZE 4096
+#define MAX_RESPONSE_KB 1024
+#define MEMORY_BUDGET_KB 512
+/* Replies that carry no more than a status, an error or a session id */
+#define SMALL_RESPONSE_SIZE 1024
+#define OUTPUT_RING_SIZE BUFFER_SIZE
+/* Output asked for per poll, JSON-encoded; leaves room for the rest of a reply */
+#define OUTPUT_PAGE_BYTES (BUFFER_SIZE / 2)
 #define TRANSFER_TIMEOUT_SEC 30
 #define POLL_SLEEP_MS 1000
-#define POLL_BACKOFF_MS 2000
+#define LONG_POLL_WAIT_MS 15000
+#define LONG_POLL_IDLE_WAIT_MS 30000
 #define INPUT_SLEEP_MS 100
-#define POLL_INTERVAL_CYCLES 5
 #define POLL_TIMEOUT_CYCLES 120
+#define SCHED_ACTIVE_MS 60000
+#define SCHED_IDLE_MIN_MS 2000
+#define SCHED_IDLE_MAX_MS 60000
+#define SCHED_FAIL_THRESHOLD 2
+#define SCHED_RETRY_MIN_MS 2000
+#define SCHED_RETRY_MAX_MS 60000
 #define IDEMPOTENCY_CACHE_SIZE 16
 typedef enum {
     HTTP_OK = 0,
@@ -42,9 +59,20 @@ typedef enum {
     HTTP_ERR_NO_BODY = -6,
     HTTP_ERR_SERVER = -7,
     HTTP_ERR_TRUNCATED = -8,
-    HTTP_ERR_RESPONSE_TOO_LARGE = -9
+    HTTP_ERR_RESPONSE_TOO_LARGE = -9,
+    HTTP_ERR_OFFLINE = -10
 } HttpResult;
 
+/* Where Claude is in answering the last input, as reported by the server */
+typedef enum {
+    TURN_UNKNOWN = 0,
+    TURN_IDLE,
+    TURN_THINKING,
+    TURN_TOOL_RUNNING,
+    TURN_AWAITING_APPROVAL,
+    TURN_DONE
+} TurnState;
+
 typedef struct {
     char server_ip[64];
     int server_port;
@@ -58,15 +86,25 @@ typedef struct {
     DWORD last_heartbeat;
     HANDLE poll_thread;
     CRITICAL_SECTION output_lock;
-    char pending_output[BUFFER_SIZE];
-    int has_pending_output;
+    HANDLE output_event;
+    OutputRing output_ring; /* poll thread writes, main thread prints */
     int session_stopped;
     int has_pending_approval;
     int approval_in_progress;
     char approval_id[64];
     char approval_tool_name[128];
-    char approval_tool_input[BUFFER_SIZE];
+    char *approval_tool_input; /* pooled, handed to the main thread */
+    char lease_cmd_id[64];     /* command the poll thread is running */
+    DWORD lease_ms;            /* its lease; 0 if the server gave none */
+    DWORD lease_renewed;       /* tick of the last renewal */
     int skip_permissions;
+    int max_response_kb;
+    int memory_budget_kb;
+    int frame_protocol;
+    TurnState turn_state;
+    int turn_seq;
+    int turns_sent;
+    long output_next; /* server output log offset to read from next */
 } ClientState;
 
 extern ClientState g_state;
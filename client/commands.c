@@ -3,6 +3,11 @@
  */
 
 #include "commands.h"
+#include "arena.h"
+#include "frame.h"
+#include "http.h"
+#include "pool.h"
+#include "sched.h"
 #include "session.h"
 #include "transfer.h"
 #include "util.h"
@@ -53,6 +58,7 @@ static void cmd_server(const char *addr)
     if (g_state.poll_thread != NULL) {
         LeaveCriticalSection(&g_state.output_lock);
     }
+    http_reset_connections();
 
     printf("[Server set to %s:%d]\n", g_state.server_ip, g_state.server_port);
 }
@@ -94,6 +100,22 @@ static void cmd_log(const char *arg)
 
 static void cmd_status(void)
 {
+    long connects;
+    long reuses;
+    long polls;
+    long failed_fast;
+    long arena_peak;
+    long arena_size;
+    long arena_fallbacks;
+    PoolStats pool;
+    DWORD retry_ms;
+
+    http_get_stats(&connects, &reuses);
+    sched_get_stats(&polls, &failed_fast);
+    arena_get_stats(&arena_peak, &arena_size, &arena_fallbacks);
+    pool_get_stats(&pool);
+    retry_ms = sched_server_down();
+
     printf("\n");
     printf("Server: %s:%d\n", g_state.server_ip, g_state.server_port);
 
@@ -104,6 +126,42 @@ static void cmd_status(void)
         printf("Status: Not connected\n");
     }
 
+    if (retry_ms > 0) {
+        printf("Server health: unreachable, next try in %lus\n",
+               (unsigned long)(retry_ms + 999) / 1000);
+    } else {
+        printf("Server health: OK\n");
+    }
+
+    printf("HTTP: %ld connects, %ld saved by keep-alive\n", connects,
+           reuses);
+    printf("Polls: %ld, %ld requests skipped while server was down\n", polls,
+           failed_fast);
+    printf("Memory: %ld KB in use (main %ld KB, poll %ld KB), %ld KB cached, "
+           "peak %ld of %ld KB\n",
+           pool.in_use / 1024, pool.main_thread / 1024,
+           pool.other_threads / 1024, pool.cached / 1024, pool.peak / 1024,
+           pool.budget / 1024);
+    if (pool.denied > 0) {
+        printf("Memory: %ld requests over budget\n", pool.denied);
+    }
+    if (g_state.poll_thread != NULL) {
+        printf("Output: waited %ld times for the screen to catch up\n",
+               g_state.output_ring.stalls);
+    }
+    printf("JSON arena: peak %ld of %ld bytes, %ld allocations fell back to "
+           "the heap\n",
+           arena_peak, arena_size, arena_fallbacks);
+
+    if (frame_active()) {
+        long sent;
+        long received;
+
+        frame_get_stats(&sent, &received);
+        printf("Binary protocol: %ld bytes sent, %ld received\n", sent,
+               received);
+    }
+
     printf("\n");
 }
 
@@ -0,0 +1,660 @@
+/*
+ * evloop.c - Nonblocking HTTP requests driven by one select() loop
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include "evloop.h"
+
+#ifdef _WIN32
+typedef int ev_socklen;
+#define ev_close_socket closesocket
+#define ev_error() WSAGetLastError()
+#define EV_IN_PROGRESS(e) ((e) == WSAEWOULDBLOCK)
+#define EV_WOULD_BLOCK(e) ((e) == WSAEWOULDBLOCK)
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+typedef socklen_t ev_socklen;
+#define ev_close_socket close
+#define ev_error() errno
+#define EV_IN_PROGRESS(e) ((e) == EINPROGRESS)
+#define EV_WOULD_BLOCK(e) \
+    ((e) == EAGAIN || (e) == EWOULDBLOCK || (e) == EINTR)
+#endif
+
+/* Keeps a server that hung up from raising SIGPIPE on Linux */
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define EV_HEAD_MAX 4096
+#define EV_CHUNK 4096
+
+enum { EV_FREE = 0, EV_CONNECTING, EV_SENDING, EV_READING, EV_FINISHED };
+
+static unsigned long ev_now(void)
+{
+#ifdef _WIN32
+    return GetTickCount();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000UL +
+           (unsigned long)(ts.tv_nsec / 1000000L);
+#endif
+}
+
+/* Millisecond counters wrap; compare through a signed difference */
+static long ms_until(unsigned long when, unsigned long now)
+{
+    return (long)(when - now);
+}
+
+static int set_nonblocking(SOCKET sock)
+{
+#ifdef _WIN32
+    u_long on = 1;
+
+    return ioctlsocket(sock, FIONBIO, &on);
+#else
+    int flags = fcntl(sock, F_GETFL, 0);
+
+    return flags < 0 ? -1 : fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
+
+/* Case-insensitive check that the line at s starts with prefix */
+static int line_starts_with(const char *s, const char *end, const char *prefix)
+{
+    while (*prefix) {
+        char c;
+
+        if (s >= end) {
+            return 0;
+        }
+        c = *s++;
+        if (c >= 'A' && c <= 'Z') {
+            c = (char)(c - 'A' + 'a');
+        }
+        if (c != *prefix++) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int ev_parse_head(const char *head, size_t head_len, long *content_length,
+                  int *keep_alive)
+{
+    const char *end = head + head_len;
+    const char *line;
+    const char *next;
+    int close_after = 0;
+    int status = 0;
+
+    *content_length = -1;
+    *keep_alive = 0;
+
+    if (head_len < 5 || strncmp(head, "HTTP/", 5) != 0) {
+        return 0;
+    }
+    line = (const char *)memchr(head, ' ', head_len);
+    if (line) {
+        status = atoi(line + 1);
+    }
+
+    for (line = head; line < end; line = next) {
+        next = (const char *)memchr(line, '\n', (size_t)(end - line));
+        next = next ? next + 1 : end;
+
+        if (line_starts_with(line, next, "content-length:")) {
+            *content_length = atol(line + 15);
+        } else if (line_starts_with(line, next, "connection:")) {
+            const char *value = line + 11;
+
+            while (value < next && *value == ' ') {
+                value++;
+            }
+            close_after = line_starts_with(value, next, "close");
+        }
+    }
+
+    /* Without a length the body runs to EOF, so the socket is spent */
+    *keep_alive = *content_length >= 0 && !close_after;
+    return status;
+}
+
+static void finish(EvRequest *req, EvResult result)
+{
+    req->state = EV_FINISHED;
+    req->result = result;
+}
+
+static EvResult open_socket(EvLoop *loop, EvRequest *req)
+{
+    SOCKET sock;
+
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == INVALID_SOCKET) {
+        return EV_ERR_SOCKET;
+    }
+    if (set_nonblocking(sock) != 0) {
+        ev_close_socket(sock);
+        return EV_ERR_SOCKET;
+    }
+
+    loop->connects++;
+    req->sock = sock;
+    req->reused = 0;
+
+    if (connect(sock, (struct sockaddr *)&loop->addr, sizeof(loop->addr)) ==
+        0) {
+        req->state = EV_SENDING;
+        return EV_OK;
+    }
+    if (!EV_IN_PROGRESS(ev_error())) {
+        ev_close_socket(sock);
+        req->sock = INVALID_SOCKET;
+        return EV_ERR_CONNECT;
+    }
+
+    req->state = EV_CONNECTING;
+    return EV_OK;
+}
+
+/*
+ * A kept-alive socket the server had already closed: reconnect and send
+ * again, once. A request that went out whole and got no reply may have
+ * been acted on, so after that (sent set) only a GET goes again. Returns
+ * 0 if the failure was real and the caller should report it.
+ */
+static int retry_fresh(EvLoop *loop, EvRequest *req, int sent)
+{
+    EvResult rc;
+
+    if (!req->reused || req->in_len > 0 ||
+        (sent && strncmp(req->out, "GET ", 4) != 0)) {
+        return 0;
+    }
+
+    ev_close_socket(req->sock);
+    req->sock = INVALID_SOCKET;
+    req->out_pos = 0;
+
+    rc = open_socket(loop, req);
+    if (rc != EV_OK) {
+        finish(req, rc);
+    }
+    return 1;
+}
+
+static EvResult reserve(EvRequest *req, size_t need, size_t limit)
+{
+    size_t cap;
+    char *grown;
+
+    if (need <= req->in_cap) {
+        return EV_OK;
+    }
+    if (need > limit) {
+        return EV_ERR_TOO_LARGE;
+    }
+
+    cap = req->in_cap ? req->in_cap : EV_CHUNK;
+    while (cap < need) {
+        cap *= 2;
+    }
+    if (cap > limit) {
+        cap = limit;
+    }
+
+    grown = (char *)realloc(req->in, cap);
+    if (!grown) {
+        return EV_ERR_NOMEM;
+    }
+    req->in = grown;
+    req->in_cap = cap;
+    return EV_OK;
+}
+
+static void do_send(EvLoop *loop, EvRequest *req)
+{
+    while (req->out_pos < req->out_len) {
+        int n = send(req->sock, req->out + req->out_pos,
+                     (int)(req->out_len - req->out_pos), MSG_NOSIGNAL);
+
+        if (n < 0) {
+            if (EV_WOULD_BLOCK(ev_error())) {
+                return;
+            }
+            if (!retry_fresh(loop, req, 0)) {
+                finish(req, EV_ERR_SEND);
+            }
+            return;
+        }
+        req->out_pos += (size_t)n;
+    }
+
+    req->state = EV_READING;
+}
+
+/* The head is in: check it and size the buffer for the whole body */
+static EvResult got_head(EvLoop *loop, EvRequest *req)
+{
+    req->status = ev_parse_head(req->in, (size_t)req->head_len,
+                                &req->content_length, &req->keep_alive);
+    if (req->status == 0) {
+        return EV_ERR_NO_BODY;
+    }
+    if (req->content_length < 0) {
+        return EV_OK;
+    }
+    if ((size_t)req->content_length > loop->max_body) {
+        return EV_ERR_TOO_LARGE;
+    }
+    return reserve(req, (size_t)req->head_len + req->content_length + 1,
+                   (size_t)req->head_len + loop->max_body + 1);
+}
+
+static int body_complete(const EvRequest *req)
+{
+    return req->head_len >= 0 && req->content_length >= 0 &&
+           req->in_len - (size_t)req->head_len >=
+               (size_t)req->content_length;
+}
+
+static void do_read(EvLoop *loop, EvRequest *req)
+{
+    for (;;) {
+        size_t limit = (req->head_len < 0 ? EV_HEAD_MAX : req->head_len) +
+                       loop->max_body + 1;
+        size_t want = EV_CHUNK;
+        EvResult rc;
+        int n;
+
+        if (req->in_len + want + 1 > limit) {
+            want = limit - req->in_len - 1;
+        }
+        rc = want > 0 ? reserve(req, req->in_len + want + 1, limit)
+                      : EV_ERR_TOO_LARGE;
+        if (rc != EV_OK) {
+            finish(req, rc);
+            return;
+        }
+
+        n = recv(req->sock, req->in + req->in_len, (int)want, 0);
+        if (n < 0 && EV_WOULD_BLOCK(ev_error())) {
+            return;
+        }
+        if (n <= 0) {
+            if (retry_fresh(loop, req, 1)) {
+                return;
+            }
+            if (req->head_len < 0) {
+                finish(req, req->in_len == 0 && !req->reused ? EV_ERR_SEND
+                                                             : EV_ERR_NO_BODY);
+            } else if (req->content_length >= 0 || n < 0) {
+                finish(req, EV_ERR_TRUNCATED);
+            } else {
+                /* EOF is the normal end of an unframed body */
+                finish(req, req->status >= 200 && req->status < 300
+                                ? EV_OK
+                                : EV_ERR_STATUS);
+            }
+            return;
+        }
+
+        req->in_len += (size_t)n;
+        req->in[req->in_len] = '\0';
+
+        if (req->head_len < 0) {
+            const char *end = strstr(req->in, "\r\n\r\n");
+
+            if (!end) {
+                if (req->in_len >= EV_HEAD_MAX) {
+                    finish(req, EV_ERR_NO_BODY);
+                    return;
+                }
+                continue;
+            }
+            req->head_len = (long)(end + 4 - req->in);
+            rc = got_head(loop, req);
+            if (rc != EV_OK) {
+                finish(req, rc);
+                return;
+            }
+        }
+
+        if (body_complete(req)) {
+            /* Anything past the body is garbage; don't reuse the socket */
+            if (req->in_len - (size_t)req->head_len >
+                (size_t)req->content_length) {
+                req->keep_alive = 0;
+            }
+            finish(req, req->status >= 200 && req->status < 300
+                            ? EV_OK
+                            : EV_ERR_STATUS);
+            return;
+        }
+    }
+}
+
+static void connected(EvLoop *loop, EvRequest *req)
+{
+    int so_error = 0;
+    ev_socklen so_len = sizeof(so_error);
+
+    if (getsockopt(req->sock, SOL_SOCKET, SO_ERROR, (char *)&so_error,
+                   &so_len) < 0 ||
+        so_error != 0) {
+        finish(req, EV_ERR_CONNECT);
+        return;
+    }
+
+    req->state = EV_SENDING;
+    do_send(loop, req);
+}
+
+static void park(EvLoop *loop, SOCKET sock)
+{
+    int i;
+
+    for (i = 0; i < EV_MAX_REQUESTS; i++) {
+        if (loop->idle[i] == INVALID_SOCKET) {
+            loop->idle[i] = sock;
+            return;
+        }
+    }
+    ev_close_socket(sock);
+}
+
+static SOCKET unpark(EvLoop *loop)
+{
+    SOCKET sock;
+    int i;
+
+    for (i = 0; i < EV_MAX_REQUESTS; i++) {
+        if (loop->idle[i] != INVALID_SOCKET) {
+            sock = loop->idle[i];
+            loop->idle[i] = INVALID_SOCKET;
+            return sock;
+        }
+    }
+    return INVALID_SOCKET;
+}
+
+static void close_idle(EvLoop *loop)
+{
+    SOCKET sock;
+
+    while ((sock = unpark(loop)) != INVALID_SOCKET) {
+        ev_close_socket(sock);
+    }
+}
+
+/* Free the slot first, so the callback may start a request in it */
+static void complete(EvLoop *loop, EvRequest *req)
+{
+    EvDone done = req->done;
+    void *ctx = req->ctx;
+    char *in = req->in;
+    EvResult result = req->result;
+    int status = req->status;
+    char *body = NULL;
+    size_t len = 0;
+    int reusable = 0;
+
+    if ((result == EV_OK || result == EV_ERR_STATUS) && in != NULL) {
+        body = in + req->head_len;
+        len = req->in_len - (size_t)req->head_len;
+        if (req->content_length >= 0 && len > (size_t)req->content_length) {
+            len = (size_t)req->content_length;
+        }
+        in[req->head_len + len] = '\0';
+        reusable = req->keep_alive;
+    }
+
+    if (req->sock != INVALID_SOCKET) {
+        if (reusable) {
+            park(loop, req->sock);
+        } else {
+            ev_close_socket(req->sock);
+        }
+    }
+
+    free(req->out);
+    memset(req, 0, sizeof(*req));
+    req->state = EV_FREE;
+    req->sock = INVALID_SOCKET;
+
+    if (done) {
+        done(ctx, result, status, body, len);
+    }
+    free(in);
+}
+
+void ev_init(EvLoop *loop, const char *ip, int port, size_t max_body)
+{
+    int i;
+
+    memset(loop, 0, sizeof(*loop));
+    for (i = 0; i < EV_MAX_REQUESTS; i++) {
+        loop->reqs[i].state = EV_FREE;
+        loop->reqs[i].sock = INVALID_SOCKET;
+        loop->idle[i] = INVALID_SOCKET;
+    }
+    loop->addr.sin_family = AF_INET;
+    loop->max_body = max_body;
+    ev_set_server(loop, ip, port);
+}
+
+void ev_set_server(EvLoop *loop, const char *ip, int port)
+{
+    unsigned long addr = inet_addr(ip);
+    unsigned short nport = htons((unsigned short)port);
+
+    if (loop->addr.sin_addr.s_addr == addr && loop->addr.sin_port == nport) {
+        return;
+    }
+
+    close_idle(loop);
+    loop->addr.sin_addr.s_addr = addr;
+    loop->addr.sin_port = nport;
+}
+
+int ev_start(EvLoop *loop, char *request, size_t len, long timeout_ms,
+             EvDone done, void *ctx)
+{
+    EvRequest *req = NULL;
+    EvResult rc;
+    int i;
+
+    for (i = 0; i < EV_MAX_REQUESTS; i++) {
+        if (loop->reqs[i].state == EV_FREE) {
+            req = &loop->reqs[i];
+            break;
+        }
+    }
+    if (!req) {
+        free(request);
+        return -1;
+    }
+
+    req->out = request;
+    req->out_len = len;
+    req->out_pos = 0;
+    req->in = NULL;
+    req->in_len = 0;
+    req->in_cap = 0;
+    req->head_len = -1;
+    req->content_length = -1;
+    req->status = 0;
+    req->keep_alive = 0;
+    req->result = EV_OK;
+    req->deadline = ev_now() + (unsigned long)timeout_ms;
+    req->done = done;
+    req->ctx = ctx;
+
+    req->sock = unpark(loop);
+    if (req->sock != INVALID_SOCKET) {
+        loop->reuses++;
+        req->reused = 1;
+        req->state = EV_SENDING;
+        return 0;
+    }
+
+    /* Failures surface through done on the next ev_run */
+    rc = open_socket(loop, req);
+    if (rc != EV_OK) {
+        finish(req, rc);
+    }
+    return 0;
+}
+
+int ev_room(const EvLoop *loop)
+{
+    int free_slots = 0;
+    int i;
+
+    for (i = 0; i < EV_MAX_REQUESTS; i++) {
+        if (loop->reqs[i].state == EV_FREE) {
+            free_slots++;
+        }
+    }
+    return free_slots;
+}
+
+int ev_active(const EvLoop *loop)
+{
+    return EV_MAX_REQUESTS - ev_room(loop);
+}
+
+int ev_run(EvLoop *loop, long timeout_ms)
+{
+    fd_set readfds;
+    fd_set writefds;
+    fd_set exceptfds;
+    struct timeval tv;
+    unsigned long now = ev_now();
+    long wait = timeout_ms;
+    int maxfd = 0;
+    int armed = 0;
+    int i;
+
+    FD_ZERO(&readfds);
+    FD_ZERO(&writefds);
+    FD_ZERO(&exceptfds);
+
+    for (i = 0; i < EV_MAX_REQUESTS; i++) {
+        EvRequest *req = &loop->reqs[i];
+        long left;
+
+        req->armed = 0;
+        if (req->state == EV_FREE) {
+            continue;
+        }
+        if (req->state == EV_FINISHED) {
+            wait = 0;
+            continue;
+        }
+
+        left = ms_until(req->deadline, now);
+        if (left < wait) {
+            wait = left > 0 ? left : 0;
+        }
+
+        if (req->state == EV_READING) {
+            FD_SET(req->sock, &readfds);
+        } else {
+            FD_SET(req->sock, &writefds);
+            /* Winsock reports a refused connect here, not as writable */
+            FD_SET(req->sock, &exceptfds);
+        }
+        if ((int)req->sock > maxfd) {
+            maxfd = (int)req->sock;
+        }
+        req->armed = 1;
+        armed++;
+    }
+
+    if (armed > 0) {
+        tv.tv_sec = wait / 1000;
+        tv.tv_usec = (wait % 1000) * 1000;
+        if (select(maxfd + 1, &readfds, &writefds, &exceptfds, &tv) < 0) {
+            FD_ZERO(&readfds);
+            FD_ZERO(&writefds);
+            FD_ZERO(&exceptfds);
+        }
+    }
+
+    for (i = 0; i < EV_MAX_REQUESTS; i++) {
+        EvRequest *req = &loop->reqs[i];
+
+        if (!req->armed) {
+            continue;
+        }
+        if (req->state == EV_CONNECTING &&
+            (FD_ISSET(req->sock, &writefds) ||
+             FD_ISSET(req->sock, &exceptfds))) {
+            connected(loop, req);
+        } else if (req->state == EV_SENDING &&
+                   FD_ISSET(req->sock, &writefds)) {
+            do_send(loop, req);
+        } else if (req->state == EV_READING &&
+                   FD_ISSET(req->sock, &readfds)) {
+            do_read(loop, req);
+        }
+    }
+
+    now = ev_now();
+    for (i = 0; i < EV_MAX_REQUESTS; i++) {
+        EvRequest *req = &loop->reqs[i];
+
+        if (req->state != EV_FREE && req->state != EV_FINISHED &&
+            ms_until(req->deadline, now) <= 0) {
+            if (req->state == EV_CONNECTING) {
+                finish(req, EV_ERR_CONNECT);
+            } else if (req->head_len >= 0) {
+                finish(req, EV_ERR_TRUNCATED);
+            } else {
+                finish(req, req->in_len == 0 ? EV_ERR_TIMEOUT
+                                             : EV_ERR_NO_BODY);
+            }
+        }
+    }
+
+    for (i = 0; i < EV_MAX_REQUESTS; i++) {
+        if (loop->reqs[i].state == EV_FINISHED) {
+            complete(loop, &loop->reqs[i]);
+        }
+    }
+
+    return ev_active(loop);
+}
+
+void ev_close(EvLoop *loop)
+{
+    int i;
+
+    for (i = 0; i < EV_MAX_REQUESTS; i++) {
+        EvRequest *req = &loop->reqs[i];
+
+        if (req->state == EV_FREE) {
+            continue;
+        }
+        if (req->state != EV_FINISHED) {
+            finish(req, EV_ERR_ABORTED);
+        }
+        req->keep_alive = 0;
+        complete(loop, req);
+    }
+    close_idle(loop);
+}
@@ -0,0 +1,129 @@
+/*
+ * evloop.h - Nonblocking HTTP requests driven by one select() loop
+ *
+ * Each request is a small state machine on its own socket: connect, send,
+ * read the head, read the body. ev_run() waits on every socket at once and
+ * advances whichever are ready, so a slow request never holds up the
+ * others. Only BSD socket calls are used (Winsock spellings are mapped
+ * below), so the loop builds on Linux as well as under Watcom.
+ *
+ * A loop belongs to one thread; completion callbacks run on that thread
+ * from inside ev_run() and may start further requests.
+ */
+
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+typedef int SOCKET;
+#ifndef INVALID_SOCKET
+#define INVALID_SOCKET (-1)
+#endif
+#endif
+
+#define EV_MAX_REQUESTS 8
+
+typedef enum {
+    EV_OK = 0,
+    EV_ERR_SOCKET = -1,
+    EV_ERR_CONNECT = -2,
+    EV_ERR_SEND = -3,
+    EV_ERR_TIMEOUT = -4,
+    EV_ERR_NO_BODY = -5,
+    EV_ERR_STATUS = -6,
+    EV_ERR_TRUNCATED = -7,
+    EV_ERR_TOO_LARGE = -8,
+    EV_ERR_NOMEM = -9,
+    EV_ERR_ABORTED = -10
+} EvResult;
+
+/*
+ * Called once per request. body is the response body, NUL-terminated and
+ * only valid during the call (the callee may modify it in place); it is
+ * set for EV_OK and EV_ERR_STATUS and NULL otherwise.
+ */
+typedef void (*EvDone)(void *ctx, EvResult result, int status, char *body,
+                       size_t len);
+
+typedef struct {
+    int state;
+    SOCKET sock;
+    int reused;
+    int armed;
+    char *out;
+    size_t out_len;
+    size_t out_pos;
+    char *in;
+    size_t in_len;
+    size_t in_cap;
+    long head_len;
+    long content_length;
+    int status;
+    int keep_alive;
+    EvResult result;
+    unsigned long deadline;
+    EvDone done;
+    void *ctx;
+} EvRequest;
+
+typedef struct {
+    struct sockaddr_in addr;
+    size_t max_body;
+    EvRequest reqs[EV_MAX_REQUESTS];
+    SOCKET idle[EV_MAX_REQUESTS];
+    long connects;
+    long reuses;
+} EvLoop;
+
+/* Bodies over max_body bytes fail with EV_ERR_TOO_LARGE */
+void ev_init(EvLoop *loop, const char *ip, int port, size_t max_body);
+
+/* Point the loop at another server; kept-alive sockets are dropped */
+void ev_set_server(EvLoop *loop, const char *ip, int port);
+
+/*
+ * Start sending request (a complete HTTP/1.1 request in a malloc'd buffer
+ * that the loop frees, also on failure) and give up after timeout_ms.
+ * Returns 0 if the request was queued, in which case done is always
+ * called later from ev_run(); -1 if no slot was free, in which case done
+ * is never called.
+ */
+int ev_start(EvLoop *loop, char *request, size_t len, long timeout_ms,
+             EvDone done, void *ctx);
+
+/* Free slots for ev_start */
+int ev_room(const EvLoop *loop);
+
+/* Requests still in flight */
+int ev_active(const EvLoop *loop);
+
+/*
+ * Wait up to timeout_ms for any socket to become ready, advance every
+ * request that can make progress and run callbacks for the ones that
+ * finished. Returns ev_active() afterwards.
+ */
+int ev_run(EvLoop *loop, long timeout_ms);
+
+/* Fail everything in flight with EV_ERR_ABORTED and close all sockets */
+void ev_close(EvLoop *loop);
+
+/*
+ * Parse a response head of head_len bytes (through the blank line).
+ * *content_length is -1 when absent; *keep_alive is set when the socket
+ * can carry another request once the body has been read. Returns the
+ * status code, or 0 if this is not an HTTP status line.
+ */
+int ev_parse_head(const char *head, size_t head_len, long *content_length,
+                  int *keep_alive);
+
+#endif /* EVLOOP_H */
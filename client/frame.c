@@ -0,0 +1,968 @@
+/*
+ * frame.c - Binary frame protocol
+ */
+
+#include "frame.h"
+#include "http.h"
+#include "util.h"
+
+static void put_u16(char *p, unsigned int value)
+{
+    p[0] = (char)(value & 0xFF);
+    p[1] = (char)((value >> 8) & 0xFF);
+}
+
+static void put_u32(char *p, unsigned long value)
+{
+    p[0] = (char)(value & 0xFF);
+    p[1] = (char)((value >> 8) & 0xFF);
+    p[2] = (char)((value >> 16) & 0xFF);
+    p[3] = (char)((value >> 24) & 0xFF);
+}
+
+static unsigned int get_u16(const char *p)
+{
+    const unsigned char *u = (const unsigned char *)p;
+    return (unsigned int)u[0] | ((unsigned int)u[1] << 8);
+}
+
+static unsigned long get_u32(const char *p)
+{
+    const unsigned char *u = (const unsigned char *)p;
+    return (unsigned long)u[0] | ((unsigned long)u[1] << 8) |
+           ((unsigned long)u[2] << 16) | ((unsigned long)u[3] << 24);
+}
+
+void fbuf_init(FrameBuf *b)
+{
+    b->data = NULL;
+    b->len = 0;
+    b->cap = 0;
+    b->failed = 0;
+}
+
+void fbuf_free(FrameBuf *b)
+{
+    free(b->data);
+    fbuf_init(b);
+}
+
+static int fbuf_reserve(FrameBuf *b, size_t extra)
+{
+    size_t need = b->len + extra;
+    size_t cap;
+    char *grown;
+
+    if (b->failed) {
+        return -1;
+    }
+    if (need <= b->cap) {
+        return 0;
+    }
+    if (need > (size_t)FRAME_MAX_PAYLOAD) {
+        b->failed = 1;
+        return -1;
+    }
+
+    cap = b->cap ? b->cap : 256;
+    while (cap < need) {
+        cap *= 2;
+    }
+
+    grown = (char *)realloc(b->data, cap);
+    if (!grown) {
+        b->failed = 1;
+        return -1;
+    }
+    b->data = grown;
+    b->cap = cap;
+    return 0;
+}
+
+/* Append bytes without a length prefix */
+static void fbuf_append(FrameBuf *b, const char *data, size_t len)
+{
+    if (fbuf_reserve(b, len) < 0) {
+        return;
+    }
+    if (len > 0) {
+        memcpy(b->data + b->len, data, len);
+        b->len += len;
+    }
+}
+
+void fbuf_add_int(FrameBuf *b, long value)
+{
+    if (fbuf_reserve(b, 4) < 0) {
+        return;
+    }
+    put_u32(b->data + b->len, (unsigned long)value);
+    b->len += 4;
+}
+
+void fbuf_add_bytes(FrameBuf *b, const char *data, size_t len)
+{
+    fbuf_add_int(b, (long)len);
+    fbuf_append(b, data, len);
+}
+
+void fbuf_add_str(FrameBuf *b, const char *s)
+{
+    if (!s) {
+        s = "";
+    }
+    fbuf_add_bytes(b, s, strlen(s));
+}
+
+void frd_init(FrameReader *r, const char *data, size_t len)
+{
+    r->data = data;
+    r->len = len;
+    r->pos = 0;
+    r->failed = 0;
+}
+
+long frd_int(FrameReader *r)
+{
+    unsigned long v;
+
+    if (r->failed || r->len - r->pos < 4) {
+        r->failed = 1;
+        return 0;
+    }
+    v = get_u32(r->data + r->pos);
+    r->pos += 4;
+
+    /* Sign-extend; long may be wider than 32 bits */
+    if (v & 0x80000000UL) {
+        return -(long)((~v & 0xFFFFFFFFUL) + 1);
+    }
+    return (long)v;
+}
+
+const char *frd_bytes(FrameReader *r, size_t *len)
+{
+    const char *p;
+    long n = frd_int(r);
+
+    *len = 0;
+    if (r->failed || n < 0 || (size_t)n > r->len - r->pos) {
+        r->failed = 1;
+        return NULL;
+    }
+
+    p = r->data + r->pos;
+    r->pos += (size_t)n;
+    *len = (size_t)n;
+    return p;
+}
+
+char *frd_str(FrameReader *r)
+{
+    size_t len;
+    const char *p = frd_bytes(r, &len);
+    char *s;
+
+    if (!p) {
+        return NULL;
+    }
+
+    s = (char *)malloc(len + 1);
+    if (!s) {
+        return NULL;
+    }
+    memcpy(s, p, len);
+    s[len] = '\0';
+    return s;
+}
+
+/*
+ * Called with the link lock held for each frame on the waiter's stream.
+ * Return 0 to keep waiting, 1 when the call succeeded, -1 when it failed.
+ */
+typedef int (*FrameHandler)(void *ctx, int type, const char *payload,
+                            size_t len);
+
+typedef struct {
+    unsigned short stream;
+    FrameHandler handler;
+    void *ctx;
+    volatile LONG done;
+    volatile DWORD last_activity;
+} FrameWaiter;
+
+/*
+ * Whichever waiting thread claims s_reading reads frames off the socket
+ * and hands each to the waiter for its stream, until its own call is done.
+ * Then it lets go and wakes the others, one of which takes over.
+ */
+static SOCKET s_sock = INVALID_SOCKET;
+static volatile LONG s_active = 0;
+static volatile LONG s_reading = 0;
+static volatile LONG s_next_stream = 0;
+static volatile LONG s_bytes_sent = 0;
+static volatile LONG s_bytes_received = 0;
+static CRITICAL_SECTION s_lock;
+static HANDLE s_wake = NULL;
+static FrameWaiter *s_waiters[FRAME_MAX_WAITERS];
+static int s_initialized = 0;
+
+void frame_init(void)
+{
+    int i;
+
+    if (s_initialized) {
+        return;
+    }
+
+    for (i = 0; i < FRAME_MAX_WAITERS; i++) {
+        s_waiters[i] = NULL;
+    }
+
+    InitializeCriticalSection(&s_lock);
+    s_wake = CreateEvent(NULL, FALSE, FALSE, NULL);
+    s_initialized = 1;
+}
+
+void frame_cleanup(void)
+{
+    if (!s_initialized) {
+        return;
+    }
+
+    frame_close();
+
+    if (s_wake) {
+        CloseHandle(s_wake);
+        s_wake = NULL;
+    }
+    DeleteCriticalSection(&s_lock);
+    s_initialized = 0;
+}
+
+int frame_active(void)
+{
+    return s_initialized && s_active;
+}
+
+void frame_get_stats(long *sent, long *received)
+{
+    *sent = (long)s_bytes_sent;
+    *received = (long)s_bytes_received;
+}
+
+/* Caller holds s_lock. Fails every outstanding call. */
+static void link_fail_locked(void)
+{
+    int i;
+
+    if (s_active) {
+        s_active = 0;
+        closesocket(s_sock);
+        s_sock = INVALID_SOCKET;
+    }
+
+    for (i = 0; i < FRAME_MAX_WAITERS; i++) {
+        if (s_waiters[i] && !s_waiters[i]->done) {
+            s_waiters[i]->done = -1;
+        }
+    }
+}
+
+void frame_close(void)
+{
+    if (!s_initialized) {
+        return;
+    }
+
+    EnterCriticalSection(&s_lock);
+    link_fail_locked();
+    LeaveCriticalSection(&s_lock);
+    SetEvent(s_wake);
+}
+
+static int send_all(SOCKET sock, const char *data, size_t len)
+{
+    size_t sent = 0;
+
+    while (sent < len) {
+        int n = send(sock, data + sent, (int)(len - sent), 0);
+        if (n <= 0) {
+            return -1;
+        }
+        sent += (size_t)n;
+    }
+    return 0;
+}
+
+static int recv_all(SOCKET sock, char *data, size_t len)
+{
+    size_t got = 0;
+
+    while (got < len) {
+        fd_set readfds;
+        struct timeval tv;
+        int n;
+
+        FD_ZERO(&readfds);
+        FD_SET(sock, &readfds);
+        tv.tv_sec = TRANSFER_TIMEOUT_SEC;
+        tv.tv_usec = 0;
+
+        if (select((int)sock + 1, &readfds, NULL, NULL, &tv) <= 0) {
+            return -1;
+        }
+
+        n = recv(sock, data + got, (int)(len - got), 0);
+        if (n <= 0) {
+            return -1;
+        }
+        got += (size_t)n;
+    }
+    return 0;
+}
+
+/* Small frames go out in a single send so the header is not a packet */
+#define FRAME_COALESCE_MAX 1024
+
+static int write_frame(SOCKET sock, int type, int priority,
+                       unsigned short stream, const char *payload, size_t len)
+{
+    char small[FRAME_HEADER_SIZE + FRAME_COALESCE_MAX];
+
+    small[0] = (char)type;
+    small[1] = (char)priority;
+    put_u16(small + 2, stream);
+    put_u32(small + 4, (unsigned long)len);
+
+    if (len <= FRAME_COALESCE_MAX) {
+        if (len > 0) {
+            memcpy(small + FRAME_HEADER_SIZE, payload, len);
+        }
+        return send_all(sock, small, FRAME_HEADER_SIZE + len);
+    }
+
+    if (send_all(sock, small, FRAME_HEADER_SIZE) < 0) {
+        return -1;
+    }
+    return send_all(sock, payload, len);
+}
+
+/* Send one frame; a failed send takes the link down */
+static int send_frame(int type, int priority, unsigned short stream,
+                      const char *payload, size_t len)
+{
+    int rc = -1;
+
+    EnterCriticalSection(&s_lock);
+    if (s_active) {
+        rc = write_frame(s_sock, type, priority, stream, payload, len);
+        if (rc < 0) {
+            link_fail_locked();
+        } else {
+            InterlockedExchangeAdd(&s_bytes_sent,
+                                   (LONG)(FRAME_HEADER_SIZE + len));
+        }
+    }
+    LeaveCriticalSection(&s_lock);
+
+    if (rc < 0) {
+        SetEvent(s_wake);
+    }
+    return rc;
+}
+
+/*
+ * Read one frame and hand it to its waiter. Returns 1 if a frame was
+ * dispatched, 0 if none arrived within timeout_ms, -1 if the link broke.
+ */
+static int read_frame(SOCKET sock, DWORD timeout_ms)
+{
+    char header[FRAME_HEADER_SIZE];
+    fd_set readfds;
+    struct timeval tv;
+    unsigned long len;
+    unsigned int stream;
+    char *payload;
+    int i;
+
+    FD_ZERO(&readfds);
+    FD_SET(sock, &readfds);
+    tv.tv_sec = (long)(timeout_ms / 1000);
+    tv.tv_usec = (long)(timeout_ms % 1000) * 1000;
+
+    if (select((int)sock + 1, &readfds, NULL, NULL, &tv) <= 0) {
+        return 0;
+    }
+
+    if (recv_all(sock, header, FRAME_HEADER_SIZE) < 0) {
+        return -1;
+    }
+
+    len = get_u32(header + 4);
+    if (len > (unsigned long)FRAME_MAX_PAYLOAD) {
+        return -1;
+    }
+
+    payload = (char *)malloc(len + 1);
+    if (!payload) {
+        return -1;
+    }
+    if (len > 0 && recv_all(sock, payload, len) < 0) {
+        free(payload);
+        return -1;
+    }
+    InterlockedExchangeAdd(&s_bytes_received,
+                           (LONG)(FRAME_HEADER_SIZE + len));
+
+    /* Frames for a call that already gave up are dropped */
+    stream = get_u16(header + 2);
+    EnterCriticalSection(&s_lock);
+    for (i = 0; i < FRAME_MAX_WAITERS; i++) {
+        FrameWaiter *w = s_waiters[i];
+        if (w && w->stream == stream && !w->done) {
+            int rc = w->handler(w->ctx, (unsigned char)header[0], payload,
+                                len);
+            w->last_activity = GetTickCount();
+            if (rc != 0) {
+                w->done = rc > 0 ? 1 : -1;
+            }
+            break;
+        }
+    }
+    LeaveCriticalSection(&s_lock);
+
+    free(payload);
+    return 1;
+}
+
+/* Register a call on a fresh stream id. Returns -1 if the link is down. */
+static int begin_call(FrameWaiter *w, FrameHandler handler, void *ctx)
+{
+    int rc = -1;
+    int i;
+
+    w->stream = (unsigned short)(InterlockedIncrement(&s_next_stream) &
+                                 0xFFFF);
+    w->handler = handler;
+    w->ctx = ctx;
+    w->done = 0;
+    w->last_activity = GetTickCount();
+
+    if (!frame_active()) {
+        return -1;
+    }
+
+    EnterCriticalSection(&s_lock);
+    if (s_active) {
+        for (i = 0; i < FRAME_MAX_WAITERS; i++) {
+            if (s_waiters[i] == NULL) {
+                s_waiters[i] = w;
+                rc = 0;
+                break;
+            }
+        }
+    }
+    LeaveCriticalSection(&s_lock);
+
+    return rc;
+}
+
+/*
+ * Wait until the call completes, fails, or goes timeout_sec without a
+ * frame on its stream. Always unregisters. Returns 0 on success.
+ */
+static int wait_call(FrameWaiter *w, long timeout_sec)
+{
+    DWORD limit = (DWORD)timeout_sec * 1000;
+    int i;
+
+    while (!w->done) {
+        DWORD idle = GetTickCount() - w->last_activity;
+        if (idle >= limit) {
+            break;
+        }
+
+        if (InterlockedExchange(&s_reading, 1) == 0) {
+            SOCKET sock = s_sock;
+
+            while (!w->done && s_active) {
+                idle = GetTickCount() - w->last_activity;
+                if (idle >= limit) {
+                    break;
+                }
+                if (read_frame(sock, limit - idle) < 0) {
+                    EnterCriticalSection(&s_lock);
+                    if (s_sock == sock) {
+                        link_fail_locked();
+                    }
+                    LeaveCriticalSection(&s_lock);
+                    break;
+                }
+            }
+
+            InterlockedExchange(&s_reading, 0);
+            SetEvent(s_wake);
+        } else {
+            WaitForSingleObject(s_wake, FRAME_HANDOFF_MS);
+        }
+
+        if (!s_active) {
+            break;
+        }
+    }
+
+    EnterCriticalSection(&s_lock);
+    for (i = 0; i < FRAME_MAX_WAITERS; i++) {
+        if (s_waiters[i] == w) {
+            s_waiters[i] = NULL;
+        }
+    }
+    LeaveCriticalSection(&s_lock);
+
+    return w->done > 0 ? 0 : -1;
+}
+
+/* Record the message of an ERROR frame */
+static void log_frame_error(const char *context, const char *payload,
+                            size_t len)
+{
+    FrameReader r;
+    char *message;
+
+    frd_init(&r, payload, len);
+    message = frd_str(&r);
+    log_error(context, message ? message : "Server error");
+    free(message);
+}
+
+/* Send a single-frame request and wait for ACK or ERROR */
+static int on_ack(void *ctx, int type, const char *payload, size_t len)
+{
+    if (type == FRAME_ACK) {
+        return 1;
+    }
+    if (type == FRAME_ERROR) {
+        log_frame_error((const char *)ctx, payload, len);
+        return -1;
+    }
+    return 0;
+}
+
+static int call_ack(int type, const FrameBuf *request, const char *context)
+{
+    FrameWaiter w;
+
+    if (request->failed) {
+        return -1;
+    }
+    if (begin_call(&w, on_ack, (void *)context) < 0) {
+        return -1;
+    }
+
+    send_frame(type, FRAME_PRIO_CONTROL, w.stream, request->data,
+               request->len);
+    return wait_call(&w, HTTP_TIMEOUT_SEC);
+}
+
+int frame_open(int port, const char *session_id)
+{
+    SOCKET sock;
+    FrameBuf hello;
+    char header[FRAME_HEADER_SIZE];
+    char payload[256];
+    unsigned long len;
+    BOOL nodelay = TRUE;
+    int rc;
+
+    if (!s_initialized) {
+        return -1;
+    }
+
+    frame_close();
+
+    if (http_connect(port, &sock) != HTTP_OK) {
+        return -1;
+    }
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&nodelay,
+               sizeof(nodelay));
+
+    fbuf_init(&hello);
+    fbuf_add_str(&hello, API_KEY);
+    fbuf_add_str(&hello, session_id);
+
+    rc = hello.failed ? -1
+                      : write_frame(sock, FRAME_HELLO, FRAME_PRIO_CONTROL, 0,
+                                    hello.data, hello.len);
+    fbuf_free(&hello);
+
+    if (rc == 0) {
+        rc = recv_all(sock, header, FRAME_HEADER_SIZE);
+    }
+    if (rc == 0) {
+        len = get_u32(header + 4);
+        if (len > sizeof(payload) ||
+            (len > 0 && recv_all(sock, payload, len) < 0)) {
+            rc = -1;
+        } else if ((unsigned char)header[0] != FRAME_HELLO_OK) {
+            if ((unsigned char)header[0] == FRAME_ERROR) {
+                log_frame_error("frame_open", payload, len);
+            }
+            rc = -1;
+        }
+    }
+
+    if (rc < 0) {
+        closesocket(sock);
+        return -1;
+    }
+
+    EnterCriticalSection(&s_lock);
+    s_sock = sock;
+    s_active = 1;
+    LeaveCriticalSection(&s_lock);
+
+    return 0;
+}
+
+typedef struct {
+    cJSON *json;
+    FrameBuf output;
+    const char *context;
+} SyncCall;
+
+static void add_field(cJSON *obj, const char *name, FrameReader *r)
+{
+    char *value = frd_str(r);
+    if (value) {
+        cJSON_AddStringToObject(obj, name, value);
+        free(value);
+    }
+}
+
+static int on_sync(void *ctx, int type, const char *payload, size_t len)
+{
+    SyncCall *call = (SyncCall *)ctx;
+    FrameReader r;
+    cJSON *item;
+    const char *text;
+    size_t text_len;
+
+    frd_init(&r, payload, len);
+
+    switch (type) {
+    case FRAME_OUTPUT:
+        text = frd_bytes(&r, &text_len);
+        if (text) {
+            fbuf_append(&call->output, text, text_len);
+        }
+        break;
+    case FRAME_FILE_OP:
+        item = cJSON_AddObjectToObject(call->json, "file_op");
+        if (item) {
+            cJSON_AddTrueToObject(item, "has_pending");
+            add_field(item, "op_id", &r);
+            add_field(item, "operation", &r);
+            add_field(item, "path", &r);
+            add_field(item, "content", &r);
+            if (r.pos < r.len) {
+                cJSON_AddNumberToObject(item, "priority", frd_int(&r));
+            }
+        }
+        break;
+    case FRAME_COMMAND:
+        item = cJSON_AddObjectToObject(call->json, "command");
+        if (item) {
+            cJSON_AddTrueToObject(item, "has_pending");
+            add_field(item, "cmd_id", &r);
+            add_field(item, "command", &r);
+            add_field(item, "working_directory", &r);
+            if (r.pos < r.len) {
+                cJSON_AddNumberToObject(item, "priority", frd_int(&r));
+            }
+            if (r.pos < r.len) {
+                cJSON_AddNumberToObject(item, "lease_ms", frd_int(&r));
+            }
+        }
+        break;
+    case FRAME_APPROVAL:
+        item = cJSON_AddObjectToObject(call->json, "approval");
+        if (item) {
+            cJSON_AddTrueToObject(item, "has_pending");
+            add_field(item, "approval_id", &r);
+            add_field(item, "tool_name", &r);
+            add_field(item, "tool_input", &r);
+        }
+        break;
+    case FRAME_SYNC_END:
+        add_field(call->json, "status", &r);
+        if (r.pos < r.len) {
+            add_field(call->json, "turn_state", &r);
+            cJSON_AddNumberToObject(call->json, "turn_seq", frd_int(&r));
+        }
+        if (r.pos < r.len) {
+            cJSON_AddNumberToObject(call->json, "offset", frd_int(&r));
+            cJSON_AddNumberToObject(call->json, "next", frd_int(&r));
+        }
+        return r.failed || call->output.failed ? -1 : 1;
+    case FRAME_ACK:
+        /* Ends an approval answer, after any work it released */
+        return call->output.failed ? -1 : 1;
+    case FRAME_ERROR:
+        log_frame_error(call->context, payload, len);
+        return -1;
+    default:
+        break;
+    }
+
+    return r.failed ? -1 : 0;
+}
+
+/*
+ * Send a request answered by OUTPUT/FILE_OP/COMMAND/APPROVAL frames and
+ * ended by SYNC_END or ACK; collects them into a /sync-shaped object.
+ */
+static cJSON *json_call(int type, const FrameBuf *request, int timeout_sec,
+                        const char *context)
+{
+    FrameWaiter w;
+    SyncCall call;
+    int rc = -1;
+
+    call.json = cJSON_CreateObject();
+    call.context = context;
+    fbuf_init(&call.output);
+
+    if (call.json && !request->failed &&
+        begin_call(&w, on_sync, &call) == 0) {
+        send_frame(type, FRAME_PRIO_CONTROL, w.stream, request->data,
+                   request->len);
+        rc = wait_call(&w, timeout_sec);
+    }
+
+    if (rc == 0) {
+        fbuf_append(&call.output, "", 1);
+        if (call.output.failed ||
+            !cJSON_AddStringToObject(call.json, "output",
+                                     call.output.data ? call.output.data
+                                                      : "")) {
+            rc = -1;
+        }
+    }
+    fbuf_free(&call.output);
+
+    if (rc < 0) {
+        cJSON_Delete(call.json);
+        return NULL;
+    }
+    return call.json;
+}
+
+cJSON *frame_sync(int wait_ms, int want_approval, long since, int max_bytes)
+{
+    FrameBuf request;
+    cJSON *json;
+
+    fbuf_init(&request);
+    fbuf_add_int(&request, wait_ms);
+    fbuf_add_int(&request, want_approval);
+    fbuf_add_int(&request, since);
+    fbuf_add_int(&request, max_bytes);
+
+    json = json_call(FRAME_SYNC, &request, HTTP_TIMEOUT_SEC + wait_ms / 1000,
+                     "frame_sync");
+    fbuf_free(&request);
+    return json;
+}
+
+static const char *json_str(const cJSON *obj, const char *name)
+{
+    const cJSON *item = cJSON_GetObjectItem(obj, name);
+    return cJSON_IsString(item) ? item->valuestring : NULL;
+}
+
+int frame_send_fileop_result(const cJSON *result)
+{
+    FrameBuf request;
+    const cJSON *entries = cJSON_GetObjectItem(result, "entries");
+    const cJSON *entry;
+    int rc;
+
+    fbuf_init(&request);
+    fbuf_add_str(&request, json_str(result, "op_id"));
+    fbuf_add_str(&request, json_str(result, "error"));
+    fbuf_add_str(&request, json_str(result, "content"));
+
+    if (cJSON_IsArray(entries)) {
+        fbuf_add_int(&request, cJSON_GetArraySize(entries));
+        cJSON_ArrayForEach(entry, entries)
+        {
+            const cJSON *size = cJSON_GetObjectItem(entry, "size");
+            fbuf_add_str(&request, json_str(entry, "name"));
+            fbuf_add_str(&request, json_str(entry, "type"));
+            fbuf_add_int(&request,
+                         cJSON_IsNumber(size) ? (long)size->valuedouble : 0);
+        }
+    } else {
+        fbuf_add_int(&request, -1);
+    }
+
+    rc = call_ack(FRAME_FILE_RESULT, &request, "frame_fileop_result");
+    fbuf_free(&request);
+    return rc;
+}
+
+int frame_send_cmd_result(const cJSON *result)
+{
+    FrameBuf request;
+    const cJSON *exit_code = cJSON_GetObjectItem(result, "exit_code");
+    int rc;
+
+    fbuf_init(&request);
+    fbuf_add_str(&request, json_str(result, "command_id"));
+    fbuf_add_int(&request, cJSON_IsNumber(exit_code) ? exit_code->valueint
+                                                     : -1);
+    fbuf_add_str(&request, json_str(result, "stdout"));
+    fbuf_add_str(&request, json_str(result, "stderr"));
+
+    rc = call_ack(FRAME_CMD_RESULT, &request, "frame_cmd_result");
+    fbuf_free(&request);
+    return rc;
+}
+
+cJSON *frame_send_approval(const char *approval_id, int approved)
+{
+    FrameBuf request;
+    cJSON *json;
+
+    fbuf_init(&request);
+    fbuf_add_str(&request, approval_id);
+    fbuf_add_int(&request, approved ? 1 : 0);
+    fbuf_add_int(&request, 1);
+
+    json = json_call(FRAME_APPROVAL_RESP, &request, HTTP_TIMEOUT_SEC,
+                     "frame_approval");
+    fbuf_free(&request);
+    return json;
+}
+
+int frame_send_input(const char *text)
+{
+    FrameBuf request;
+    int rc;
+
+    fbuf_init(&request);
+    fbuf_add_str(&request, text);
+
+    rc = call_ack(FRAME_INPUT, &request, "frame_input");
+    fbuf_free(&request);
+    return rc;
+}
+
+int frame_send_lease(const char *cmd_id)
+{
+    FrameBuf request;
+    int rc;
+
+    fbuf_init(&request);
+    fbuf_add_str(&request, cmd_id);
+
+    rc = call_ack(FRAME_LEASE, &request, "frame_lease");
+    fbuf_free(&request);
+    return rc;
+}
+
+typedef struct {
+    FILE *fp;
+    unsigned long received;
+    int write_failed;
+} DownloadCall;
+
+static int on_download(void *ctx, int type, const char *payload, size_t len)
+{
+    DownloadCall *call = (DownloadCall *)ctx;
+
+    switch (type) {
+    case FRAME_DATA_BEGIN:
+        return 0;
+    case FRAME_DATA:
+        if (!call->write_failed && len > 0 &&
+            fwrite(payload, 1, len, call->fp) != len) {
+            call->write_failed = 1;
+        }
+        call->received += (unsigned long)len;
+        return 0;
+    case FRAME_DATA_END:
+        return call->write_failed ? -1 : 1;
+    case FRAME_ERROR:
+        log_frame_error("frame_download", payload, len);
+        return -1;
+    default:
+        return 0;
+    }
+}
+
+int frame_download(const char *remote_path, FILE *fp, unsigned long *size)
+{
+    FrameBuf request;
+    FrameWaiter w;
+    DownloadCall call;
+    int rc = -1;
+
+    call.fp = fp;
+    call.received = 0;
+    call.write_failed = 0;
+
+    fbuf_init(&request);
+    fbuf_add_str(&request, remote_path);
+
+    if (!request.failed && begin_call(&w, on_download, &call) == 0) {
+        send_frame(FRAME_DOWNLOAD, FRAME_PRIO_CONTROL, w.stream,
+                   request.data, request.len);
+        rc = wait_call(&w, TRANSFER_TIMEOUT_SEC);
+    }
+    fbuf_free(&request);
+
+    *size = call.received;
+    return rc;
+}
+
+int frame_upload(const char *remote_path, FILE *fp, unsigned long size)
+{
+    FrameBuf request;
+    FrameWaiter w;
+    char *chunk;
+    size_t n;
+    int rc;
+
+    chunk = (char *)malloc(FRAME_DATA_CHUNK);
+    if (!chunk) {
+        return -1;
+    }
+
+    fbuf_init(&request);
+    fbuf_add_str(&request, remote_path);
+    fbuf_add_int(&request, (long)size);
+
+    if (request.failed || begin_call(&w, on_ack, "frame_upload") < 0) {
+        fbuf_free(&request);
+        free(chunk);
+        return -1;
+    }
+
+    rc = send_frame(FRAME_UPLOAD, FRAME_PRIO_CONTROL, w.stream, request.data,
+                    request.len);
+    fbuf_free(&request);
+
+    /* A rejection can arrive mid-transfer; done is set when it is read */
+    while (rc == 0 && !w.done &&
+           (n = fread(chunk, 1, FRAME_DATA_CHUNK, fp)) > 0) {
+        rc = send_frame(FRAME_DATA, FRAME_PRIO_BULK, w.stream, chunk, n);
+    }
+    if (rc == 0 && !w.done) {
+        send_frame(FRAME_DATA_END, FRAME_PRIO_BULK, w.stream, NULL, 0);
+    }
+    free(chunk);
+
+    return wait_call(&w, TRANSFER_TIMEOUT_SEC);
+}
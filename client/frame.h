@@ -0,0 +1,115 @@
+/*
+ * frame.h - Binary frame protocol
+ *
+ * Optional alternative to the JSON/HTTP API. Every message is an 8-byte
+ * little-endian header (type, priority, stream id, payload length) and a
+ * payload of fields: strings are a 4-byte length plus bytes, integers are
+ * 4 bytes. Each request gets its own stream id, so replies for the poll
+ * thread and the main thread can share one connection.
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "claude.h"
+
+#define FRAME_HEADER_SIZE 8
+#define FRAME_MAX_PAYLOAD (1024L * 1024L)
+#define FRAME_DATA_CHUNK 16384
+#define FRAME_MAX_WAITERS 8
+#define FRAME_HANDOFF_MS 50
+
+typedef enum {
+    FRAME_HELLO = 0x01,
+    FRAME_HELLO_OK = 0x02,
+    FRAME_ACK = 0x03,
+    FRAME_SYNC = 0x10,
+    FRAME_OUTPUT = 0x11,
+    FRAME_FILE_OP = 0x12,
+    FRAME_COMMAND = 0x13,
+    FRAME_APPROVAL = 0x14,
+    FRAME_SYNC_END = 0x15,
+    FRAME_FILE_RESULT = 0x20,
+    FRAME_CMD_RESULT = 0x21,
+    FRAME_APPROVAL_RESP = 0x22,
+    FRAME_INPUT = 0x23,
+    FRAME_LEASE = 0x24,
+    FRAME_DOWNLOAD = 0x30,
+    FRAME_UPLOAD = 0x31,
+    FRAME_DATA_BEGIN = 0x32,
+    FRAME_DATA = 0x33,
+    FRAME_DATA_END = 0x34,
+    FRAME_ERROR = 0x7F
+} FrameType;
+
+#define FRAME_PRIO_CONTROL 0
+#define FRAME_PRIO_BULK 1
+
+/* Growable payload being built */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    int failed;
+} FrameBuf;
+
+void fbuf_init(FrameBuf *b);
+void fbuf_free(FrameBuf *b);
+void fbuf_add_int(FrameBuf *b, long value);
+void fbuf_add_bytes(FrameBuf *b, const char *data, size_t len);
+void fbuf_add_str(FrameBuf *b, const char *s);
+
+/* Cursor over a received payload; failed is set on a short field */
+typedef struct {
+    const char *data;
+    size_t len;
+    size_t pos;
+    int failed;
+} FrameReader;
+
+void frd_init(FrameReader *r, const char *data, size_t len);
+long frd_int(FrameReader *r);
+const char *frd_bytes(FrameReader *r, size_t *len);
+
+/*
+ * Returns a NUL-terminated heap copy of the next string field (caller
+ * frees), or NULL if the payload is short or out of memory.
+ */
+char *frd_str(FrameReader *r);
+
+void frame_init(void);
+void frame_cleanup(void);
+
+/*
+ * Connect to the frame port and bind the link to session_id.
+ * Returns 0 on success; on failure the client stays on HTTP.
+ */
+int frame_open(int port, const char *session_id);
+void frame_close(void);
+int frame_active(void);
+
+/*
+ * Same as GET /sync: returns an object shaped like its JSON response
+ * (caller frees with cJSON_Delete), or NULL on failure.
+ */
+cJSON *frame_sync(int wait_ms, int want_approval, long since, int max_bytes);
+
+/*
+ * Answer an approval. Returns the server's reply shaped like the JSON
+ * from POST /approval/respond with dispatch set: an approved command or
+ * file op comes back in it (caller frees), or NULL on failure.
+ */
+cJSON *frame_send_approval(const char *approval_id, int approved);
+
+/* Each returns 0 once the server acknowledged, -1 otherwise */
+int frame_send_fileop_result(const cJSON *result);
+int frame_send_cmd_result(const cJSON *result);
+int frame_send_input(const char *text);
+int frame_send_lease(const char *cmd_id);
+int frame_download(const char *remote_path, FILE *fp, unsigned long *size);
+int frame_upload(const char *remote_path, FILE *fp, unsigned long size);
+
+/* Bytes written to and read from the link, headers included */
+void frame_get_stats(long *sent, long *received);
+
+#endif /* FRAME_H */
@@ -4,12 +4,20 @@
 
 #include <conio.h>
 #include "handlers.h"
+#include "arena.h"
+#include "frame.h"
 #include "http.h"
+#include "jsonio.h"
+#include "pool.h"
+#include "sched.h"
+#include "session.h"
 #include "util.h"
 
+/* owned is the buffer that result's big string references, if any */
 typedef struct {
     char id[64];
-    char *result;
+    cJSON *result;
+    char *owned;
 } CacheEntry;
 
 static CacheEntry fs_cache[IDEMPOTENCY_CACHE_SIZE];
@@ -18,7 +26,58 @@ static int fs_cache_index = 0;
 static CacheEntry cmd_cache[IDEMPOTENCY_CACHE_SIZE];
 static int cmd_cache_index = 0;
 
-static const char *cache_lookup(CacheEntry *cache, const char *id)
+/*
+ * Work released with an approval runs on the main thread while the poll
+ * thread runs polled work; they share the current directory and caches.
+ */
+static CRITICAL_SECTION s_exec_lock;
+
+/* Event loop of the thread that called handlers_set_loop */
+static EvLoop *s_loop = NULL;
+static DWORD s_loop_thread = 0;
+
+static int run_work(const cJSON *json);
+
+void handlers_init(void)
+{
+    InitializeCriticalSection(&s_exec_lock);
+}
+
+void handlers_cleanup(void)
+{
+    int i;
+
+    for (i = 0; i < IDEMPOTENCY_CACHE_SIZE; i++) {
+        cJSON_Delete(fs_cache[i].result);
+        fs_cache[i].result = NULL;
+        free(fs_cache[i].owned);
+        fs_cache[i].owned = NULL;
+        cJSON_Delete(cmd_cache[i].result);
+        cmd_cache[i].result = NULL;
+        free(cmd_cache[i].owned);
+        cmd_cache[i].owned = NULL;
+    }
+
+    /* An approval the main thread never got to */
+    pool_adopt(g_state.approval_tool_input);
+    pool_put(g_state.approval_tool_input);
+    g_state.approval_tool_input = NULL;
+
+    DeleteCriticalSection(&s_exec_lock);
+}
+
+void handlers_set_loop(EvLoop *loop)
+{
+    s_loop_thread = loop ? GetCurrentThreadId() : 0;
+    s_loop = loop;
+}
+
+static EvLoop *thread_loop(void)
+{
+    return s_loop_thread == GetCurrentThreadId() ? s_loop : NULL;
+}
+
+static const cJSON *cache_lookup(CacheEntry *cache, const char *id)
 {
     int i;
     for (i = 0; i < IDEMPOTENCY_CACHE_SIZE; i++) {
@@ -29,65 +88,109 @@ static const char *cache_lookup(CacheEntry *cache, const char *id)
     return NULL;
 }
 
+/* Takes ownership of result and owned; they stay valid until evicted */
 static void cache_store(CacheEntry *cache, int *index, const char *id,
-                        const char *result)
+                        cJSON *result, char *owned)
 {
     int slot = *index;
 
-    if (cache[slot].result) {
-        free(cache[slot].result);
-        cache[slot].result = NULL;
-    }
+    cJSON_Delete(cache[slot].result);
+    free(cache[slot].owned);
 
     strncpy(cache[slot].id, id, sizeof(cache[slot].id) - 1);
     cache[slot].id[sizeof(cache[slot].id) - 1] = '\0';
-    cache[slot].result = strdup(result);
+    cache[slot].result = result;
+    cache[slot].owned = owned;
 
     *index = (slot + 1) % IDEMPOTENCY_CACHE_SIZE;
 }
 
-int poll_approval(void)
+static void result_posted(void *ctx, HttpResult result, char *body,
+                          size_t len)
 {
-    static char response[BUFFER_SIZE];
-    char path[256];
-    char local_session_id[64];
-    cJSON *json;
-    const cJSON *has_pending;
-    const cJSON *approval_id;
-    const cJSON *tool_name;
-    const cJSON *tool_input;
+    (void)body;
+    (void)len;
 
-    EnterCriticalSection(&g_state.output_lock);
-    strncpy(local_session_id, g_state.session_id, sizeof(local_session_id));
-    local_session_id[sizeof(local_session_id) - 1] = '\0';
+    if (result != HTTP_OK) {
+        log_error((const char *)ctx, http_error_string(result));
+    }
+}
 
-    if (g_state.has_pending_approval || g_state.approval_in_progress) {
-        LeaveCriticalSection(&g_state.output_lock);
-        return 0;
+/*
+ * Submit a file op or command result, over the frame link when it is up
+ * and as JSON to path otherwise. The JSON is serialized straight into the
+ * request, never printed to a string. On the poll thread the post goes out
+ * on its loop and this returns without waiting for the reply.
+ */
+static void post_result(int frame_type, const char *path,
+                        const cJSON *result, const char *context)
+{
+    char response[SMALL_RESPONSE_SIZE];
+    EvLoop *loop;
+    HttpResult ret = HTTP_OK;
+
+    if (frame_active()) {
+        int rc = frame_type == FRAME_FILE_RESULT
+                     ? frame_send_fileop_result(result)
+                     : frame_send_cmd_result(result);
+        if (rc == 0) {
+            return;
+        }
     }
-    LeaveCriticalSection(&g_state.output_lock);
 
-    if (!local_session_id[0]) {
-        return 0;
+    loop = thread_loop();
+    if (loop) {
+        ret = http_post_json_async(loop, path, result, result_posted,
+                                   (void *)context);
     }
+    if (!loop || ret == HTTP_ERR_OVERFLOW) {
+        ret = http_post_json(path, result, response, sizeof(response));
+    }
+    if (ret != HTTP_OK) {
+        log_error(context, http_error_string(ret));
+    }
+}
 
-    snprintf(path, sizeof(path), "/approval/poll?session_id=%s",
-             local_session_id);
+/*
+ * Answer an approval request. Returns the server's reply, which carries
+ * the approved command or file op when the server released it at once
+ * (caller frees), or NULL if the answer didn't get through.
+ */
+static cJSON *send_approval(const char *approval_id, int approved)
+{
+    char *response;
+    char body[512];
+    cJSON *json;
 
-    if (http_request("GET", path, NULL, response, sizeof(response)) !=
-        HTTP_OK) {
-        Sleep(POLL_BACKOFF_MS);
-        return 0;
+    if (frame_active()) {
+        json = frame_send_approval(approval_id, approved);
+        if (json) {
+            return json;
+        }
     }
 
-    json = cJSON_Parse(response);
-    if (!json) {
-        return 0;
+    snprintf(body, sizeof(body),
+             "{\"approval_id\":\"%s\",\"approved\":%s,\"dispatch\":true}",
+             approval_id, approved ? "true" : "false");
+
+    /* Heap-sized: a released write carries its file content */
+    if (http_request_alloc("POST", "/approval/respond", body, 0, &response,
+                           NULL) != HTTP_OK) {
+        return NULL;
     }
 
-    has_pending = cJSON_GetObjectItem(json, "has_pending");
-    if (!cJSON_IsTrue(has_pending)) {
-        cJSON_Delete(json);
+    json = cJSON_Parse(response);
+    free(response);
+    return json ? json : cJSON_CreateObject();
+}
+
+static int store_approval(const cJSON *json)
+{
+    const cJSON *approval_id;
+    const cJSON *tool_name;
+    const cJSON *tool_input;
+
+    if (!cJSON_IsTrue(cJSON_GetObjectItem(json, "has_pending"))) {
         return 0;
     }
 
@@ -97,6 +200,11 @@ int poll_approval(void)
 
     EnterCriticalSection(&g_state.output_lock);
 
+    if (g_state.has_pending_approval || g_state.approval_in_progress) {
+        LeaveCriticalSection(&g_state.output_lock);
+        return 0;
+    }
+
     if (cJSON_IsString(approval_id)) {
         strncpy(g_state.approval_id, approval_id->valuestring,
                 sizeof(g_state.approval_id) - 1);
@@ -114,30 +222,34 @@ int poll_approval(void)
         strcpy(g_state.approval_tool_name, "unknown");
     }
 
+    /* Sized to fit; process_approval takes it over */
+    g_state.approval_tool_input = NULL;
     if (cJSON_IsString(tool_input) && tool_input->valuestring[0]) {
-        strncpy(g_state.approval_tool_input, tool_input->valuestring,
-                sizeof(g_state.approval_tool_input) - 1);
-        g_state.approval_tool_input[sizeof(g_state.approval_tool_input) - 1] =
-            '\0';
-    } else {
-        g_state.approval_tool_input[0] = '\0';
+        size_t size = strlen(tool_input->valuestring) + 1;
+
+        if (size > BUFFER_SIZE) {
+            size = BUFFER_SIZE;
+        }
+        g_state.approval_tool_input = pool_get_upto(&size);
+        if (g_state.approval_tool_input) {
+            strncpy(g_state.approval_tool_input, tool_input->valuestring,
+                    size - 1);
+            g_state.approval_tool_input[size - 1] = '\0';
+        }
     }
 
     g_state.has_pending_approval = 1;
 
     LeaveCriticalSection(&g_state.output_lock);
-
-    cJSON_Delete(json);
     return 1;
 }
 
 int process_approval(void)
 {
-    static char response[BUFFER_SIZE];
-    static char local_tool_input[BUFFER_SIZE];
-    char body[512];
+    char *local_tool_input;
     char local_approval_id[64];
     char local_tool_name[128];
+    cJSON *response;
     int key;
     int approved;
 
@@ -152,14 +264,15 @@ int process_approval(void)
     strncpy(local_tool_name, g_state.approval_tool_name,
             sizeof(local_tool_name));
     local_tool_name[sizeof(local_tool_name) - 1] = '\0';
-    strncpy(local_tool_input, g_state.approval_tool_input,
-            sizeof(local_tool_input));
-    local_tool_input[sizeof(local_tool_input) - 1] = '\0';
+    local_tool_input = g_state.approval_tool_input;
+    g_state.approval_tool_input = NULL;
 
     g_state.approval_in_progress = 1;
     g_state.has_pending_approval = 0;
     LeaveCriticalSection(&g_state.output_lock);
 
+    pool_adopt(local_tool_input);
+
     if (g_state.skip_permissions) {
         printf("[Auto-approving: %s]\n", local_tool_name);
         approved = 1;
@@ -170,7 +283,7 @@ int process_approval(void)
         printf("========================================\n");
         printf("Tool: %s\n", local_tool_name);
 
-        if (local_tool_input[0]) {
+        if (local_tool_input) {
             printf("Input: %s\n", local_tool_input);
         }
 
@@ -184,58 +297,39 @@ int process_approval(void)
         approved = (key == 'y' || key == 'Y') ? 1 : 0;
     }
 
-    if (local_approval_id[0]) {
-        snprintf(body, sizeof(body), "{\"approval_id\":\"%s\",\"approved\":%s}",
-                 local_approval_id, approved ? "true" : "false");
-
-        if (http_request("POST", "/approval/respond", body, response,
-                         sizeof(response)) == HTTP_OK) {
-            printf("[%s]\n", approved ? "Approved" : "Rejected");
-        }
+    response = local_approval_id[0]
+                   ? send_approval(local_approval_id, approved)
+                   : NULL;
+    if (response) {
+        printf("[%s]\n", approved ? "Approved" : "Rejected");
     }
 
     printf("========================================\n\n");
 
+    /* The approved tool may come back with the answer; no need to poll */
+    if (response) {
+        run_work(response);
+        cJSON_Delete(response);
+        arena_reset();
+    }
+
     EnterCriticalSection(&g_state.output_lock);
     g_state.approval_in_progress = 0;
     LeaveCriticalSection(&g_state.output_lock);
 
+    pool_put(local_tool_input);
     return 1;
 }
 
-int handle_approval(void)
+static int prompt_approval(const cJSON *json)
 {
-    static char response[BUFFER_SIZE];
-    char path[256];
-    char body[512];
-    cJSON *json;
-    const cJSON *has_pending;
     const cJSON *approval_id;
     const cJSON *tool_name;
     const cJSON *tool_input;
+    cJSON *response = NULL;
     int key;
 
-    if (!g_state.session_id[0]) {
-        return 0;
-    }
-
-    snprintf(path, sizeof(path), "/approval/poll?session_id=%s",
-             g_state.session_id);
-
-    if (http_request("GET", path, NULL, response, sizeof(response)) !=
-        HTTP_OK) {
-        Sleep(POLL_BACKOFF_MS);
-        return 0;
-    }
-
-    json = cJSON_Parse(response);
-    if (!json) {
-        return 0;
-    }
-
-    has_pending = cJSON_GetObjectItem(json, "has_pending");
-    if (!cJSON_IsTrue(has_pending)) {
-        cJSON_Delete(json);
+    if (!cJSON_IsTrue(cJSON_GetObjectItem(json, "has_pending"))) {
         return 0;
     }
 
@@ -264,18 +358,19 @@ int handle_approval(void)
     if (cJSON_IsString(approval_id)) {
         int approved = (key == 'y' || key == 'Y') ? 1 : 0;
 
-        snprintf(body, sizeof(body), "{\"approval_id\":\"%s\",\"approved\":%s}",
-                 approval_id->valuestring, approved ? "true" : "false");
-
-        if (http_request("POST", "/approval/respond", body, response,
-                         sizeof(response)) == HTTP_OK) {
+        response = send_approval(approval_id->valuestring, approved);
+        if (response) {
             printf("[%s]\n", approved ? "Approved" : "Rejected");
         }
     }
 
     printf("========================================\n\n");
 
-    cJSON_Delete(json);
+    if (response) {
+        run_work(response);
+        cJSON_Delete(response);
+    }
+
     return 1;
 }
 
@@ -327,39 +422,65 @@ static void handle_list_op(const char *full_path, cJSON *result)
     cJSON_AddItemToObject(result, "entries", entries);
 }
 
-static void handle_read_op(const char *full_path, cJSON *result)
+/*
+ * The content is added by reference; returns the buffer it lives in
+ * (caller owns), or NULL on error.
+ */
+static char *handle_read_op(const char *full_path, cJSON *result)
 {
     FILE *fp;
     char *file_buffer;
+    size_t size = BUFFER_SIZE * 2 - 1;
+    long file_size;
     int bytes_read;
 
-    file_buffer = malloc(BUFFER_SIZE * 2);
-    if (!file_buffer) {
-        cJSON_AddStringToObject(result, "error", "Out of memory");
-        return;
-    }
-
     fp = fopen(full_path, "rb");
     if (!fp) {
         cJSON_AddStringToObject(result, "error", "File not found");
-        free(file_buffer);
-        return;
+        return NULL;
+    }
+
+    /* The cache keeps this buffer; size it to the file */
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        file_size = ftell(fp);
+        if (file_size >= 0 && (size_t)file_size < size) {
+            size = (size_t)file_size;
+        }
+    }
+    rewind(fp);
+
+    file_buffer = malloc(size + 1);
+    if (!file_buffer) {
+        cJSON_AddStringToObject(result, "error", "Out of memory");
+        fclose(fp);
+        return NULL;
     }
 
-    bytes_read = fread(file_buffer, 1, BUFFER_SIZE * 2 - 1, fp);
+    bytes_read = fread(file_buffer, 1, size, fp);
     fclose(fp);
 
     file_buffer[bytes_read] = '\0';
-    cJSON_AddStringToObject(result, "content", file_buffer);
-    free(file_buffer);
+    cJSON_AddItemToObject(result, "content",
+                          cJSON_CreateStringReference(file_buffer));
+    return file_buffer;
 }
 
-static void handle_write_op(const char *full_path, const char *content,
+/* A file op request; content_span, when set, is used instead of content */
+typedef struct {
+    const char *op_id;
+    const char *operation;
+    const char *path;
+    const char *content;
+    const JsonSpan *content_span;
+} FileOp;
+
+static void handle_write_op(const char *full_path, const FileOp *op,
                             cJSON *result)
 {
     FILE *fp;
+    int failed;
 
-    if (!content) {
+    if (op->content_span ? !jr_is_string(op->content_span) : !op->content) {
         cJSON_AddStringToObject(result, "error", "No content provided");
         return;
     }
@@ -370,14 +491,18 @@ static void handle_write_op(const char *full_path, const char *content,
         return;
     }
 
-    {
-        size_t content_len = strlen(content);
-        size_t written = fwrite(content, 1, content_len, fp);
-        fclose(fp);
-        if (written != content_len) {
-            cJSON_AddStringToObject(result, "error", "Write failed");
-            return;
-        }
+    /* Decoded straight from the reply into the file, no copy in between */
+    if (op->content_span) {
+        failed = jr_string_to_file(op->content_span, fp) < 0;
+    } else {
+        size_t content_len = strlen(op->content);
+        failed = fwrite(op->content, 1, content_len, fp) != content_len;
+    }
+    if (fclose(fp) != 0) {
+        failed = 1;
+    }
+    if (failed) {
+        cJSON_AddStringToObject(result, "error", "Write failed");
     }
 }
 
@@ -392,35 +517,61 @@ static void handle_mkdir_op(const char *full_path, cJSON *result)
     }
 }
 
-int handle_fileop(void)
+static int exec_fileop(const FileOp *fop)
 {
-    static char response[BUFFER_SIZE];
     char full_path[MAX_PATH_LEN];
-    cJSON *json;
-    const cJSON *has_pending;
-    const cJSON *op_id;
-    const cJSON *operation;
-    const cJSON *filepath;
-    const cJSON *content;
     cJSON *result;
-    char *result_str;
-    const char *op;
-    const char *cached_result;
+    char *owned = NULL;
+    const char *op = fop->operation;
+    const cJSON *cached_result;
+    JsonArena *arena;
 
-    if (http_request("GET", "/fs/poll", NULL, response, sizeof(response)) !=
-        HTTP_OK) {
-        Sleep(POLL_BACKOFF_MS);
-        return 0;
+    cached_result = cache_lookup(fs_cache, fop->op_id);
+    if (cached_result) {
+        printf("[FS: replaying cached result for %s]\n", fop->op_id);
+        post_result(FRAME_FILE_RESULT, "/fs/result", cached_result, "fileop");
+        return 1;
     }
 
-    json = cJSON_Parse(response);
-    if (!json) {
+    printf("[FS: %s %s]\n", op, fop->path);
+
+    if (build_full_path(fop->path, full_path, sizeof(full_path)) < 0) {
+        log_error("fileop", "path too long or traversal rejected");
         return 0;
     }
 
-    has_pending = cJSON_GetObjectItem(json, "has_pending");
-    if (!cJSON_IsTrue(has_pending)) {
-        cJSON_Delete(json);
+    /* The cache keeps the result past this cycle; build it on the heap */
+    arena = arena_enter(NULL);
+    result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "op_id", fop->op_id);
+
+    if (strcmp(op, "list") == 0) {
+        handle_list_op(full_path, result);
+    } else if (strcmp(op, "read") == 0) {
+        owned = handle_read_op(full_path, result);
+    } else if (strcmp(op, "write") == 0) {
+        handle_write_op(full_path, fop, result);
+    } else if (strcmp(op, "mkdir") == 0) {
+        handle_mkdir_op(full_path, result);
+    } else {
+        cJSON_AddStringToObject(result, "error", "Unknown operation");
+    }
+
+    cache_store(fs_cache, &fs_cache_index, fop->op_id, result, owned);
+    arena_enter(arena);
+    post_result(FRAME_FILE_RESULT, "/fs/result", result, "fileop");
+    return 1;
+}
+
+static int run_fileop(const cJSON *json)
+{
+    const cJSON *op_id;
+    const cJSON *operation;
+    const cJSON *filepath;
+    const cJSON *content;
+    FileOp fop;
+
+    if (!cJSON_IsTrue(cJSON_GetObjectItem(json, "has_pending"))) {
         return 0;
     }
 
@@ -431,64 +582,52 @@ int handle_fileop(void)
 
     if (!cJSON_IsString(op_id) || !cJSON_IsString(operation) ||
         !cJSON_IsString(filepath)) {
-        log_error("handle_fileop", "malformed file operation request");
-        cJSON_Delete(json);
+        log_error("fileop", "malformed file operation request");
         return 0;
     }
 
-    cached_result = cache_lookup(fs_cache, op_id->valuestring);
-    if (cached_result) {
-        printf("[FS: replaying cached result for %s]\n", op_id->valuestring);
-        HttpResult cached_ret = http_request(
-            "POST", "/fs/result", cached_result, response, sizeof(response));
-        if (cached_ret != HTTP_OK) {
-            log_error("handle_fileop", http_error_string(cached_ret));
-        }
-        cJSON_Delete(json);
-        return 1;
-    }
-
-    op = operation->valuestring;
-    printf("[FS: %s %s]\n", op, filepath->valuestring);
+    fop.op_id = op_id->valuestring;
+    fop.operation = operation->valuestring;
+    fop.path = filepath->valuestring;
+    fop.content = cJSON_IsString(content) ? content->valuestring : NULL;
+    fop.content_span = NULL;
+    return exec_fileop(&fop);
+}
 
-    if (build_full_path(filepath->valuestring, full_path, sizeof(full_path)) <
-        0) {
-        log_error("handle_fileop", "path too long or traversal rejected");
-        cJSON_Delete(json);
+/*
+ * Same as run_fileop, but read from the reply text where it lies, so a
+ * write's content goes from the receive buffer to disk undecoded in memory.
+ */
+static int run_fileop_text(const JsonSpan *json)
+{
+    char op_id[64];
+    char operation[64];
+    char path[MAX_PATH_LEN];
+    JsonSpan v;
+    JsonSpan content;
+    FileOp fop;
+
+    if (jr_get(json, "has_pending", &v) < 0 || !jr_is_true(&v)) {
         return 0;
     }
 
-    result = cJSON_CreateObject();
-    cJSON_AddStringToObject(result, "op_id", op_id->valuestring);
-
-    if (strcmp(op, "list") == 0) {
-        handle_list_op(full_path, result);
-    } else if (strcmp(op, "read") == 0) {
-        handle_read_op(full_path, result);
-    } else if (strcmp(op, "write") == 0) {
-        const char *content_str =
-            cJSON_IsString(content) ? content->valuestring : NULL;
-        handle_write_op(full_path, content_str, result);
-    } else if (strcmp(op, "mkdir") == 0) {
-        handle_mkdir_op(full_path, result);
-    } else {
-        cJSON_AddStringToObject(result, "error", "Unknown operation");
-    }
-
-    result_str = cJSON_PrintUnformatted(result);
-    if (result_str) {
-        cache_store(fs_cache, &fs_cache_index, op_id->valuestring, result_str);
-        HttpResult post_ret = http_request("POST", "/fs/result", result_str,
-                                           response, sizeof(response));
-        if (post_ret != HTTP_OK) {
-            log_error("handle_fileop", http_error_string(post_ret));
-        }
-        free(result_str);
+    if (jr_get(json, "op_id", &v) < 0 ||
+        jr_string(&v, op_id, sizeof(op_id)) < 0 ||
+        jr_get(json, "operation", &v) < 0 ||
+        jr_string(&v, operation, sizeof(operation)) < 0 ||
+        jr_get(json, "path", &v) < 0 ||
+        jr_string(&v, path, sizeof(path)) < 0) {
+        log_error("fileop", "malformed file operation request");
+        return 0;
     }
 
-    cJSON_Delete(result);
-    cJSON_Delete(json);
-    return 1;
+    fop.op_id = op_id;
+    fop.operation = operation;
+    fop.path = path;
+    fop.content = NULL;
+    fop.content_span = jr_get(json, "content", &content) == 0 ? &content
+                                                              : NULL;
+    return exec_fileop(&fop);
 }
 
 /*
@@ -589,38 +728,47 @@ static int execute_command_9x(const char *command, char *output,
     return exit_code;
 }
 
-int handle_command(void)
+/* Let the main thread renew the lease on cmd_id while it runs */
+static void lease_hold(const char *cmd_id, const cJSON *json)
+{
+    const cJSON *lease_ms = cJSON_GetObjectItem(json, "lease_ms");
+
+    EnterCriticalSection(&g_state.output_lock);
+    strncpy(g_state.lease_cmd_id, cmd_id, sizeof(g_state.lease_cmd_id) - 1);
+    g_state.lease_cmd_id[sizeof(g_state.lease_cmd_id) - 1] = '\0';
+    g_state.lease_ms = cJSON_IsNumber(lease_ms) && lease_ms->valueint > 0
+                           ? (DWORD)lease_ms->valueint
+                           : 0;
+    g_state.lease_renewed = GetTickCount();
+    LeaveCriticalSection(&g_state.output_lock);
+}
+
+static void lease_drop(void)
+{
+    EnterCriticalSection(&g_state.output_lock);
+    g_state.lease_cmd_id[0] = '\0';
+    g_state.lease_ms = 0;
+    LeaveCriticalSection(&g_state.output_lock);
+}
+
+static int run_command(const cJSON *json)
 {
-    static char response[BUFFER_SIZE];
     char *cmd_output;
+    char *scratch;
+    size_t scratch_size = MAX_CMD_OUTPUT;
     char old_workdir[MAX_PATH_LEN];
-    cJSON *json;
-    const cJSON *has_pending;
     const cJSON *cmd_id;
-    cJSON *command;
+    const cJSON *command;
     const cJSON *workdir;
     cJSON *result;
-    char *result_str;
-    const char *cached_result;
+    const cJSON *cached_result;
+    JsonArena *arena;
     int exit_code = 0;
     int changed_dir = 0;
     DWORD ver;
     DWORD major;
 
-    if (http_request("GET", "/cmd/poll", NULL, response, sizeof(response)) !=
-        HTTP_OK) {
-        Sleep(POLL_BACKOFF_MS);
-        return 0;
-    }
-
-    json = cJSON_Parse(response);
-    if (!json) {
-        return 0;
-    }
-
-    has_pending = cJSON_GetObjectItem(json, "has_pending");
-    if (!cJSON_IsTrue(has_pending)) {
-        cJSON_Delete(json);
+    if (!cJSON_IsTrue(cJSON_GetObjectItem(json, "has_pending"))) {
         return 0;
     }
 
@@ -629,23 +777,19 @@ int handle_command(void)
     workdir = cJSON_GetObjectItem(json, "working_directory");
 
     if (!cJSON_IsString(cmd_id) || !cJSON_IsString(command)) {
-        log_error("handle_command", "malformed command request");
-        cJSON_Delete(json);
+        log_error("command", "malformed command request");
         return 0;
     }
 
     cached_result = cache_lookup(cmd_cache, cmd_id->valuestring);
     if (cached_result) {
         printf("[CMD: replaying cached result for %s]\n", cmd_id->valuestring);
-        HttpResult cached_ret = http_request(
-            "POST", "/cmd/result", cached_result, response, sizeof(response));
-        if (cached_ret != HTTP_OK) {
-            log_error("handle_command", http_error_string(cached_ret));
-        }
-        cJSON_Delete(json);
+        post_result(FRAME_CMD_RESULT, "/cmd/result", cached_result, "command");
         return 1;
     }
 
+    lease_hold(cmd_id->valuestring, json);
+
     if (cJSON_IsString(workdir) && workdir->valuestring[0]) {
         char full_workdir[MAX_PATH_LEN];
         if (build_full_path(workdir->valuestring, full_workdir,
@@ -667,63 +811,353 @@ int handle_command(void)
         path_to_backslashes(cmd_copy);
         printf("[CMD: %s]\n", cmd_copy);
 
-        cmd_output = malloc(MAX_CMD_OUTPUT);
-        if (!cmd_output) {
-            log_error("handle_command", "out of memory for command output");
-            cJSON_Delete(json);
+        /* A tight budget gets a smaller buffer and shorter output */
+        scratch = pool_get_upto(&scratch_size);
+        if (!scratch) {
+            log_error("command", "out of memory for command output");
             if (changed_dir) {
                 SetCurrentDirectory(old_workdir);
             }
+            lease_drop();
             return 0;
         }
-        cmd_output[0] = '\0';
+        scratch[0] = '\0';
 
         ver = GetVersion();
         major = (DWORD)(LOBYTE(LOWORD(ver)));
 
         if (major >= 5) {
-            exit_code =
-                execute_command_nt(cmd_copy, cmd_output, MAX_CMD_OUTPUT);
+            exit_code = execute_command_nt(cmd_copy, scratch, scratch_size);
         } else {
-            exit_code =
-                execute_command_9x(cmd_copy, cmd_output, MAX_CMD_OUTPUT);
+            exit_code = execute_command_9x(cmd_copy, scratch, scratch_size);
         }
 
-        if (cmd_output[0] != '\0') {
-            printf("%s", cmd_output);
+        if (scratch[0] != '\0') {
+            printf("%s", scratch);
             {
-                size_t len = strlen(cmd_output);
-                if (len > 0 && cmd_output[len - 1] != '\n') {
+                size_t len = strlen(scratch);
+                if (len > 0 && scratch[len - 1] != '\n') {
                     printf("\n");
                 }
             }
         }
+
+        /* Only the output itself is kept, for the cache */
+        cmd_output = (char *)malloc(strlen(scratch) + 1);
+        if (cmd_output) {
+            strcpy(cmd_output, scratch);
+        }
+        pool_put(scratch);
     }
 
+    lease_drop();
+
     if (changed_dir) {
         SetCurrentDirectory(old_workdir);
     }
 
+    arena = arena_enter(NULL);
     result = cJSON_CreateObject();
     cJSON_AddStringToObject(result, "command_id", cmd_id->valuestring);
-    cJSON_AddStringToObject(result, "stdout", cmd_output);
+    cJSON_AddItemToObject(
+        result, "stdout",
+        cJSON_CreateStringReference(cmd_output ? cmd_output : ""));
     cJSON_AddStringToObject(result, "stderr", "");
     cJSON_AddNumberToObject(result, "exit_code", exit_code);
 
-    result_str = cJSON_PrintUnformatted(result);
-    if (result_str) {
-        cache_store(cmd_cache, &cmd_cache_index, cmd_id->valuestring,
-                    result_str);
-        HttpResult post_ret = http_request("POST", "/cmd/result", result_str,
-                                           response, sizeof(response));
-        if (post_ret != HTTP_OK) {
-            log_error("handle_command", http_error_string(post_ret));
+    cache_store(cmd_cache, &cmd_cache_index, cmd_id->valuestring, result,
+                cmd_output);
+    arena_enter(arena);
+    post_result(FRAME_CMD_RESULT, "/cmd/result", result, "command");
+    return 1;
+}
+
+/* Server priority class of a work item after ageing; lower runs first */
+static int work_priority(const cJSON *item)
+{
+    const cJSON *priority = cJSON_GetObjectItem(item, "priority");
+
+    return cJSON_IsNumber(priority) ? priority->valueint : 0;
+}
+
+/* A file op as cJSON, or still in the reply text when file_op_text is set */
+static int run_any_fileop(const cJSON *file_op, const JsonSpan *file_op_text)
+{
+    return file_op_text ? run_fileop_text(file_op_text) : run_fileop(file_op);
+}
+
+/*
+ * Run a file op and a command, the more urgent first by the class each
+ * was dispatched in. The server ages waiting work a class at a time, so
+ * a command held back long enough goes ahead of a fresh write; on a tie
+ * the file op goes first.
+ */
+static int run_ranked(const cJSON *file_op, const JsonSpan *file_op_text,
+                      const cJSON *command)
+{
+    JsonSpan v;
+    int file_priority;
+    int work;
+
+    if (file_op_text) {
+        file_priority = jr_get(file_op_text, "priority", &v) == 0
+                            ? (int)jr_long(&v, 0)
+                            : 0;
+    } else {
+        file_priority = work_priority(file_op);
+    }
+
+    EnterCriticalSection(&s_exec_lock);
+    if (work_priority(command) < file_priority) {
+        work = run_command(command);
+        work += run_any_fileop(file_op, file_op_text);
+    } else {
+        work = run_any_fileop(file_op, file_op_text);
+        work += run_command(command);
+    }
+    LeaveCriticalSection(&s_exec_lock);
+
+    return work;
+}
+
+/* Run the file op and command carried by a sync or approval reply */
+static int run_work(const cJSON *json)
+{
+    return run_ranked(cJSON_GetObjectItem(json, "file_op"), NULL,
+                      cJSON_GetObjectItem(json, "command"));
+}
+
+/*
+ * Approvals go first: Claude is blocked on them, and handed to the
+ * main thread they get answered while a long command runs here.
+ */
+static int take_approval(const cJSON *approval, int interactive)
+{
+    return interactive ? prompt_approval(approval) : store_approval(approval);
+}
+
+TurnState sync_turn_state(const cJSON *json, int *seq)
+{
+    static const struct {
+        const char *name;
+        TurnState state;
+    } names[] = {{"idle", TURN_IDLE},
+                 {"thinking", TURN_THINKING},
+                 {"tool_running", TURN_TOOL_RUNNING},
+                 {"awaiting_approval", TURN_AWAITING_APPROVAL},
+                 {"done", TURN_DONE}};
+    const cJSON *state = cJSON_GetObjectItem(json, "turn_state");
+    const cJSON *seq_item = cJSON_GetObjectItem(json, "turn_seq");
+    size_t i;
+
+    *seq = cJSON_IsNumber(seq_item) ? seq_item->valueint : 0;
+
+    if (cJSON_IsString(state)) {
+        for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+            if (strcmp(state->valuestring, names[i].name) == 0) {
+                return names[i].state;
+            }
         }
-        free(result_str);
     }
+    return TURN_UNKNOWN;
+}
 
-    cJSON_Delete(result);
-    cJSON_Delete(json);
-    free(cmd_output);
-    return 1;
+/* The work in a /sync reply; the file op is left in the reply text */
+typedef struct {
+    cJSON *approval;
+    cJSON *command;
+    JsonSpan file_op;
+    int has_file_op;
+} SyncItems;
+
+/* Find the work in a /sync reply held in a writable buffer; runs nothing */
+static void parse_sync(char *text, size_t len, SyncItems *items)
+{
+    JsonSpan root;
+    JsonSpan v;
+
+    memset(items, 0, sizeof(*items));
+    if (jr_root(text, len, &root) != 0) {
+        return;
+    }
+
+    /* Small, so parsed on their own while the file op is still in the way */
+    if (jr_get(&root, "approval", &v) == 0) {
+        items->approval = cJSON_ParseWithLength(v.p, v.len);
+    }
+    if (jr_get(&root, "command", &v) == 0) {
+        items->command = cJSON_ParseWithLength(v.p, v.len);
+    }
+    items->has_file_op = jr_get(&root, "file_op", &items->file_op) == 0;
+}
+
+/*
+ * Do the work in a /sync reply while its text is still there, then parse
+ * the rest. The file op runs from the text and is blanked after, so
+ * cJSON never copies write content.
+ */
+static cJSON *take_sync(char *text, size_t len, int interactive, int *work)
+{
+    SyncItems items;
+
+    parse_sync(text, len, &items);
+    *work += take_approval(items.approval, interactive);
+    *work += run_ranked(NULL, items.has_file_op ? &items.file_op : NULL,
+                        items.command);
+    cJSON_Delete(items.approval);
+    cJSON_Delete(items.command);
+
+    if (items.has_file_op) {
+        jr_blank(&items.file_op);
+    }
+    return cJSON_Parse(text);
+}
+
+typedef struct {
+    int finished;
+    int interactive;
+    int work;
+    cJSON *json;
+} SyncReply;
+
+/* Work straight from the loop's buffer; NULL json means the sync failed */
+static void sync_received(void *ctx, HttpResult result, char *body,
+                          size_t len)
+{
+    SyncReply *reply = (SyncReply *)ctx;
+
+    if (result == HTTP_OK) {
+        reply->json = take_sync(body, len, reply->interactive, &reply->work);
+    }
+    reply->finished = 1;
+}
+
+static long sync_number(const cJSON *json, const char *name, long fallback)
+{
+    const cJSON *item = cJSON_GetObjectItem(json, name);
+
+    return cJSON_IsNumber(item) ? (long)item->valuedouble : fallback;
+}
+
+/* Output older than the page was dropped before we got to it; say so */
+static void mark_output_gap(cJSON *json, long dropped)
+{
+    const cJSON *output = cJSON_GetObjectItem(json, "output");
+    const char *text = cJSON_IsString(output) ? output->valuestring : "";
+    size_t size = strlen(text) + 64;
+    char *marked = (char *)malloc(size);
+
+    if (!marked) {
+        return;
+    }
+    snprintf(marked, size, "[... %ld characters of output dropped ...]\n%s",
+             dropped, text);
+    if (cJSON_GetObjectItem(json, "output")) {
+        cJSON_ReplaceItemInObject(json, "output", cJSON_CreateString(marked));
+    } else {
+        cJSON_AddStringToObject(json, "output", marked);
+    }
+    free(marked);
+}
+
+cJSON *handle_sync(const char *session_id, int interactive, int wait_ms,
+                   int *did_work)
+{
+    char *response;
+    size_t resp_len;
+    char path[256];
+    EvLoop *loop;
+    SyncReply reply;
+    HttpResult ret;
+    cJSON *json;
+    const cJSON *output;
+    TurnState turn;
+    int seq;
+    int work = 0;
+    int want_approval = 1;
+    long since;
+    long dropped;
+
+    if (did_work) {
+        *did_work = 0;
+    }
+
+    /*
+     * An approval already handed to the main thread stays pending on the
+     * server until answered; don't let it cut every long poll short.
+     */
+    if (!interactive) {
+        EnterCriticalSection(&g_state.output_lock);
+        want_approval =
+            !g_state.has_pending_approval && !g_state.approval_in_progress;
+        LeaveCriticalSection(&g_state.output_lock);
+    }
+
+    since = session_output_cursor();
+    if (frame_active()) {
+        json = frame_sync(wait_ms, want_approval, since, OUTPUT_PAGE_BYTES);
+        if (json) {
+            work += take_approval(cJSON_GetObjectItem(json, "approval"),
+                                  interactive);
+            work += run_work(json);
+        }
+    } else {
+        snprintf(path, sizeof(path),
+                 "/sync?session_id=%s&wait_ms=%d&approval=%d&since=%ld"
+                 "&max_bytes=%d",
+                 session_id, wait_ms, want_approval, since, OUTPUT_PAGE_BYTES);
+
+        loop = thread_loop();
+        reply.finished = 0;
+        reply.interactive = interactive;
+        reply.work = 0;
+        reply.json = NULL;
+        ret = loop ? http_request_async(loop, "GET", path, NULL, wait_ms,
+                                        sync_received, &reply)
+                   : HTTP_ERR_OVERFLOW;
+        if (ret == HTTP_OK) {
+            /* Results posted by the last sync keep moving meanwhile */
+            while (!reply.finished) {
+                ev_run(loop, POLL_SLEEP_MS);
+            }
+            json = reply.json;
+            work += reply.work;
+        } else if (ret == HTTP_ERR_OVERFLOW) {
+            /* Heap-sized: file ops can carry content well past BUFFER_SIZE */
+            if (http_request_alloc("GET", path, NULL, wait_ms, &response,
+                                   &resp_len) != HTTP_OK) {
+                sched_poll_done(-1);
+                return NULL;
+            }
+
+            json = take_sync(response, resp_len, interactive, &work);
+            free(response);
+        } else {
+            json = NULL;
+        }
+    }
+    if (!json) {
+        sched_poll_done(-1);
+        return NULL;
+    }
+
+    /* A server without the output log sends neither; the cursor stays */
+    dropped = session_output_advance(since, sync_number(json, "offset", since),
+                                     sync_number(json, "next", since));
+    if (dropped > 0) {
+        mark_output_gap(json, dropped);
+    }
+
+    if (did_work) {
+        *did_work = work;
+    }
+
+    /* Claude is mid-turn; keep polling at full rate */
+    output = cJSON_GetObjectItem(json, "output");
+    turn = sync_turn_state(json, &seq);
+    sched_poll_done(work || (cJSON_IsString(output) && output->valuestring[0]) ||
+                    turn == TURN_THINKING || turn == TURN_TOOL_RUNNING ||
+                    turn == TURN_AWAITING_APPROVAL);
+
+    return json;
 }
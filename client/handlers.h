@@ -6,13 +6,46 @@
 #define HANDLERS_H
 
 #include "claude.h"
+#include "evloop.h"
 
-int poll_approval(void);
+void handlers_init(void);
+void handlers_cleanup(void);
+
+/*
+ * Hand the calling thread's event loop to the handlers (NULL to take it
+ * back). Syncs made on that thread then run on the loop, and results are
+ * posted on it without waiting for the reply, so a slow post never holds
+ * up the next poll. Other threads keep using blocking requests.
+ */
+void handlers_set_loop(EvLoop *loop);
+
+/*
+ * Prompt for an approval the poll thread stored in g_state. An approved
+ * command or file op that the server releases with the answer is run
+ * straight away.
+ */
 int process_approval(void);
-int handle_approval(void);
 
-int handle_fileop(void);
+/*
+ * Fetch pending output and the next file op, command and approval in one
+ * /sync round trip. File ops and commands are executed before returning.
+ * Approvals are prompted for inline when interactive is set, otherwise
+ * handed to the main thread through g_state.
+ *
+ * wait_ms lets the server hold the request open until there is output or
+ * work (long poll); 0 returns immediately.
+ *
+ * Returns the parsed response (caller reads "output"/"status" and frees it
+ * with cJSON_Delete), or NULL on failure. The outcome is reported to the
+ * poll scheduler, which decides when the next call is due.
+ */
+cJSON *handle_sync(const char *session_id, int interactive, int wait_ms,
+                   int *did_work);
 
-int handle_command(void);
+/*
+ * Turn state from a sync response; *seq gets the server's count of inputs
+ * on the session. TURN_UNKNOWN if the server doesn't report turns.
+ */
+TurnState sync_turn_state(const cJSON *json, int *seq);
 
 #endif /* HANDLERS_H */
@@ -3,6 +3,8 @@
  */
 
 #include "http.h"
+#include "jsonio.h"
+#include "sched.h"
 
 const char *http_error_string(HttpResult code)
 {
@@ -26,50 +28,147 @@ const char *http_error_string(HttpResult code)
     case HTTP_ERR_TRUNCATED:
         return "Response truncated";
     case HTTP_ERR_RESPONSE_TOO_LARGE:
-        return "Response Content-Length exceeds buffer size";
+        return "Response exceeds buffer size";
+    case HTTP_ERR_OFFLINE:
+        return "Server unreachable, waiting to retry";
     default:
         return "Unknown error";
     }
 }
 
-static int parse_http_status(const char *buffer)
+/*
+ * One kept-alive connection per calling thread (main and poll thread), so
+ * requests never interleave on a socket. The lock only guards slot lookup.
+ */
+typedef struct {
+    DWORD thread_id;
+    SOCKET sock;
+    LONG generation;
+} HttpConn;
+
+static HttpConn s_conns[HTTP_MAX_CONNS];
+static CRITICAL_SECTION s_conns_lock;
+static int s_initialized = 0;
+static volatile LONG s_generation = 0;
+static volatile LONG s_connects = 0;
+static volatile LONG s_reuses = 0;
+
+void http_init(void)
 {
-    int status = 0;
-    if (strncmp(buffer, "HTTP/", 5) == 0) {
-        const char *p = strchr(buffer, ' ');
-        if (p) {
-            status = atoi(p + 1);
+    int i;
+
+    if (s_initialized) {
+        return;
+    }
+
+    for (i = 0; i < HTTP_MAX_CONNS; i++) {
+        s_conns[i].thread_id = 0;
+        s_conns[i].sock = INVALID_SOCKET;
+        s_conns[i].generation = 0;
+    }
+
+    InitializeCriticalSection(&s_conns_lock);
+    s_initialized = 1;
+}
+
+void http_cleanup(void)
+{
+    int i;
+
+    if (!s_initialized) {
+        return;
+    }
+
+    for (i = 0; i < HTTP_MAX_CONNS; i++) {
+        if (s_conns[i].sock != INVALID_SOCKET) {
+            closesocket(s_conns[i].sock);
+            s_conns[i].sock = INVALID_SOCKET;
         }
+        s_conns[i].thread_id = 0;
     }
-    return status;
+
+    DeleteCriticalSection(&s_conns_lock);
+    s_initialized = 0;
 }
 
-static int parse_content_length(const char *buffer)
+void http_reset_connections(void)
 {
-    const char *cl = strstr(buffer, "Content-Length:");
-    if (!cl) {
-        cl = strstr(buffer, "content-length:");
+    /* Sockets are closed lazily by their owning thread */
+    InterlockedIncrement(&s_generation);
+}
+
+void http_release_thread(void)
+{
+    DWORD self = GetCurrentThreadId();
+    int i;
+
+    if (!s_initialized) {
+        return;
     }
-    if (cl) {
-        return atoi(cl + 15);
+
+    EnterCriticalSection(&s_conns_lock);
+    for (i = 0; i < HTTP_MAX_CONNS; i++) {
+        if (s_conns[i].thread_id == self) {
+            if (s_conns[i].sock != INVALID_SOCKET) {
+                closesocket(s_conns[i].sock);
+                s_conns[i].sock = INVALID_SOCKET;
+            }
+            s_conns[i].thread_id = 0;
+            break;
+        }
     }
-    return -1;
+    LeaveCriticalSection(&s_conns_lock);
 }
 
-HttpResult http_request(const char *method, const char *path, const char *body,
-                        char *response, size_t resp_size)
+void http_get_stats(long *connects, long *reuses)
+{
+    *connects = (long)s_connects;
+    *reuses = (long)s_reuses;
+}
+
+/* Returns this thread's slot, claiming a free one; NULL if all are taken */
+static HttpConn *thread_conn(void)
+{
+    DWORD self = GetCurrentThreadId();
+    HttpConn *free_slot = NULL;
+    HttpConn *conn = NULL;
+    int i;
+
+    if (!s_initialized) {
+        return NULL;
+    }
+
+    EnterCriticalSection(&s_conns_lock);
+    for (i = 0; i < HTTP_MAX_CONNS; i++) {
+        if (s_conns[i].thread_id == self) {
+            conn = &s_conns[i];
+            break;
+        }
+        if (s_conns[i].thread_id == 0 && free_slot == NULL) {
+            free_slot = &s_conns[i];
+        }
+    }
+    if (conn == NULL && free_slot != NULL) {
+        conn = free_slot;
+        conn->thread_id = self;
+        conn->sock = INVALID_SOCKET;
+    }
+    LeaveCriticalSection(&s_conns_lock);
+
+    return conn;
+}
+
+HttpResult http_connect(int port, SOCKET *out)
 {
     SOCKET sock;
     struct sockaddr_in server;
-    char buffer[BUFFER_SIZE];
-    int total = 0;
-    int body_len;
-    int req_len;
-    char *body_start;
-    size_t req_capacity;
-    char *request;
-
-    response[0] = '\0';
+    u_long nonblocking = 1;
+    u_long blocking = 0;
+    fd_set writefds;
+    struct timeval tv;
+    int connect_result;
+    int so_error;
+    int so_len = sizeof(so_error);
 
     sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock == INVALID_SOCKET) {
@@ -77,162 +176,723 @@ HttpResult http_request(const char *method, const char *path, const char *body,
     }
 
     server.sin_family = AF_INET;
-    server.sin_port = htons((unsigned short)g_state.server_port);
+    server.sin_port = htons((unsigned short)port);
     server.sin_addr.s_addr = inet_addr(g_state.server_ip);
 
-    {
-        u_long nonblocking = 1;
-        u_long blocking = 0;
-        fd_set writefds;
-        struct timeval tv;
-        int connect_result;
-        int so_error;
-        int so_len = sizeof(so_error);
+    ioctlsocket(sock, FIONBIO, &nonblocking);
 
-        ioctlsocket(sock, FIONBIO, &nonblocking);
+    connect_result = connect(sock, (struct sockaddr *)&server, sizeof(server));
 
-        connect_result =
-            connect(sock, (struct sockaddr *)&server, sizeof(server));
+    if (connect_result < 0 && WSAGetLastError() != WSAEWOULDBLOCK) {
+        closesocket(sock);
+        return HTTP_ERR_CONNECT;
+    }
 
-        if (connect_result < 0 && WSAGetLastError() != WSAEWOULDBLOCK) {
+    if (connect_result != 0) {
+        FD_ZERO(&writefds);
+        FD_SET(sock, &writefds);
+        tv.tv_sec = HTTP_TIMEOUT_SEC;
+        tv.tv_usec = 0;
+
+        if (select((int)sock + 1, NULL, &writefds, NULL, &tv) <= 0) {
             closesocket(sock);
             return HTTP_ERR_CONNECT;
         }
 
-        if (connect_result != 0) {
-            FD_ZERO(&writefds);
-            FD_SET(sock, &writefds);
-            tv.tv_sec = HTTP_TIMEOUT_SEC;
-            tv.tv_usec = 0;
+        if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *)&so_error,
+                       &so_len) < 0 ||
+            so_error != 0) {
+            closesocket(sock);
+            return HTTP_ERR_CONNECT;
+        }
+    }
 
-            if (select((int)sock + 1, NULL, &writefds, NULL, &tv) <= 0) {
-                closesocket(sock);
-                return HTTP_ERR_CONNECT;
-            }
+    ioctlsocket(sock, FIONBIO, &blocking);
 
-            if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *)&so_error,
-                           &so_len) < 0 ||
-                so_error != 0) {
-                closesocket(sock);
-                return HTTP_ERR_CONNECT;
-            }
+    *out = sock;
+    return HTTP_OK;
+}
+
+static int send_all(SOCKET sock, const char *data, int len)
+{
+    int sent = 0;
+
+    while (sent < len) {
+        int n = send(sock, data + sent, len - sent, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        sent += n;
+    }
+    return 0;
+}
+
+#define HTTP_HEAD_CLOSED -2
+
+static int wait_readable(SOCKET sock, long timeout_sec)
+{
+    fd_set readfds;
+    struct timeval tv;
+
+    FD_ZERO(&readfds);
+    FD_SET(sock, &readfds);
+    tv.tv_sec = timeout_sec;
+    tv.tv_usec = 0;
+
+    return select((int)sock + 1, &readfds, NULL, NULL, &tv) > 0;
+}
+
+/*
+ * Read the status line and headers into head. Any body bytes that arrived
+ * with them are left after the blank line; *head_len covers the headers
+ * only and *total everything read. Returns 0 once the headers are complete,
+ * HTTP_HEAD_CLOSED if the peer closed the socket, -1 otherwise.
+ */
+static int read_head(SOCKET sock, char *head, size_t size, long timeout_sec,
+                     int *head_len, int *total)
+{
+    *head_len = -1;
+    *total = 0;
+    head[0] = '\0';
+
+    while ((size_t)*total < size - 1) {
+        const char *header_end;
+        int received;
+
+        if (!wait_readable(sock, timeout_sec)) {
+            return -1;
         }
 
-        ioctlsocket(sock, FIONBIO, &blocking);
+        received = recv(sock, head + *total, (int)(size - *total - 1), 0);
+        if (received <= 0) {
+            return HTTP_HEAD_CLOSED;
+        }
+        *total += received;
+        head[*total] = '\0';
+
+        header_end = strstr(head, "\r\n\r\n");
+        if (header_end) {
+            *head_len = (int)(header_end + 4 - head);
+            return 0;
+        }
     }
 
-    body_len = (body != NULL) ? (int)strlen(body) : 0;
-    req_capacity = (size_t)body_len + strlen(path) + strlen(method) +
-                   strlen(g_state.server_ip) + 256;
-    if (req_capacity < BUFFER_SIZE) {
-        req_capacity = BUFFER_SIZE;
+    return -1;
+}
+
+/*
+ * Pass the body to sink, starting with the bytes that arrived with the
+ * headers. content_length < 0 reads until the server closes. *complete is
+ * cleared if the body ended early, which also rules out reusing the socket.
+ */
+static HttpResult read_body(SOCKET sock, const char *prefix, int prefix_len,
+                            long content_length, long timeout_sec,
+                            const HttpBodySink *sink, int *complete)
+{
+    char chunk[HTTP_CHUNK_SIZE];
+    long remaining = content_length;
+    HttpResult ret;
+
+    *complete = 0;
+
+    if (content_length >= 0 && prefix_len > content_length) {
+        prefix_len = (int)content_length;
     }
 
-    request = (char *)malloc(req_capacity);
+    if (prefix_len > 0) {
+        ret = sink->write(sink->ctx, prefix, (size_t)prefix_len);
+        if (ret != HTTP_OK) {
+            return ret;
+        }
+        if (remaining >= 0) {
+            remaining -= prefix_len;
+        }
+    }
+
+    while (remaining != 0) {
+        int want = sizeof(chunk);
+        int received;
+
+        if (remaining > 0 && remaining < want) {
+            want = (int)remaining;
+        }
+
+        if (!wait_readable(sock, timeout_sec)) {
+            return remaining > 0 ? HTTP_ERR_TRUNCATED : HTTP_OK;
+        }
+
+        received = recv(sock, chunk, want, 0);
+        if (received <= 0) {
+            /* EOF is the normal end of an unframed body */
+            return remaining > 0 ? HTTP_ERR_TRUNCATED : HTTP_OK;
+        }
+
+        ret = sink->write(sink->ctx, chunk, (size_t)received);
+        if (ret != HTTP_OK) {
+            return ret;
+        }
+        if (remaining > 0) {
+            remaining -= received;
+        }
+    }
+
+    *complete = 1;
+    return HTTP_OK;
+}
+
+static HttpResult discard_write(void *ctx, const char *data, size_t len)
+{
+    (void)ctx;
+    (void)data;
+    (void)len;
+    return HTTP_OK;
+}
+
+/*
+ * Format the request line, headers and body into one heap buffer (caller
+ * frees). With json_len >= 0 only the head is formatted, announcing a JSON
+ * body of that length that the caller sends itself. Returns NULL if out of
+ * memory.
+ */
+static char *build_request(const char *method, const char *path,
+                           const char *body, long json_len, int keep_alive,
+                           int *len)
+{
+    int body_len = (body != NULL) ? (int)strlen(body) : 0;
+    size_t capacity = (size_t)body_len + strlen(path) + strlen(method) +
+                      strlen(g_state.server_ip) + 256;
+    char *request = (char *)malloc(capacity);
+    int n;
+
     if (!request) {
-        closesocket(sock);
-        return HTTP_ERR_OVERFLOW;
+        return NULL;
     }
 
-    if (body_len > 0) {
-        req_len = snprintf(request, req_capacity,
-                           "%s %s HTTP/1.1\r\n"
-                           "Host: %s:%d\r\n"
-                           "X-API-Key: %s\r\n"
-                           "Content-Type: application/json\r\n"
-                           "Content-Length: %d\r\n"
-                           "Connection: close\r\n"
-                           "\r\n"
-                           "%s",
-                           method, path, g_state.server_ip, g_state.server_port,
-                           API_KEY, body_len, body);
+    if (json_len >= 0) {
+        n = snprintf(request, capacity,
+                     "%s %s HTTP/1.1\r\n"
+                     "Host: %s:%d\r\n"
+                     "X-API-Key: %s\r\n"
+                     "Content-Type: application/json\r\n"
+                     "Content-Length: %ld\r\n"
+                     "Connection: %s\r\n"
+                     "\r\n",
+                     method, path, g_state.server_ip, g_state.server_port,
+                     API_KEY, json_len, keep_alive ? "keep-alive" : "close");
+    } else if (body_len > 0) {
+        n = snprintf(request, capacity,
+                     "%s %s HTTP/1.1\r\n"
+                     "Host: %s:%d\r\n"
+                     "X-API-Key: %s\r\n"
+                     "Content-Type: application/json\r\n"
+                     "Content-Length: %d\r\n"
+                     "Connection: %s\r\n"
+                     "\r\n"
+                     "%s",
+                     method, path, g_state.server_ip, g_state.server_port,
+                     API_KEY, body_len, keep_alive ? "keep-alive" : "close",
+                     body);
     } else {
-        req_len = snprintf(request, req_capacity,
-                           "%s %s HTTP/1.1\r\n"
-                           "Host: %s:%d\r\n"
-                           "X-API-Key: %s\r\n"
-                           "Connection: close\r\n"
-                           "\r\n",
-                           method, path, g_state.server_ip, g_state.server_port,
-                           API_KEY);
+        n = snprintf(request, capacity,
+                     "%s %s HTTP/1.1\r\n"
+                     "Host: %s:%d\r\n"
+                     "X-API-Key: %s\r\n"
+                     "Connection: %s\r\n"
+                     "\r\n",
+                     method, path, g_state.server_ip, g_state.server_port,
+                     API_KEY, keep_alive ? "keep-alive" : "close");
     }
 
-    if (req_len < 0 || (size_t)req_len >= req_capacity) {
+    if (n < 0 || (size_t)n >= capacity) {
         free(request);
-        closesocket(sock);
+        return NULL;
+    }
+
+    *len = n;
+    return request;
+}
+
+static int socket_sink(void *ctx, const char *data, size_t len)
+{
+    return send_all(*(SOCKET *)ctx, data, (int)len);
+}
+
+/*
+ * Send the head and json serialized straight into the socket, so the body
+ * is never held in memory. The head shares the first send with the body.
+ */
+static int send_json(SOCKET sock, const char *head, int head_len,
+                     const cJSON *json)
+{
+    JsonWriter w;
+
+    jw_init(&w, socket_sink, &sock);
+    jw_raw(&w, head, (size_t)head_len);
+    jw_value(&w, json);
+    return jw_finish(&w);
+}
+
+/* json, when set, is the request body instead of body */
+static HttpResult send_request(const char *method, const char *path,
+                               const char *body, const cJSON *json,
+                               int wait_ms, const HttpBodySink *sink)
+{
+    SOCKET sock = INVALID_SOCKET;
+    HttpConn *conn;
+    char head[HTTP_HEADER_MAX];
+    int head_len = -1;
+    int total = 0;
+    int req_len;
+    char *request;
+    long content_length;
+    long timeout_sec = HTTP_TIMEOUT_SEC + wait_ms / 1000;
+    int keep_alive;
+    int complete = 0;
+    int reused = 0;
+    int attempt;
+    int status;
+    HttpResult ret;
+
+    conn = thread_conn();
+
+    request = build_request(method, path, body,
+                            json ? (long)jw_measure(json) : -1L,
+                            conn != NULL, &req_len);
+    if (!request) {
         return HTTP_ERR_OVERFLOW;
     }
 
-    if (send(sock, request, req_len, 0) < 0) {
-        free(request);
+    /*
+     * A reused socket may have been closed by the server; retry once fresh.
+     * A failed send never reached it, but a request sent with no reply may
+     * have been acted on, so only a GET is sent again after that.
+     */
+    for (attempt = 0; attempt < 2; attempt++) {
+        reused = 0;
+        sock = INVALID_SOCKET;
+
+        if (conn && conn->sock != INVALID_SOCKET) {
+            if (conn->generation == s_generation) {
+                sock = conn->sock;
+                reused = 1;
+            } else {
+                closesocket(conn->sock);
+            }
+            conn->sock = INVALID_SOCKET;
+        }
+
+        if (sock == INVALID_SOCKET) {
+            ret = http_connect(g_state.server_port, &sock);
+            if (ret != HTTP_OK) {
+                free(request);
+                return ret;
+            }
+            InterlockedIncrement(&s_connects);
+        }
+
+        if ((json ? send_json(sock, request, req_len, json)
+                  : send_all(sock, request, req_len)) < 0) {
+            closesocket(sock);
+            if (reused) {
+                continue;
+            }
+            free(request);
+            return HTTP_ERR_SEND;
+        }
+
+        /* Server may legitimately hold a long poll open for wait_ms */
+        if (read_head(sock, head, sizeof(head), timeout_sec, &head_len,
+                      &total) != HTTP_HEAD_CLOSED ||
+            total > 0 || !reused) {
+            break;
+        }
         closesocket(sock);
-        return HTTP_ERR_SEND;
+        if (strcmp(method, "GET") != 0) {
+            free(request);
+            return HTTP_ERR_NO_BODY;
+        }
     }
 
     free(request);
-    memset(buffer, 0, sizeof(buffer));
 
-    while ((size_t)total < sizeof(buffer) - 1) {
-        fd_set readfds;
-        struct timeval tv;
-        int received;
+    if (attempt == 2) {
+        return HTTP_ERR_SEND;
+    }
 
-        FD_ZERO(&readfds);
-        FD_SET(sock, &readfds);
-        tv.tv_sec = HTTP_TIMEOUT_SEC;
-        tv.tv_usec = 0;
+    if (reused) {
+        InterlockedIncrement(&s_reuses);
+    }
 
-        if (select((int)sock + 1, &readfds, NULL, NULL, &tv) <= 0) {
-            break;
-        }
+    if (head_len < 0) {
+        closesocket(sock);
+        return total == 0 ? HTTP_ERR_TIMEOUT : HTTP_ERR_NO_BODY;
+    }
 
-        received = recv(sock, buffer + total, sizeof(buffer) - total - 1, 0);
-        if (received <= 0) {
-            break;
-        }
-        total += received;
+    status = ev_parse_head(head, (size_t)head_len, &content_length,
+                           &keep_alive);
+
+    if (status < 200 || status >= 300) {
+        HttpBodySink discard = {NULL, discard_write, NULL};
+
+        /* Drain so the connection stays usable */
+        read_body(sock, head + head_len, total - head_len, content_length,
+                  timeout_sec, &discard, &complete);
+        ret = HTTP_ERR_SERVER;
+    } else if (sink->begin != NULL &&
+               (ret = sink->begin(sink->ctx, content_length)) != HTTP_OK) {
+        complete = 0;
+    } else {
+        ret = read_body(sock, head + head_len, total - head_len,
+                        content_length, timeout_sec, sink, &complete);
+    }
+
+    if (conn && keep_alive && complete) {
+        conn->sock = sock;
+        conn->generation = s_generation;
+    } else {
+        closesocket(sock);
+    }
+
+    return ret;
+}
+
+static HttpResult request_sink(const char *method, const char *path,
+                               const char *body, const cJSON *json,
+                               int wait_ms, const HttpBodySink *sink)
+{
+    HttpResult ret;
+
+    /* Don't spend a connect timeout on a server known to be down */
+    if (sched_begin_request() < 0) {
+        return HTTP_ERR_OFFLINE;
     }
-    buffer[total] = '\0';
 
-    closesocket(sock);
+    ret = send_request(method, path, body, json, wait_ms, sink);
+    sched_end_request(ret != HTTP_ERR_CONNECT && ret != HTTP_ERR_SEND &&
+                      ret != HTTP_ERR_TIMEOUT);
+    return ret;
+}
 
-    if (total == 0) {
+HttpResult http_request_sink(const char *method, const char *path,
+                             const char *body, int wait_ms,
+                             const HttpBodySink *sink)
+{
+    return request_sink(method, path, body, NULL, wait_ms, sink);
+}
+
+typedef struct {
+    HttpDone done;
+    void *ctx;
+} AsyncCall;
+
+static HttpResult from_ev_result(EvResult result)
+{
+    switch (result) {
+    case EV_OK:
+        return HTTP_OK;
+    case EV_ERR_SOCKET:
+        return HTTP_ERR_SOCKET;
+    case EV_ERR_CONNECT:
+        return HTTP_ERR_CONNECT;
+    case EV_ERR_TIMEOUT:
         return HTTP_ERR_TIMEOUT;
+    case EV_ERR_NO_BODY:
+        return HTTP_ERR_NO_BODY;
+    case EV_ERR_STATUS:
+        return HTTP_ERR_SERVER;
+    case EV_ERR_TRUNCATED:
+        return HTTP_ERR_TRUNCATED;
+    case EV_ERR_TOO_LARGE:
+        return HTTP_ERR_RESPONSE_TOO_LARGE;
+    case EV_ERR_NOMEM:
+        return HTTP_ERR_OVERFLOW;
+    default:
+        return HTTP_ERR_SEND;
     }
+}
 
-    {
-        int status = parse_http_status(buffer);
-        if (status < 200 || status >= 300) {
-            return HTTP_ERR_SERVER;
-        }
+static void async_done(void *ctx, EvResult result, int status, char *body,
+                       size_t len)
+{
+    AsyncCall *call = (AsyncCall *)ctx;
+    HttpResult ret = from_ev_result(result);
+
+    (void)status;
+
+    /* A loop torn down at exit says nothing about the server */
+    sched_end_request(result == EV_ERR_ABORTED ||
+                      (ret != HTTP_ERR_CONNECT && ret != HTTP_ERR_SEND &&
+                       ret != HTTP_ERR_TIMEOUT));
+
+    if (ret == HTTP_OK) {
+        call->done(call->ctx, ret, body, len);
+    } else {
+        call->done(call->ctx, ret, NULL, 0);
     }
+    free(call);
+}
 
-    body_start = strstr(buffer, "\r\n\r\n");
-    if (body_start) {
-        int content_length;
-        int body_len;
+/*
+ * Format method path with body, or with json serialized after the head
+ * into the same exact-size buffer. Returns NULL if out of memory.
+ */
+static char *build_async(const char *method, const char *path,
+                         const char *body, const cJSON *json, int *len)
+{
+    size_t json_len;
+    char *head;
+    char *request;
+    JsonBuffer jb;
+    JsonWriter w;
 
-        body_start += 4;
-        body_len = total - (int)(body_start - buffer);
+    if (!json) {
+        return build_request(method, path, body, -1L, 1, len);
+    }
 
-        content_length = parse_content_length(buffer);
+    json_len = jw_measure(json);
+    head = build_request(method, path, NULL, (long)json_len, 1, len);
+    if (!head) {
+        return NULL;
+    }
+    request = (char *)malloc((size_t)*len + json_len + 1);
+    if (!request) {
+        free(head);
+        return NULL;
+    }
+    memcpy(request, head, (size_t)*len);
+    free(head);
+
+    jb.buf = request;
+    jb.size = (size_t)*len + json_len + 1;
+    jb.len = (size_t)*len;
+    jw_init(&w, jw_buffer_sink, &jb);
+    jw_value(&w, json);
+    if (jw_finish(&w) < 0) {
+        free(request);
+        return NULL;
+    }
+    *len = (int)jb.len;
+    return request;
+}
 
-        if (content_length > 0 && (size_t)content_length >= resp_size) {
-            return HTTP_ERR_RESPONSE_TOO_LARGE;
-        }
+static HttpResult start_async(EvLoop *loop, const char *method,
+                              const char *path, const char *body,
+                              const cJSON *json, int wait_ms, HttpDone done,
+                              void *ctx)
+{
+    AsyncCall *call;
+    char *request;
+    int req_len;
 
-        if (content_length > 0 && body_len < content_length) {
-            return HTTP_ERR_TRUNCATED;
-        }
+    if (ev_room(loop) == 0) {
+        return HTTP_ERR_OVERFLOW;
+    }
 
-        if (content_length <= 0 && (size_t)total >= sizeof(buffer) - 1) {
-            return HTTP_ERR_TRUNCATED;
-        }
+    call = (AsyncCall *)malloc(sizeof(*call));
+    if (!call) {
+        return HTTP_ERR_OVERFLOW;
+    }
+    request = build_async(method, path, body, json, &req_len);
+    if (!request) {
+        free(call);
+        return HTTP_ERR_OVERFLOW;
+    }
 
-        strncpy(response, body_start, resp_size - 1);
-        response[resp_size - 1] = '\0';
+    if (sched_begin_request() < 0) {
+        free(request);
+        free(call);
+        return HTTP_ERR_OFFLINE;
+    }
+
+    call->done = done;
+    call->ctx = ctx;
+    ev_set_server(loop, g_state.server_ip, g_state.server_port);
+    loop->max_body = (size_t)g_state.max_response_kb * 1024;
+
+    /* The loop owns request from here on */
+    if (ev_start(loop, request, (size_t)req_len,
+                 HTTP_TIMEOUT_SEC * 1000L + wait_ms, async_done, call) < 0) {
+        sched_end_request(1);
+        free(call);
+        return HTTP_ERR_OVERFLOW;
+    }
+    return HTTP_OK;
+}
+
+HttpResult http_request_async(EvLoop *loop, const char *method,
+                              const char *path, const char *body, int wait_ms,
+                              HttpDone done, void *ctx)
+{
+    return start_async(loop, method, path, body, NULL, wait_ms, done, ctx);
+}
+
+HttpResult http_post_json_async(EvLoop *loop, const char *path,
+                                const cJSON *json, HttpDone done, void *ctx)
+{
+    return start_async(loop, "POST", path, NULL, json, 0, done, ctx);
+}
+
+/* Fixed caller buffer; keeps the original size error semantics */
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+} FixedBody;
+
+static HttpResult fixed_begin(void *ctx, long content_length)
+{
+    FixedBody *fb = (FixedBody *)ctx;
+
+    if (content_length > 0 && (size_t)content_length >= fb->size) {
+        return HTTP_ERR_RESPONSE_TOO_LARGE;
+    }
+    return HTTP_OK;
+}
+
+static HttpResult fixed_write(void *ctx, const char *data, size_t len)
+{
+    FixedBody *fb = (FixedBody *)ctx;
+
+    if (fb->len + len >= fb->size) {
+        return HTTP_ERR_TRUNCATED;
+    }
+    memcpy(fb->buf + fb->len, data, len);
+    fb->len += len;
+    fb->buf[fb->len] = '\0';
+    return HTTP_OK;
+}
+
+/* Heap buffer sized from Content-Length, grown when there is none */
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+    size_t limit;
+} HeapBody;
+
+static HttpResult heap_reserve(HeapBody *hb, size_t need)
+{
+    size_t cap;
+    char *grown;
+
+    if (need <= hb->cap) {
         return HTTP_OK;
     }
+    if (need > hb->limit + 1) {
+        return HTTP_ERR_RESPONSE_TOO_LARGE;
+    }
 
-    return HTTP_ERR_NO_BODY;
+    cap = hb->cap ? hb->cap : HTTP_CHUNK_SIZE;
+    while (cap < need) {
+        cap *= 2;
+    }
+    if (cap > hb->limit + 1) {
+        cap = hb->limit + 1;
+    }
+
+    grown = (char *)realloc(hb->buf, cap);
+    if (!grown) {
+        return HTTP_ERR_OVERFLOW;
+    }
+    hb->buf = grown;
+    hb->cap = cap;
+    return HTTP_OK;
+}
+
+static HttpResult heap_begin(void *ctx, long content_length)
+{
+    HeapBody *hb = (HeapBody *)ctx;
+
+    if (content_length >= 0) {
+        return heap_reserve(hb, (size_t)content_length + 1);
+    }
+    return HTTP_OK;
+}
+
+static HttpResult heap_write(void *ctx, const char *data, size_t len)
+{
+    HeapBody *hb = (HeapBody *)ctx;
+    HttpResult ret = heap_reserve(hb, hb->len + len + 1);
+
+    if (ret != HTTP_OK) {
+        return ret;
+    }
+    memcpy(hb->buf + hb->len, data, len);
+    hb->len += len;
+    return HTTP_OK;
+}
+
+HttpResult http_request_alloc(const char *method, const char *path,
+                              const char *body, int wait_ms, char **response,
+                              size_t *resp_len)
+{
+    HeapBody hb = {NULL, 0, 0, 0};
+    HttpBodySink sink;
+    HttpResult ret;
+
+    *response = NULL;
+    if (resp_len) {
+        *resp_len = 0;
+    }
+
+    hb.limit = (size_t)g_state.max_response_kb * 1024;
+    sink.begin = heap_begin;
+    sink.write = heap_write;
+    sink.ctx = &hb;
+
+    ret = http_request_sink(method, path, body, wait_ms, &sink);
+    if (ret == HTTP_OK) {
+        ret = heap_reserve(&hb, hb.len + 1);
+    }
+    if (ret != HTTP_OK) {
+        free(hb.buf);
+        return ret;
+    }
+
+    hb.buf[hb.len] = '\0';
+    *response = hb.buf;
+    if (resp_len) {
+        *resp_len = hb.len;
+    }
+    return HTTP_OK;
+}
+
+HttpResult http_request(const char *method, const char *path, const char *body,
+                        char *response, size_t resp_size)
+{
+    return http_request_wait(method, path, body, response, resp_size, 0);
+}
+
+static HttpResult request_fixed(const char *method, const char *path,
+                                const char *body, const cJSON *json,
+                                char *response, size_t resp_size,
+                                int wait_ms)
+{
+    FixedBody fb;
+    HttpBodySink sink;
+
+    response[0] = '\0';
+
+    fb.buf = response;
+    fb.size = resp_size;
+    fb.len = 0;
+    sink.begin = fixed_begin;
+    sink.write = fixed_write;
+    sink.ctx = &fb;
+
+    return request_sink(method, path, body, json, wait_ms, &sink);
+}
+
+HttpResult http_request_wait(const char *method, const char *path,
+                             const char *body, char *response,
+                             size_t resp_size, int wait_ms)
+{
+    return request_fixed(method, path, body, NULL, response, resp_size,
+                         wait_ms);
+}
+
+HttpResult http_post_json(const char *path, const cJSON *json,
+                          char *response, size_t resp_size)
+{
+    return request_fixed("POST", path, NULL, json, response, resp_size, 0);
 }
@@ -6,6 +6,19 @@
 #define HTTP_H
 
 #include "claude.h"
+#include "evloop.h"
+
+/*
+ * Receives a response body as it arrives. begin (optional) is called once
+ * with the Content-Length, or -1 when the server sent none; write is called
+ * for each chunk. Returning anything but HTTP_OK aborts the request and
+ * that code is returned to the caller.
+ */
+typedef struct {
+    HttpResult (*begin)(void *ctx, long content_length);
+    HttpResult (*write)(void *ctx, const char *data, size_t len);
+    void *ctx;
+} HttpBodySink;
 
 /*
  * Perform an HTTP request to the server.
@@ -21,6 +34,84 @@
 HttpResult http_request(const char *method, const char *path, const char *body,
                         char *response, size_t resp_size);
 
+/*
+ * Same as http_request, but allows the server to hold the request open for
+ * up to wait_ms before answering (long poll). The read timeout is extended
+ * to match.
+ */
+HttpResult http_request_wait(const char *method, const char *path,
+                             const char *body, char *response,
+                             size_t resp_size, int wait_ms);
+
+/*
+ * Perform a request and stream the body of a 2xx response to sink. Only
+ * the headers are buffered, so there is no limit on body size.
+ */
+HttpResult http_request_sink(const char *method, const char *path,
+                             const char *body, int wait_ms,
+                             const HttpBodySink *sink);
+
+/*
+ * Perform a request and return the body in a heap buffer sized from
+ * Content-Length (NUL-terminated, caller frees). Bodies larger than the
+ * max_response_kb setting fail with HTTP_ERR_RESPONSE_TOO_LARGE.
+ */
+HttpResult http_request_alloc(const char *method, const char *path,
+                              const char *body, int wait_ms, char **response,
+                              size_t *resp_len);
+
+/*
+ * Completion of http_request_async, run on the loop's thread. body is the
+ * NUL-terminated body of a 2xx response, valid only during the call and
+ * free to be modified in place, or NULL when result is an error.
+ */
+typedef void (*HttpDone)(void *ctx, HttpResult result, char *body,
+                         size_t len);
+
+/*
+ * Start a request on loop and return at once; ev_run() drives it and
+ * calls done. It counts toward the breaker like a blocking request.
+ * Returns HTTP_OK once started, HTTP_ERR_OFFLINE while the breaker is
+ * open, or HTTP_ERR_OVERFLOW if the loop is full; done is only called
+ * when HTTP_OK was returned.
+ */
+HttpResult http_request_async(EvLoop *loop, const char *method,
+                              const char *path, const char *body, int wait_ms,
+                              HttpDone done, void *ctx);
+
+/*
+ * POST json, serialized straight into the socket rather than printed to a
+ * string first. Otherwise the same as http_request.
+ */
+HttpResult http_post_json(const char *path, const cJSON *json,
+                          char *response, size_t resp_size);
+
+/* POST json on loop; the body is serialized once into the request buffer */
+HttpResult http_post_json_async(EvLoop *loop, const char *path,
+                                const cJSON *json, HttpDone done, void *ctx);
+
+/*
+ * Open a blocking TCP connection to port on the configured server, giving
+ * up after HTTP_TIMEOUT_SEC. Used by the frame protocol link as well.
+ */
+HttpResult http_connect(int port, SOCKET *out);
+
+/*
+ * Set up / tear down the per-thread keep-alive connection table. Call once
+ * from the main thread after WSAStartup and before WSACleanup.
+ */
+void http_init(void);
+void http_cleanup(void);
+
+/* Close the calling thread's kept-alive connection and free its slot */
+void http_release_thread(void);
+
+/* Drop all kept-alive connections, e.g. after the server address changes */
+void http_reset_connections(void);
+
+/* Connections opened, and requests that reused an open connection instead */
+void http_get_stats(long *connects, long *reuses);
+
 const char *http_error_string(HttpResult code);
 
 #endif /* HTTP_H */
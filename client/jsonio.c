@@ -0,0 +1,793 @@
+/*
+ * jsonio.c - Streaming JSON writer and in-place JSON reader
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jsonio.h"
+
+static void flush(JsonWriter *w)
+{
+    if (w->used > 0 && !w->error && w->sink(w->ctx, w->buf, w->used) != 0) {
+        w->error = 1;
+    }
+    w->used = 0;
+}
+
+static void put(JsonWriter *w, const char *data, size_t len)
+{
+    w->total += len;
+    if (!w->sink || w->error) {
+        return;
+    }
+
+    while (len > 0) {
+        size_t n = sizeof(w->buf) - w->used;
+
+        if (n > len) {
+            n = len;
+        }
+        memcpy(w->buf + w->used, data, n);
+        w->used += n;
+        data += n;
+        len -= n;
+        if (w->used == sizeof(w->buf)) {
+            flush(w);
+        }
+    }
+}
+
+static void put_char(JsonWriter *w, char c)
+{
+    put(w, &c, 1);
+}
+
+/* Comma between members or elements; none right after a key */
+static void before_value(JsonWriter *w)
+{
+    if (w->after_key) {
+        w->after_key = 0;
+        return;
+    }
+    if (w->depth > 0) {
+        if (w->need_comma[w->depth - 1]) {
+            put_char(w, ',');
+        }
+        w->need_comma[w->depth - 1] = 1;
+    }
+}
+
+static void open_container(JsonWriter *w, char c)
+{
+    before_value(w);
+    put_char(w, c);
+    if (w->depth >= JW_MAX_DEPTH) {
+        w->error = 1;
+        return;
+    }
+    w->need_comma[w->depth++] = 0;
+}
+
+static void close_container(JsonWriter *w, char c)
+{
+    if (w->depth > 0) {
+        w->depth--;
+    }
+    put_char(w, c);
+}
+
+/* Same escapes as cJSON; bytes >= 0x80 pass through untouched */
+static void put_escaped(JsonWriter *w, const char *s, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *end = s + len;
+
+    put_char(w, '"');
+    while (s < end) {
+        const char *run = s;
+        unsigned char c;
+        char esc[6];
+
+        while (s < end && (unsigned char)*s >= 0x20 && *s != '"' &&
+               *s != '\\') {
+            s++;
+        }
+        if (s > run) {
+            put(w, run, (size_t)(s - run));
+        }
+        if (s == end) {
+            break;
+        }
+
+        c = (unsigned char)*s++;
+        esc[0] = '\\';
+        switch (c) {
+        case '"':
+        case '\\':
+            esc[1] = (char)c;
+            break;
+        case '\b':
+            esc[1] = 'b';
+            break;
+        case '\f':
+            esc[1] = 'f';
+            break;
+        case '\n':
+            esc[1] = 'n';
+            break;
+        case '\r':
+            esc[1] = 'r';
+            break;
+        case '\t':
+            esc[1] = 't';
+            break;
+        default:
+            esc[1] = 'u';
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 15];
+            put(w, esc, 6);
+            continue;
+        }
+        put(w, esc, 2);
+    }
+    put_char(w, '"');
+}
+
+void jw_init(JsonWriter *w, JsonSink sink, void *ctx)
+{
+    w->sink = sink;
+    w->ctx = ctx;
+    w->used = 0;
+    w->total = 0;
+    w->depth = 0;
+    w->after_key = 0;
+    w->error = 0;
+}
+
+void jw_object_begin(JsonWriter *w)
+{
+    open_container(w, '{');
+}
+
+void jw_object_end(JsonWriter *w)
+{
+    close_container(w, '}');
+}
+
+void jw_array_begin(JsonWriter *w)
+{
+    open_container(w, '[');
+}
+
+void jw_array_end(JsonWriter *w)
+{
+    close_container(w, ']');
+}
+
+void jw_key(JsonWriter *w, const char *key)
+{
+    before_value(w);
+    put_escaped(w, key, strlen(key));
+    put_char(w, ':');
+    w->after_key = 1;
+}
+
+void jw_string(JsonWriter *w, const char *s)
+{
+    jw_string_n(w, s, s ? strlen(s) : 0);
+}
+
+void jw_string_n(JsonWriter *w, const char *s, size_t len)
+{
+    before_value(w);
+    put_escaped(w, s ? s : "", len);
+}
+
+void jw_long(JsonWriter *w, long value)
+{
+    char num[24];
+    int n = sprintf(num, "%ld", value);
+
+    before_value(w);
+    put(w, num, (size_t)n);
+}
+
+void jw_bool(JsonWriter *w, int value)
+{
+    before_value(w);
+    if (value) {
+        put(w, "true", 4);
+    } else {
+        put(w, "false", 5);
+    }
+}
+
+void jw_null(JsonWriter *w)
+{
+    before_value(w);
+    put(w, "null", 4);
+}
+
+static void put_number(JsonWriter *w, const cJSON *item)
+{
+    char num[32];
+    double d = item->valuedouble;
+    double test = 0.0;
+    int n;
+
+    if (isnan(d) || isinf(d)) {
+        n = sprintf(num, "null");
+    } else if (d == (double)item->valueint) {
+        n = sprintf(num, "%d", item->valueint);
+    } else {
+        n = sprintf(num, "%1.15g", d);
+        if (sscanf(num, "%lg", &test) != 1 || test != d) {
+            n = sprintf(num, "%1.17g", d);
+        }
+    }
+    put(w, num, (size_t)n);
+}
+
+void jw_value(JsonWriter *w, const cJSON *item)
+{
+    const cJSON *child;
+
+    if (!item) {
+        w->error = 1;
+        return;
+    }
+
+    switch (item->type & 0xFF) {
+    case cJSON_NULL:
+        jw_null(w);
+        break;
+    case cJSON_False:
+        jw_bool(w, 0);
+        break;
+    case cJSON_True:
+        jw_bool(w, 1);
+        break;
+    case cJSON_Number:
+        before_value(w);
+        put_number(w, item);
+        break;
+    case cJSON_String:
+        jw_string(w, item->valuestring);
+        break;
+    case cJSON_Raw:
+        before_value(w);
+        if (item->valuestring) {
+            put(w, item->valuestring, strlen(item->valuestring));
+        }
+        break;
+    case cJSON_Array:
+        jw_array_begin(w);
+        cJSON_ArrayForEach(child, item)
+        {
+            jw_value(w, child);
+        }
+        jw_array_end(w);
+        break;
+    case cJSON_Object:
+        jw_object_begin(w);
+        cJSON_ArrayForEach(child, item)
+        {
+            jw_key(w, child->string ? child->string : "");
+            jw_value(w, child);
+        }
+        jw_object_end(w);
+        break;
+    default:
+        w->error = 1;
+        break;
+    }
+}
+
+void jw_raw(JsonWriter *w, const char *data, size_t len)
+{
+    put(w, data, len);
+}
+
+int jw_finish(JsonWriter *w)
+{
+    if (w->sink) {
+        flush(w);
+    }
+    return w->error ? -1 : 0;
+}
+
+size_t jw_measure(const cJSON *item)
+{
+    JsonWriter w;
+
+    jw_init(&w, NULL, NULL);
+    jw_value(&w, item);
+    return w.total;
+}
+
+int jw_buffer_sink(void *ctx, const char *data, size_t len)
+{
+    JsonBuffer *jb = (JsonBuffer *)ctx;
+
+    if (jb->len + len >= jb->size) {
+        return -1;
+    }
+    memcpy(jb->buf + jb->len, data, len);
+    jb->len += len;
+    jb->buf[jb->len] = '\0';
+    return 0;
+}
+
+static char *skip_ws(char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        p++;
+    }
+    return p;
+}
+
+/*
+ * Returns the byte after the closing quote of the string at p. memchr
+ * does the walking; a quote is escaped when an odd run of backslashes
+ * precedes it.
+ */
+static char *scan_string(char *p, const char *end)
+{
+    char *q = p + 1;
+
+    while (q < end) {
+        char *b;
+
+        q = (char *)memchr(q, '"', (size_t)(end - q));
+        if (!q) {
+            return NULL;
+        }
+        for (b = q; b > p + 1 && b[-1] == '\\'; b--) {
+        }
+        if (((q - b) & 1) == 0) {
+            return q + 1;
+        }
+        q++;
+    }
+    return NULL;
+}
+
+/* Returns the first byte after the value at p, or NULL if malformed */
+static char *scan_value(char *p, const char *end)
+{
+    int depth = 0;
+
+    if (p >= end) {
+        return NULL;
+    }
+
+    if (*p == '"') {
+        return scan_string(p, end);
+    }
+
+    if (*p != '{' && *p != '[') {
+        char *start = p;
+
+        while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' &&
+               *p != '\t' && *p != '\r' && *p != '\n') {
+            p++;
+        }
+        return p > start ? p : NULL;
+    }
+
+    while (p < end) {
+        if (*p == '"') {
+            p = scan_string(p, end);
+            if (!p) {
+                return NULL;
+            }
+            continue;
+        }
+        if (*p == '{' || *p == '[') {
+            depth++;
+        } else if ((*p == '}' || *p == ']') && --depth == 0) {
+            return p + 1;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+int jr_root(char *text, size_t len, JsonSpan *root)
+{
+    const char *end = text + len;
+    char *p = skip_ws(text, end);
+
+    /* Not validated here; jr_get checks what it walks */
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' ||
+                       end[-1] == '\r' || end[-1] == '\n')) {
+        end--;
+    }
+    if (p == end) {
+        return -1;
+    }
+    root->p = p;
+    root->len = (size_t)(end - p);
+    return 0;
+}
+
+static int hex4(const char *s, unsigned long *out)
+{
+    int i;
+
+    *out = 0;
+    for (i = 0; i < 4; i++) {
+        char c = s[i];
+
+        *out <<= 4;
+        if (c >= '0' && c <= '9') {
+            *out |= (unsigned long)(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            *out |= (unsigned long)(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            *out |= (unsigned long)(c - 'A' + 10);
+        } else {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Decode the escape at *src (just past the backslash) into out, as UTF-8
+ * for \u. Returns the byte count, or -1 if the escape is invalid.
+ */
+static int decode_escape(const char **src, const char *end, char out[4])
+{
+    const char *s = *src;
+    unsigned long cp;
+
+    if (s >= end) {
+        return -1;
+    }
+
+    switch (*s) {
+    case '"':
+    case '\\':
+    case '/':
+        out[0] = *s;
+        break;
+    case 'b':
+        out[0] = '\b';
+        break;
+    case 'f':
+        out[0] = '\f';
+        break;
+    case 'n':
+        out[0] = '\n';
+        break;
+    case 'r':
+        out[0] = '\r';
+        break;
+    case 't':
+        out[0] = '\t';
+        break;
+    case 'u':
+        if (end - s < 5 || hex4(s + 1, &cp) < 0) {
+            return -1;
+        }
+        s += 4;
+        if (cp >= 0xDC00 && cp <= 0xDFFF) {
+            return -1;
+        }
+        if (cp >= 0xD800 && cp <= 0xDBFF) {
+            unsigned long low;
+
+            if (end - s < 7 || s[1] != '\\' || s[2] != 'u' ||
+                hex4(s + 3, &low) < 0 || low < 0xDC00 || low > 0xDFFF) {
+                return -1;
+            }
+            s += 6;
+            cp = 0x10000 + (((cp & 0x3FF) << 10) | (low & 0x3FF));
+        }
+        *src = s + 1;
+        if (cp < 0x80) {
+            out[0] = (char)cp;
+            return 1;
+        }
+        if (cp < 0x800) {
+            out[0] = (char)(0xC0 | (cp >> 6));
+            out[1] = (char)(0x80 | (cp & 0x3F));
+            return 2;
+        }
+        if (cp < 0x10000) {
+            out[0] = (char)(0xE0 | (cp >> 12));
+            out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+            out[2] = (char)(0x80 | (cp & 0x3F));
+            return 3;
+        }
+        out[0] = (char)(0xF0 | (cp >> 18));
+        out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[3] = (char)(0x80 | (cp & 0x3F));
+        return 4;
+    default:
+        return -1;
+    }
+
+    *src = s + 1;
+    return 1;
+}
+
+/*
+ * Decode the string body [s, end) into dst, which may be s itself since
+ * output never overtakes input. Returns the length or -1.
+ */
+static long decode_into(const char *s, const char *end, char *dst,
+                        size_t size)
+{
+    size_t len = 0;
+
+    while (s < end) {
+        const char *run = s;
+        char out[4];
+        int n;
+
+        while (s < end && *s != '\\') {
+            s++;
+        }
+        if (s > run) {
+            if (len + (size_t)(s - run) >= size) {
+                return -1;
+            }
+            memmove(dst + len, run, (size_t)(s - run));
+            len += (size_t)(s - run);
+        }
+        if (s == end) {
+            break;
+        }
+
+        s++;
+        n = decode_escape(&s, end, out);
+        if (n < 0 || len + (size_t)n >= size) {
+            return -1;
+        }
+        memcpy(dst + len, out, (size_t)n);
+        len += (size_t)n;
+    }
+
+    dst[len] = '\0';
+    return (long)len;
+}
+
+int jr_get(const JsonSpan *obj, const char *key, JsonSpan *value)
+{
+    const char *end = obj->p + obj->len;
+    size_t key_len = strlen(key);
+    char *p = obj->p;
+
+    if (obj->len < 2 || *p != '{') {
+        return -1;
+    }
+    p++;
+
+    for (;;) {
+        char *name;
+        char *name_end;
+        char *after;
+        JsonSpan name_span;
+
+        p = skip_ws(p, end);
+        if (p >= end || *p != '"') {
+            return -1;
+        }
+        name = p;
+        name_end = scan_value(p, end);
+        if (!name_end) {
+            return -1;
+        }
+
+        p = skip_ws(name_end, end);
+        if (p >= end || *p != ':') {
+            return -1;
+        }
+        p = skip_ws(p + 1, end);
+        after = scan_value(p, end);
+        if (!after) {
+            return -1;
+        }
+
+        name_span.p = name;
+        name_span.len = (size_t)(name_end - name);
+        if (name_span.len >= key_len + 2 && jr_string_eq(&name_span, key)) {
+            value->p = p;
+            value->len = (size_t)(after - p);
+            return 0;
+        }
+
+        p = skip_ws(after, end);
+        if (p >= end || *p != ',') {
+            return -1;
+        }
+        p++;
+    }
+}
+
+int jr_is_string(const JsonSpan *v)
+{
+    return v->len >= 2 && v->p[0] == '"' && v->p[v->len - 1] == '"';
+}
+
+int jr_is_true(const JsonSpan *v)
+{
+    return v->len == 4 && memcmp(v->p, "true", 4) == 0;
+}
+
+int jr_string_eq(const JsonSpan *v, const char *s)
+{
+    const char *p;
+    const char *end;
+
+    if (!jr_is_string(v)) {
+        return 0;
+    }
+    p = v->p + 1;
+    end = v->p + v->len - 1;
+
+    while (p < end) {
+        char out[4];
+        int n;
+        int i;
+
+        if (*p != '\\') {
+            if (*s++ != *p++) {
+                return 0;
+            }
+            continue;
+        }
+        p++;
+        n = decode_escape(&p, end, out);
+        if (n < 0) {
+            return 0;
+        }
+        for (i = 0; i < n; i++) {
+            if (*s++ != out[i]) {
+                return 0;
+            }
+        }
+    }
+    return *s == '\0';
+}
+
+long jr_string(const JsonSpan *v, char *dst, size_t size)
+{
+    if (!jr_is_string(v) || size == 0) {
+        return -1;
+    }
+    return decode_into(v->p + 1, v->p + v->len - 1, dst, size);
+}
+
+char *jr_string_inplace(JsonSpan *v)
+{
+    if (!jr_is_string(v) ||
+        decode_into(v->p + 1, v->p + v->len - 1, v->p, v->len) < 0) {
+        return NULL;
+    }
+    return v->p;
+}
+
+/* Write out what is staged in chunk; returns -1 on a short write */
+static long flush_chunk(FILE *fp, const char *chunk, size_t *used)
+{
+    size_t n = *used;
+
+    if (n == 0) {
+        return 0;
+    }
+    *used = 0;
+    return fwrite(chunk, 1, n, fp) == n ? (long)n : -1;
+}
+
+long jr_string_to_file(const JsonSpan *v, FILE *fp)
+{
+    char chunk[1024];
+    const char *s;
+    const char *end;
+    size_t used = 0;
+    long written = 0;
+    long n;
+
+    if (!jr_is_string(v)) {
+        return -1;
+    }
+    s = v->p + 1;
+    end = v->p + v->len - 1;
+
+    /*
+     * Short runs and escapes are staged so a newline every line doesn't
+     * cost an fwrite each; long runs go straight from the received text.
+     */
+    while (s < end) {
+        const char *esc = (const char *)memchr(s, '\\', (size_t)(end - s));
+        size_t run = (size_t)((esc ? esc : end) - s);
+
+        if (used + run > sizeof(chunk) - 4) {
+            if ((n = flush_chunk(fp, chunk, &used)) < 0) {
+                return -1;
+            }
+            written += n;
+        }
+        if (run > sizeof(chunk) - 4) {
+            if (fwrite(s, 1, run, fp) != run) {
+                return -1;
+            }
+            written += (long)run;
+        } else {
+            memcpy(chunk + used, s, run);
+            used += run;
+        }
+        s += run;
+
+        if (esc) {
+            int len;
+
+            s++;
+            len = decode_escape(&s, end, chunk + used);
+            if (len < 0) {
+                return -1;
+            }
+            used += (size_t)len;
+        }
+    }
+
+    if ((n = flush_chunk(fp, chunk, &used)) < 0) {
+        return -1;
+    }
+    return written + n;
+}
+
+long jr_long(const JsonSpan *v, long fallback)
+{
+    const char *p = v->p;
+    const char *end = v->p + v->len;
+    int negative = 0;
+    long value = 0;
+
+    if (p < end && *p == '-') {
+        negative = 1;
+        p++;
+    }
+    if (p >= end || *p < '0' || *p > '9') {
+        return fallback;
+    }
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p++ - '0');
+    }
+    return negative ? -value : value;
+}
+
+void jr_blank(JsonSpan *v)
+{
+    const char *empty;
+    size_t n;
+
+    if (v->len == 0) {
+        return;
+    }
+    switch (v->p[0]) {
+    case '{':
+        empty = "{}";
+        break;
+    case '[':
+        empty = "[]";
+        break;
+    case '"':
+        empty = "\"\"";
+        break;
+    default:
+        empty = v->len >= 4 ? "null" : "0";
+        break;
+    }
+
+    n = strlen(empty);
+    memcpy(v->p, empty, n);
+    memset(v->p + n, ' ', v->len - n);
+}
@@ -0,0 +1,119 @@
+/*
+ * jsonio.h - Streaming JSON writer and in-place JSON reader
+ *
+ * The writer escapes as it goes into a small buffer that is handed to a
+ * sink (a socket, a heap buffer) whenever it fills, so a 128 KB command
+ * output never exists twice in memory. With no sink it only counts, which
+ * gives the Content-Length before anything is sent.
+ *
+ * The reader walks JSON text where it lies: values come back as spans of
+ * the original text, and strings are decoded on demand into a caller
+ * buffer, over their own bytes, or straight into a FILE*.
+ */
+
+#ifndef JSONIO_H
+#define JSONIO_H
+
+#include <stdio.h>
+#include "third_party/cJSON.h"
+
+#define JW_BUFFER_SIZE 4096
+#define JW_MAX_DEPTH 16
+
+/* Returns 0 on success; anything else stops the writer */
+typedef int (*JsonSink)(void *ctx, const char *data, size_t len);
+
+typedef struct {
+    JsonSink sink;
+    void *ctx;
+    char buf[JW_BUFFER_SIZE];
+    size_t used;
+    size_t total;
+    int depth;
+    int need_comma[JW_MAX_DEPTH];
+    int after_key;
+    int error;
+} JsonWriter;
+
+/* sink NULL: nothing is kept, only total is counted */
+void jw_init(JsonWriter *w, JsonSink sink, void *ctx);
+
+void jw_object_begin(JsonWriter *w);
+void jw_object_end(JsonWriter *w);
+void jw_array_begin(JsonWriter *w);
+void jw_array_end(JsonWriter *w);
+
+/* Member name; the next value call supplies its value */
+void jw_key(JsonWriter *w, const char *key);
+
+void jw_string(JsonWriter *w, const char *s);
+void jw_string_n(JsonWriter *w, const char *s, size_t len);
+void jw_long(JsonWriter *w, long value);
+void jw_bool(JsonWriter *w, int value);
+void jw_null(JsonWriter *w);
+
+/* Pass data through unescaped, e.g. an HTTP head ahead of the body */
+void jw_raw(JsonWriter *w, const char *data, size_t len);
+
+/* Serialize a cJSON tree, byte for byte as cJSON_PrintUnformatted would */
+void jw_value(JsonWriter *w, const cJSON *item);
+
+/* Flush what is buffered. Returns 0, or -1 if the sink failed */
+int jw_finish(JsonWriter *w);
+
+/* Length of item as unformatted JSON */
+size_t jw_measure(const cJSON *item);
+
+/* Sink appending to a fixed buffer, kept NUL-terminated */
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+} JsonBuffer;
+
+int jw_buffer_sink(void *ctx, const char *data, size_t len);
+
+/* A value as it appears in the text; strings include their quotes */
+typedef struct {
+    char *p;
+    size_t len;
+} JsonSpan;
+
+/* The top-level value of text. Returns 0, or -1 if there is none */
+int jr_root(char *text, size_t len, JsonSpan *root);
+
+/* Member key of object obj. Returns 0, or -1 if absent or malformed */
+int jr_get(const JsonSpan *obj, const char *key, JsonSpan *value);
+
+int jr_is_string(const JsonSpan *v);
+int jr_is_true(const JsonSpan *v);
+
+/* Compare a string value with s without decoding it */
+int jr_string_eq(const JsonSpan *v, const char *s);
+
+/*
+ * Decode a string value into dst (NUL-terminated). Returns its length, or
+ * -1 if v is not a string or does not fit.
+ */
+long jr_string(const JsonSpan *v, char *dst, size_t size);
+
+/*
+ * Decode a string value over its own bytes (decoding never grows it) and
+ * return it NUL-terminated, or NULL if v is not a string. The span is no
+ * longer valid JSON afterwards.
+ */
+char *jr_string_inplace(JsonSpan *v);
+
+/* Decode a string value into fp. Returns bytes written, or -1 */
+long jr_string_to_file(const JsonSpan *v, FILE *fp);
+
+/* Numeric value, or fallback if v is not a number */
+long jr_long(const JsonSpan *v, long fallback);
+
+/*
+ * Overwrite v with an empty value of the same kind padded with spaces, so
+ * the text stays valid JSON but a later parse skips what it held.
+ */
+void jr_blank(JsonSpan *v);
+
+#endif /* JSONIO_H */
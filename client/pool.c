@@ -0,0 +1,223 @@
+/*
+ * pool.c - Shared buffer pool under a memory budget
+ */
+
+#include "pool.h"
+#include "util.h"
+
+/* Header in front of every buffer; a multiple of 8 bytes on Win32 */
+typedef struct PoolBlock {
+    struct PoolBlock *next;
+    size_t size;
+    DWORD owner;
+    int cls;
+} PoolBlock;
+
+static CRITICAL_SECTION s_lock;
+static int s_ready = 0;
+static DWORD s_main_thread;
+
+static PoolBlock *s_free[POOL_CLASSES];
+static int s_free_count[POOL_CLASSES];
+
+static size_t s_budget;
+static size_t s_in_use;
+static size_t s_cached;
+static size_t s_peak;
+static size_t s_main_bytes;
+static long s_denied;
+
+/* Size class for size, or -1 if it is bigger than the largest one */
+static int size_class(size_t size, size_t *class_size)
+{
+    size_t cs = POOL_MIN_SIZE;
+    int cls;
+
+    for (cls = 0; cls < POOL_CLASSES; cls++) {
+        if (size <= cs) {
+            *class_size = cs;
+            return cls;
+        }
+        cs *= 2;
+    }
+    *class_size = size;
+    return -1;
+}
+
+static size_t footprint(const PoolBlock *blk)
+{
+    return sizeof(PoolBlock) + blk->size;
+}
+
+static void charge(const PoolBlock *blk, int add)
+{
+    size_t bytes = footprint(blk);
+
+    if (add) {
+        s_in_use += bytes;
+        if (blk->owner == s_main_thread) {
+            s_main_bytes += bytes;
+        }
+        if (s_in_use + s_cached > s_peak) {
+            s_peak = s_in_use + s_cached;
+        }
+    } else {
+        s_in_use -= bytes;
+        if (blk->owner == s_main_thread) {
+            s_main_bytes -= bytes;
+        }
+    }
+}
+
+/* Free cached blocks, largest first, until need more bytes fit */
+static void trim_cache(size_t need)
+{
+    int cls;
+
+    for (cls = POOL_CLASSES - 1; cls >= 0; cls--) {
+        while (s_free[cls] && s_in_use + s_cached + need > s_budget) {
+            PoolBlock *blk = s_free[cls];
+
+            s_free[cls] = blk->next;
+            s_free_count[cls]--;
+            s_cached -= footprint(blk);
+            free(blk);
+        }
+    }
+}
+
+void pool_init(int budget_kb)
+{
+    InitializeCriticalSection(&s_lock);
+    s_main_thread = GetCurrentThreadId();
+    s_budget = (size_t)budget_kb * 1024;
+    s_ready = 1;
+}
+
+void pool_cleanup(void)
+{
+    if (!s_ready) {
+        return;
+    }
+
+    trim_cache((size_t)-1 / 2);
+    s_ready = 0;
+    DeleteCriticalSection(&s_lock);
+}
+
+char *pool_get(size_t size)
+{
+    PoolBlock *blk;
+    size_t class_size;
+    int cls = size_class(size, &class_size);
+
+    if (!s_ready) {
+        return NULL;
+    }
+
+    EnterCriticalSection(&s_lock);
+
+    if (cls >= 0 && s_free[cls]) {
+        blk = s_free[cls];
+        s_free[cls] = blk->next;
+        s_free_count[cls]--;
+        s_cached -= footprint(blk);
+    } else {
+        trim_cache(sizeof(PoolBlock) + class_size);
+        blk = NULL;
+        if (s_in_use + s_cached + sizeof(PoolBlock) + class_size <=
+            s_budget) {
+            blk = (PoolBlock *)malloc(sizeof(PoolBlock) + class_size);
+        }
+        if (!blk) {
+            s_denied++;
+            LeaveCriticalSection(&s_lock);
+            return NULL;
+        }
+        blk->size = class_size;
+        blk->cls = cls;
+    }
+
+    blk->next = NULL;
+    blk->owner = GetCurrentThreadId();
+    charge(blk, 1);
+
+    LeaveCriticalSection(&s_lock);
+    return (char *)(blk + 1);
+}
+
+char *pool_get_upto(size_t *size)
+{
+    char *buf = pool_get(*size);
+
+    while (!buf && *size > POOL_MIN_SIZE) {
+        *size /= 2;
+        if (*size < POOL_MIN_SIZE) {
+            *size = POOL_MIN_SIZE;
+        }
+        buf = pool_get(*size);
+    }
+    return buf;
+}
+
+void pool_put(char *buf)
+{
+    PoolBlock *blk;
+
+    if (!buf) {
+        return;
+    }
+    blk = (PoolBlock *)buf - 1;
+
+    if (blk->owner != GetCurrentThreadId()) {
+        log_error("pool", "buffer returned by a thread that does not own it");
+    }
+
+    EnterCriticalSection(&s_lock);
+    charge(blk, 0);
+
+    if (blk->cls >= 0 && s_free_count[blk->cls] < POOL_KEEP &&
+        s_in_use + s_cached + footprint(blk) <= s_budget) {
+        blk->next = s_free[blk->cls];
+        s_free[blk->cls] = blk;
+        s_free_count[blk->cls]++;
+        s_cached += footprint(blk);
+    } else {
+        free(blk);
+    }
+    LeaveCriticalSection(&s_lock);
+}
+
+void pool_adopt(char *buf)
+{
+    PoolBlock *blk;
+
+    if (!buf) {
+        return;
+    }
+    blk = (PoolBlock *)buf - 1;
+
+    EnterCriticalSection(&s_lock);
+    charge(blk, 0);
+    blk->owner = GetCurrentThreadId();
+    charge(blk, 1);
+    LeaveCriticalSection(&s_lock);
+}
+
+void pool_get_stats(PoolStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (!s_ready) {
+        return;
+    }
+
+    EnterCriticalSection(&s_lock);
+    stats->budget = (long)s_budget;
+    stats->in_use = (long)s_in_use;
+    stats->cached = (long)s_cached;
+    stats->peak = (long)s_peak;
+    stats->denied = s_denied;
+    stats->main_thread = (long)s_main_bytes;
+    stats->other_threads = (long)(s_in_use - s_main_bytes);
+    LeaveCriticalSection(&s_lock);
+}
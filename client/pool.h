@@ -0,0 +1,54 @@
+/*
+ * pool.h - Shared buffer pool under a memory budget
+ *
+ * Working buffers (command output, request bodies, pending output, the
+ * cJSON arenas) are borrowed from here instead of sitting in statics, so
+ * only what is in use plus a few cached blocks stays allocated, and never
+ * more than the memory_budget_kb setting. Sizes round up to a power of
+ * two; returned blocks are kept for reuse while they fit the budget.
+ *
+ * A buffer belongs to the thread that took it. Handing one to another
+ * thread goes through pool_adopt so the footprint is charged correctly.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include "claude.h"
+
+#define POOL_MIN_SIZE 1024
+#define POOL_CLASSES 8
+#define POOL_KEEP 2
+
+/* Budget in KB; call once after config_load, before other threads start */
+void pool_init(int budget_kb);
+void pool_cleanup(void);
+
+/* A buffer of at least size bytes, or NULL if the budget is spent */
+char *pool_get(size_t size);
+
+/*
+ * Like pool_get, but halves *size until the budget allows it, down to
+ * POOL_MIN_SIZE. *size is set to what was granted.
+ */
+char *pool_get_upto(size_t *size);
+
+/* Give buf back (NULL is ignored) */
+void pool_put(char *buf);
+
+/* Take over buf from the thread that handed it here */
+void pool_adopt(char *buf);
+
+typedef struct {
+    long budget;
+    long in_use;
+    long cached;
+    long peak;
+    long denied;
+    long main_thread;
+    long other_threads;
+} PoolStats;
+
+void pool_get_stats(PoolStats *stats);
+
+#endif /* POOL_H */
@@ -0,0 +1,107 @@
+/*
+ * ring.c - Output ring between the poll thread and the main thread
+ *
+ * Each segment is a LONG length (text plus NUL) followed by the text,
+ * padded to RING_ALIGN. A segment never wraps: when the tail is too short
+ * the writer leaves a RING_WRAP marker and starts again at 0. The writer
+ * keeps at least RING_ALIGN bytes clear in front of read_pos so a full
+ * ring never looks empty. Win32 only runs on x86 here, where loads are
+ * not reordered with other loads, so the reader needs no fence of its own.
+ */
+
+#include "ring.h"
+#include <string.h>
+
+#define RING_ALIGN 4
+#define RING_HDR ((LONG)sizeof(LONG))
+#define RING_WRAP (-1)
+
+#define ROUND_UP(n) (((n) + RING_ALIGN - 1) & ~(LONG)(RING_ALIGN - 1))
+
+void ring_init(OutputRing *ring, char *buf, size_t size)
+{
+    ring->base = buf;
+    ring->size = (LONG)size & ~(LONG)(RING_ALIGN - 1);
+    ring->read_pos = 0;
+    ring->write_pos = 0;
+    ring->stalls = 0;
+}
+
+size_t ring_write(OutputRing *ring, const char *text, size_t len)
+{
+    LONG r = ring->read_pos;
+    LONG w = ring->write_pos;
+    LONG room;
+    LONG n;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    if (w >= r) {
+        LONG tail = ring->size - w - RING_HDR;
+        LONG head = r - RING_HDR - RING_ALIGN;
+
+        if (r == 0) {
+            tail -= RING_ALIGN;
+        }
+
+        /* Start over at 0 if the text fits better there */
+        if (tail < (LONG)len + 1 && head > tail) {
+            *(LONG *)(ring->base + w) = RING_WRAP;
+            w = 0;
+            room = head;
+        } else {
+            room = tail;
+        }
+    } else {
+        room = r - w - RING_HDR - RING_ALIGN;
+    }
+
+    if (room < 2) {
+        ring->stalls++;
+        return 0;
+    }
+
+    n = (LONG)len < room - 1 ? (LONG)len : room - 1;
+    *(LONG *)(ring->base + w) = n + 1;
+    memcpy(ring->base + w + RING_HDR, text, (size_t)n);
+    ring->base[w + RING_HDR + n] = '\0';
+
+    w += RING_HDR + ROUND_UP(n + 1);
+    if (w == ring->size) {
+        w = 0;
+    }
+    InterlockedExchange((LONG *)&ring->write_pos, w);
+    return (size_t)n;
+}
+
+const char *ring_peek(OutputRing *ring)
+{
+    LONG r = ring->read_pos;
+    LONG w = ring->write_pos;
+
+    if (r == w) {
+        return NULL;
+    }
+
+    if (*(LONG *)(ring->base + r) == RING_WRAP) {
+        r = 0;
+        InterlockedExchange((LONG *)&ring->read_pos, 0);
+        if (w == 0) {
+            return NULL;
+        }
+    }
+    return ring->base + r + RING_HDR;
+}
+
+void ring_release(OutputRing *ring)
+{
+    LONG r = ring->read_pos;
+
+    r += RING_HDR + ROUND_UP(*(LONG *)(ring->base + r));
+    if (r == ring->size) {
+        r = 0;
+    }
+    InterlockedExchange((LONG *)&ring->read_pos, r);
+}
@@ -0,0 +1,44 @@
+/*
+ * ring.h - Output ring between the poll thread and the main thread
+ *
+ * The poll thread writes each /output chunk as a segment; the main thread
+ * prints segments in order and hands the space back. One writer and one
+ * reader, each owning one index, so no lock is needed: a side publishes
+ * its index with InterlockedExchange once the bytes behind it are in
+ * place. When the ring is full, ring_write takes nothing and the writer
+ * waits instead of dropping text.
+ *
+ * Deliberately free of claude.h, which embeds a ring in g_state.
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stddef.h>
+#include <windows.h>
+
+typedef struct {
+    char *base;
+    LONG size;
+    volatile LONG read_pos;  /* written by the reader only */
+    volatile LONG write_pos; /* written by the writer only */
+    long stalls;             /* writer found no room; writer only */
+} OutputRing;
+
+/* Use size bytes at buf (8-byte aligned) as an empty ring */
+void ring_init(OutputRing *ring, char *buf, size_t size);
+
+/*
+ * Writer: store up to len bytes of text as one NUL-terminated segment and
+ * return how many were taken. Text longer than the free space is split
+ * over several calls; 0 means the ring is full.
+ */
+size_t ring_write(OutputRing *ring, const char *text, size_t len);
+
+/* Reader: the oldest segment, or NULL if there is none */
+const char *ring_peek(OutputRing *ring);
+
+/* Reader: done with the segment from ring_peek */
+void ring_release(OutputRing *ring);
+
+#endif /* RING_H */
@@ -0,0 +1,241 @@
+/*
+ * sched.c - Poll scheduling and server health
+ */
+
+#include "sched.h"
+
+typedef enum { LINK_UP = 0, LINK_DOWN, LINK_PROBING } LinkState;
+
+static CRITICAL_SECTION s_lock;
+static HANDLE s_kick = NULL;
+static int s_initialized = 0;
+
+static DWORD s_last_activity = 0;
+static DWORD s_last_poll = 0;
+static DWORD s_next_poll = 0;
+static DWORD s_idle_gap = 0;
+
+static LinkState s_link = LINK_UP;
+static int s_failures = 0;
+static DWORD s_retry_interval = SCHED_RETRY_MIN_MS;
+static DWORD s_retry_at = 0;
+
+static long s_polls = 0;
+static long s_failed_fast = 0;
+
+/* Tick counts wrap every 49.7 days; compare through a signed difference */
+static LONG ticks_until(DWORD when, DWORD now)
+{
+    return (LONG)(when - now);
+}
+
+void sched_init(void)
+{
+    if (s_initialized) {
+        return;
+    }
+
+    InitializeCriticalSection(&s_lock);
+    s_kick = CreateEvent(NULL, FALSE, FALSE, NULL);
+    s_last_activity = GetTickCount();
+    s_last_poll = s_last_activity;
+    s_next_poll = s_last_activity;
+    s_initialized = 1;
+}
+
+void sched_cleanup(void)
+{
+    if (!s_initialized) {
+        return;
+    }
+
+    if (s_kick) {
+        CloseHandle(s_kick);
+        s_kick = NULL;
+    }
+    DeleteCriticalSection(&s_lock);
+    s_initialized = 0;
+}
+
+void sched_kick(void)
+{
+    if (!s_initialized) {
+        return;
+    }
+
+    EnterCriticalSection(&s_lock);
+    s_last_activity = GetTickCount();
+    s_next_poll = s_last_activity;
+    s_idle_gap = 0;
+    /* The user is waiting on this one; let it probe a server marked down */
+    if (s_link == LINK_DOWN) {
+        s_retry_at = s_last_activity;
+    }
+    LeaveCriticalSection(&s_lock);
+
+    if (s_kick) {
+        SetEvent(s_kick);
+    }
+}
+
+DWORD sched_poll_delay(DWORD min_interval)
+{
+    DWORD now = GetTickCount();
+    LONG delay;
+    LONG wait;
+
+    if (!s_initialized) {
+        return 0;
+    }
+
+    EnterCriticalSection(&s_lock);
+    delay = ticks_until(s_next_poll, now);
+    wait = ticks_until(s_last_poll + min_interval, now);
+    if (wait > delay) {
+        delay = wait;
+    }
+    if (s_link != LINK_UP) {
+        wait = ticks_until(s_retry_at, now);
+        if (wait > delay) {
+            delay = wait;
+        }
+    }
+    LeaveCriticalSection(&s_lock);
+
+    return delay > 0 ? (DWORD)delay : 0;
+}
+
+int sched_poll_wait_ms(void)
+{
+    int idle;
+
+    if (!s_initialized) {
+        return LONG_POLL_WAIT_MS;
+    }
+
+    EnterCriticalSection(&s_lock);
+    idle = s_idle_gap > 0;
+    LeaveCriticalSection(&s_lock);
+
+    return idle ? LONG_POLL_IDLE_WAIT_MS : LONG_POLL_WAIT_MS;
+}
+
+void sched_poll_done(int result)
+{
+    DWORD now = GetTickCount();
+
+    if (!s_initialized) {
+        return;
+    }
+
+    EnterCriticalSection(&s_lock);
+    s_polls++;
+    s_last_poll = now;
+
+    if (result > 0) {
+        s_last_activity = now;
+        s_idle_gap = 0;
+        s_next_poll = now;
+    } else if (result < 0) {
+        s_next_poll = now + SCHED_RETRY_MIN_MS;
+    } else if (now - s_last_activity < SCHED_ACTIVE_MS) {
+        s_next_poll = now;
+    } else {
+        /* Quiet session: double the gap between polls up to the cap */
+        s_idle_gap = s_idle_gap ? s_idle_gap * 2 : SCHED_IDLE_MIN_MS;
+        if (s_idle_gap > SCHED_IDLE_MAX_MS) {
+            s_idle_gap = SCHED_IDLE_MAX_MS;
+        }
+        s_next_poll = now + s_idle_gap;
+    }
+    LeaveCriticalSection(&s_lock);
+}
+
+void sched_wait(DWORD ms)
+{
+    if (s_kick) {
+        WaitForSingleObject(s_kick, ms);
+    } else {
+        Sleep(ms);
+    }
+}
+
+int sched_begin_request(void)
+{
+    int allowed = 1;
+
+    if (!s_initialized) {
+        return 0;
+    }
+
+    EnterCriticalSection(&s_lock);
+    if (s_link == LINK_PROBING) {
+        allowed = 0;
+    } else if (s_link == LINK_DOWN) {
+        if (ticks_until(s_retry_at, GetTickCount()) <= 0) {
+            s_link = LINK_PROBING;
+        } else {
+            allowed = 0;
+        }
+    }
+    if (!allowed) {
+        s_failed_fast++;
+    }
+    LeaveCriticalSection(&s_lock);
+
+    return allowed ? 0 : -1;
+}
+
+void sched_end_request(int reachable)
+{
+    if (!s_initialized) {
+        return;
+    }
+
+    EnterCriticalSection(&s_lock);
+    if (reachable) {
+        s_link = LINK_UP;
+        s_failures = 0;
+        s_retry_interval = SCHED_RETRY_MIN_MS;
+    } else if (s_link == LINK_PROBING) {
+        /* Probe failed: wait twice as long before the next one */
+        s_retry_interval *= 2;
+        if (s_retry_interval > SCHED_RETRY_MAX_MS) {
+            s_retry_interval = SCHED_RETRY_MAX_MS;
+        }
+        s_link = LINK_DOWN;
+        s_retry_at = GetTickCount() + s_retry_interval;
+    } else if (s_link == LINK_UP && ++s_failures >= SCHED_FAIL_THRESHOLD) {
+        s_link = LINK_DOWN;
+        s_retry_at = GetTickCount() + s_retry_interval;
+    }
+    LeaveCriticalSection(&s_lock);
+}
+
+DWORD sched_server_down(void)
+{
+    LONG wait = 0;
+    int down;
+
+    if (!s_initialized) {
+        return 0;
+    }
+
+    EnterCriticalSection(&s_lock);
+    down = s_link != LINK_UP;
+    if (down) {
+        wait = ticks_until(s_retry_at, GetTickCount());
+    }
+    LeaveCriticalSection(&s_lock);
+
+    if (!down) {
+        return 0;
+    }
+    return wait > 0 ? (DWORD)wait : 1;
+}
+
+void sched_get_stats(long *polls, long *failed_fast)
+{
+    *polls = s_polls;
+    *failed_fast = s_failed_fast;
+}
@@ -0,0 +1,50 @@
+/*
+ * sched.h - Poll scheduling and server health
+ *
+ * Polls run back to back while Claude is busy or the user just typed, and
+ * spread out exponentially once the session has been quiet for a while.
+ * Separately, requests that can't reach the server trip a breaker: while
+ * it is open every request fails at once, except one probe per retry
+ * interval.
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "claude.h"
+
+void sched_init(void);
+void sched_cleanup(void);
+
+/* User submitted input, or a session started: poll at once and often */
+void sched_kick(void);
+
+/*
+ * Milliseconds until the next poll is due, never sooner than min_interval
+ * after the previous one. 0 means poll now.
+ */
+DWORD sched_poll_delay(DWORD min_interval);
+
+/* How long the next poll may ask the server to hold it open */
+int sched_poll_wait_ms(void);
+
+/* Result of a poll: > 0 it carried output or work, 0 empty, < 0 failed */
+void sched_poll_done(int result);
+
+/* Sleep up to ms; returns early on sched_kick */
+void sched_wait(DWORD ms);
+
+/*
+ * Called around every HTTP request. sched_begin_request returns -1 while
+ * the breaker is open, so the caller can fail without touching the
+ * network; sched_end_request records whether the server answered.
+ */
+int sched_begin_request(void);
+void sched_end_request(int reachable);
+
+/* 0 if the server is reachable, else ms until the next probe */
+DWORD sched_server_down(void);
+
+void sched_get_stats(long *polls, long *failed_fast);
+
+#endif /* SCHED_H */
@@ -4,13 +4,18 @@
 
 #include <conio.h>
 #include "session.h"
+#include "arena.h"
+#include "frame.h"
 #include "http.h"
 #include "handlers.h"
+#include "jsonio.h"
+#include "pool.h"
+#include "sched.h"
 #include "util.h"
 
 void session_heartbeat(void)
 {
-    static char response[BUFFER_SIZE];
+    char response[SMALL_RESPONSE_SIZE];
     char body[256];
     DWORD now;
 
@@ -33,10 +38,68 @@ void session_heartbeat(void)
     }
 }
 
+void session_renew_lease(void)
+{
+    char response[SMALL_RESPONSE_SIZE];
+    char cmd_id[64];
+    char body[128];
+    DWORD now = GetTickCount();
+
+    EnterCriticalSection(&g_state.output_lock);
+    if (!g_state.lease_cmd_id[0] || g_state.lease_ms == 0 ||
+        now - g_state.lease_renewed < g_state.lease_ms / 3) {
+        LeaveCriticalSection(&g_state.output_lock);
+        return;
+    }
+    strcpy(cmd_id, g_state.lease_cmd_id);
+    g_state.lease_renewed = now;
+    LeaveCriticalSection(&g_state.output_lock);
+
+    /* A missed renewal only means the result is replayed from the cache */
+    if (frame_active()) {
+        frame_send_lease(cmd_id);
+        return;
+    }
+
+    snprintf(body, sizeof(body), "{\"cmd_id\":\"%s\"}", cmd_id);
+    http_request("POST", "/cmd/lease", body, response, sizeof(response));
+}
+
+/*
+ * The server keeps output in a log and hands it out from this cursor. It
+ * only moves once a reply has been parsed, so a lost or oversized reply
+ * is asked for again instead of taking its text with it.
+ */
+long session_output_cursor(void)
+{
+    long since;
+
+    if (g_state.poll_thread != NULL) {
+        EnterCriticalSection(&g_state.output_lock);
+    }
+    since = g_state.output_next;
+    if (g_state.poll_thread != NULL) {
+        LeaveCriticalSection(&g_state.output_lock);
+    }
+    return since;
+}
+
+long session_output_advance(long since, long offset, long next)
+{
+    if (g_state.poll_thread != NULL) {
+        EnterCriticalSection(&g_state.output_lock);
+    }
+    if (next > g_state.output_next) {
+        g_state.output_next = next;
+    }
+    if (g_state.poll_thread != NULL) {
+        LeaveCriticalSection(&g_state.output_lock);
+    }
+    return offset > since ? offset - since : 0;
+}
+
 static void session_poll_output(void)
 {
-    static char response[BUFFER_SIZE];
-    char path[256];
     cJSON *json;
     const cJSON *output_item;
     const cJSON *status_item;
@@ -44,6 +107,10 @@ static void session_poll_output(void)
     int ever_got_output = 0;
     int spinner = 0;
     int got_output = 0;
+    int did_work = 0;
+    int turn_seq = 0;
+    int expected_seq = g_state.turns_sent;
+    TurnState turn = TURN_UNKNOWN;
     const char *spinchars = "|/-\\";
 
     if (!g_state.session_id[0]) {
@@ -51,6 +118,8 @@ static void session_poll_output(void)
     }
 
     while (g_state.session_id[0]) {
+        DWORD retry_ms;
+
         if (kbhit()) {
             getch();
             printf("\r                              \r");
@@ -58,41 +127,56 @@ static void session_poll_output(void)
             break;
         }
 
+        retry_ms = sched_server_down();
+        if (retry_ms > 0) {
+            printf("\r                              \r");
+            printf("[Server unreachable, retrying in %lus]\n",
+                   (unsigned long)(retry_ms + 999) / 1000);
+            break;
+        }
+
         got_output = 0;
+        did_work = 0;
 
         if (g_state.poll_thread != NULL) {
+            const char *text;
             int session_ended = 0;
 
             session_heartbeat();
+            session_renew_lease();
 
             if (process_approval()) {
                 continue;
             }
 
             EnterCriticalSection(&g_state.output_lock);
-            if (g_state.has_pending_output) {
+            turn = g_state.turn_state;
+            turn_seq = g_state.turn_seq;
+
+            if (g_state.session_stopped) {
+                g_state.session_stopped = 0;
+                g_state.session_id[0] = '\0';
+                g_state.connected = 0;
+                session_ended = 1;
+            }
+            LeaveCriticalSection(&g_state.output_lock);
+
+            /* Read after the state: output queued before "done" is here */
+            while ((text = ring_peek(&g_state.output_ring)) != NULL) {
                 if (!ever_got_output) {
                     printf("\r                              \r");
                 }
-                print_output(g_state.pending_output);
-                g_state.has_pending_output = 0;
+                print_output(text);
                 got_output = 1;
 
-                if (strncmp(g_state.pending_output, "[Session", 8) != 0 &&
-                    strncmp(g_state.pending_output, "[Using tool", 11) != 0) {
+                if (strncmp(text, "[Session", 8) != 0 &&
+                    strncmp(text, "[Using tool", 11) != 0) {
                     ever_got_output = 1;
                 }
+                ring_release(&g_state.output_ring);
                 idle_count = 0;
             }
 
-            if (g_state.session_stopped) {
-                g_state.session_stopped = 0;
-                g_state.session_id[0] = '\0';
-                g_state.connected = 0;
-                session_ended = 1;
-            }
-            LeaveCriticalSection(&g_state.output_lock);
-
             if (session_ended) {
                 printf("\n[Session ended]\n");
                 break;
@@ -101,55 +185,44 @@ static void session_poll_output(void)
         } else {
             session_heartbeat();
 
-            while (handle_fileop()) {
-            }
-
-            while (handle_command()) {
-            }
-
-            handle_approval();
-
-            snprintf(path, sizeof(path), "/output?session_id=%s",
-                     g_state.session_id);
-
-            if (http_request("GET", path, NULL, response, sizeof(response)) ==
-                HTTP_OK) {
-                json = cJSON_Parse(response);
-                if (json) {
-                    output_item = cJSON_GetObjectItem(json, "output");
-                    status_item = cJSON_GetObjectItem(json, "status");
-
-                    if (cJSON_IsString(output_item) &&
-                        output_item->valuestring[0]) {
-                        if (!ever_got_output) {
-                            printf("\r                              \r");
-                        }
-
-                        print_output(output_item->valuestring);
-                        got_output = 1;
-
-                        if (strncmp(output_item->valuestring, "[Session", 8) !=
-                                0 &&
-                            strncmp(output_item->valuestring, "[Using tool",
-                                    11) != 0) {
-                            ever_got_output = 1;
-                        }
-                        idle_count = 0;
+            /* Long poll for one cycle instead of sleeping through it */
+            json = handle_sync(g_state.session_id, 1, POLL_SLEEP_MS,
+                               &did_work);
+            if (json) {
+                output_item = cJSON_GetObjectItem(json, "output");
+                status_item = cJSON_GetObjectItem(json, "status");
+                turn = sync_turn_state(json, &turn_seq);
+
+                if (cJSON_IsString(output_item) &&
+                    output_item->valuestring[0]) {
+                    if (!ever_got_output) {
+                        printf("\r                              \r");
                     }
 
-                    if (cJSON_IsString(status_item) &&
-                        strcmp(status_item->valuestring, "stopped") == 0) {
-                        printf("\n[Session ended]\n");
-                        g_state.session_id[0] = '\0';
-                        g_state.connected = 0;
-                        cJSON_Delete(json);
-                        break;
+                    print_output(output_item->valuestring);
+                    got_output = 1;
+
+                    if (strncmp(output_item->valuestring, "[Session", 8) !=
+                            0 &&
+                        strncmp(output_item->valuestring, "[Using tool", 11) !=
+                            0) {
+                        ever_got_output = 1;
                     }
+                    idle_count = 0;
+                }
 
+                if (cJSON_IsString(status_item) &&
+                    strcmp(status_item->valuestring, "stopped") == 0) {
+                    printf("\n[Session ended]\n");
+                    g_state.session_id[0] = '\0';
+                    g_state.connected = 0;
                     cJSON_Delete(json);
+                    arena_reset();
+                    break;
                 }
-            } else {
-                Sleep(POLL_BACKOFF_MS);
+
+                cJSON_Delete(json);
+                arena_reset();
             }
         }
 
@@ -159,10 +232,28 @@ static void session_poll_output(void)
             spinner++;
         }
 
-        if (!got_output) {
+        /* Servers that report turns say when Claude is finished */
+        if (turn != TURN_UNKNOWN && turn_seq >= expected_seq) {
+            if (turn == TURN_DONE) {
+                if (!ever_got_output) {
+                    printf("\r                              \r");
+                }
+                break;
+            }
+            /* Still working: a long tool run or approval isn't a timeout */
+            idle_count = 0;
+        }
+
+        if (did_work) {
+            idle_count = 0;
+            continue;
+        }
+
+        if (!got_output && (turn == TURN_UNKNOWN || turn_seq < expected_seq)) {
             idle_count++;
 
-            if (ever_got_output && idle_count >= 2) {
+            /* Older server: guess the turn is over after two quiet polls */
+            if (turn == TURN_UNKNOWN && ever_got_output && idle_count >= 2) {
                 break;
             }
 
@@ -173,19 +264,151 @@ static void session_poll_output(void)
             }
         }
 
-        Sleep(POLL_SLEEP_MS);
+        if (g_state.poll_thread != NULL) {
+            WaitForSingleObject(g_state.output_event, POLL_SLEEP_MS);
+        }
     }
 }
 
-void session_connect(const char *working_dir)
+/*
+ * POST /start; placed tells the server another instance sent us here, and
+ * ticket (or "") holds our place in its line
+ */
+static HttpResult start_request(const char *working_dir,
+                                const char *win_version, int placed,
+                                const char *ticket, char *response,
+                                size_t size)
 {
-    static char response[BUFFER_SIZE];
-    cJSON *request;
-    cJSON *json;
-    const cJSON *session_id_item;
-    const cJSON *error_item;
     char *body;
+    JsonBuffer jb;
+    JsonWriter w;
+    HttpResult ret;
+
+    /* Room for every byte escaped as \u00XX */
+    jb.size = strlen(win_version) * 6 + 128;
+    if (working_dir) {
+        jb.size += strlen(working_dir) * 6;
+    }
+    body = pool_get(jb.size);
+    if (!body) {
+        log_error("session", "Out of memory");
+        return HTTP_ERR_OVERFLOW;
+    }
+    jb.buf = body;
+    jb.len = 0;
+    jw_init(&w, jw_buffer_sink, &jb);
+    jw_object_begin(&w);
+    if (working_dir && working_dir[0]) {
+        jw_key(&w, "working_directory");
+        jw_string(&w, working_dir);
+    }
+    jw_key(&w, "windows_version");
+    jw_string(&w, win_version);
+    if (g_state.frame_protocol) {
+        jw_key(&w, "frame_protocol");
+        jw_bool(&w, 1);
+    }
+    if (placed) {
+        jw_key(&w, "placed");
+        jw_bool(&w, 1);
+    }
+    if (ticket[0]) {
+        jw_key(&w, "ticket");
+        jw_string(&w, ticket);
+    }
+    jw_object_end(&w);
+
+    if (jw_finish(&w) < 0) {
+        pool_put(body);
+        return HTTP_ERR_OVERFLOW;
+    }
+
+    ret = http_request("POST", "/start", body, response, size);
+    pool_put(body);
+    return ret;
+}
+
+/* Follow a "moved" reply to the server instance the session was placed on */
+static int session_moved(char *response)
+{
+    JsonSpan root;
+    JsonSpan status;
+    JsonSpan host;
+    JsonSpan port;
+    char ip[sizeof(g_state.server_ip)];
+
+    if (jr_root(response, strlen(response), &root) < 0 ||
+        jr_get(&root, "status", &status) < 0 ||
+        !jr_string_eq(&status, "moved") ||
+        jr_get(&root, "api_port", &port) < 0) {
+        return 0;
+    }
+
+    if (jr_get(&root, "host", &host) == 0 &&
+        jr_string(&host, ip, sizeof(ip)) > 0) {
+        strcpy(g_state.server_ip, ip);
+    }
+    g_state.server_port = (int)jr_long(&port, g_state.server_port);
+    if (jr_get(&root, "download_port", &port) == 0) {
+        g_state.download_port = (int)jr_long(&port, g_state.download_port);
+    }
+    if (jr_get(&root, "upload_port", &port) == 0) {
+        g_state.upload_port = (int)jr_long(&port, g_state.upload_port);
+    }
+
+    /* Kept-alive connections still lead to the old instance */
+    http_reset_connections();
+    printf("[Session placed on %s:%d]\n", g_state.server_ip,
+           g_state.server_port);
+    return 1;
+}
+
+/*
+ * A "queued" reply: every session slot is taken. Keeps the ticket and
+ * returns how long to wait before asking again, or 0 if not queued.
+ */
+static DWORD session_queued(char *response, char *ticket, size_t size)
+{
+    JsonSpan root;
+    JsonSpan status;
+    JsonSpan item;
+    long position = 0;
+    long retry_ms = 2000;
+
+    if (jr_root(response, strlen(response), &root) < 0 ||
+        jr_get(&root, "status", &status) < 0 ||
+        !jr_string_eq(&status, "queued") ||
+        jr_get(&root, "ticket", &item) < 0 ||
+        jr_string(&item, ticket, size) <= 0) {
+        return 0;
+    }
+
+    if (jr_get(&root, "position", &item) == 0) {
+        position = jr_long(&item, 0);
+    }
+    if (jr_get(&root, "retry_ms", &item) == 0) {
+        retry_ms = jr_long(&item, retry_ms);
+    }
+
+    printf("\r[Server busy: %ld ahead of you, any key cancels]   ",
+           position > 0 ? position - 1 : 0);
+    return retry_ms > 0 ? (DWORD)retry_ms : 2000;
+}
+
+void session_connect(const char *working_dir)
+{
+    char response[SMALL_RESPONSE_SIZE];
+    JsonSpan root;
+    JsonSpan session_id_item;
+    JsonSpan error_item;
+    JsonSpan frame_port;
+    int has_frame_port;
+    char *session_id;
     char win_version[128];
+    char ticket[64];
+    int placed = 0;
+    DWORD retry_ms;
+    HttpResult ret;
 
     if (g_state.session_id[0]) {
         printf("[Already connected. Use /disconnect first]\n");
@@ -197,67 +420,88 @@ void session_connect(const char *working_dir)
     printf("[Connecting to %s:%d...]\n", g_state.server_ip,
            g_state.server_port);
 
-    request = cJSON_CreateObject();
-    if (!request) {
-        log_error("session", "Out of memory");
-        return;
-    }
-
-    if (working_dir && working_dir[0]) {
-        cJSON_AddStringToObject(request, "working_directory", working_dir);
+    ticket[0] = '\0';
+    ret = start_request(working_dir, win_version, placed, ticket, response,
+                        sizeof(response));
+    if (ret == HTTP_OK && session_moved(response)) {
+        placed = 1;
+        ret = start_request(working_dir, win_version, placed, ticket,
+                            response, sizeof(response));
     }
-    cJSON_AddStringToObject(request, "windows_version", win_version);
 
-    body = cJSON_PrintUnformatted(request);
-    cJSON_Delete(request);
+    /* Wait our turn; the ticket lapses on the server once we stop asking */
+    while (ret == HTTP_OK &&
+           (retry_ms = session_queued(response, ticket, sizeof(ticket))) > 0) {
+        DWORD waited;
 
-    if (!body) {
-        log_error("session", "Out of memory");
-        return;
+        for (waited = 0; waited < retry_ms && !kbhit(); waited += 100) {
+            Sleep(100);
+        }
+        if (kbhit()) {
+            getch();
+            printf("\n[Connect cancelled]\n");
+            return;
+        }
+        ret = start_request(working_dir, win_version, placed, ticket,
+                            response, sizeof(response));
+    }
+    if (ticket[0]) {
+        printf("\n");
     }
-
-    HttpResult ret =
-        http_request("POST", "/start", body, response, sizeof(response));
-    free(body);
 
     if (ret != HTTP_OK) {
         log_error("session", http_error_string(ret));
         return;
     }
 
-    json = cJSON_Parse(response);
-    if (!json) {
+    if (jr_root(response, strlen(response), &root) < 0) {
         log_error("session", "Invalid response from server");
         return;
     }
 
-    error_item = cJSON_GetObjectItem(json, "error");
-    if (cJSON_IsString(error_item)) {
-        log_error("session", error_item->valuestring);
-        cJSON_Delete(json);
+    /* Find every member before decoding any of them in place */
+    has_frame_port = jr_get(&root, "frame_port", &frame_port) == 0;
+    if (jr_get(&root, "error", &error_item) == 0 &&
+        jr_is_string(&error_item)) {
+        log_error("session", jr_string_inplace(&error_item));
         return;
     }
 
-    session_id_item = cJSON_GetObjectItem(json, "session_id");
-    if (!cJSON_IsString(session_id_item)) {
+    session_id = jr_get(&root, "session_id", &session_id_item) == 0
+                     ? jr_string_inplace(&session_id_item)
+                     : NULL;
+    if (!session_id || !session_id[0]) {
         log_error("session", "No session ID returned");
-        cJSON_Delete(json);
         return;
     }
 
     if (g_state.poll_thread != NULL) {
         EnterCriticalSection(&g_state.output_lock);
     }
-    strncpy(g_state.session_id, session_id_item->valuestring,
-            sizeof(g_state.session_id) - 1);
+    strncpy(g_state.session_id, session_id, sizeof(g_state.session_id) - 1);
     g_state.session_id[sizeof(g_state.session_id) - 1] = '\0';
     g_state.connected = 1;
     g_state.session_stopped = 0;
     g_state.last_heartbeat = GetTickCount();
+    g_state.turn_state = TURN_UNKNOWN;
+    g_state.turn_seq = 0;
+    g_state.turns_sent = 0;
+    g_state.output_next = 0;
     if (g_state.poll_thread != NULL) {
         LeaveCriticalSection(&g_state.output_lock);
     }
-    cJSON_Delete(json);
+
+    if (g_state.frame_protocol) {
+        int port = has_frame_port ? (int)jr_long(&frame_port, 0) : 0;
+
+        if (port > 0 && frame_open(port, g_state.session_id) == 0) {
+            printf("[Binary protocol on port %d]\n", port);
+        } else {
+            printf("[Binary protocol unavailable, using HTTP]\n");
+        }
+    }
+
+    sched_kick();
 
     printf("[Connected! Session: %s]\n", g_state.session_id);
     printf("[Ready - type a message to start chatting]\n\n");
@@ -265,25 +509,28 @@ void session_connect(const char *working_dir)
 
 void session_disconnect(void)
 {
-    static char response[BUFFER_SIZE];
-    cJSON *request;
+    char response[SMALL_RESPONSE_SIZE];
+    char body[512];
+    JsonBuffer jb;
+    JsonWriter w;
 
     if (!g_state.session_id[0]) {
         printf("[Not connected]\n");
         return;
     }
 
-    request = cJSON_CreateObject();
-    if (request) {
-        char *body;
-        cJSON_AddStringToObject(request, "session_id", g_state.session_id);
-        body = cJSON_PrintUnformatted(request);
-        cJSON_Delete(request);
-
-        if (body) {
-            http_request("POST", "/stop", body, response, sizeof(response));
-            free(body);
-        }
+    frame_close();
+
+    jb.buf = body;
+    jb.size = sizeof(body);
+    jb.len = 0;
+    jw_init(&w, jw_buffer_sink, &jb);
+    jw_object_begin(&w);
+    jw_key(&w, "session_id");
+    jw_string(&w, g_state.session_id);
+    jw_object_end(&w);
+    if (jw_finish(&w) == 0) {
+        http_request("POST", "/stop", body, response, sizeof(response));
     }
 
     if (g_state.poll_thread != NULL) {
@@ -299,11 +546,13 @@ void session_disconnect(void)
 
 void session_send_input(const char *text)
 {
-    static char response[BUFFER_SIZE];
-    char text_with_newline[MAX_INPUT + 2];
-    cJSON *request;
-    cJSON *json;
+    char response[SMALL_RESPONSE_SIZE];
     char *body;
+    char text_with_newline[MAX_INPUT + 2];
+    JsonBuffer jb;
+    JsonWriter w;
+    JsonSpan root;
+    JsonSpan error_item;
 
     if (!g_state.session_id[0]) {
         printf("[Not connected. Use /connect first]\n");
@@ -314,27 +563,39 @@ void session_send_input(const char *text)
 
     snprintf(text_with_newline, sizeof(text_with_newline), "%s\n", text);
 
-    request = cJSON_CreateObject();
-    if (!request) {
-        log_error("input", "Out of memory");
+    if (frame_active() && frame_send_input(text_with_newline) == 0) {
+        g_state.turns_sent++;
+        session_poll_output();
         return;
     }
 
-    cJSON_AddStringToObject(request, "session_id", g_state.session_id);
-    cJSON_AddStringToObject(request, "text", text_with_newline);
-
-    body = cJSON_PrintUnformatted(request);
-    cJSON_Delete(request);
-
+    /* Room for every input byte escaped as \u00XX */
+    jb.size = (strlen(text_with_newline) + sizeof(g_state.session_id)) * 6 + 64;
+    body = pool_get(jb.size);
     if (!body) {
         log_error("input", "Out of memory");
         return;
     }
+    jb.buf = body;
+    jb.len = 0;
+    jw_init(&w, jw_buffer_sink, &jb);
+    jw_object_begin(&w);
+    jw_key(&w, "session_id");
+    jw_string(&w, g_state.session_id);
+    jw_key(&w, "text");
+    jw_string(&w, text_with_newline);
+    jw_object_end(&w);
+
+    if (jw_finish(&w) < 0) {
+        log_error("input", http_error_string(HTTP_ERR_OVERFLOW));
+        pool_put(body);
+        return;
+    }
 
     {
         HttpResult ret =
             http_request("POST", "/input", body, response, sizeof(response));
-        free(body);
+        pool_put(body);
 
         if (ret != HTTP_OK) {
             log_error("input", http_error_string(ret));
@@ -342,48 +603,72 @@ void session_send_input(const char *text)
         }
     }
 
-    json = cJSON_Parse(response);
-    if (json) {
-        const cJSON *error_item = cJSON_GetObjectItem(json, "error");
-        if (cJSON_IsString(error_item)) {
-            log_error("input", error_item->valuestring);
-            cJSON_Delete(json);
-            return;
-        }
-        cJSON_Delete(json);
+    if (jr_root(response, strlen(response), &root) == 0 &&
+        jr_get(&root, "error", &error_item) == 0 &&
+        jr_is_string(&error_item)) {
+        log_error("input", jr_string_inplace(&error_item));
+        return;
     }
 
+    g_state.turns_sent++;
     session_poll_output();
 }
 
 void session_poll_once(void)
 {
-    static char response[BUFFER_SIZE];
+    char *response;
+    size_t resp_len;
     char path[256];
-    cJSON *json;
+    JsonSpan root;
+    JsonSpan output_item;
+    JsonSpan status_item;
+    JsonSpan offset_item;
+    JsonSpan next_item;
+    long since;
+    long dropped;
 
     if (!g_state.session_id[0]) {
         printf("[Not connected]\n");
         return;
     }
 
-    snprintf(path, sizeof(path), "/output?session_id=%s", g_state.session_id);
+    since = session_output_cursor();
+    snprintf(path, sizeof(path), "/output?session_id=%s&since=%ld&max_bytes=%d",
+             g_state.session_id, since, OUTPUT_PAGE_BYTES);
 
-    if (http_request("GET", path, NULL, response, sizeof(response)) ==
+    if (http_request_alloc("GET", path, NULL, 0, &response, &resp_len) ==
         HTTP_OK) {
-        json = cJSON_Parse(response);
-        if (json) {
-            const cJSON *output_item = cJSON_GetObjectItem(json, "output");
-            const cJSON *status_item = cJSON_GetObjectItem(json, "status");
+        /* Output is decoded over the response itself, never copied */
+        if (jr_root(response, resp_len, &root) == 0) {
+            int stopped = jr_get(&root, "status", &status_item) == 0 &&
+                          jr_string_eq(&status_item, "stopped");
+            char *output;
+
+            /* Numbers first: decoding the output rewrites the text after it */
+            dropped = session_output_advance(
+                since,
+                jr_get(&root, "offset", &offset_item) == 0
+                    ? jr_long(&offset_item, since)
+                    : since,
+                jr_get(&root, "next", &next_item) == 0
+                    ? jr_long(&next_item, since)
+                    : since);
+            output = jr_get(&root, "output", &output_item) == 0
+                         ? jr_string_inplace(&output_item)
+                         : NULL;
+
+            if (dropped > 0) {
+                printf("[... %ld characters of output dropped ...]\n",
+                       dropped);
+            }
 
-            if (cJSON_IsString(output_item) && output_item->valuestring[0]) {
-                print_output(output_item->valuestring);
+            if (output && output[0]) {
+                print_output(output);
             } else {
                 printf("[No new output]\n");
             }
 
-            if (cJSON_IsString(status_item) &&
-                strcmp(status_item->valuestring, "stopped") == 0) {
+            if (stopped) {
                 printf("\n[Session ended]\n");
                 if (g_state.poll_thread != NULL) {
                     EnterCriticalSection(&g_state.output_lock);
@@ -394,9 +679,8 @@ void session_poll_once(void)
                     LeaveCriticalSection(&g_state.output_lock);
                 }
             }
-
-            cJSON_Delete(json);
         }
+        free(response);
     } else {
         log_error("poll", "Failed to get output");
     }
@@ -15,6 +15,18 @@ void session_send_input(const char *text);
 
 void session_heartbeat(void);
 
+/* Renew the lease on the command the poll thread is running, when due */
+void session_renew_lease(void);
+
+/* Where in the server's output log the next poll reads from */
+long session_output_cursor(void);
+
+/*
+ * Move the cursor past a reply that asked from `since`. Returns how many
+ * characters the server dropped before `offset` for want of room.
+ */
+long session_output_advance(long since, long offset, long next);
+
 void session_poll_once(void);
 
 #endif /* SESSION_H */
@@ -0,0 +1,150 @@
+/*
+ * bench_alloc.c - CPU and heap allocations per operation with the arena
+ * and the pool against plain malloc
+ *
+ * A poll cycle parses a /sync reply, reads it and frees it: with cJSON on
+ * the heap, and with the arena selected and reset afterwards. A command
+ * borrows and returns a 32 KB output buffer: from malloc, and from the
+ * pool. glibc's allocator is far better than the Win9x heap, so the
+ * figure that carries over is heap allocations per cycle, not the time.
+ */
+
+#include "../arena.h"
+#include "../pool.h"
+#include "../util.h"
+#include "test.h"
+
+#define MIN_CPU_SEC 0.3
+#define OUTPUT_BUFFER 32768
+
+static char s_reply[4096];
+static long s_heap_allocs;
+
+void log_error(const char *context, const char *message)
+{
+    (void)context;
+    (void)message;
+}
+
+static void *CJSON_CDECL counting_malloc(size_t size)
+{
+    s_heap_allocs++;
+    return malloc(size);
+}
+
+static void CJSON_CDECL counting_free(void *p)
+{
+    free(p);
+}
+
+static void parse_cycle(void)
+{
+    cJSON *json = cJSON_Parse(s_reply);
+    const cJSON *cmd = cJSON_GetObjectItem(json, "command");
+
+    if (!cJSON_IsString(cJSON_GetObjectItem(cmd, "command"))) {
+        test_failures++;
+    }
+    cJSON_Delete(json);
+}
+
+static void arena_cycle(void)
+{
+    parse_cycle();
+    arena_reset();
+}
+
+static void malloc_buffer(void)
+{
+    char *buf = (char *)malloc(OUTPUT_BUFFER);
+
+    buf[0] = '\0';
+    free(buf);
+}
+
+static void pool_buffer(void)
+{
+    char *buf = pool_get(OUTPUT_BUFFER);
+
+    buf[0] = '\0';
+    pool_put(buf);
+}
+
+typedef void (*OpFn)(void);
+
+/* CPU microseconds per call, over at least MIN_CPU_SEC; *calls is set */
+static double time_op(OpFn fn, long *calls)
+{
+    double start = test_cpu_now();
+    double elapsed;
+
+    *calls = 0;
+    do {
+        fn();
+        (*calls)++;
+        elapsed = test_cpu_now() - start;
+    } while (elapsed < MIN_CPU_SEC);
+
+    return elapsed * 1e6 / (double)*calls;
+}
+
+int main(void)
+{
+    cJSON_Hooks hooks;
+    JsonArena arena;
+    char output[1500];
+    double heap_us;
+    double arena_us;
+    double malloc_us;
+    double pool_us;
+    long heap_cycles;
+    long arena_cycles;
+    long calls;
+    PoolStats st;
+
+    memset(output, 'x', sizeof(output) - 1);
+    output[sizeof(output) - 1] = '\0';
+    snprintf(s_reply, sizeof(s_reply),
+             "{\"output\":\"%s\\n\",\"status\":\"running\","
+             "\"turn_state\":\"tool_running\",\"turn_seq\":3,"
+             "\"file_op\":{\"has_pending\":false},"
+             "\"command\":{\"has_pending\":true,"
+             "\"cmd_id\":\"20260101120000-0001\",\"command\":\"dir C:\\\\\","
+             "\"working_directory\":\"C:\\\\\"},"
+             "\"approval\":{\"has_pending\":false}}",
+             output);
+
+    pool_init(MEMORY_BUDGET_KB);
+
+    hooks.malloc_fn = counting_malloc;
+    hooks.free_fn = counting_free;
+    cJSON_InitHooks(&hooks);
+    heap_us = time_op(parse_cycle, &heap_cycles);
+    cJSON_InitHooks(NULL);
+
+    arena_install();
+    CHECK(arena_init(&arena, ARENA_SIZE) == 0);
+    arena_enter(&arena);
+    arena_us = time_op(arena_cycle, &arena_cycles);
+    arena_enter(NULL);
+
+    malloc_us = time_op(malloc_buffer, &calls);
+    pool_us = time_op(pool_buffer, &calls);
+
+    printf("%-24s %23s %23s\n", "", "heap", "arena / pool");
+    printf("%-24s %8.2f us %5.1f allocs %8.2f us %5.1f allocs\n",
+           "sync reply parse", heap_us, (double)s_heap_allocs / heap_cycles,
+           arena_us, (double)arena.fallbacks / arena_cycles);
+    printf("%-24s %8.3f us %5.1f allocs %8.3f us %5.1f allocs\n",
+           "32 KB output buffer", malloc_us, 1.0, pool_us, 0.0);
+    printf("arena peak %lu of %lu bytes\n", (unsigned long)arena.high_water,
+           (unsigned long)arena.size);
+
+    /* The arena's block is the only thing still borrowed */
+    CHECK(arena.fallbacks == 0);
+    arena_cleanup();
+    pool_get_stats(&st);
+    CHECK(st.in_use == 0);
+    pool_cleanup();
+    return test_result("bench_alloc");
+}
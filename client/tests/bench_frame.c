@@ -0,0 +1,451 @@
+/*
+ * bench_frame.c - Bytes on the wire and client CPU per operation, HTTP
+ * with JSON against the frame protocol
+ *
+ * Each side does what the client does for the operation, minus the socket.
+ * For a /sync reply the HTTP path formats the request, parses the response
+ * head and decodes the body the way parse_sync does: the file op in place,
+ * the rest through cJSON. The frame path builds the request payload and
+ * decodes each frame into the /sync-shaped object on_sync builds. A
+ * command result is serialized as http_post_json sends it, or packed as
+ * frame_send_cmd_result does. Times are CPU time, so they stay comparable
+ * on a busy machine; nothing is asserted about them, only that both paths
+ * decode the same thing.
+ */
+
+#include "../frame.h"
+#include "../evloop.h"
+#include "../jsonio.h"
+#include "../util.h"
+#include "test.h"
+
+ClientState g_state;
+
+void log_error(const char *context, const char *message)
+{
+    (void)context;
+    (void)message;
+}
+
+#define CONTENT_SIZE 4096
+#define STDOUT_SIZE 16384
+#define MIN_CPU_SEC 0.2
+
+static const char OUTPUT[] = "I'll write the file, then build it.\r\n";
+static const char OK_REPLY[] =
+    "HTTP/1.1 200 OK\r\nContent-Type: application/json; charset=utf-8\r\n"
+    "Date: Thu, 01 Jan 2026 12:00:00 GMT\r\nServer: Kestrel\r\n"
+    "Content-Length: 15\r\n\r\n{\"status\":\"ok\"}";
+
+static char s_content[CONTENT_SIZE + 1];
+static char s_stdout[STDOUT_SIZE + 1];
+
+/* Bytes as they cross the socket */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} Wire;
+
+/* What the client pulls out of a /sync reply, to compare the paths */
+typedef struct {
+    char content[CONTENT_SIZE + 1];
+    char command[64];
+    char output[128];
+} Decoded;
+
+/* Source text: quotes, backslashes and line breaks, as code has */
+static void fill_text(char *dst, size_t len)
+{
+    static const char line[] =
+        "    if (strcmp(path, \"C:\\\\PROJECTS\") == 0) { n++; }\r\n";
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        dst[i] = line[i % (sizeof(line) - 1)];
+    }
+    dst[len] = '\0';
+}
+
+static void wire_put(Wire *w, const char *data, size_t len)
+{
+    if (w->len + len > w->cap) {
+        w->cap = (w->len + len) * 2;
+        w->data = (char *)realloc(w->data, w->cap);
+    }
+    memcpy(w->data + w->len, data, len);
+    w->len += len;
+}
+
+static void wire_frame(Wire *w, int type, const FrameBuf *payload)
+{
+    unsigned long len = (unsigned long)payload->len;
+    char header[FRAME_HEADER_SIZE];
+
+    header[0] = (char)type;
+    header[1] = FRAME_PRIO_CONTROL;
+    header[2] = 1;
+    header[3] = 0;
+    header[4] = (char)(len & 0xFF);
+    header[5] = (char)((len >> 8) & 0xFF);
+    header[6] = (char)((len >> 16) & 0xFF);
+    header[7] = (char)((len >> 24) & 0xFF);
+    wire_put(w, header, FRAME_HEADER_SIZE);
+    wire_put(w, payload->data, payload->len);
+}
+
+/* ---- /sync carrying output, a 4 KB write and a command ---- */
+
+static void http_sync_reply(Wire *w)
+{
+    cJSON *reply = cJSON_CreateObject();
+    cJSON *op = cJSON_AddObjectToObject(reply, "file_op");
+    cJSON *cmd = cJSON_AddObjectToObject(reply, "command");
+    char head[256];
+    char *body;
+
+    cJSON_AddStringToObject(reply, "output", OUTPUT);
+    cJSON_AddStringToObject(reply, "status", "running");
+    cJSON_AddStringToObject(reply, "turn_state", "tool_running");
+    cJSON_AddNumberToObject(reply, "turn_seq", 3);
+    cJSON_AddTrueToObject(op, "has_pending");
+    cJSON_AddStringToObject(op, "op_id", "20260101120000-0002");
+    cJSON_AddStringToObject(op, "operation", "write");
+    cJSON_AddStringToObject(op, "path", "C:\\PROJECTS\\MAIN.C");
+    cJSON_AddStringToObject(op, "content", s_content);
+    cJSON_AddTrueToObject(cmd, "has_pending");
+    cJSON_AddStringToObject(cmd, "cmd_id", "20260101120000-0001");
+    cJSON_AddStringToObject(cmd, "command", "wmake");
+    cJSON_AddStringToObject(cmd, "working_directory", "C:\\PROJECTS");
+
+    body = cJSON_PrintUnformatted(reply);
+    snprintf(head, sizeof(head),
+             "HTTP/1.1 200 OK\r\nContent-Type: application/json; "
+             "charset=utf-8\r\nDate: Thu, 01 Jan 2026 12:00:00 GMT\r\n"
+             "Server: Kestrel\r\nContent-Length: %lu\r\n\r\n",
+             (unsigned long)strlen(body));
+    wire_put(w, head, strlen(head));
+    wire_put(w, body, strlen(body) + 1);
+    w->len--;
+    free(body);
+    cJSON_Delete(reply);
+}
+
+static void frame_sync_reply(Wire *w)
+{
+    FrameBuf p;
+
+    fbuf_init(&p);
+    fbuf_add_str(&p, OUTPUT);
+    wire_frame(w, FRAME_OUTPUT, &p);
+    fbuf_free(&p);
+
+    fbuf_init(&p);
+    fbuf_add_str(&p, "20260101120000-0002");
+    fbuf_add_str(&p, "write");
+    fbuf_add_str(&p, "C:\\PROJECTS\\MAIN.C");
+    fbuf_add_str(&p, s_content);
+    wire_frame(w, FRAME_FILE_OP, &p);
+    fbuf_free(&p);
+
+    fbuf_init(&p);
+    fbuf_add_str(&p, "20260101120000-0001");
+    fbuf_add_str(&p, "wmake");
+    fbuf_add_str(&p, "C:\\PROJECTS");
+    wire_frame(w, FRAME_COMMAND, &p);
+    fbuf_free(&p);
+
+    fbuf_init(&p);
+    fbuf_add_str(&p, "running");
+    fbuf_add_str(&p, "tool_running");
+    fbuf_add_int(&p, 3);
+    wire_frame(w, FRAME_SYNC_END, &p);
+    fbuf_free(&p);
+}
+
+static size_t http_sync_op(const Wire *reply, char *scratch, Decoded *out)
+{
+    char request[512];
+    int request_len;
+    size_t head_len = (size_t)(strstr(reply->data, "\r\n\r\n") + 4 -
+                               reply->data);
+    size_t body_len = reply->len - head_len;
+    long content_length;
+    int keep_alive;
+    JsonSpan root;
+    JsonSpan op;
+    JsonSpan v;
+    cJSON *json;
+    const cJSON *cmd;
+
+    request_len = snprintf(
+        request, sizeof(request),
+        "GET /sync?session_id=%s&wait_ms=%d&approval=%d&since=%ld"
+        "&max_bytes=%d HTTP/1.1\r\nHost: %s:%d\r\nX-API-Key: %s\r\n"
+        "Connection: keep-alive\r\n\r\n",
+        "20260101120000-0001", LONG_POLL_WAIT_MS, 1, 0L, OUTPUT_PAGE_BYTES,
+        "192.168.56.1", PORT_API, API_KEY);
+
+    ev_parse_head(reply->data, head_len, &content_length, &keep_alive);
+    memcpy(scratch, reply->data + head_len, body_len);
+    scratch[body_len] = '\0';
+
+    /* As parse_sync: the file op is decoded in place, then blanked */
+    if (jr_root(scratch, body_len, &root) == 0 &&
+        jr_get(&root, "file_op", &op) == 0 &&
+        jr_get(&op, "content", &v) == 0) {
+        jr_string(&v, out->content, sizeof(out->content));
+        jr_blank(&op);
+    }
+
+    json = cJSON_Parse(scratch);
+    cmd = cJSON_GetObjectItem(json, "command");
+    snprintf(out->command, sizeof(out->command), "%s",
+             cJSON_GetStringValue(cJSON_GetObjectItem(cmd, "command")));
+    snprintf(out->output, sizeof(out->output), "%s",
+             cJSON_GetStringValue(cJSON_GetObjectItem(json, "output")));
+    cJSON_Delete(json);
+
+    return (size_t)request_len + reply->len;
+}
+
+static void add_field(cJSON *obj, const char *name, FrameReader *r)
+{
+    char *value = frd_str(r);
+
+    if (value) {
+        cJSON_AddStringToObject(obj, name, value);
+        free(value);
+    }
+}
+
+static size_t frame_sync_op(const Wire *reply, Decoded *out)
+{
+    FrameBuf request;
+    size_t request_len;
+    size_t pos = 0;
+    cJSON *json = cJSON_CreateObject();
+    cJSON *item;
+    char *output = NULL;
+
+    fbuf_init(&request);
+    fbuf_add_int(&request, LONG_POLL_WAIT_MS);
+    fbuf_add_int(&request, 1);
+    fbuf_add_int(&request, 0);
+    fbuf_add_int(&request, OUTPUT_PAGE_BYTES);
+    request_len = FRAME_HEADER_SIZE + request.len;
+    fbuf_free(&request);
+
+    /* As on_sync, one frame at a time */
+    while (pos + FRAME_HEADER_SIZE <= reply->len) {
+        const unsigned char *h = (const unsigned char *)reply->data + pos;
+        size_t len = (size_t)h[4] | ((size_t)h[5] << 8) |
+                     ((size_t)h[6] << 16) | ((size_t)h[7] << 24);
+        FrameReader r;
+
+        frd_init(&r, reply->data + pos + FRAME_HEADER_SIZE, len);
+        switch (h[0]) {
+        case FRAME_OUTPUT:
+            output = frd_str(&r);
+            break;
+        case FRAME_FILE_OP:
+            item = cJSON_AddObjectToObject(json, "file_op");
+            cJSON_AddTrueToObject(item, "has_pending");
+            add_field(item, "op_id", &r);
+            add_field(item, "operation", &r);
+            add_field(item, "path", &r);
+            add_field(item, "content", &r);
+            break;
+        case FRAME_COMMAND:
+            item = cJSON_AddObjectToObject(json, "command");
+            cJSON_AddTrueToObject(item, "has_pending");
+            add_field(item, "cmd_id", &r);
+            add_field(item, "command", &r);
+            add_field(item, "working_directory", &r);
+            break;
+        case FRAME_SYNC_END:
+            add_field(json, "status", &r);
+            add_field(json, "turn_state", &r);
+            cJSON_AddNumberToObject(json, "turn_seq", frd_int(&r));
+            break;
+        default:
+            break;
+        }
+        pos += FRAME_HEADER_SIZE + len;
+    }
+    cJSON_AddStringToObject(json, "output", output ? output : "");
+    free(output);
+
+    item = cJSON_GetObjectItem(json, "file_op");
+    snprintf(out->content, sizeof(out->content), "%s",
+             cJSON_GetStringValue(cJSON_GetObjectItem(item, "content")));
+    item = cJSON_GetObjectItem(json, "command");
+    snprintf(out->command, sizeof(out->command), "%s",
+             cJSON_GetStringValue(cJSON_GetObjectItem(item, "command")));
+    snprintf(out->output, sizeof(out->output), "%s",
+             cJSON_GetStringValue(cJSON_GetObjectItem(json, "output")));
+    cJSON_Delete(json);
+
+    return request_len + reply->len;
+}
+
+/* ---- command result with 16 KB of stdout ---- */
+
+static size_t http_result_op(const cJSON *result, char *scratch, size_t size)
+{
+    JsonWriter w;
+    JsonBuffer out;
+    char head[512];
+    int head_len;
+
+    out.buf = scratch;
+    out.size = size;
+    out.len = 0;
+
+    head_len = snprintf(head, sizeof(head),
+                        "POST /cmd/result HTTP/1.1\r\nHost: %s:%d\r\n"
+                        "X-API-Key: %s\r\nContent-Type: application/json\r\n"
+                        "Content-Length: %lu\r\nConnection: keep-alive\r\n"
+                        "\r\n",
+                        "192.168.56.1", PORT_API, API_KEY,
+                        (unsigned long)jw_measure(result));
+
+    jw_init(&w, jw_buffer_sink, &out);
+    jw_raw(&w, head, (size_t)head_len);
+    jw_value(&w, result);
+    jw_finish(&w);
+
+    return out.len + sizeof(OK_REPLY) - 1;
+}
+
+static size_t frame_result_op(const cJSON *result)
+{
+    FrameBuf request;
+    size_t len;
+
+    fbuf_init(&request);
+    fbuf_add_str(&request, cJSON_GetStringValue(
+                               cJSON_GetObjectItem(result, "command_id")));
+    fbuf_add_int(&request, cJSON_GetObjectItem(result, "exit_code")->valueint);
+    fbuf_add_str(&request,
+                 cJSON_GetStringValue(cJSON_GetObjectItem(result, "stdout")));
+    fbuf_add_str(&request,
+                 cJSON_GetStringValue(cJSON_GetObjectItem(result, "stderr")));
+    len = FRAME_HEADER_SIZE + request.len;
+    fbuf_free(&request);
+
+    /* The ACK that answers it */
+    return len + FRAME_HEADER_SIZE;
+}
+
+/* ---- running them ---- */
+
+typedef struct {
+    const Wire *reply;
+    const cJSON *result;
+    char *scratch;
+    size_t scratch_size;
+    Decoded decoded;
+} Op;
+
+typedef size_t (*OpFn)(Op *op);
+
+static size_t run_http_sync(Op *op)
+{
+    return http_sync_op(op->reply, op->scratch, &op->decoded);
+}
+
+static size_t run_frame_sync(Op *op)
+{
+    return frame_sync_op(op->reply, &op->decoded);
+}
+
+static size_t run_http_result(Op *op)
+{
+    return http_result_op(op->result, op->scratch, op->scratch_size);
+}
+
+static size_t run_frame_result(Op *op)
+{
+    return frame_result_op(op->result);
+}
+
+/* CPU microseconds per call, over at least MIN_CPU_SEC */
+static double time_op(OpFn fn, Op *op, size_t *bytes)
+{
+    long calls = 0;
+    double start = test_cpu_now();
+    double elapsed;
+
+    do {
+        *bytes = fn(op);
+        calls++;
+        elapsed = test_cpu_now() - start;
+    } while (elapsed < MIN_CPU_SEC);
+
+    return elapsed * 1e6 / (double)calls;
+}
+
+static void report(const char *name, OpFn http, Op *http_op, OpFn frame,
+                   Op *frame_op)
+{
+    size_t http_bytes;
+    size_t frame_bytes;
+    double http_us = time_op(http, http_op, &http_bytes);
+    double frame_us = time_op(frame, frame_op, &frame_bytes);
+
+    printf("%-22s %8lu B %9.2f us    %8lu B %9.2f us    %5.2fx\n", name,
+           (unsigned long)http_bytes, http_us, (unsigned long)frame_bytes,
+           frame_us, http_us / frame_us);
+}
+
+int main(void)
+{
+    Wire http_reply = {NULL, 0, 0};
+    Wire frame_reply = {NULL, 0, 0};
+    cJSON *result = cJSON_CreateObject();
+    static Op http_op;
+    static Op frame_op;
+    size_t bytes;
+
+    fill_text(s_content, CONTENT_SIZE);
+    fill_text(s_stdout, STDOUT_SIZE);
+    http_sync_reply(&http_reply);
+    frame_sync_reply(&frame_reply);
+
+    cJSON_AddStringToObject(result, "command_id", "20260101120000-0001");
+    cJSON_AddNumberToObject(result, "exit_code", 0);
+    cJSON_AddStringToObject(result, "stdout", s_stdout);
+    cJSON_AddStringToObject(result, "stderr", "");
+
+    http_op.reply = &http_reply;
+    http_op.result = result;
+    http_op.scratch_size = 4 * STDOUT_SIZE;
+    http_op.scratch = (char *)malloc(http_op.scratch_size);
+    frame_op = http_op;
+    frame_op.reply = &frame_reply;
+
+    /* Both paths must hand the handlers the same work */
+    bytes = run_http_sync(&http_op);
+    CHECK(bytes > 0);
+    bytes = run_frame_sync(&frame_op);
+    CHECK(bytes > 0);
+    CHECK(strcmp(http_op.decoded.content, s_content) == 0);
+    CHECK(strcmp(frame_op.decoded.content, s_content) == 0);
+    CHECK(strcmp(http_op.decoded.command, "wmake") == 0);
+    CHECK(strcmp(frame_op.decoded.command, "wmake") == 0);
+    CHECK(strcmp(http_op.decoded.output, OUTPUT) == 0);
+    CHECK(strcmp(frame_op.decoded.output, OUTPUT) == 0);
+
+    printf("%-22s %21s    %21s\n", "", "HTTP + JSON", "frames");
+    report("sync, write + command", run_http_sync, &http_op, run_frame_sync,
+           &frame_op);
+    report("command result", run_http_result, &http_op, run_frame_result,
+           &frame_op);
+
+    free(http_op.scratch);
+    free(http_reply.data);
+    free(frame_reply.data);
+    cJSON_Delete(result);
+    return test_result("bench_frame");
+}
@@ -0,0 +1,185 @@
+/*
+ * bench_jsonio.c - CPU per operation for jw_* and jr_* against cJSON
+ *
+ * The operations are the ones the handlers do most: send a command
+ * result with 128 KB of output (printed to a string and sent, or
+ * streamed through the writer as http_post_json does) and take a 1 MB
+ * write off a /sync reply (parsed into a tree, or read in place and
+ * decoded straight to the file as run_fileop_text does). Each pair is
+ * checked to produce the same bytes before it is timed; the times are
+ * only reported.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../jsonio.h"
+#include "test.h"
+
+#define STDOUT_SIZE (128 * 1024)
+#define CONTENT_SIZE (1024 * 1024)
+#define MIN_CPU_SEC 0.3
+
+typedef struct {
+    size_t bytes;
+} CountSink;
+
+static int count_sink(void *ctx, const char *data, size_t len)
+{
+    (void)data;
+    ((CountSink *)ctx)->bytes += len;
+    return 0;
+}
+
+static char *s_stdout;
+static char *s_sync;
+static char *s_copy;
+static size_t s_sync_len;
+static FILE *s_null;
+
+static void fill_text(char *dst, size_t len)
+{
+    static const char line[] =
+        "main.c(42): Warning! W131: No prototype for \"foo\" in C:\\INC\r\n";
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        dst[i] = line[i % (sizeof(line) - 1)];
+    }
+    dst[len] = '\0';
+}
+
+static cJSON *command_result(void)
+{
+    cJSON *result = cJSON_CreateObject();
+
+    cJSON_AddStringToObject(result, "command_id", "20260101120000-0001");
+    cJSON_AddItemToObject(result, "stdout",
+                          cJSON_CreateStringReference(s_stdout));
+    cJSON_AddStringToObject(result, "stderr", "");
+    cJSON_AddNumberToObject(result, "exit_code", 0);
+    return result;
+}
+
+/* Returns bytes that would go on the wire */
+static size_t write_cjson(void)
+{
+    cJSON *result = command_result();
+    char *text = cJSON_PrintUnformatted(result);
+    size_t len = strlen(text);
+
+    free(text);
+    cJSON_Delete(result);
+    return len;
+}
+
+static size_t write_jw(void)
+{
+    cJSON *result = command_result();
+    CountSink sink = {0};
+    JsonWriter w;
+    size_t measured = jw_measure(result);
+
+    jw_init(&w, count_sink, &sink);
+    jw_value(&w, result);
+    jw_finish(&w);
+    cJSON_Delete(result);
+    return sink.bytes == measured ? sink.bytes : 0;
+}
+
+/* Returns bytes written to the file */
+static size_t read_cjson(void)
+{
+    cJSON *json;
+    const char *content;
+    size_t len;
+
+    memcpy(s_copy, s_sync, s_sync_len + 1);
+    json = cJSON_Parse(s_copy);
+    content = cJSON_GetObjectItem(cJSON_GetObjectItem(json, "file_op"),
+                                  "content")->valuestring;
+    len = fwrite(content, 1, strlen(content), s_null);
+    cJSON_Delete(json);
+    return len;
+}
+
+static size_t read_jr(void)
+{
+    JsonSpan root;
+    JsonSpan op;
+    JsonSpan content;
+    long len;
+
+    memcpy(s_copy, s_sync, s_sync_len + 1);
+    jr_root(s_copy, s_sync_len, &root);
+    jr_get(&root, "file_op", &op);
+    jr_get(&op, "content", &content);
+    len = jr_string_to_file(&content, s_null);
+    return len < 0 ? 0 : (size_t)len;
+}
+
+typedef size_t (*OpFn)(void);
+
+/* CPU microseconds per call, over at least MIN_CPU_SEC */
+static double time_op(OpFn fn)
+{
+    long calls = 0;
+    double start = test_cpu_now();
+    double elapsed;
+
+    do {
+        fn();
+        calls++;
+        elapsed = test_cpu_now() - start;
+    } while (elapsed < MIN_CPU_SEC);
+
+    return elapsed * 1e6 / (double)calls;
+}
+
+static void report(const char *name, OpFn cjson, OpFn jsonio)
+{
+    size_t expect = cjson();
+    double cjson_us;
+    double jsonio_us;
+
+    CHECK(expect > 0 && jsonio() == expect);
+    cjson_us = time_op(cjson);
+    jsonio_us = time_op(jsonio);
+    printf("%-28s %10.1f us %10.1f us %7.2fx\n", name, cjson_us, jsonio_us,
+           cjson_us / jsonio_us);
+}
+
+int main(void)
+{
+    cJSON *sync = cJSON_CreateObject();
+    cJSON *op = cJSON_AddObjectToObject(sync, "file_op");
+    char *content = (char *)malloc(CONTENT_SIZE + 1);
+
+    s_stdout = (char *)malloc(STDOUT_SIZE + 1);
+    fill_text(s_stdout, STDOUT_SIZE);
+    fill_text(content, CONTENT_SIZE);
+
+    cJSON_AddStringToObject(sync, "output", "");
+    cJSON_AddStringToObject(sync, "status", "running");
+    cJSON_AddTrueToObject(op, "has_pending");
+    cJSON_AddStringToObject(op, "op_id", "20260101120000-0002");
+    cJSON_AddStringToObject(op, "operation", "write");
+    cJSON_AddStringToObject(op, "path", "C:\\PROJECTS\\MAIN.C");
+    cJSON_AddItemToObject(op, "content", cJSON_CreateStringReference(content));
+    s_sync = cJSON_PrintUnformatted(sync);
+    s_sync_len = strlen(s_sync);
+    s_copy = (char *)malloc(s_sync_len + 1);
+    s_null = fopen("/dev/null", "wb");
+    CHECK(s_null != NULL);
+
+    printf("%-28s %13s %13s\n", "", "cJSON", "jsonio");
+    report("command result, 128 KB", write_cjson, write_jw);
+    report("sync with a 1 MB write", read_cjson, read_jr);
+
+    fclose(s_null);
+    free(s_copy);
+    free(s_sync);
+    cJSON_Delete(sync);
+    free(content);
+    free(s_stdout);
+    return test_result("bench_jsonio");
+}
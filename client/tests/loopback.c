@@ -0,0 +1,268 @@
+/*
+ * loopback.c - A small HTTP/1.1 server on 127.0.0.1 for the host tests
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "loopback.h"
+
+#define LOOPBACK_MAX_CONNS 64
+#define LOOPBACK_HEAD_MAX 8192
+
+static LoopbackHandler s_handler;
+static int s_listen = -1;
+static pthread_t s_accept_thread;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static int s_conns[LOOPBACK_MAX_CONNS];
+static int s_open = 0;
+static long s_accepted = 0;
+
+static void conn_track(int fd, int add)
+{
+    int i;
+
+    pthread_mutex_lock(&s_lock);
+    for (i = 0; i < LOOPBACK_MAX_CONNS; i++) {
+        if (add && s_conns[i] < 0) {
+            s_conns[i] = fd;
+            s_open++;
+            s_accepted++;
+            break;
+        }
+        if (!add && s_conns[i] == fd) {
+            s_conns[i] = -1;
+            s_open--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+static long content_length(const char *head)
+{
+    const char *line = strstr(head, "\r\n");
+
+    while (line && line[2] != '\r') {
+        line += 2;
+        if (strncasecmp(line, "content-length:", 15) == 0) {
+            return atol(line + 15);
+        }
+        line = strstr(line, "\r\n");
+    }
+    return 0;
+}
+
+/* One request per pass; returns nonzero when the connection is done */
+static int serve_one(int fd, char *head, size_t *have)
+{
+    char method[16];
+    char path[1024];
+    char *end;
+    char *body;
+    size_t head_len;
+    long len;
+    long got;
+    int done;
+
+    while ((end = strstr(head, "\r\n\r\n")) == NULL) {
+        ssize_t n;
+
+        if (*have >= LOOPBACK_HEAD_MAX - 1) {
+            return 1;
+        }
+        n = recv(fd, head + *have, LOOPBACK_HEAD_MAX - 1 - *have, 0);
+        if (n <= 0) {
+            return 1;
+        }
+        *have += (size_t)n;
+        head[*have] = '\0';
+    }
+    head_len = (size_t)(end + 4 - head);
+
+    if (sscanf(head, "%15s %1023s", method, path) != 2) {
+        return 1;
+    }
+    len = content_length(head);
+    body = (char *)malloc((size_t)len + 1);
+    if (!body) {
+        return 1;
+    }
+
+    /* Body bytes that came in with the head, then the rest */
+    got = (long)(*have - head_len) < len ? (long)(*have - head_len) : len;
+    memcpy(body, head + head_len, (size_t)got);
+    while (got < len) {
+        ssize_t n = recv(fd, body + got, (size_t)(len - got), 0);
+        if (n <= 0) {
+            free(body);
+            return 1;
+        }
+        got += n;
+    }
+    body[len] = '\0';
+
+    /* Keep whatever followed for the next request */
+    head_len += (size_t)((long)(*have - head_len) < len
+                             ? (long)(*have - head_len)
+                             : len);
+    memmove(head, head + head_len, *have - head_len);
+    *have -= head_len;
+    head[*have] = '\0';
+
+    done = s_handler(fd, method, path, body, (size_t)len);
+    free(body);
+    return done;
+}
+
+static void *conn_main(void *arg)
+{
+    int fd = (int)(long)arg;
+    char *head = (char *)malloc(LOOPBACK_HEAD_MAX);
+    size_t have = 0;
+
+    if (head) {
+        head[0] = '\0';
+        while (!serve_one(fd, head, &have)) {
+        }
+        free(head);
+    }
+
+    conn_track(fd, 0);
+    shutdown(fd, SHUT_RDWR);
+    close(fd);
+    return NULL;
+}
+
+static void *accept_main(void *arg)
+{
+    (void)arg;
+
+    for (;;) {
+        pthread_t thread;
+        int fd = accept(s_listen, NULL, NULL);
+
+        if (fd < 0) {
+            return NULL;
+        }
+        conn_track(fd, 1);
+        if (pthread_create(&thread, NULL, conn_main, (void *)(long)fd) != 0) {
+            conn_track(fd, 0);
+            close(fd);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
+
+int loopback_start(LoopbackHandler handler)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int one = 1;
+    int i;
+
+    for (i = 0; i < LOOPBACK_MAX_CONNS; i++) {
+        s_conns[i] = -1;
+    }
+    s_handler = handler;
+
+    s_listen = socket(AF_INET, SOCK_STREAM, 0);
+    if (s_listen < 0) {
+        return -1;
+    }
+    setsockopt(s_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(s_listen, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(s_listen, 64) != 0 ||
+        getsockname(s_listen, (struct sockaddr *)&addr, &addr_len) != 0 ||
+        pthread_create(&s_accept_thread, NULL, accept_main, NULL) != 0) {
+        close(s_listen);
+        s_listen = -1;
+        return -1;
+    }
+    return ntohs(addr.sin_port);
+}
+
+void loopback_stop(void)
+{
+    int i;
+    int open;
+
+    if (s_listen < 0) {
+        return;
+    }
+    shutdown(s_listen, SHUT_RDWR);
+    close(s_listen);
+    pthread_join(s_accept_thread, NULL);
+    s_listen = -1;
+
+    pthread_mutex_lock(&s_lock);
+    for (i = 0; i < LOOPBACK_MAX_CONNS; i++) {
+        if (s_conns[i] >= 0) {
+            shutdown(s_conns[i], SHUT_RDWR);
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+
+    /* Handlers that sleep finish their nap first */
+    for (i = 0; i < 1000; i++) {
+        pthread_mutex_lock(&s_lock);
+        open = s_open;
+        pthread_mutex_unlock(&s_lock);
+        if (open == 0) {
+            break;
+        }
+        usleep(10000);
+    }
+}
+
+long loopback_connections(void)
+{
+    long accepted;
+
+    pthread_mutex_lock(&s_lock);
+    accepted = s_accepted;
+    pthread_mutex_unlock(&s_lock);
+    return accepted;
+}
+
+void loopback_reply(int fd, int status, const char *body, size_t len,
+                    long content_length, int close_after)
+{
+    char head[256];
+    int n;
+    size_t sent = 0;
+
+    n = snprintf(head, sizeof(head), "HTTP/1.1 %d X\r\n", status);
+    if (content_length >= 0) {
+        n += snprintf(head + n, sizeof(head) - (size_t)n,
+                      "Content-Length: %ld\r\n", content_length);
+    }
+    if (close_after) {
+        n += snprintf(head + n, sizeof(head) - (size_t)n,
+                      "Connection: close\r\n");
+    }
+    n += snprintf(head + n, sizeof(head) - (size_t)n, "\r\n");
+
+    if (send(fd, head, (size_t)n, MSG_NOSIGNAL) != n) {
+        return;
+    }
+    while (sent < len) {
+        ssize_t w = send(fd, body + sent, len - sent, MSG_NOSIGNAL);
+        if (w <= 0) {
+            return;
+        }
+        sent += (size_t)w;
+    }
+}
@@ -0,0 +1,33 @@
+/*
+ * loopback.h - A small HTTP/1.1 server on 127.0.0.1 for the host tests
+ *
+ * Each connection gets its own thread and may carry any number of
+ * requests. The test's handler answers each one with loopback_reply (or
+ * writes to fd itself) and returns nonzero to close the connection.
+ */
+
+#ifndef LOOPBACK_H
+#define LOOPBACK_H
+
+#include <stddef.h>
+
+typedef int (*LoopbackHandler)(int fd, const char *method, const char *path,
+                               const char *body, size_t body_len);
+
+/* Start serving on a free port; returns the port, or -1 */
+int loopback_start(LoopbackHandler handler);
+
+/* Stop accepting and hang up on every open connection */
+void loopback_stop(void);
+
+/* Connections accepted so far */
+long loopback_connections(void);
+
+/*
+ * Send a reply. content_length < 0 sends no Content-Length, so the body
+ * runs to the close that the caller must then ask for.
+ */
+void loopback_reply(int fd, int status, const char *body, size_t len,
+                    long content_length, int close_after);
+
+#endif /* LOOPBACK_H */
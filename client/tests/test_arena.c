@@ -0,0 +1,211 @@
+/*
+ * test_arena.c - arena.c as cJSON's allocator: resets, the hooks going
+ * in and out, trees that outlive a cycle, and the heap taking over when
+ * an arena is full or the pool has no room for one
+ */
+
+#include "../arena.h"
+#include "../pool.h"
+#include "../util.h"
+#include "test.h"
+
+void log_error(const char *context, const char *message)
+{
+    (void)context;
+    (void)message;
+}
+
+static char s_reply[4096];
+
+static int in_arena(const JsonArena *arena, const void *p)
+{
+    return (const char *)p >= arena->base &&
+           (const char *)p < arena->base + arena->size;
+}
+
+/* One poll: parse a reply, read it, print part of it back, free it */
+static cJSON *cycle(void)
+{
+    cJSON *json = cJSON_Parse(s_reply);
+    char *printed;
+
+    CHECK(json != NULL);
+    CHECK(strcmp(cJSON_GetObjectItem(cJSON_GetObjectItem(json, "command"),
+                                     "cmd_id")->valuestring,
+                 "20260101120000-0001") == 0);
+    printed = cJSON_PrintUnformatted(cJSON_GetObjectItem(json, "command"));
+    CHECK(printed && strstr(printed, "\"command\":\"dir C:\\\\\"") != NULL);
+    cJSON_free(printed);
+    return json;
+}
+
+static void test_reset(JsonArena *arena)
+{
+    cJSON *first;
+    cJSON *second;
+    size_t used;
+
+    CHECK(arena_enter(arena) == NULL);
+
+    first = cycle();
+    CHECK(in_arena(arena, first));
+    CHECK(in_arena(arena, first->child->valuestring));
+    used = arena->used;
+    CHECK(used > 0 && arena->allocs > 0 && arena->fallbacks == 0);
+
+    /* Freeing costs nothing; only the reset takes the space back */
+    cJSON_Delete(first);
+    CHECK(arena->used == used);
+    arena_reset();
+    CHECK(arena->used == 0 && arena->high_water == used);
+
+    /* The next cycle lands where the last one did */
+    second = cycle();
+    CHECK(second == first);
+    CHECK(arena->used == used);
+    cJSON_Delete(second);
+    arena_reset();
+}
+
+static void test_heap_trees(JsonArena *arena)
+{
+    JsonArena *prev;
+    cJSON *keep;
+    cJSON *json;
+
+    /* Built with the heap selected, a tree outlives any number of resets */
+    prev = arena_enter(NULL);
+    CHECK(prev == arena);
+    keep = cJSON_CreateObject();
+    cJSON_AddStringToObject(keep, "session_id", "20260101120000-0001");
+    arena_enter(prev);
+    CHECK(!in_arena(arena, keep));
+
+    cJSON_Delete(cycle());
+    arena_reset();
+    cJSON_Delete(cycle());
+    arena_reset();
+    CHECK(strcmp(cJSON_GetObjectItem(keep, "session_id")->valuestring,
+                 "20260101120000-0001") == 0);
+
+    /* Freed while the arena is selected, it still goes back to the heap */
+    cJSON_Delete(keep);
+
+    /* A heap item moved into an arena tree is freed with it */
+    json = cycle();
+    prev = arena_enter(NULL);
+    keep = cJSON_CreateString("from the heap");
+    arena_enter(prev);
+    cJSON_AddItemToObject(json, "extra", keep);
+    cJSON_Delete(json);
+    arena_reset();
+}
+
+static void test_full_arena(JsonArena *tiny)
+{
+    JsonArena *prev = arena_enter(tiny);
+    cJSON *json;
+    int i;
+
+    /* What does not fit comes from the heap and is freed to it */
+    for (i = 0; i < 100; i++) {
+        json = cycle();
+        cJSON_Delete(json);
+        arena_reset();
+    }
+    CHECK(tiny->allocs > 0 && tiny->fallbacks > 0);
+    CHECK(tiny->high_water <= tiny->size);
+    arena_enter(prev);
+}
+
+static void test_no_budget(void)
+{
+    JsonArena starved;
+    JsonArena *prev;
+    char *hog;
+    size_t size = 64 * 1024;
+    cJSON *json;
+    long high_water;
+    long arena_size;
+    long fallbacks;
+
+    /* With the pool spent, the arena has no block and cJSON uses malloc */
+    hog = pool_get_upto(&size);
+    while (pool_get(POOL_MIN_SIZE)) {
+    }
+    CHECK(arena_init(&starved, ARENA_SIZE) == -1);
+    CHECK(starved.base == NULL);
+
+    prev = arena_enter(&starved);
+    json = cycle();
+    CHECK(json != NULL && starved.allocs == 0);
+    CHECK(starved.fallbacks > 0);
+    cJSON_Delete(json);
+    arena_reset();
+    arena_enter(prev);
+
+    arena_get_stats(&high_water, &arena_size, &fallbacks);
+    CHECK(arena_size == ARENA_SIZE && high_water > 0 && fallbacks > 0);
+    (void)hog;
+}
+
+static void test_hooks_removed(JsonArena *arena)
+{
+    cJSON *json;
+
+    /* After cleanup cJSON is back on the heap, arena selected or not */
+    arena_enter(NULL);
+    arena_cleanup();
+    CHECK(arena_enter(arena) == NULL);
+    json = cycle();
+    CHECK(json != NULL);
+    cJSON_Delete(json);
+    CHECK(arena_init(arena, ARENA_SIZE) == -1);
+}
+
+int main(void)
+{
+    JsonArena arena;
+    JsonArena tiny;
+    JsonArena extra[ARENA_MAX - 1];
+    char output[1500];
+    int i;
+
+    memset(output, 'x', sizeof(output) - 1);
+    output[sizeof(output) - 1] = '\0';
+    snprintf(s_reply, sizeof(s_reply),
+             "{\"output\":\"%s\\n\",\"status\":\"running\","
+             "\"turn_state\":\"tool_running\",\"turn_seq\":3,"
+             "\"file_op\":{\"has_pending\":false},"
+             "\"command\":{\"has_pending\":true,"
+             "\"cmd_id\":\"20260101120000-0001\",\"command\":\"dir C:\\\\\","
+             "\"working_directory\":\"C:\\\\\"},"
+             "\"approval\":{\"has_pending\":false}}",
+             output);
+
+    pool_init(256);
+
+    /* Before install there is nowhere to register an arena */
+    CHECK(arena_init(&arena, ARENA_SIZE) == -1);
+
+    arena_install();
+    CHECK(arena_init(&arena, ARENA_SIZE) == 0);
+    CHECK(arena_init(&tiny, 256) == 0);
+
+    test_reset(&arena);
+    test_heap_trees(&arena);
+    test_full_arena(&tiny);
+
+    /* Only ARENA_MAX are registered; the one past that is refused */
+    for (i = 0; i < ARENA_MAX - 2; i++) {
+        CHECK(arena_init(&extra[i], 1024) == 0);
+    }
+    CHECK(arena_init(&extra[i], 1024) == -1);
+
+    test_no_budget();
+
+    test_hooks_removed(&arena);
+    pool_cleanup();
+
+    return test_result("test_arena");
+}
@@ -0,0 +1,397 @@
+/*
+ * test_evloop.c - evloop.c and the async calls in http.c against a
+ * loopback server: requests overlapping on one loop, kept-alive sockets,
+ * bodies, timeouts, a full loop and aborts
+ *
+ * Overlap is shown without clocks: the server holds a request until
+ * others have arrived, which a loop that ran one request at a time would
+ * never deliver.
+ */
+
+#include <pthread.h>
+#include "../evloop.h"
+#include "../http.h"
+#include "../jsonio.h"
+#include "../sched.h"
+#include "loopback.h"
+#include "test.h"
+
+ClientState g_state;
+
+#define BIG_BODY 200000
+#define UNFRAMED_BODY 50000
+#define GATE_WAIT_MS 5000
+
+static char s_big[BIG_BODY];
+
+/* Server side: requests seen by /held, /gate and /hangup */
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond = PTHREAD_COND_INITIALIZER;
+static int s_posts = 0;
+static int s_gated = 0;
+static int s_hung_posts = 0;
+
+/* Wait until *count reaches want or the wait runs out; returns *count */
+static int wait_for(int *count, int want)
+{
+    struct timespec until;
+    int seen;
+
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += GATE_WAIT_MS / 1000;
+
+    pthread_mutex_lock(&s_lock);
+    while (*count < want &&
+           pthread_cond_timedwait(&s_cond, &s_lock, &until) == 0) {
+    }
+    seen = *count;
+    pthread_mutex_unlock(&s_lock);
+    return seen;
+}
+
+static void bump(int *count)
+{
+    pthread_mutex_lock(&s_lock);
+    (*count)++;
+    pthread_cond_broadcast(&s_cond);
+    pthread_mutex_unlock(&s_lock);
+}
+
+static int handler(int fd, const char *method, const char *path,
+                   const char *body, size_t body_len)
+{
+    static char unframed[UNFRAMED_BODY];
+    char reply[64];
+    int n;
+
+    if (strcmp(path, "/held") == 0) {
+        /* Answers once two posts have been served alongside it */
+        n = snprintf(reply, sizeof(reply), "{\"posts\":%d}",
+                     wait_for(&s_posts, 2));
+        loopback_reply(fd, 200, reply, (size_t)n, n, 0);
+    } else if (strcmp(path, "/gate") == 0) {
+        /* Answers once EV_MAX_REQUESTS are waiting here together */
+        bump(&s_gated);
+        n = snprintf(reply, sizeof(reply), "%d",
+                     wait_for(&s_gated, EV_MAX_REQUESTS));
+        loopback_reply(fd, 200, reply, (size_t)n, n, 0);
+    } else if (strcmp(path, "/hangup") == 0) {
+        /* Acted on, then the connection drops before any reply */
+        bump(&s_hung_posts);
+        return 1;
+    } else if (strcmp(method, "POST") == 0) {
+        n = snprintf(reply, sizeof(reply), "posted:%lu",
+                     (unsigned long)body_len);
+        loopback_reply(fd, 200, reply, (size_t)n, n, 0);
+        bump(&s_posts);
+    } else if (strcmp(path, "/big") == 0) {
+        loopback_reply(fd, 200, s_big, BIG_BODY, BIG_BODY, 0);
+    } else if (strcmp(path, "/err") == 0) {
+        loopback_reply(fd, 500, "nope", 4, 4, 0);
+    } else if (strcmp(path, "/unframed") == 0) {
+        memset(unframed, 'y', sizeof(unframed));
+        loopback_reply(fd, 200, unframed, sizeof(unframed), -1, 1);
+        return 1;
+    } else if (strcmp(path, "/bye") == 0) {
+        loopback_reply(fd, 200, "bye", 3, 3, 1);
+        return 1;
+    } else if (strcmp(path, "/drop") == 0) {
+        /* Looks kept alive, but the server hangs up straight after */
+        loopback_reply(fd, 200, "{}", 2, 2, 0);
+        return 1;
+    } else if (strcmp(path, "/hang") == 0) {
+        usleep(500000);
+        return 1;
+    } else {
+        loopback_reply(fd, 200, "{\"ok\":true}", 11, 11, 0);
+    }
+    return 0;
+}
+
+/* ---- client side ---- */
+
+typedef struct {
+    int done;
+    EvResult result;
+    HttpResult http_result;
+    int status;
+    size_t len;
+    char first[32];
+} Out;
+
+static void keep_body(Out *out, const char *body, size_t len)
+{
+    out->done = 1;
+    out->len = len;
+    if (body) {
+        snprintf(out->first, sizeof(out->first), "%s", body);
+    } else {
+        strcpy(out->first, "(null)");
+    }
+}
+
+static void on_done(void *ctx, EvResult result, int status, char *body,
+                    size_t len)
+{
+    Out *out = (Out *)ctx;
+
+    out->result = result;
+    out->status = status;
+    keep_body(out, body, len);
+}
+
+static void on_http_done(void *ctx, HttpResult result, char *body,
+                         size_t len)
+{
+    Out *out = (Out *)ctx;
+
+    out->http_result = result;
+    keep_body(out, body, len);
+}
+
+/* Queue method path (with body) on loop; returns ev_start's result */
+static int start(EvLoop *loop, const char *method, const char *path,
+                 const char *body, long timeout_ms, Out *out)
+{
+    char *request = (char *)malloc(1024);
+    int len;
+
+    if (body) {
+        len = snprintf(request, 1024,
+                       "%s %s HTTP/1.1\r\nHost: x\r\nContent-Length: %lu\r\n"
+                       "Connection: keep-alive\r\n\r\n%s",
+                       method, path, (unsigned long)strlen(body), body);
+    } else {
+        len = snprintf(request, 1024,
+                       "%s %s HTTP/1.1\r\nHost: x\r\n"
+                       "Connection: keep-alive\r\n\r\n",
+                       method, path);
+    }
+    memset(out, 0, sizeof(*out));
+    return ev_start(loop, request, (size_t)len, timeout_ms, on_done, out);
+}
+
+static void run_until(EvLoop *loop, const Out *out)
+{
+    while (!out->done) {
+        ev_run(loop, 1000);
+    }
+}
+
+static void test_parse_head(void)
+{
+    static const char head[] =
+        "HTTP/1.1 204 No\r\ncontent-LENGTH: 12\r\nConnection: Close\r\n\r\n";
+    long content_length;
+    int keep_alive;
+
+    CHECK(ev_parse_head(head, sizeof(head) - 1, &content_length,
+                        &keep_alive) == 204);
+    CHECK(content_length == 12 && keep_alive == 0);
+    CHECK(ev_parse_head("garbage\r\n\r\n", 11, &content_length,
+                        &keep_alive) == 0);
+}
+
+static void test_overlap(EvLoop *loop)
+{
+    Out held;
+    Out post1;
+    Out post2;
+
+    /* /held only answers after both posts, so they must not queue behind */
+    CHECK(start(loop, "GET", "/held", NULL, 10000, &held) == 0);
+    CHECK(start(loop, "POST", "/r1", "{\"a\":1}", 10000, &post1) == 0);
+    CHECK(start(loop, "POST", "/r2", "{\"bb\":22}", 10000, &post2) == 0);
+    CHECK(ev_active(loop) == 3);
+    while (ev_run(loop, 1000) > 0) {
+    }
+
+    CHECK(held.result == EV_OK && strcmp(held.first, "{\"posts\":2}") == 0);
+    CHECK(post1.result == EV_OK && strcmp(post1.first, "posted:7") == 0);
+    CHECK(post2.result == EV_OK && strcmp(post2.first, "posted:9") == 0);
+    CHECK(loop->connects == 3);
+
+    /* The next request takes one of the sockets they left behind */
+    CHECK(start(loop, "GET", "/a", NULL, 5000, &held) == 0);
+    run_until(loop, &held);
+    CHECK(held.result == EV_OK && loop->connects == 3 && loop->reuses == 1);
+}
+
+static void test_bodies(EvLoop *loop)
+{
+    Out out;
+
+    CHECK(start(loop, "GET", "/big", NULL, 5000, &out) == 0);
+    run_until(loop, &out);
+    CHECK(out.result == EV_OK && out.len == BIG_BODY &&
+          strncmp(out.first, s_big, sizeof(out.first) - 1) == 0);
+
+    loop->max_body = BIG_BODY / 2;
+    CHECK(start(loop, "GET", "/big", NULL, 5000, &out) == 0);
+    run_until(loop, &out);
+    CHECK(out.result == EV_ERR_TOO_LARGE && strcmp(out.first, "(null)") == 0);
+    loop->max_body = 1024 * 1024;
+
+    /* Error statuses still hand over their body */
+    CHECK(start(loop, "GET", "/err", NULL, 5000, &out) == 0);
+    run_until(loop, &out);
+    CHECK(out.result == EV_ERR_STATUS && out.status == 500 &&
+          strcmp(out.first, "nope") == 0);
+
+    CHECK(start(loop, "GET", "/unframed", NULL, 5000, &out) == 0);
+    run_until(loop, &out);
+    CHECK(out.result == EV_OK && out.len == UNFRAMED_BODY);
+
+    CHECK(start(loop, "GET", "/bye", NULL, 5000, &out) == 0);
+    run_until(loop, &out);
+    CHECK(out.result == EV_OK && strcmp(out.first, "bye") == 0);
+}
+
+static void test_timeout_and_stale(EvLoop *loop)
+{
+    Out out;
+    long connects;
+
+    CHECK(start(loop, "GET", "/hang", NULL, 200, &out) == 0);
+    run_until(loop, &out);
+    CHECK(out.result == EV_ERR_TIMEOUT);
+
+    /* The kept socket dies while idle; the request goes again on a new one */
+    CHECK(start(loop, "GET", "/drop", NULL, 5000, &out) == 0);
+    run_until(loop, &out);
+    CHECK(out.result == EV_OK);
+    usleep(50000);
+    connects = loop->connects;
+    CHECK(start(loop, "GET", "/a", NULL, 5000, &out) == 0);
+    run_until(loop, &out);
+    CHECK(out.result == EV_OK && strcmp(out.first, "{\"ok\":true}") == 0);
+    CHECK(loop->connects == connects + 1);
+
+    /* A POST with no reply on the kept socket may have been done: not resent */
+    CHECK(start(loop, "POST", "/hangup", "{}", 5000, &out) == 0);
+    run_until(loop, &out);
+    CHECK(out.result == EV_ERR_NO_BODY);
+    usleep(50000);
+    CHECK(wait_for(&s_hung_posts, 1) == 1);
+}
+
+static void test_full_loop(EvLoop *loop)
+{
+    Out many[EV_MAX_REQUESTS];
+    Out extra;
+    char expect[8];
+    int i;
+
+    for (i = 0; i < EV_MAX_REQUESTS; i++) {
+        CHECK(start(loop, "GET", "/gate", NULL, 10000, &many[i]) == 0);
+    }
+    CHECK(ev_room(loop) == 0);
+    CHECK(start(loop, "GET", "/a", NULL, 5000, &extra) == -1);
+    while (ev_run(loop, 1000) > 0) {
+    }
+
+    /* Every one was at the server before any was answered */
+    snprintf(expect, sizeof(expect), "%d", EV_MAX_REQUESTS);
+    for (i = 0; i < EV_MAX_REQUESTS; i++) {
+        CHECK(many[i].result == EV_OK && strcmp(many[i].first, expect) == 0);
+    }
+    CHECK(extra.done == 0);
+    CHECK(ev_room(loop) == EV_MAX_REQUESTS);
+}
+
+static void test_abort_and_refused(EvLoop *loop)
+{
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int sock;
+    Out out;
+
+    CHECK(start(loop, "GET", "/hang", NULL, 5000, &out) == 0);
+    ev_run(loop, 50);
+    ev_close(loop);
+    CHECK(out.done && out.result == EV_ERR_ABORTED);
+    CHECK(ev_active(loop) == 0);
+
+    /* A port that was free a moment ago refuses the connection */
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+    getsockname(sock, (struct sockaddr *)&addr, &addr_len);
+    close(sock);
+
+    ev_init(loop, "127.0.0.1", ntohs(addr.sin_port), 1024);
+    CHECK(start(loop, "GET", "/", NULL, 5000, &out) == 0);
+    run_until(loop, &out);
+    CHECK(out.result == EV_ERR_CONNECT);
+    ev_close(loop);
+}
+
+static void test_http_async(int port)
+{
+    EvLoop loop;
+    Out get;
+    Out post;
+    Out err;
+    cJSON *json = cJSON_CreateObject();
+
+    cJSON_AddStringToObject(json, "text", "dir \"C:\\\"\r\n");
+    ev_init(&loop, "127.0.0.1", port, 1024);
+
+    memset(&get, 0, sizeof(get));
+    memset(&post, 0, sizeof(post));
+    memset(&err, 0, sizeof(err));
+    CHECK(http_request_async(&loop, "GET", "/a", NULL, 0, on_http_done,
+                             &get) == HTTP_OK);
+    CHECK(http_post_json_async(&loop, "/input", json, on_http_done, &post) ==
+          HTTP_OK);
+    CHECK(http_request_async(&loop, "GET", "/err", NULL, 0, on_http_done,
+                             &err) == HTTP_OK);
+    while (ev_run(&loop, 1000) > 0) {
+    }
+
+    CHECK(get.http_result == HTTP_OK &&
+          strcmp(get.first, "{\"ok\":true}") == 0);
+    CHECK(post.http_result == HTTP_OK);
+    CHECK(strncmp(post.first, "posted:", 7) == 0 &&
+          atoi(post.first + 7) == (int)jw_measure(json));
+    CHECK(err.http_result == HTTP_ERR_SERVER && err.len == 0);
+
+    ev_close(&loop);
+    cJSON_Delete(json);
+}
+
+int main(void)
+{
+    EvLoop loop;
+    int port;
+    size_t i;
+
+    for (i = 0; i < BIG_BODY; i++) {
+        s_big[i] = (char)('a' + i % 26);
+    }
+
+    port = loopback_start(handler);
+    CHECK(port > 0);
+    strcpy(g_state.server_ip, "127.0.0.1");
+    g_state.server_port = port;
+    g_state.max_response_kb = MAX_RESPONSE_KB;
+
+    sched_init();
+    http_init();
+
+    test_parse_head();
+    ev_init(&loop, "127.0.0.1", port, 1024 * 1024);
+    test_overlap(&loop);
+    test_bodies(&loop);
+    test_timeout_and_stale(&loop);
+    test_full_loop(&loop);
+    test_abort_and_refused(&loop);
+    test_http_async(port);
+
+    http_cleanup();
+    sched_cleanup();
+    loopback_stop();
+    return test_result("test_evloop");
+}
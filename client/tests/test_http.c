@@ -0,0 +1,214 @@
+/*
+ * test_http.c - http.c against a loopback server: kept-alive connections,
+ * streamed and heap-sized bodies, unframed replies, stale sockets and
+ * requests that must not be sent twice
+ */
+
+#include "../http.h"
+#include "../sched.h"
+#include "loopback.h"
+#include "test.h"
+
+ClientState g_state;
+
+#define BIG_BODY 200000
+#define UNFRAMED_BODY 50000
+
+static char s_big[BIG_BODY];
+static volatile int s_hung_posts = 0;
+
+static int handler(int fd, const char *method, const char *path,
+                   const char *body, size_t body_len)
+{
+    static char unframed[UNFRAMED_BODY];
+
+    if (strcmp(method, "POST") == 0 && strcmp(path, "/hangup") == 0) {
+        /* Acted on, then the connection drops before any reply */
+        s_hung_posts++;
+        return 1;
+    } else if (strcmp(method, "POST") == 0) {
+        loopback_reply(fd, 200, body, body_len, (long)body_len, 0);
+    } else if (strcmp(path, "/big") == 0) {
+        loopback_reply(fd, 200, s_big, BIG_BODY, BIG_BODY, 0);
+    } else if (strcmp(path, "/err") == 0) {
+        loopback_reply(fd, 500, "{\"error\":\"nope\"}", 16, 16, 0);
+    } else if (strcmp(path, "/unframed") == 0) {
+        memset(unframed, 'y', sizeof(unframed));
+        loopback_reply(fd, 200, unframed, sizeof(unframed), -1, 1);
+        return 1;
+    } else if (strcmp(path, "/bye") == 0) {
+        loopback_reply(fd, 200, "bye", 3, 3, 1);
+        return 1;
+    } else if (strcmp(path, "/drop") == 0) {
+        /* Looks kept alive, but the server hangs up straight after */
+        loopback_reply(fd, 200, "{}", 2, 2, 0);
+        return 1;
+    } else {
+        loopback_reply(fd, 200, "{\"ok\":true}", 11, 11, 0);
+    }
+    return 0;
+}
+
+typedef struct {
+    long announced;
+    size_t received;
+    size_t largest_write;
+    int in_order;
+} CountSink;
+
+static HttpResult count_begin(void *ctx, long content_length)
+{
+    ((CountSink *)ctx)->announced = content_length;
+    return HTTP_OK;
+}
+
+static HttpResult count_write(void *ctx, const char *data, size_t len)
+{
+    CountSink *sink = (CountSink *)ctx;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        if (data[i] != s_big[sink->received + i]) {
+            sink->in_order = 0;
+        }
+    }
+    sink->received += len;
+    if (len > sink->largest_write) {
+        sink->largest_write = len;
+    }
+    return HTTP_OK;
+}
+
+static void test_keep_alive(void)
+{
+    char small[64];
+    long connects;
+    long reuses;
+    int i;
+
+    for (i = 0; i < 5; i++) {
+        CHECK(http_request("GET", "/a", NULL, small, sizeof(small)) ==
+              HTTP_OK);
+        CHECK(strcmp(small, "{\"ok\":true}") == 0);
+    }
+    http_get_stats(&connects, &reuses);
+    CHECK(connects == 1 && reuses == 4);
+    CHECK(loopback_connections() == 1);
+
+    /* Connection: close is honoured, and the next call reconnects */
+    CHECK(http_request("GET", "/bye", NULL, small, sizeof(small)) ==
+          HTTP_OK);
+    CHECK(strcmp(small, "bye") == 0);
+    CHECK(http_request("GET", "/a", NULL, small, sizeof(small)) == HTTP_OK);
+    http_get_stats(&connects, &reuses);
+    CHECK(connects == 2);
+}
+
+static void test_stale_socket(void)
+{
+    char small[64];
+    long before;
+    long connects;
+    long reuses;
+
+    CHECK(http_request("GET", "/drop", NULL, small, sizeof(small)) ==
+          HTTP_OK);
+    usleep(50000);
+    http_get_stats(&before, &reuses);
+
+    /* The kept socket is dead; the request goes again on a new one */
+    CHECK(http_request("GET", "/a", NULL, small, sizeof(small)) == HTTP_OK);
+    CHECK(strcmp(small, "{\"ok\":true}") == 0);
+    http_get_stats(&connects, &reuses);
+    CHECK(connects == before + 1);
+}
+
+static void test_no_reply_post(void)
+{
+    char small[64];
+
+    /* On a kept socket, so the missing reply looks like a stale one */
+    CHECK(http_request("GET", "/a", NULL, small, sizeof(small)) == HTTP_OK);
+
+    /* The server may have done it: not sent again, the caller decides */
+    CHECK(http_request("POST", "/hangup", "{}", small, sizeof(small)) ==
+          HTTP_ERR_NO_BODY);
+    usleep(50000);
+    CHECK(s_hung_posts == 1);
+
+    CHECK(http_request("GET", "/a", NULL, small, sizeof(small)) == HTTP_OK);
+}
+
+static void test_bodies(void)
+{
+    char small[64];
+    char *heap = NULL;
+    size_t len = 0;
+    CountSink counted = {0, 0, 0, 1};
+    HttpBodySink sink;
+
+    /* A fixed buffer refuses what doesn't fit rather than truncating it */
+    CHECK(http_request("GET", "/big", NULL, small, sizeof(small)) ==
+          HTTP_ERR_RESPONSE_TOO_LARGE);
+
+    CHECK(http_request_alloc("GET", "/big", NULL, 0, &heap, &len) ==
+          HTTP_OK);
+    CHECK(len == BIG_BODY && heap && memcmp(heap, s_big, BIG_BODY) == 0 &&
+          heap[BIG_BODY] == '\0');
+    free(heap);
+
+    /* Streamed in chunks; nothing close to the body is buffered */
+    sink.begin = count_begin;
+    sink.write = count_write;
+    sink.ctx = &counted;
+    CHECK(http_request_sink("GET", "/big", NULL, 0, &sink) == HTTP_OK);
+    CHECK(counted.announced == BIG_BODY && counted.received == BIG_BODY);
+    CHECK(counted.in_order && counted.largest_write <= HTTP_CHUNK_SIZE);
+
+    g_state.max_response_kb = 100;
+    heap = NULL;
+    CHECK(http_request_alloc("GET", "/big", NULL, 0, &heap, &len) ==
+          HTTP_ERR_RESPONSE_TOO_LARGE);
+    CHECK(heap == NULL);
+    g_state.max_response_kb = MAX_RESPONSE_KB;
+
+    /* No Content-Length: read to the close, growing the buffer */
+    CHECK(http_request_alloc("GET", "/unframed", NULL, 0, &heap, &len) ==
+          HTTP_OK);
+    CHECK(len == UNFRAMED_BODY && heap && heap[0] == 'y' &&
+          heap[len - 1] == 'y');
+    free(heap);
+
+    CHECK(http_request("GET", "/err", NULL, small, sizeof(small)) ==
+          HTTP_ERR_SERVER);
+    CHECK(http_request("GET", "/a", NULL, small, sizeof(small)) == HTTP_OK);
+}
+
+int main(void)
+{
+    int port;
+    size_t i;
+
+    for (i = 0; i < BIG_BODY; i++) {
+        s_big[i] = (char)('a' + i % 26);
+    }
+
+    port = loopback_start(handler);
+    CHECK(port > 0);
+    strcpy(g_state.server_ip, "127.0.0.1");
+    g_state.server_port = port;
+    g_state.max_response_kb = MAX_RESPONSE_KB;
+
+    sched_init();
+    http_init();
+
+    test_keep_alive();
+    test_stale_socket();
+    test_no_reply_post();
+    test_bodies();
+
+    http_cleanup();
+    sched_cleanup();
+    loopback_stop();
+    return test_result("test_http");
+}
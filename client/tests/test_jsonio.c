@@ -0,0 +1,276 @@
+/*
+ * test_jsonio.c - jw_* and jr_* against cJSON on what the handlers send
+ * and receive
+ *
+ * The writer must print exactly what cJSON_PrintUnformatted prints for
+ * the results the handlers build, and the reader must find the same
+ * values cJSON_Parse does in /sync replies as System.Text.Json writes
+ * them: \uXXXX for quotes, HTML characters and anything past ASCII.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../jsonio.h"
+#include "test.h"
+
+#define BIG_TEXT (3 * JW_BUFFER_SIZE + 123)
+
+/* A /sync reply as the server sends it, with a write waiting */
+static const char SYNC_WRITE[] =
+    "{\"output\":\"Writing \\u0022MAIN.C\\u0022 \\u2014 done\\r\\n\","
+    "\"status\":\"running\",\"turn_state\":\"tool_running\",\"turn_seq\":3,"
+    "\"file_op\":{\"has_pending\":true,\"op_id\":\"20260101120000-0002\","
+    "\"operation\":\"write\",\"path\":\"C:\\\\PROJECTS\\\\MAIN.C\","
+    "\"content\":\"#include \\u003Cstdio.h\\u003E\\r\\nint main(void) "
+    "{ puts(\\u0022caf\\u00E9 \\uD83D\\uDE00\\\\n\\u0022); return 0; }"
+    "\\r\\n\\t/* a \\u0026 b */\\r\\n\"},"
+    "\"command\":{\"has_pending\":true,\"cmd_id\":\"20260101120000-0001\","
+    "\"command\":\"wmake \\u002B all\",\"working_directory\":\"C:\\\\PROJECTS\"},"
+    "\"approval\":{\"has_pending\":false}}";
+
+/* The same shape, nothing waiting, with the spacing of a hand edit */
+static const char SYNC_IDLE[] =
+    " {\n  \"output\" : \"\",\n  \"status\" : \"idle\",\n"
+    "  \"file_op\" : { \"has_pending\" : false },\n"
+    "  \"command\" : { \"has_pending\" : false, \"note\" : \"{\\\"op_id\\\"}\" },\n"
+    "  \"turn_seq\" : -1\n} ";
+
+static char s_out[1 << 16];
+static char s_big[BIG_TEXT + 1];
+
+static const char *print_jw(const cJSON *item, size_t *len)
+{
+    JsonBuffer jb;
+    JsonWriter w;
+
+    jb.buf = s_out;
+    jb.size = sizeof(s_out);
+    jb.len = 0;
+    jw_init(&w, jw_buffer_sink, &jb);
+    jw_value(&w, item);
+    CHECK(jw_finish(&w) == 0);
+    *len = jb.len;
+    return s_out;
+}
+
+/* jw prints item byte for byte as cJSON does, and measures it right */
+static void check_same_print(const char *name, cJSON *item)
+{
+    char *expect = cJSON_PrintUnformatted(item);
+    size_t len;
+    const char *got = print_jw(item, &len);
+
+    if (strcmp(expect, got) != 0) {
+        fprintf(stderr, "%s: cJSON and jw differ\n  %s\n  %s\n", name, expect,
+                got);
+        test_failures++;
+    }
+    CHECK(len == strlen(expect));
+    CHECK(jw_measure(item) == strlen(expect));
+    free(expect);
+    cJSON_Delete(item);
+}
+
+static void fill_text(char *dst, size_t len)
+{
+    static const char line[] =
+        "C:\\PROJECTS> wmake \"all\"\r\n\tcl386 /c main.c\x01\x1f \xe9\r\n";
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        dst[i] = line[i % (sizeof(line) - 1)];
+    }
+    dst[len] = '\0';
+}
+
+static void test_writer(void)
+{
+    cJSON *result;
+    cJSON *entries;
+    cJSON *entry;
+
+    /* run_command's result; stdout crosses several writer buffers */
+    result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "command_id", "20260101120000-0001");
+    cJSON_AddStringToObject(result, "stdout", s_big);
+    cJSON_AddStringToObject(result, "stderr", "");
+    cJSON_AddNumberToObject(result, "exit_code", -1);
+    check_same_print("command result", result);
+
+    /* handle_list_directory */
+    result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "op_id", "20260101120000-0002");
+    cJSON_AddTrueToObject(result, "success");
+    entries = cJSON_CreateArray();
+    entry = cJSON_CreateObject();
+    cJSON_AddStringToObject(entry, "name", "MAIN.C");
+    cJSON_AddStringToObject(entry, "type", "file");
+    cJSON_AddNumberToObject(entry, "size", 4294967295.0);
+    cJSON_AddItemToArray(entries, entry);
+    entry = cJSON_CreateObject();
+    cJSON_AddStringToObject(entry, "name", "SUB DIR");
+    cJSON_AddStringToObject(entry, "type", "dir");
+    cJSON_AddNumberToObject(entry, "size", 0);
+    cJSON_AddItemToArray(entries, entry);
+    cJSON_AddItemToObject(result, "entries", entries);
+    cJSON_AddItemToObject(result, "empty", cJSON_CreateArray());
+    check_same_print("directory listing", result);
+
+    /* A failed write, and the odd values cJSON can hold */
+    result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "op_id", "x");
+    cJSON_AddFalseToObject(result, "success");
+    cJSON_AddStringToObject(result, "error", "Could not create file");
+    cJSON_AddNullToObject(result, "content");
+    cJSON_AddNumberToObject(result, "ratio", 0.1);
+    cJSON_AddNumberToObject(result, "huge", 1e300);
+    cJSON_AddNumberToObject(result, "negative", -1.5);
+    cJSON_AddItemToObject(result, "nested", cJSON_CreateObject());
+    check_same_print("error result", result);
+
+    /* What /sync round-trips through the parser, printed back */
+    check_same_print("sync reply", cJSON_Parse(SYNC_WRITE));
+}
+
+/* Every string and number jr finds in text matches what cJSON finds */
+static void check_same_read(const char *name, const char *fixture,
+                            const char *object, const char **keys)
+{
+    size_t len = strlen(fixture);
+    char *text = (char *)malloc(len + 1);
+    cJSON *json = cJSON_Parse(fixture);
+    const cJSON *parent = object ? cJSON_GetObjectItem(json, object) : json;
+    JsonSpan root;
+    JsonSpan obj;
+    JsonSpan v;
+    char buf[1024];
+
+    memcpy(text, fixture, len + 1);
+    CHECK(json != NULL);
+    CHECK(jr_root(text, len, &root) == 0);
+    obj = root;
+    if (object) {
+        CHECK(jr_get(&root, object, &obj) == 0);
+    }
+
+    for (; *keys; keys++) {
+        const cJSON *item = cJSON_GetObjectItem(parent, *keys);
+
+        if (jr_get(&obj, *keys, &v) != 0) {
+            fprintf(stderr, "%s: %s not found\n", name, *keys);
+            test_failures++;
+            continue;
+        }
+        if (cJSON_IsString(item)) {
+            CHECK(jr_is_string(&v));
+            CHECK(jr_string(&v, buf, sizeof(buf)) ==
+                  (long)strlen(item->valuestring));
+            if (strcmp(buf, item->valuestring) != 0) {
+                fprintf(stderr, "%s: %s differs\n  %s\n  %s\n", name, *keys,
+                        item->valuestring, buf);
+                test_failures++;
+            }
+            CHECK(jr_string_eq(&v, item->valuestring));
+        } else if (cJSON_IsNumber(item)) {
+            CHECK(jr_long(&v, 12345) == (long)item->valueint);
+        } else if (cJSON_IsBool(item)) {
+            CHECK(jr_is_true(&v) == cJSON_IsTrue(item));
+        } else {
+            fprintf(stderr, "%s: %s has no counterpart\n", name, *keys);
+            test_failures++;
+        }
+    }
+
+    cJSON_Delete(json);
+    free(text);
+}
+
+static void test_reader(void)
+{
+    static const char *top[] = {"output", "status", "turn_state", "turn_seq",
+                                NULL};
+    static const char *file_op[] = {"has_pending", "op_id", "operation",
+                                    "path", "content", NULL};
+    static const char *command[] = {"has_pending", "cmd_id", "command",
+                                    "working_directory", NULL};
+    static const char *idle[] = {"output", "status", "turn_seq", NULL};
+    static const char *idle_command[] = {"has_pending", "note", NULL};
+
+    check_same_read("sync", SYNC_WRITE, NULL, top);
+    check_same_read("sync file_op", SYNC_WRITE, "file_op", file_op);
+    check_same_read("sync command", SYNC_WRITE, "command", command);
+    check_same_read("idle", SYNC_IDLE, NULL, idle);
+    check_same_read("idle command", SYNC_IDLE, "command", idle_command);
+}
+
+/* parse_sync's path: content to a file, the op blanked, the rest parsed */
+static void test_sync_handoff(void)
+{
+    size_t len = sizeof(SYNC_WRITE) - 1;
+    char *text = (char *)malloc(len + 1);
+    cJSON *expect = cJSON_Parse(SYNC_WRITE);
+    const char *content = cJSON_GetObjectItem(
+        cJSON_GetObjectItem(expect, "file_op"), "content")->valuestring;
+    JsonSpan root;
+    JsonSpan op;
+    JsonSpan v;
+    char small[8];
+    char file_text[1024];
+    FILE *fp = tmpfile();
+    long written;
+    cJSON *rest;
+
+    memcpy(text, SYNC_WRITE, len + 1);
+    CHECK(jr_root(text, len, &root) == 0);
+    CHECK(jr_get(&root, "file_op", &op) == 0);
+    CHECK(jr_get(&op, "content", &v) == 0);
+    CHECK(jr_get(&op, "missing", &v) == -1 && jr_get(&op, "content", &v) == 0);
+
+    /* Too small is refused, not cut short */
+    CHECK(jr_string(&v, small, sizeof(small)) == -1);
+
+    written = jr_string_to_file(&v, fp);
+    CHECK(written == (long)strlen(content));
+    rewind(fp);
+    CHECK(fread(file_text, 1, sizeof(file_text), fp) == (size_t)written);
+    CHECK(memcmp(file_text, content, (size_t)written) == 0);
+    fclose(fp);
+
+    jr_blank(&op);
+    rest = cJSON_Parse(text);
+    CHECK(rest != NULL);
+    CHECK(cJSON_GetObjectItem(rest, "file_op")->child == NULL);
+    CHECK(strcmp(cJSON_GetObjectItem(rest, "output")->valuestring,
+                 cJSON_GetObjectItem(expect, "output")->valuestring) == 0);
+    CHECK(strcmp(cJSON_GetObjectItem(cJSON_GetObjectItem(rest, "command"),
+                                     "command")->valuestring,
+                 "wmake + all") == 0);
+    cJSON_Delete(rest);
+
+    /* In place, over the text's own bytes */
+    memcpy(text, SYNC_WRITE, len + 1);
+    CHECK(jr_root(text, len, &root) == 0 && jr_get(&root, "output", &v) == 0);
+    CHECK(strcmp(jr_string_inplace(&v),
+                 cJSON_GetObjectItem(expect, "output")->valuestring) == 0);
+
+    /* A key that only appears inside a string is not a member */
+    memcpy(text, SYNC_IDLE, sizeof(SYNC_IDLE));
+    CHECK(jr_root(text, sizeof(SYNC_IDLE) - 1, &root) == 0);
+    CHECK(jr_get(&root, "op_id", &v) == -1);
+    CHECK(jr_get(&root, "file_op", &op) == 0);
+    CHECK(jr_get(&op, "has_pending", &v) == 0 && !jr_is_true(&v));
+
+    cJSON_Delete(expect);
+    free(text);
+}
+
+int main(void)
+{
+    fill_text(s_big, BIG_TEXT);
+
+    test_writer();
+    test_reader();
+    test_sync_handoff();
+
+    return test_result("test_jsonio");
+}
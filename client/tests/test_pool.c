@@ -0,0 +1,203 @@
+/*
+ * test_pool.c - pool.c under its budget: refusals, halving, the cache,
+ * sizes past the largest class, and buffers that change threads
+ */
+
+#include <pthread.h>
+#include "../pool.h"
+#include "../util.h"
+#include "test.h"
+
+#define BUDGET_KB 64
+#define HEADER 32
+
+static int s_errors = 0;
+
+void log_error(const char *context, const char *message)
+{
+    (void)context;
+    (void)message;
+    s_errors++;
+}
+
+static PoolStats stats(void)
+{
+    PoolStats st;
+
+    pool_get_stats(&st);
+    return st;
+}
+
+static void test_budget(void)
+{
+    char *small;
+    char *mid;
+    char *big;
+    char *rest[64];
+    size_t size;
+    PoolStats st;
+    int n;
+
+    /* Sizes round up to a power of two: 1 KB and 32 KB of 64 KB */
+    small = pool_get(1000);
+    mid = pool_get(30000);
+    CHECK(small && mid);
+    st = stats();
+    CHECK(st.budget == BUDGET_KB * 1024L);
+    CHECK(st.in_use >= 33 * 1024L && st.in_use <= 33 * 1024L + 2 * HEADER);
+
+    /* The next 64 KB class would pass the budget, so it is refused */
+    CHECK(pool_get(40000) == NULL);
+    CHECK(stats().denied == 1);
+
+    /* Halved until it fits: 40000 and 20000 won't, 10000 (16 KB) will */
+    size = 40000;
+    big = pool_get_upto(&size);
+    CHECK(big != NULL && size == 10000);
+
+    /* Take what is left; halving stops at the smallest class */
+    for (n = 0; n < 64; n++) {
+        size = 40000;
+        rest[n] = pool_get_upto(&size);
+        if (!rest[n]) {
+            break;
+        }
+    }
+    CHECK(n > 0 && n < 64 && size == POOL_MIN_SIZE);
+    st = stats();
+    CHECK(st.in_use <= st.budget && st.in_use > st.budget - 2 * 1024L);
+
+    while (n > 0) {
+        pool_put(rest[--n]);
+    }
+    pool_put(small);
+    pool_put(mid);
+    pool_put(big);
+    st = stats();
+    CHECK(st.in_use == 0);
+    CHECK(st.cached > 0 && st.cached <= st.budget);
+    CHECK(st.peak <= st.budget);
+}
+
+static void test_cache(void)
+{
+    char *bufs[POOL_KEEP + 1];
+    char *again;
+    PoolStats st;
+    int i;
+
+    /* From an empty cache */
+    pool_cleanup();
+    pool_init(BUDGET_KB);
+    pool_put(pool_get(30000));
+    st = stats();
+
+    /* A cached block of the right class comes back without a new one */
+    again = pool_get(20000);
+    CHECK(again != NULL);
+    CHECK(stats().cached < st.cached);
+    pool_put(again);
+    CHECK(stats().cached == st.cached);
+
+    /* At most POOL_KEEP per class are kept */
+    st = stats();
+    for (i = 0; i <= POOL_KEEP; i++) {
+        bufs[i] = pool_get(2000);
+        CHECK(bufs[i] != NULL);
+    }
+    for (i = 0; i <= POOL_KEEP; i++) {
+        pool_put(bufs[i]);
+    }
+    CHECK(stats().in_use == 0);
+    CHECK(stats().cached - st.cached > (POOL_KEEP - 1) * 2048L &&
+          stats().cached - st.cached <= POOL_KEEP * (2048L + HEADER));
+
+    /* The cached 32 KB block is freed to make room for three of 16 KB */
+    CHECK(stats().cached > 32 * 1024L);
+    for (i = 0; i <= POOL_KEEP; i++) {
+        bufs[i] = pool_get(12000);
+        CHECK(bufs[i] != NULL);
+    }
+    st = stats();
+    CHECK(st.in_use + st.cached <= st.budget && st.cached < 16 * 1024L);
+    for (i = 0; i <= POOL_KEEP; i++) {
+        pool_put(bufs[i]);
+    }
+    pool_put(NULL);
+}
+
+static void test_past_largest_class(void)
+{
+    size_t largest = (size_t)POOL_MIN_SIZE << (POOL_CLASSES - 1);
+    char *buf;
+    PoolStats st;
+
+    /* Within budget, a size past the classes is a plain malloc'd block */
+    pool_cleanup();
+    pool_init((int)(largest * 4 / 1024));
+    buf = pool_get(largest + 1);
+    CHECK(buf != NULL);
+    memset(buf, 'x', largest + 1);
+    st = stats();
+    CHECK(st.in_use >= (long)(largest + 1));
+
+    /* ...and it goes straight back to the heap, never into the cache */
+    pool_put(buf);
+    st = stats();
+    CHECK(st.in_use == 0 && st.cached == 0);
+
+    pool_cleanup();
+    pool_init(BUDGET_KB);
+}
+
+static void *take_buffer(void *arg)
+{
+    *(char **)arg = pool_get(4000);
+    return NULL;
+}
+
+static void test_threads(void)
+{
+    pthread_t thread;
+    char *buf = NULL;
+    PoolStats st;
+
+    pthread_create(&thread, NULL, take_buffer, &buf);
+    pthread_join(thread, NULL);
+    CHECK(buf != NULL);
+    st = stats();
+    CHECK(st.other_threads > 0 && st.main_thread == 0);
+
+    /* Handed over: charged to this thread, and put back without a fuss */
+    pool_adopt(buf);
+    st = stats();
+    CHECK(st.other_threads == 0 && st.main_thread == st.in_use);
+    pool_put(buf);
+    CHECK(s_errors == 0);
+
+    /* Not handed over: the put still works but is reported */
+    pthread_create(&thread, NULL, take_buffer, &buf);
+    pthread_join(thread, NULL);
+    pool_put(buf);
+    CHECK(s_errors == 1);
+    CHECK(stats().in_use == 0);
+}
+
+int main(void)
+{
+    PoolStats st;
+
+    /* Before init nothing is handed out */
+    CHECK(pool_get(100) == NULL);
+    pool_get_stats(&st);
+    CHECK(st.budget == 0);
+
+    pool_init(BUDGET_KB);
+    test_budget();
+    test_cache();
+    test_past_largest_class();
+    test_threads();
+    pool_cleanup();
+
+    return test_result("test_pool");
+}
@@ -0,0 +1,204 @@
+/*
+ * test_ring.c - ring.c with a real writer thread and reader thread
+ *
+ * The single-threaded cases pin down a full ring and the wrap marker. The
+ * stress run then pushes a long stream through small rings with the
+ * writer and reader racing: every byte carries its offset in the stream,
+ * so a segment read before the writer finished it, or read twice, or
+ * skipped, shows up as a wrong byte.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../ring.h"
+#include "test.h"
+
+#define STREAM_BYTES (64L * 1024 * 1024)
+#define MAX_CHUNK 70000
+
+static OutputRing s_ring;
+
+static char expect(long offset)
+{
+    return (char)('a' + (offset * 7 + offset / 13) % 26);
+}
+
+static void test_full(void)
+{
+    static char mem[256];
+    size_t taken[64];
+    size_t n;
+    const char *seg;
+    int written = 0;
+    int read = 0;
+
+    ring_init(&s_ring, mem, sizeof(mem));
+    CHECK(ring_peek(&s_ring) == NULL);
+
+    /* Ten bytes at a time, the last perhaps cut short, until turned away */
+    while ((n = ring_write(&s_ring, "0123456789", 10)) > 0 && written < 64) {
+        taken[written++] = n;
+    }
+    CHECK(written > 1 && written * 16 <= (int)sizeof(mem));
+    CHECK(s_ring.stalls == 1);
+
+    /* Full stays full, and a full ring does not look empty */
+    CHECK(ring_write(&s_ring, "x", 1) == 0);
+    CHECK(s_ring.stalls == 2);
+    CHECK(ring_peek(&s_ring) != NULL);
+
+    while ((seg = ring_peek(&s_ring)) != NULL && read < written) {
+        CHECK(strlen(seg) == taken[read] &&
+              strncmp(seg, "0123456789", taken[read]) == 0);
+        ring_release(&s_ring);
+        read++;
+    }
+    CHECK(read == written && ring_peek(&s_ring) == NULL);
+
+    /* Drained, it takes text again */
+    CHECK(ring_write(&s_ring, "again", 5) == 5);
+    CHECK(strcmp(ring_peek(&s_ring), "again") == 0);
+    ring_release(&s_ring);
+    CHECK(ring_peek(&s_ring) == NULL);
+}
+
+static void test_wrap(void)
+{
+    static char mem[128];
+    char text[40];
+    const char *seg;
+
+    memset(text, 'a', sizeof(text));
+    ring_init(&s_ring, mem, sizeof(mem));
+
+    /* Two segments of 4 + 44 bytes leave 32 at the end */
+    CHECK(ring_write(&s_ring, text, 40) == 40);
+    text[0] = 'b';
+    CHECK(ring_write(&s_ring, text, 40) == 40);
+    seg = ring_peek(&s_ring);
+    CHECK(seg == mem + 4 && seg[0] == 'a');
+    ring_release(&s_ring);
+
+    /* 30 bytes don't fit in the tail but do at the front: a wrap marker */
+    text[0] = 'c';
+    CHECK(ring_write(&s_ring, text, 30) == 30);
+    CHECK(s_ring.write_pos < s_ring.read_pos);
+
+    seg = ring_peek(&s_ring);
+    CHECK(seg == mem + 48 + 4 && seg[0] == 'b' && strlen(seg) == 40);
+    ring_release(&s_ring);
+
+    /* The reader follows the marker back to the start */
+    seg = ring_peek(&s_ring);
+    CHECK(seg == mem + 4 && seg[0] == 'c' && strlen(seg) == 30);
+    ring_release(&s_ring);
+    CHECK(ring_peek(&s_ring) == NULL);
+    CHECK(s_ring.read_pos == s_ring.write_pos);
+
+    /* Text longer than the room is split, never dropped */
+    memset(text, 'd', sizeof(text));
+    CHECK(ring_write(&s_ring, text, 40) == 40);
+    CHECK(ring_write(&s_ring, text, 40) > 0);
+}
+
+static void *writer_main(void *arg)
+{
+    static char chunk[MAX_CHUNK];
+    unsigned seed = 1;
+    long sent = 0;
+
+    (void)arg;
+    while (sent < STREAM_BYTES) {
+        size_t len = (size_t)(rand_r(&seed) % 5000) + 1;
+        size_t off = 0;
+        size_t i;
+
+        /* Now and then a chunk much larger than the ring */
+        if (rand_r(&seed) % 50 == 0) {
+            len = MAX_CHUNK - 1;
+        }
+        if (sent + (long)len > STREAM_BYTES) {
+            len = (size_t)(STREAM_BYTES - sent);
+        }
+        for (i = 0; i < len; i++) {
+            chunk[i] = expect(sent + (long)i);
+        }
+        while (off < len) {
+            size_t n = ring_write(&s_ring, chunk + off, len - off);
+
+            if (n == 0) {
+                sched_yield();
+            }
+            off += n;
+        }
+        sent += (long)len;
+    }
+    return NULL;
+}
+
+static void stress(size_t size)
+{
+    char *mem = (char *)malloc(size);
+    pthread_t writer;
+    long got = 0;
+    long segments = 0;
+    long wraps = 0;
+    long bad = -1;
+    const char *last = NULL;
+
+    ring_init(&s_ring, mem, size);
+    pthread_create(&writer, NULL, writer_main, NULL);
+
+    while (got < STREAM_BYTES) {
+        const char *seg = ring_peek(&s_ring);
+        size_t len;
+        size_t i;
+
+        if (!seg) {
+            sched_yield();
+            continue;
+        }
+        if (last && seg < last) {
+            wraps++;
+        }
+        last = seg;
+
+        /* Length from the header, text up to the NUL: both must agree */
+        len = strlen(seg);
+        if (len == 0 || *(const LONG *)(seg - sizeof(LONG)) != (LONG)len + 1) {
+            bad = got;
+        }
+        for (i = 0; i < len && bad < 0; i++) {
+            if (seg[i] != expect(got + (long)i)) {
+                bad = got + (long)i;
+            }
+        }
+        got += (long)len;
+        segments++;
+        ring_release(&s_ring);
+    }
+
+    pthread_join(writer, NULL);
+    if (bad >= 0) {
+        fprintf(stderr, "ring of %lu: wrong byte at %ld\n",
+                (unsigned long)size, bad);
+        test_failures++;
+    }
+    CHECK(ring_peek(&s_ring) == NULL);
+    CHECK(wraps > 0 && s_ring.stalls > 0);
+    printf("ring of %lu: %ld segments, %ld wraps, %ld stalls\n",
+           (unsigned long)size, segments, wraps, s_ring.stalls);
+    free(mem);
+}
+
+int main(void)
+{
+    test_full();
+    test_wrap();
+    stress(1024);
+    stress(32768);
+
+    return test_result("test_ring");
+}
@@ -0,0 +1,169 @@
+/*
+ * windows.h - The Win32 calls the client uses, mapped onto POSIX
+ *
+ * Only for building client modules into the host tests on Linux. Sockets
+ * are BSD sockets already; threads, locks, events and TLS map onto
+ * pthreads, and Interlocked* onto GCC atomics.
+ */
+
+#ifndef TESTS_WIN32_WINDOWS_H
+#define TESTS_WIN32_WINDOWS_H
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef int BOOL;
+typedef void *HANDLE;
+typedef const char *LPCSTR;
+typedef int SOCKET;
+typedef unsigned long u_long;
+typedef pthread_mutex_t CRITICAL_SECTION;
+typedef struct {
+    int unused;
+} WSADATA;
+
+#define TRUE 1
+#define FALSE 0
+#define INFINITE 0xFFFFFFFFu
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define TLS_OUT_OF_INDEXES ((DWORD)0xFFFFFFFF)
+
+#define closesocket close
+#define ioctlsocket ioctl
+#define WSAGetLastError() errno
+#define WSAEWOULDBLOCK EINPROGRESS
+#define WSAStartup(v, d) ((void)(v), (void)(d), 0)
+#define WSACleanup() 0
+#define MAKEWORD(a, b) ((a) | ((b) << 8))
+
+#define InitializeCriticalSection(c) pthread_mutex_init((c), NULL)
+#define DeleteCriticalSection(c) pthread_mutex_destroy(c)
+#define EnterCriticalSection(c) pthread_mutex_lock(c)
+#define LeaveCriticalSection(c) pthread_mutex_unlock(c)
+
+#define InterlockedIncrement(p) __atomic_add_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define InterlockedDecrement(p) __atomic_sub_fetch((p), 1, __ATOMIC_SEQ_CST)
+#define InterlockedExchange(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define InterlockedExchangeAdd(p, v) \
+    __atomic_fetch_add((p), (v), __ATOMIC_SEQ_CST)
+
+#define GetCurrentThreadId() ((DWORD)(uintptr_t)pthread_self())
+#define Sleep(ms) usleep((useconds_t)(ms) * 1000)
+
+static inline DWORD GetTickCount(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (DWORD)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+/* Auto-reset events, which is all the client creates */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int set;
+} TestEvent;
+
+static inline HANDLE CreateEvent(void *attrs, BOOL manual, BOOL initial,
+                                 LPCSTR name)
+{
+    TestEvent *ev = (TestEvent *)calloc(1, sizeof(TestEvent));
+
+    (void)attrs;
+    (void)manual;
+    (void)name;
+    pthread_mutex_init(&ev->lock, NULL);
+    pthread_cond_init(&ev->cond, NULL);
+    ev->set = initial;
+    return ev;
+}
+
+static inline BOOL SetEvent(HANDLE h)
+{
+    TestEvent *ev = (TestEvent *)h;
+
+    pthread_mutex_lock(&ev->lock);
+    ev->set = 1;
+    pthread_cond_signal(&ev->cond);
+    pthread_mutex_unlock(&ev->lock);
+    return TRUE;
+}
+
+static inline DWORD WaitForSingleObject(HANDLE h, DWORD ms)
+{
+    TestEvent *ev = (TestEvent *)h;
+    struct timespec until;
+    DWORD result;
+
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += ms / 1000;
+    until.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (until.tv_nsec >= 1000000000L) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&ev->lock);
+    while (!ev->set) {
+        if (ms == INFINITE) {
+            pthread_cond_wait(&ev->cond, &ev->lock);
+        } else if (pthread_cond_timedwait(&ev->cond, &ev->lock, &until) != 0) {
+            break;
+        }
+    }
+    result = ev->set ? WAIT_OBJECT_0 : WAIT_TIMEOUT;
+    ev->set = 0;
+    pthread_mutex_unlock(&ev->lock);
+    return result;
+}
+
+static inline BOOL CloseHandle(HANDLE h)
+{
+    TestEvent *ev = (TestEvent *)h;
+
+    pthread_cond_destroy(&ev->cond);
+    pthread_mutex_destroy(&ev->lock);
+    free(ev);
+    return TRUE;
+}
+
+static inline DWORD TlsAlloc(void)
+{
+    pthread_key_t key;
+
+    return pthread_key_create(&key, NULL) == 0 ? (DWORD)key
+                                               : TLS_OUT_OF_INDEXES;
+}
+
+static inline BOOL TlsFree(DWORD index)
+{
+    return pthread_key_delete((pthread_key_t)index) == 0;
+}
+
+static inline void *TlsGetValue(DWORD index)
+{
+    return pthread_getspecific((pthread_key_t)index);
+}
+
+static inline BOOL TlsSetValue(DWORD index, void *value)
+{
+    return pthread_setspecific((pthread_key_t)index, value) == 0;
+}
+
+#endif /* TESTS_WIN32_WINDOWS_H */
@@ -0,0 +1,5 @@
+/*
+ * winsock2.h - Sockets come with the POSIX windows.h shim
+ */
+
+#include "windows.h"
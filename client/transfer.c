@@ -12,6 +12,7 @@
  */
 
 #include "transfer.h"
+#include "frame.h"
 #include "util.h"
 
 static int read_line(SOCKET sock, char *buf, size_t bufsize)
@@ -62,6 +63,28 @@ int transfer_download(const char *remote_path, const char *local_path)
 
     printf("[Downloading %s -> %s]\n", remote_path, local_path);
 
+    /* Server-side errors are final; only a dropped link falls back */
+    if (frame_active()) {
+        int rc;
+
+        fp = fopen(local_path, "wb");
+        if (!fp) {
+            log_error("download", "Could not create local file");
+            return -1;
+        }
+        rc = frame_download(remote_path, fp, &total);
+        fclose(fp);
+
+        if (rc == 0) {
+            printf("[Downloaded %lu bytes to %s]\n", total, local_path);
+            return 0;
+        }
+        if (frame_active()) {
+            return -1;
+        }
+        total = 0;
+    }
+
     sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock == INVALID_SOCKET) {
         log_error("download", "Could not create socket");
@@ -212,6 +235,18 @@ int transfer_upload(const char *local_path, const char *remote_path)
     printf("[Uploading %s (%lu bytes) -> %s]\n", local_path, file_size,
            remote_path);
 
+    if (frame_active()) {
+        if (frame_upload(remote_path, fp, file_size) == 0) {
+            fclose(fp);
+            printf("[Uploaded %lu bytes to %s]\n", file_size, remote_path);
+            return 0;
+        }
+        if (frame_active() || fseek(fp, 0, SEEK_SET) != 0) {
+            fclose(fp);
+            return -1;
+        }
+    }
+
     sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock == INVALID_SOCKET) {
         log_error("upload", "Could not create socket");
@@ -277,6 +277,25 @@ void config_load(const char *filename)
                         (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
                     printf("[Config: skip_permissions = %s]\n",
                            g_state.skip_permissions ? "true" : "false");
+                } else if (strcmp(key, "max_response_kb") == 0) {
+                    g_state.max_response_kb = atoi(value);
+                    if (g_state.max_response_kb <= 0) {
+                        g_state.max_response_kb = MAX_RESPONSE_KB;
+                    }
+                    printf("[Config: max response = %d KB]\n",
+                           g_state.max_response_kb);
+                } else if (strcmp(key, "memory_budget_kb") == 0) {
+                    g_state.memory_budget_kb = atoi(value);
+                    if (g_state.memory_budget_kb <= 0) {
+                        g_state.memory_budget_kb = MEMORY_BUDGET_KB;
+                    }
+                    printf("[Config: memory budget = %d KB]\n",
+                           g_state.memory_budget_kb);
+                } else if (strcmp(key, "frame_protocol") == 0) {
+                    g_state.frame_protocol =
+                        (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
+                    printf("[Config: frame_protocol = %s]\n",
+                           g_state.frame_protocol ? "true" : "false");
                 }
             }
         }
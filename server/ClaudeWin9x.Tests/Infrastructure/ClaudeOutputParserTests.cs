@@ -16,6 +16,7 @@ public class ClaudeOutputParserTests
 
         result.Text.ShouldBe("[Session started]");
         result.AppendNewline.ShouldBeTrue();
+        result.Turn.ShouldBeNull();
     }
 
     [Fact]
@@ -30,6 +31,17 @@ public class ClaudeOutputParserTests
         second.Text.ShouldBeNull();
     }
 
+    [Fact]
+    public void Parse_EventWithSessionId_RemembersConversationId()
+    {
+        _parser.ConversationId.ShouldBeNull();
+
+        _parser.Parse("""{"type":"system","subtype":"init","session_id":"abc-123"}""");
+        _parser.Parse("""{"type":"assistant","message":{"content":[]}}""");
+
+        _parser.ConversationId.ShouldBe("abc-123");
+    }
+
     [Fact]
     public void Parse_AssistantWithMessageContent_ReturnsText()
     {
@@ -61,6 +73,17 @@ public class ClaudeOutputParserTests
 
         result.Text.ShouldBe("[Using tool: Bash]");
         result.AppendNewline.ShouldBeTrue();
+        result.Turn.ShouldBe(TurnState.ToolRunning);
+    }
+
+    [Fact]
+    public void Parse_AssistantWithTextOnly_ReportsThinking()
+    {
+        var json = """{"type":"assistant","message":{"content":[{"type":"text","text":"Let me look"}]}}""";
+
+        var result = _parser.Parse(json);
+
+        result.Turn.ShouldBe(TurnState.Thinking);
     }
 
     [Fact]
@@ -113,6 +136,18 @@ public class ClaudeOutputParserTests
         var result = _parser.Parse(json);
 
         result.Text.ShouldBeNull();
+        result.Turn.ShouldBe(TurnState.Done);
+    }
+
+    [Fact]
+    public void Parse_UserToolResultMessage_ReportsThinking()
+    {
+        var json = """{"type":"user","message":{"content":[{"type":"tool_result","content":"ok"}]}}""";
+
+        var result = _parser.Parse(json);
+
+        result.Text.ShouldBeNull();
+        result.Turn.ShouldBe(TurnState.Thinking);
     }
 
     [Fact]
@@ -6,6 +6,7 @@ using ClaudeWin9xServer.Infrastructure;
 
 namespace ClaudeWin9xServer.Tests.Infrastructure;
 
+[Collection(nameof(FakeClaudeCli))]
 public class ClaudeSessionTests
 {
     private readonly ILogger<ClaudeSession> _logger = Substitute.For<ILogger<ClaudeSession>>();
@@ -33,6 +34,18 @@ public class ClaudeSessionTests
         Cleanup();
     }
 
+    [Fact]
+    public void Stop_CancelsEnded()
+    {
+        using var session = new ClaudeSession("test1", _tempWorkDir, "Windows 98", _logger);
+        session.Ended.IsCancellationRequested.ShouldBeFalse();
+
+        session.Stop();
+
+        session.Ended.IsCancellationRequested.ShouldBeTrue();
+        Cleanup();
+    }
+
     [Fact]
     public void SessionId_ReturnsProvidedId()
     {
@@ -101,6 +114,73 @@ public class ClaudeSessionTests
     }
 
 
+    [Fact]
+    public async Task Hibernate_WhenIdle_StopsProcessAndResumeCarriesOnConversation()
+    {
+        using var cli = new FakeClaudeCli();
+        using var session = new ClaudeSession("test18", cli.Directory, "Windows 98", _logger);
+        session.Start();
+        await session.SendInput("hello");
+        (await ReadUntil(session, "hello")).ShouldContain("hello");
+        var conversation = session.ConversationId;
+        conversation.ShouldNotBeNull();
+
+        session.Hibernate().ShouldBeTrue();
+
+        session.IsRunning.ShouldBeFalse();
+        session.IsHibernated.ShouldBeTrue();
+        session.IsAlive.ShouldBeTrue();
+        session.HibernatedBytes.ShouldBeGreaterThan(0);
+        session.Ended.IsCancellationRequested.ShouldBeFalse();
+
+        session.Resume().ShouldBeTrue();
+        session.Resume().ShouldBeFalse();
+        await session.SendInput("again");
+
+        (await ReadUntil(session, "again")).ShouldContain($"[resumed {conversation}] again");
+        session.ResumeLatency.ShouldNotBeNull();
+        session.ResumeLatency.Value.ShouldBeGreaterThan(FakeClaudeCli.LoadTime);
+        session.Stop().ShouldBeTrue();
+        Cleanup();
+    }
+
+    [Fact]
+    public async Task Hibernate_DuringTurn_LeavesProcessRunning()
+    {
+        using var cli = new FakeClaudeCli();
+        using var session = new ClaudeSession("test19", cli.Directory, "Windows 98", _logger);
+        session.Start();
+        await session.SendInput("hello");
+
+        session.Hibernate().ShouldBeFalse();
+        session.IsRunning.ShouldBeTrue();
+        Cleanup();
+    }
+
+    [Fact]
+    public void Stop_WhenHibernatedOrNeverStarted_ReportsWhetherItHeldAProcess()
+    {
+        using var session = new ClaudeSession("test20", _tempWorkDir, "Windows 98", _logger);
+
+        session.Resume().ShouldBeFalse();
+        session.Hibernate().ShouldBeFalse();
+        session.Stop().ShouldBeTrue();
+        Cleanup();
+    }
+
+    // Output up to the end of the turn that echoes text
+    private static async Task<string> ReadUntil(ClaudeSession session, string text)
+    {
+        var output = "";
+        var started = Stopwatch.StartNew();
+        while (!(output.Contains(text) && session.IsIdle) && started.Elapsed < TimeSpan.FromSeconds(10))
+        {
+            await Task.WhenAny(session.OutputChanged, Task.Delay(100));
+            output += session.GetParsedOutput();
+        }
+        return output;
+    }
+
     [Fact]
     public void Dispose_IsIdempotent()
     {
@@ -0,0 +1,106 @@
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+using ClaudeWin9xServer.Models.Responses;
+
+namespace ClaudeWin9xServer.Tests.Infrastructure;
+
+public class CommandResultStoreTests
+{
+    private sealed class ManualClock : TimeProvider
+    {
+        public DateTimeOffset Now { get; set; } = DateTimeOffset.UnixEpoch;
+
+        public override DateTimeOffset GetUtcNow() => Now;
+    }
+
+    private readonly ManualClock _clock = new();
+
+    private CommandResultStore CreateStore(long maxBytes = 1024 * 1024, int ttlMinutes = 30) =>
+        new(maxBytes, TimeSpan.FromMinutes(ttlMinutes), _clock);
+
+    private static CommandResult Result(string id, int stdoutChars = 0) =>
+        new() { CommandId = id, ExitCode = 0, Stdout = new string('x', stdoutChars) };
+
+    [Fact]
+    public void TryGet_WhenStored_ReturnsResult()
+    {
+        var store = CreateStore();
+        store.Add("cmd1", Result("cmd1", 10));
+
+        store.TryGet("cmd1")!.Stdout.ShouldBe(new string('x', 10));
+        store.TryGet("cmd2").ShouldBeNull();
+    }
+
+    [Fact]
+    public void Add_WhenOverByteLimit_EvictsLeastRecentlyUsed()
+    {
+        var store = CreateStore(maxBytes: 3 * 2200);
+        store.Add("a", Result("a", 1000));
+        store.Add("b", Result("b", 1000));
+        store.Add("c", Result("c", 1000));
+        store.TryGet("a");
+
+        store.Add("d", Result("d", 1000));
+
+        store.TryGet("b").ShouldBeNull();
+        store.TryGet("a").ShouldNotBeNull();
+        store.TryGet("c").ShouldNotBeNull();
+        store.TryGet("d").ShouldNotBeNull();
+        store.Evictions.ShouldBe(1);
+        store.ResidentBytes.ShouldBeLessThanOrEqualTo(store.MaxBytes);
+    }
+
+    [Fact]
+    public void Add_WhenSingleResultExceedsLimit_KeepsIt()
+    {
+        var store = CreateStore(maxBytes: 1000);
+        store.Add("small", Result("small", 10));
+
+        store.Add("big", Result("big", 5000));
+
+        store.TryGet("big").ShouldNotBeNull();
+        store.TryGet("small").ShouldBeNull();
+        store.Count.ShouldBe(1);
+    }
+
+    [Fact]
+    public void TryGet_AfterTtl_ReturnsNullAndCountsExpiration()
+    {
+        var store = CreateStore(ttlMinutes: 5);
+        store.Add("cmd1", Result("cmd1", 10));
+
+        _clock.Now += TimeSpan.FromMinutes(6);
+
+        store.TryGet("cmd1").ShouldBeNull();
+        store.Expirations.ShouldBe(1);
+        store.Count.ShouldBe(0);
+        store.ResidentBytes.ShouldBe(0);
+    }
+
+    [Fact]
+    public void Add_DropsExpiredResultsFromTheColdEnd()
+    {
+        var store = CreateStore(ttlMinutes: 5);
+        store.Add("old1", Result("old1"));
+        store.Add("old2", Result("old2"));
+
+        _clock.Now += TimeSpan.FromMinutes(10);
+        store.Add("new", Result("new"));
+
+        store.Count.ShouldBe(1);
+        store.Expirations.ShouldBe(2);
+    }
+
+    [Fact]
+    public void Add_SameIdTwice_ReplacesWithoutLeakingBytes()
+    {
+        var store = CreateStore();
+        store.Add("cmd1", Result("cmd1", 100));
+        var once = store.ResidentBytes;
+
+        store.Add("cmd1", Result("cmd1", 100));
+
+        store.ResidentBytes.ShouldBe(once);
+        store.Count.ShouldBe(1);
+    }
+}
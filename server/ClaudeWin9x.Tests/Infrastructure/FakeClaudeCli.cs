@@ -0,0 +1,41 @@
+namespace ClaudeWin9xServer.Tests.Infrastructure;
+
+/// <summary>
+/// Stands in for the Claude CLI through CLAUDE_CLI_PATH while alive: takes a second to load, then
+/// echoes each message back, prefixed with the conversation it resumed if started with --resume.
+/// The path is process-wide, so tests using it share the <c>FakeClaudeCli</c> collection.
+/// </summary>
+public sealed class FakeClaudeCli : IDisposable
+{
+    private const string Script = """
+        const resume = process.argv.indexOf("--resume");
+        const conversation = resume > 0 ? process.argv[resume + 1] : "conv-" + process.pid;
+        Atomics.wait(new Int32Array(new SharedArrayBuffer(4)), 0, 0, 1000);
+        console.log(JSON.stringify({ type: "system", subtype: "init", session_id: conversation }));
+        require("readline").createInterface({ input: process.stdin }).on("line", line => {
+          const text = (resume > 0 ? `[resumed ${conversation}] ` : "") + JSON.parse(line).message.content;
+          console.log(JSON.stringify({ type: "assistant", message: { content: [{ type: "text", text }] } }));
+          console.log(JSON.stringify({ type: "result", subtype: "success" }));
+        });
+        """;
+
+    public static readonly TimeSpan LoadTime = TimeSpan.FromSeconds(1);
+
+    private readonly string? _previous = Environment.GetEnvironmentVariable("CLAUDE_CLI_PATH");
+
+    public string Directory { get; } = Path.Combine(Path.GetTempPath(), $"fakecli_{Guid.NewGuid():N}");
+
+    public FakeClaudeCli()
+    {
+        System.IO.Directory.CreateDirectory(Directory);
+        var cli = Path.Combine(Directory, "claude.js");
+        File.WriteAllText(cli, Script);
+        Environment.SetEnvironmentVariable("CLAUDE_CLI_PATH", cli);
+    }
+
+    public void Dispose()
+    {
+        Environment.SetEnvironmentVariable("CLAUDE_CLI_PATH", _previous);
+        System.IO.Directory.Delete(Directory, recursive: true);
+    }
+}
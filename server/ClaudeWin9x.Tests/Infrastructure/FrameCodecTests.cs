@@ -0,0 +1,146 @@
+using System.Text;
+using System.Text.Json;
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+using ClaudeWin9xServer.Models.Responses;
+
+namespace ClaudeWin9xServer.Tests.Infrastructure;
+
+public class FrameCodecTests
+{
+    [Fact]
+    public async Task ReadAsync_AfterEncode_ReturnsSameFrame()
+    {
+        var payload = new FramePayloadWriter().Add("C:\\test.txt").Add(42).ToArray();
+        using var stream = new MemoryStream(FrameCodec.Encode(new Frame(FrameType.Download, FramePriority.Bulk, 513, payload)));
+
+        var frame = await FrameCodec.ReadAsync(stream, CancellationToken.None);
+
+        frame.ShouldNotBeNull();
+        frame.Value.Type.ShouldBe(FrameType.Download);
+        frame.Value.Priority.ShouldBe(FramePriority.Bulk);
+        frame.Value.Stream.ShouldBe((ushort)513);
+        frame.Value.Payload.ShouldBe(payload);
+    }
+
+    [Fact]
+    public void Encode_WritesLittleEndianHeader()
+    {
+        var bytes = FrameCodec.Encode(new Frame(FrameType.Ack, FramePriority.Control, 0x0102, [0xAA, 0xBB]));
+
+        bytes.ShouldBe(new byte[] { 0x03, 0x00, 0x02, 0x01, 0x02, 0x00, 0x00, 0x00, 0xAA, 0xBB });
+    }
+
+    [Fact]
+    public async Task ReadAsync_WhenStreamEndsBetweenFrames_ReturnsNull()
+    {
+        using var stream = new MemoryStream();
+
+        var frame = await FrameCodec.ReadAsync(stream, CancellationToken.None);
+
+        frame.ShouldBeNull();
+    }
+
+    [Fact]
+    public async Task ReadAsync_WhenStreamEndsMidFrame_Throws()
+    {
+        var bytes = FrameCodec.Encode(new Frame(FrameType.Input, FramePriority.Control, 1, new byte[10]));
+        using var stream = new MemoryStream(bytes[..12]);
+
+        await Should.ThrowAsync<EndOfStreamException>(() => FrameCodec.ReadAsync(stream, CancellationToken.None));
+    }
+
+    [Fact]
+    public async Task ReadAsync_WhenLengthExceedsMax_Throws()
+    {
+        var header = new byte[] { 0x23, 0x00, 0x01, 0x00, 0xFF, 0xFF, 0xFF, 0x7F };
+        using var stream = new MemoryStream(header);
+
+        await Should.ThrowAsync<InvalidDataException>(() => FrameCodec.ReadAsync(stream, CancellationToken.None));
+    }
+
+    [Fact]
+    public void PayloadReader_ReadsFieldsInOrder()
+    {
+        var payload = new FramePayloadWriter().Add("op1").Add((string?)null).Add(-1).Add("caf\u00e9").ToArray();
+        var reader = new FramePayloadReader(payload);
+
+        reader.ReadString().ShouldBe("op1");
+        reader.ReadOptionalString().ShouldBeNull();
+        reader.ReadInt().ShouldBe(-1);
+        reader.ReadString().ShouldBe("caf\u00e9");
+        reader.HasMore.ShouldBeFalse();
+    }
+
+    [Fact]
+    public void PayloadReader_WhenFieldIsTruncated_Throws()
+    {
+        var payload = new FramePayloadWriter().Add("truncated").ToArray();
+        var reader = new FramePayloadReader(payload[..6]);
+
+        Should.Throw<InvalidDataException>(() => reader.ReadString());
+    }
+
+    [Fact]
+    public async Task FrameWriter_WritesControlFramesBeforeQueuedBulkFrames()
+    {
+        using var stream = new MemoryStream();
+        var writer = new FrameWriter(stream);
+
+        await writer.SendAsync(new Frame(FrameType.Data, FramePriority.Bulk, 1, [1]));
+        await writer.SendAsync(new Frame(FrameType.Data, FramePriority.Bulk, 1, [2]));
+        await writer.SendAsync(new Frame(FrameType.Output, FramePriority.Control, 2, [3]));
+        writer.Complete();
+        await writer.RunAsync(CancellationToken.None);
+
+        stream.Position = 0;
+        var order = new List<byte>();
+        while (await FrameCodec.ReadAsync(stream, CancellationToken.None) is { } frame)
+        {
+            order.Add(frame.Payload[0]);
+        }
+        order.ShouldBe(new List<byte> { 3, 1, 2 });
+    }
+
+    [Fact]
+    public void SyncFrames_AreSmallerOnTheWireThanHttpJson()
+    {
+        const string output = "I'll list the directory first.\r\n";
+        var sync = new SyncResponse
+        {
+            Output = output,
+            Status = "running",
+            TurnState = "thinking",
+            TurnSeq = 1,
+            Command = new CommandPollResponse
+            {
+                HasPending = true,
+                CmdId = "20260101120000-0001",
+                Command = "dir /b C:\\PROJECTS",
+                WorkingDirectory = "C:\\PROJECTS"
+            }
+        };
+
+        var json = JsonSerializer.SerializeToUtf8Bytes(sync);
+        var httpRequest = Encoding.ASCII.GetByteCount(
+            "GET /sync?session_id=20260101120000-0001&wait_ms=15000&approval=1 HTTP/1.1\r\n" +
+            "Host: 192.168.56.1:5000\r\nConnection: keep-alive\r\n\r\n");
+        var httpResponseHeaders = Encoding.ASCII.GetByteCount(
+            "HTTP/1.1 200 OK\r\nContent-Type: application/json; charset=utf-8\r\n" +
+            $"Date: Thu, 01 Jan 2026 12:00:00 GMT\r\nServer: Kestrel\r\nContent-Length: {json.Length}\r\n\r\n");
+        var httpBytes = httpRequest + httpResponseHeaders + json.Length;
+
+        Frame[] frames =
+        [
+            new(FrameType.Sync, FramePriority.Control, 1, new FramePayloadWriter().Add(15000).Add(1).ToArray()),
+            new(FrameType.Output, FramePriority.Control, 1, new FramePayloadWriter().Add(output).ToArray()),
+            new(FrameType.Command, FramePriority.Control, 1, new FramePayloadWriter()
+                .Add(sync.Command.CmdId).Add(sync.Command.Command).Add(sync.Command.WorkingDirectory).ToArray()),
+            new(FrameType.SyncEnd, FramePriority.Control, 1, new FramePayloadWriter().Add("running").Add("thinking").Add(1).ToArray())
+        ];
+        var frameBytes = frames.Sum(f => FrameCodec.Encode(f).Length);
+
+        // Headers and key names dominate a typical poll; the frame exchange is well under half
+        (frameBytes * 2).ShouldBeLessThan(httpBytes);
+    }
+}
@@ -0,0 +1,57 @@
+using Microsoft.AspNetCore.Http;
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+
+namespace ClaudeWin9xServer.Tests.Infrastructure;
+
+public class FramedResponseBodyTests
+{
+    private readonly DefaultHttpContext _context = new();
+    private readonly MemoryStream _sent = new();
+
+    [Fact]
+    public async Task CompleteAsync_WhenReplyFits_SendsItOnceWithLength()
+    {
+        await using var body = new FramedResponseBody(_context.Response, _sent, limit: 16);
+
+        await body.WriteAsync("{\"a\":"u8.ToArray());
+        await body.FlushAsync();
+        _sent.Length.ShouldBe(0);
+
+        await body.WriteAsync("1}"u8.ToArray());
+        await body.CompleteAsync(CancellationToken.None);
+
+        _context.Response.ContentLength.ShouldBe(7);
+        _sent.ToArray().ShouldBe("{\"a\":1}"u8.ToArray());
+        body.Streaming.ShouldBeFalse();
+    }
+
+    [Fact]
+    public async Task WriteAsync_PastLimit_WritesThroughAndClosesConnection()
+    {
+        await using var body = new FramedResponseBody(_context.Response, _sent, limit: 16);
+
+        await body.WriteAsync(new byte[10]);
+        await body.WriteAsync(new byte[10]);
+        body.Streaming.ShouldBeTrue();
+        _sent.Length.ShouldBe(20);
+
+        await body.WriteAsync(new byte[5]);
+        await body.CompleteAsync(CancellationToken.None);
+
+        _sent.Length.ShouldBe(25);
+        _context.Response.ContentLength.ShouldBeNull();
+        _context.Response.Headers.Connection.ToString().ShouldBe("close");
+    }
+
+    [Fact]
+    public async Task CompleteAsync_WhenNothingWritten_SendsEmptyReply()
+    {
+        await using var body = new FramedResponseBody(_context.Response, _sent, limit: 16);
+
+        await body.CompleteAsync(CancellationToken.None);
+
+        _context.Response.ContentLength.ShouldBe(0);
+        _sent.Length.ShouldBe(0);
+    }
+}
@@ -0,0 +1,42 @@
+using System.Text.Json;
+using System.Text.Json.Serialization.Metadata;
+using ClaudeWin9xServer.Infrastructure;
+
+namespace ClaudeWin9xServer.Tests.Infrastructure;
+
+/// <summary>
+/// A <see cref="MemoryWorkStore"/> that runs a hook before each write, for making the store slow
+/// or making it refuse.
+/// </summary>
+public sealed class HookedWorkStore : IWorkStore
+{
+    private readonly MemoryWorkStore _records = new();
+
+    public Action? BeforePut { get; set; }
+
+    public Action? BeforeRemove { get; set; }
+
+    /// <summary>
+    /// A journal of <typeparamref name="T"/> in this store, serialized as the tests' own types are.
+    /// </summary>
+    public WorkJournal<T> Journal<T>(string kind) =>
+        new(this, kind, (JsonTypeInfo<T>)JsonSerializerOptions.Default.GetTypeInfo(typeof(T)));
+
+    public void Put(string kind, string id, string json)
+    {
+        BeforePut?.Invoke();
+        _records.Put(kind, id, json);
+    }
+
+    public void Remove(string kind, string id)
+    {
+        BeforeRemove?.Invoke();
+        _records.Remove(kind, id);
+    }
+
+    public string? Get(string kind, string id) => _records.Get(kind, id);
+
+    public IReadOnlyDictionary<string, string> List(string kind) => _records.List(kind);
+
+    public void Dispose() => _records.Dispose();
+}
@@ -68,6 +68,27 @@ public class IniConfigTests
         Cleanup();
     }
 
+    [Fact]
+    public void Load_WhenFramePortIsZero_DisablesFrameProtocol()
+    {
+        var iniPath = Path.Combine(_tempDir, "server.ini");
+        File.WriteAllText(iniPath, """
+            [server]
+            frame_port = 6003
+            """);
+        IniConfig.Load(iniPath);
+        IniConfig.FramePort.ShouldBe(6003);
+
+        File.WriteAllText(iniPath, """
+            [server]
+            frame_port = 0
+            """);
+        IniConfig.Load(iniPath);
+
+        IniConfig.FramePort.ShouldBe(0);
+        Cleanup();
+    }
+
     [Fact]
     public void Load_WhenKeysAreMissing_LeavesUnspecifiedKeysUnchanged()
     {
@@ -0,0 +1,115 @@
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+
+namespace ClaudeWin9xServer.Tests.Infrastructure;
+
+public class JournalWorkStoreTests : IDisposable
+{
+    private readonly string _dir = Path.Combine(Path.GetTempPath(), $"journal_{Guid.NewGuid():N}");
+
+    public void Dispose()
+    {
+        if (Directory.Exists(_dir))
+        {
+            Directory.Delete(_dir, recursive: true);
+        }
+    }
+
+    [Fact]
+    public void Put_ThenRemove_IsVisibleToGetAndList()
+    {
+        using var store = new JournalWorkStore(_dir);
+        store.Put("command", "a", "{\"x\":1}");
+        store.Put("command", "b", "{\"x\":2}");
+        store.Put("session", "a", "{}");
+        store.Remove("command", "b");
+
+        store.Get("command", "a").ShouldBe("{\"x\":1}");
+        store.Get("command", "b").ShouldBeNull();
+        store.List("command").Keys.ShouldBe(["a"]);
+        store.List("session").Keys.ShouldBe(["a"]);
+    }
+
+    [Fact]
+    public void NewStore_OnSameDirectory_SeesEarlierWrites()
+    {
+        using (var before = new JournalWorkStore(_dir))
+        {
+            before.Put("command", "a", "1");
+            before.Put("command", "a", "2");
+            before.Put("command", "b", "3");
+            before.Remove("command", "b");
+        }
+
+        using var after = new JournalWorkStore(_dir);
+
+        after.List("command").ShouldBe(new Dictionary<string, string> { ["a"] = "2" });
+    }
+
+    [Fact]
+    public void Stores_SharingDirectory_SeeEachOthersChanges()
+    {
+        using var first = new JournalWorkStore(_dir);
+        using var second = new JournalWorkStore(_dir);
+
+        first.Put("session", "s1", "one");
+        second.Put("session", "s2", "two");
+        first.Remove("session", "s2");
+
+        second.List("session").Keys.ShouldBe(["s1"]);
+        first.Get("session", "s1").ShouldBe("one");
+    }
+
+    [Fact]
+    public void TornLastLine_IsDroppedAndLaterWritesRead()
+    {
+        using (var crashed = new JournalWorkStore(_dir))
+        {
+            crashed.Put("command", "a", "kept");
+        }
+        File.AppendAllText(Path.Combine(_dir, "work.journal"), "{\"op\":\"put\",\"kind\":\"comm");
+
+        using var store = new JournalWorkStore(_dir);
+        store.Put("command", "b", "after");
+
+        using var reader = new JournalWorkStore(_dir);
+        reader.List("command").ShouldBe(new Dictionary<string, string> { ["a"] = "kept", ["b"] = "after" });
+    }
+
+    [Fact]
+    public void Compaction_KeepsLiveRecordsAndOtherStoresFollow()
+    {
+        using var writer = new JournalWorkStore(_dir);
+        using var follower = new JournalWorkStore(_dir);
+        writer.Put("command", "live", "yes");
+        follower.Get("command", "live").ShouldBe("yes");
+
+        for (var i = 0; i < 3000; i++)
+        {
+            writer.Put("command", $"c{i}", "x");
+            writer.Remove("command", $"c{i}");
+        }
+        writer.Put("command", "late", "yes");
+
+        follower.List("command").Keys.Order().ToList().ShouldBe(["late", "live"]);
+        File.ReadLines(Path.Combine(_dir, "work.journal")).Count().ShouldBeLessThan(2000);
+    }
+
+    [Fact]
+    public async Task ConcurrentWriters_LoseNothing()
+    {
+        var stores = Enumerable.Range(0, 4).Select(_ => new JournalWorkStore(_dir)).ToList();
+
+        await Task.WhenAll(stores.Select((store, n) => Task.Run(() =>
+        {
+            for (var i = 0; i < 100; i++)
+            {
+                store.Put("command", $"{n}-{i}", $"{i}");
+            }
+        })));
+
+        using var reader = new JournalWorkStore(_dir);
+        reader.List("command").Count.ShouldBe(400);
+        stores.ForEach(s => s.Dispose());
+    }
+}
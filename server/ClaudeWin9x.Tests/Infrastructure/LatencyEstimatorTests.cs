@@ -0,0 +1,150 @@
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+using static ClaudeWin9xServer.Infrastructure.LatencyEstimator;
+
+namespace ClaudeWin9xServer.Tests.Infrastructure;
+
+public class LatencyEstimatorTests
+{
+    private sealed class ManualClock : TimeProvider
+    {
+        public long Ticks { get; set; }
+
+        public override long TimestampFrequency => TimeSpan.TicksPerSecond;
+
+        public override long GetTimestamp() => Ticks;
+
+        public void Advance(TimeSpan by) => Ticks += by.Ticks;
+    }
+
+    private readonly ManualClock _clock = new();
+    private int _nextId;
+
+    private LatencyEstimator CreateEstimator() =>
+        new(TimeSpan.FromSeconds(5), TimeSpan.FromSeconds(30), TimeSpan.FromSeconds(600), _clock);
+
+    private void Sample(LatencyEstimator estimator, string session, WorkKind kind, TimeSpan took, long bytesOut = 0, long bytesBack = 0)
+    {
+        var id = $"op{_nextId++}";
+        estimator.Dispatched(id, session, kind, bytesOut);
+        _clock.Advance(took);
+        estimator.Completed(id, bytesBack);
+    }
+
+    [Fact]
+    public void Deadline_WithNoSamples_IsNull()
+    {
+        var estimator = CreateEstimator();
+
+        estimator.Deadline("s1", WorkKind.FileOp).ShouldBeNull();
+        estimator.Deadline("s1", WorkKind.Command).ShouldBeNull();
+    }
+
+    [Fact]
+    public void Deadline_ForFastClient_DropsToFloor()
+    {
+        var estimator = CreateEstimator();
+        for (var i = 0; i < 10; i++)
+        {
+            Sample(estimator, "pentium", WorkKind.FileOp, TimeSpan.FromMilliseconds(40));
+        }
+
+        estimator.Deadline("pentium", WorkKind.FileOp).ShouldBe(TimeSpan.FromSeconds(5));
+    }
+
+    [Fact]
+    public void Deadline_ForSlowLink_GrowsWithPayload()
+    {
+        var estimator = CreateEstimator();
+        for (var i = 0; i < 10; i++)
+        {
+            Sample(estimator, "ppp", WorkKind.FileOp, TimeSpan.FromMilliseconds(800));
+        }
+
+        // 64 KB read back in 800 ms plus 64 s: about 1 KB/s
+        Sample(estimator, "ppp", WorkKind.FileOp, TimeSpan.FromMilliseconds(64_800), bytesBack: 64_000);
+
+        var small = estimator.Deadline("ppp", WorkKind.FileOp)!.Value;
+        var write = estimator.Deadline("ppp", WorkKind.FileOp, 50_000)!.Value;
+
+        small.ShouldBe(TimeSpan.FromSeconds(5));
+        write.ShouldBeGreaterThan(TimeSpan.FromSeconds(60));
+        write.ShouldBeLessThan(TimeSpan.FromSeconds(120));
+    }
+
+    [Fact]
+    public void Deadline_ForLargePayloadWithoutThroughputSample_IsNull()
+    {
+        var estimator = CreateEstimator();
+        Sample(estimator, "s1", WorkKind.FileOp, TimeSpan.FromMilliseconds(100));
+
+        estimator.Deadline("s1", WorkKind.FileOp, 50_000).ShouldBeNull();
+        estimator.Deadline("s1", WorkKind.FileOp, 100).ShouldNotBeNull();
+    }
+
+    [Fact]
+    public void Deadline_ForCommands_FollowsRunTimesAndStaysWithinBounds()
+    {
+        var estimator = CreateEstimator();
+        Sample(estimator, "s1", WorkKind.Command, TimeSpan.FromSeconds(1));
+        estimator.Deadline("s1", WorkKind.Command).ShouldBe(TimeSpan.FromSeconds(30));
+
+        for (var i = 0; i < 20; i++)
+        {
+            Sample(estimator, "s1", WorkKind.Command, TimeSpan.FromMinutes(20));
+        }
+        estimator.Deadline("s1", WorkKind.Command).ShouldBe(TimeSpan.FromSeconds(600));
+    }
+
+    [Fact]
+    public void Deadline_IsPerSession()
+    {
+        var estimator = CreateEstimator();
+        Sample(estimator, "fast", WorkKind.FileOp, TimeSpan.FromMilliseconds(10));
+
+        estimator.Deadline("fast", WorkKind.FileOp).ShouldNotBeNull();
+        estimator.Deadline("slow", WorkKind.FileOp).ShouldBeNull();
+    }
+
+    [Fact]
+    public void TimedOut_DoublesTheEstimateAndCounts()
+    {
+        var estimator = CreateEstimator();
+        Sample(estimator, "s1", WorkKind.Command, TimeSpan.FromSeconds(40));
+        var before = estimator.Deadline("s1", WorkKind.Command)!.Value;
+
+        estimator.Dispatched("hung", "s1", WorkKind.Command);
+        estimator.TimedOut("hung");
+
+        estimator.Deadline("s1", WorkKind.Command)!.Value.ShouldBeGreaterThan(before);
+        estimator.Snapshot().Single().Timeouts.ShouldBe(1);
+    }
+
+    [Fact]
+    public void Completed_ForWorkNeverDispatched_IsIgnored()
+    {
+        var estimator = CreateEstimator();
+
+        estimator.Completed("unknown");
+        estimator.Dispatched("gone", "s1", WorkKind.FileOp);
+        estimator.Forget("gone");
+        estimator.Completed("gone");
+
+        estimator.Snapshot().ShouldBeEmpty();
+    }
+
+    [Fact]
+    public void ForgetSession_DropsItsEstimatesAndWorkStillInFlight()
+    {
+        var estimator = CreateEstimator();
+        Sample(estimator, "gone", WorkKind.FileOp, TimeSpan.FromMilliseconds(40));
+        Sample(estimator, "kept", WorkKind.FileOp, TimeSpan.FromMilliseconds(40));
+        estimator.Dispatched("late", "gone", WorkKind.Command);
+
+        estimator.ForgetSession("gone");
+        estimator.Completed("late");
+
+        estimator.Deadline("gone", WorkKind.FileOp).ShouldBeNull();
+        estimator.Snapshot().Select(s => s.SessionId).ShouldBe(["kept"]);
+    }
+}
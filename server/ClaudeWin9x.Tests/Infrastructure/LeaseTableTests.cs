@@ -0,0 +1,71 @@
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+
+namespace ClaudeWin9xServer.Tests.Infrastructure;
+
+public class LeaseTableTests
+{
+    private readonly LeaseTable _leases = new();
+    private readonly List<string> _expired = [];
+
+    private void Expired(string id)
+    {
+        lock (_expired)
+        {
+            _expired.Add(id);
+        }
+    }
+
+    [Fact]
+    public async Task Grant_WhenNotRenewed_ExpiresOnce()
+    {
+        _leases.Grant("a", TimeSpan.FromMilliseconds(50), Expired).ShouldBeTrue();
+
+        await Task.Delay(300);
+
+        _expired.ShouldBe(["a"]);
+        _leases.Expired.ShouldBe(1);
+        _leases.Count.ShouldBe(0);
+    }
+
+    [Fact]
+    public async Task Renew_PushesExpiryBack()
+    {
+        _leases.Grant("a", TimeSpan.FromMilliseconds(150), Expired);
+
+        for (var i = 0; i < 5; i++)
+        {
+            await Task.Delay(50);
+            _leases.Renew("a", TimeSpan.FromMilliseconds(150)).ShouldBeTrue();
+        }
+
+        _expired.ShouldBeEmpty();
+    }
+
+    [Fact]
+    public async Task Release_CancelsTheLease()
+    {
+        _leases.Grant("a", TimeSpan.FromMilliseconds(50), Expired);
+        _leases.Release("a");
+
+        await Task.Delay(200);
+
+        _expired.ShouldBeEmpty();
+        _leases.Renew("a", TimeSpan.FromSeconds(1)).ShouldBeFalse();
+        _leases.Deliveries("a").ShouldBe(0);
+    }
+
+    [Fact]
+    public void Grant_OnLastDelivery_GrantsNoLease()
+    {
+        for (var i = 1; i < LeaseTable.MaxDeliveries; i++)
+        {
+            _leases.Grant("a", TimeSpan.FromMinutes(1), Expired).ShouldBeTrue();
+        }
+
+        _leases.Grant("a", TimeSpan.FromMinutes(1), Expired).ShouldBeFalse();
+        _leases.Deliveries("a").ShouldBe(LeaseTable.MaxDeliveries);
+        _leases.Renew("a", TimeSpan.FromMinutes(1)).ShouldBeFalse();
+        _leases.Release("a");
+    }
+}
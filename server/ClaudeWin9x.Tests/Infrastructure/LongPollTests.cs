@@ -0,0 +1,66 @@
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+
+namespace ClaudeWin9xServer.Tests.Infrastructure;
+
+public class LongPollTests
+{
+    [Theory]
+    [InlineData(null, 0)]
+    [InlineData(0, 0)]
+    [InlineData(-5, 0)]
+    [InlineData(1500, 1500)]
+    [InlineData(600000, 30000)]
+    public void ClampWait_LimitsToMaxWait(int? waitMs, int expectedMs)
+    {
+        LongPoll.ClampWait(waitMs).ShouldBe(TimeSpan.FromMilliseconds(expectedMs));
+    }
+
+    [Fact]
+    public async Task WaitAsync_WhenValueAlreadyAvailable_ReturnsImmediately()
+    {
+        var signal = new AsyncSignal();
+
+        var result = await LongPoll.WaitAsync(() => "ready", () => signal.Next, TimeSpan.FromSeconds(10), CancellationToken.None);
+
+        result.ShouldBe("ready");
+    }
+
+    [Fact]
+    public async Task WaitAsync_WhenPulsed_ReturnsNewValue()
+    {
+        var signal = new AsyncSignal();
+        string? value = null;
+
+        var waitTask = LongPoll.WaitAsync(() => value, () => signal.Next, TimeSpan.FromSeconds(10), CancellationToken.None);
+        await Task.Delay(50);
+        waitTask.IsCompleted.ShouldBeFalse();
+
+        value = "queued";
+        signal.Pulse();
+
+        var result = await waitTask.WaitAsync(TimeSpan.FromSeconds(2));
+        result.ShouldBe("queued");
+    }
+
+    [Fact]
+    public async Task WaitAsync_WhenNothingArrives_ReturnsNullAfterWait()
+    {
+        var signal = new AsyncSignal();
+
+        var result = await LongPoll.WaitAsync<string>(() => null, () => signal.Next, TimeSpan.FromMilliseconds(100), CancellationToken.None);
+
+        result.ShouldBeNull();
+    }
+
+    [Fact]
+    public async Task WaitAsync_WhenCancelled_ReturnsNull()
+    {
+        var signal = new AsyncSignal();
+        using var cts = new CancellationTokenSource(TimeSpan.FromMilliseconds(50));
+
+        var result = await LongPoll.WaitAsync<string>(() => null, () => signal.Next, TimeSpan.FromSeconds(10), cts.Token);
+
+        result.ShouldBeNull();
+    }
+}
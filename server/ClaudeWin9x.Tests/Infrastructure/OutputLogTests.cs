@@ -0,0 +1,174 @@
+using System.Text.Json;
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+
+namespace ClaudeWin9xServer.Tests.Infrastructure;
+
+public class OutputLogTests : IDisposable
+{
+    private readonly string _spillDir = Path.Combine(Path.GetTempPath(), $"outputlog_{Guid.NewGuid():N}");
+
+    public OutputLogTests() => Directory.CreateDirectory(_spillDir);
+
+    public void Dispose() => Directory.Delete(_spillDir, recursive: true);
+
+    private static string ReadAll(OutputLog log, long since, int maxBytes)
+    {
+        var text = new System.Text.StringBuilder();
+        while (log.HasAfter(since))
+        {
+            var page = log.Read(since, maxBytes);
+            page.Offset.ShouldBe(since);
+            char.IsHighSurrogate(page.Text[^1]).ShouldBeFalse();
+            text.Append(page.Text);
+            since = page.Next;
+        }
+        return text.ToString();
+    }
+
+    [Fact]
+    public void Read_WithCursor_ReturnsSamePageUntilCursorMoves()
+    {
+        var log = new OutputLog();
+        log.Append("hello ");
+        log.Append("world");
+
+        var first = log.Read(since: 0);
+        var again = log.Read(since: 0);
+
+        first.ShouldBe(new OutputPage("hello world", 0, 11));
+        again.ShouldBe(first);
+        log.Read(since: 6).Text.ShouldBe("world");
+        log.Read(since: 11).ShouldBe(new OutputPage("", 11, 11));
+    }
+
+    [Fact]
+    public void Read_WithoutCursor_ReturnsEachTextOnce()
+    {
+        var log = new OutputLog();
+        log.Append("one");
+
+        log.Read(null).Text.ShouldBe("one");
+        log.HasAfter(null).ShouldBeFalse();
+
+        log.Append("two");
+        log.HasAfter(null).ShouldBeTrue();
+        log.Read(null).ShouldBe(new OutputPage("two", 3, 6));
+    }
+
+    [Fact]
+    public void Read_WithMaxBytes_PagesByEncodedSize()
+    {
+        var log = new OutputLog();
+        var text = "plain \"quoted\"\n<tag> café 😀 end";
+        log.Append(text);
+
+        var pages = new List<string>();
+        var cursor = 0L;
+        while (log.HasAfter(cursor))
+        {
+            var page = log.Read(cursor, maxBytes: 12);
+            JsonSerializer.Serialize(page.Text).Length.ShouldBeLessThanOrEqualTo(12 + 2);
+            char.IsHighSurrogate(page.Text[^1]).ShouldBeFalse();
+            pages.Add(page.Text);
+            cursor = page.Next;
+        }
+
+        string.Concat(pages).ShouldBe(text);
+    }
+
+    [Fact]
+    public void Read_WhenBudgetBelowOneCharacter_StillReturnsOne()
+    {
+        var log = new OutputLog();
+        log.Append("\u0001x");
+
+        log.Read(since: 0, maxBytes: 1).Text.ShouldBe("\u0001");
+    }
+
+    [Fact]
+    public void Read_AcknowledgesSegmentsBeforeCursorOnly()
+    {
+        var log = new OutputLog(capacity: 100, segmentSize: 4);
+        log.Append("0123456789");
+
+        log.Read(since: 0);
+        log.Buffered.ShouldBe(10);
+
+        log.Read(since: 9);
+        log.Buffered.ShouldBe(2);
+        log.Read(since: 8).Text.ShouldBe("89");
+    }
+
+    [Fact]
+    public void Append_PastCapacity_DropsOldestAndReaderSeesGap()
+    {
+        var log = new OutputLog(capacity: 8, segmentSize: 4);
+        for (var i = 0; i < 1000; i++)
+        {
+            log.Append("abc");
+            log.Buffered.ShouldBeLessThanOrEqualTo(8);
+        }
+
+        var page = log.Read(since: 0);
+        page.Offset.ShouldBeGreaterThan(0);
+        page.Next.ShouldBe(3000);
+        page.Text.Length.ShouldBe((int)(page.Next - page.Offset));
+    }
+
+    [Fact]
+    public void Append_PastCapacity_SpillsToDiskAndReaderCatchesUpWithoutGap()
+    {
+        // Segments of 3 split the surrogate pairs, in memory and on disk
+        using var log = new OutputLog(capacity: 8, segmentSize: 3, _spillDir, spillBytes: 1024);
+        var text = string.Concat(Enumerable.Range(0, 60).Select(i => $"{i % 10}é😀"));
+        log.Append(text);
+
+        log.Buffered.ShouldBeLessThanOrEqualTo(11);
+        log.Spilled.ShouldBeGreaterThan(0);
+        ReadAll(log, since: 0, maxBytes: 10).ShouldBe(text);
+    }
+
+    [Fact]
+    public void Append_PastSpillBytes_KeepsFileBoundedAndDropsOldest()
+    {
+        using var log = new OutputLog(capacity: 8, segmentSize: 4, _spillDir, spillBytes: 64);
+        for (var i = 0; i < 1000; i++)
+        {
+            log.Append("abc");
+        }
+
+        new FileInfo(log.SpillPath!).Length.ShouldBeLessThanOrEqualTo(64);
+        log.Spilled.ShouldBe(32);
+
+        var page = log.Read(since: 0);
+        page.Offset.ShouldBe(3000 - log.Spilled - log.Buffered);
+        ReadAll(log, page.Offset, maxBytes: 20).ShouldBe(string.Concat(Enumerable.Repeat("abc", 1000))[(int)page.Offset..]);
+    }
+
+    [Fact]
+    public void Read_PastSpilledText_EmptiesFileAndDisposeDeletesIt()
+    {
+        var log = new OutputLog(capacity: 8, segmentSize: 4, _spillDir, spillBytes: 1024);
+        log.Append(new string('x', 40));
+        var path = log.SpillPath!;
+        new FileInfo(path).Length.ShouldBeGreaterThan(0);
+
+        log.Read(since: 36);
+        log.Spilled.ShouldBe(0);
+        new FileInfo(path).Length.ShouldBe(0);
+
+        log.Dispose();
+        File.Exists(path).ShouldBeFalse();
+    }
+
+    [Fact]
+    public void Append_WithoutSpillDirectory_NeverWritesToDisk()
+    {
+        using var log = new OutputLog(capacity: 8, segmentSize: 4, spillDirectory: null, spillBytes: 1024);
+        log.Append(new string('x', 40));
+
+        log.SpillPath.ShouldBeNull();
+        log.Spilled.ShouldBe(0);
+    }
+}
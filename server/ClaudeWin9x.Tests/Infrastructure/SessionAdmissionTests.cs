@@ -0,0 +1,183 @@
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+
+namespace ClaudeWin9xServer.Tests.Infrastructure;
+
+public class SessionAdmissionTests
+{
+    private sealed class ManualClock : TimeProvider
+    {
+        public long Ticks { get; set; }
+
+        public override long TimestampFrequency => TimeSpan.TicksPerSecond;
+
+        public override long GetTimestamp() => Ticks;
+
+        public void Advance(TimeSpan by) => Ticks += by.Ticks;
+    }
+
+    private readonly ManualClock _clock = new();
+
+    private SessionAdmission CreateAdmission(int maxRunning) => new(maxRunning, TimeSpan.FromSeconds(30), _clock);
+
+    [Fact]
+    public void TryAdmit_UnderLimit_AdmitsWithoutTicket()
+    {
+        var admission = CreateAdmission(2);
+
+        admission.TryAdmit().Admitted.ShouldBeTrue();
+        admission.TryAdmit().Admitted.ShouldBeTrue();
+
+        var third = admission.TryAdmit();
+        third.Admitted.ShouldBeFalse();
+        third.Ticket.ShouldNotBeNull();
+        third.Position.ShouldBe(1);
+        admission.Running.ShouldBe(2);
+    }
+
+    [Fact]
+    public void Release_HoldsFreedSlotForFrontOfLine()
+    {
+        var admission = CreateAdmission(1);
+        admission.TryAdmit();
+        var first = admission.TryAdmit();
+        var second = admission.TryAdmit();
+
+        admission.Release();
+
+        admission.TryAdmit(second.Ticket).Position.ShouldBe(2);
+        admission.TryAdmit().Admitted.ShouldBeFalse();
+        admission.TryAdmit(first.Ticket).Admitted.ShouldBeTrue();
+        admission.TryAdmit(second.Ticket).Position.ShouldBe(1);
+    }
+
+    [Fact]
+    public void TryAdmit_TicketNotRenewed_LosesItsPlace()
+    {
+        var admission = CreateAdmission(1);
+        admission.TryAdmit();
+        var gone = admission.TryAdmit();
+        var patient = admission.TryAdmit();
+
+        _clock.Advance(TimeSpan.FromSeconds(20));
+        admission.TryAdmit(patient.Ticket).Position.ShouldBe(2);
+        _clock.Advance(TimeSpan.FromSeconds(20));
+
+        admission.TryAdmit(patient.Ticket).Position.ShouldBe(1);
+        admission.TryAdmit(gone.Ticket).Position.ShouldBe(2);
+        admission.Waiting.ShouldBe(2);
+    }
+
+    [Fact]
+    public void HundredClientsReconnectingAtOnce_RunAtMostMaxAndAreAdmittedInArrivalOrder()
+    {
+        const int clients = 100;
+        const int maxRunning = 8;
+        var admission = CreateAdmission(maxRunning);
+        var random = new Random(21);
+        var tickets = new string?[clients];
+        var lastPosition = Enumerable.Repeat(int.MaxValue, clients).ToArray();
+        var admittedOrder = new List<int>();
+        var endsAt = new List<(int Client, int Second)>();
+        var peak = 0;
+
+        // Everyone asks in the same instant, then retries every 2 s as the server tells them to
+        for (var second = 0; admittedOrder.Count < clients; second++)
+        {
+            foreach (var done in endsAt.Where(e => e.Second == second).ToList())
+            {
+                admission.Release();
+                endsAt.Remove(done);
+            }
+
+            if (second % 2 == 0)
+            {
+                for (var client = 0; client < clients; client++)
+                {
+                    if (admittedOrder.Contains(client))
+                    {
+                        continue;
+                    }
+
+                    var decision = admission.TryAdmit(tickets[client]);
+                    if (decision.Admitted)
+                    {
+                        admittedOrder.Add(client);
+                        endsAt.Add((client, second + random.Next(5, 30)));
+                        continue;
+                    }
+
+                    tickets[client] = decision.Ticket;
+                    decision.Position.ShouldBeLessThanOrEqualTo(lastPosition[client]);
+                    lastPosition[client] = decision.Position;
+                }
+            }
+
+            peak = Math.Max(peak, admission.Running);
+            admission.Running.ShouldBeLessThanOrEqualTo(maxRunning);
+            _clock.Advance(TimeSpan.FromSeconds(1));
+        }
+
+        peak.ShouldBe(maxRunning);
+        admittedOrder.ShouldBe(Enumerable.Range(0, clients).ToList());
+        admission.Waiting.ShouldBe(0);
+    }
+
+    [Fact]
+    public async Task ConcurrentStarts_NeverExceedLimit()
+    {
+        var admission = new SessionAdmission(4, TimeSpan.FromSeconds(30));
+        var running = 0;
+        var peak = 0;
+
+        await Task.WhenAll(Enumerable.Range(0, 100).Select(_ => Task.Run(async () =>
+        {
+            string? ticket = null;
+            while (true)
+            {
+                var decision = admission.TryAdmit(ticket);
+                if (decision.Admitted)
+                {
+                    break;
+                }
+                ticket = decision.Ticket;
+                await Task.Delay(1);
+            }
+
+            var now = Interlocked.Increment(ref running);
+            InterlockedMax(ref peak, now);
+            await Task.Delay(2);
+            Interlocked.Decrement(ref running);
+            admission.Release();
+        })));
+
+        peak.ShouldBeLessThanOrEqualTo(4);
+        admission.Running.ShouldBe(0);
+    }
+
+    private static void InterlockedMax(ref int target, int value)
+    {
+        for (var seen = target; value > seen; seen = target)
+        {
+            if (Interlocked.CompareExchange(ref target, value, seen) == seen)
+            {
+                return;
+            }
+        }
+    }
+
+    [Fact]
+    public void Reclaim_TakesSlotEvenWhenFullAndCountsAgainstNewcomers()
+    {
+        var admission = CreateAdmission(1);
+        admission.TryAdmit().Admitted.ShouldBeTrue();
+
+        admission.Reclaim();
+        admission.Running.ShouldBe(2);
+
+        admission.Release();
+        admission.TryAdmit().Admitted.ShouldBeFalse();
+        admission.Release();
+        admission.Running.ShouldBe(0);
+    }
+}
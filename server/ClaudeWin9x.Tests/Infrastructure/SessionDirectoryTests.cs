@@ -0,0 +1,76 @@
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+using ClaudeWin9xServer.Models.Responses;
+
+namespace ClaudeWin9xServer.Tests.Infrastructure;
+
+public class SessionDirectoryTests
+{
+    private sealed class ManualClock : TimeProvider
+    {
+        public DateTimeOffset Now { get; set; } = DateTimeOffset.UnixEpoch;
+
+        public override DateTimeOffset GetUtcNow() => Now;
+    }
+
+    private readonly ManualClock _clock = new();
+    private readonly MemoryWorkStore _store = new();
+
+    private SessionDirectory CreateDirectory(string name, int apiPort) =>
+        new(_store, new InstanceInfo { Name = name, ApiPort = apiPort, DownloadPort = apiPort + 1, UploadPort = apiPort + 2 }, TimeSpan.FromSeconds(30), _clock);
+
+    [Fact]
+    public void Place_PicksInstanceWithFewestSessions()
+    {
+        var a = CreateDirectory("a", 5000);
+        var b = CreateDirectory("b", 6000);
+        a.Announce();
+        b.Announce();
+
+        a.Claim("s1");
+
+        a.Place().Name.ShouldBe("b");
+        b.Place().Name.ShouldBe("b");
+        a.Live().Select(i => (i.Name, i.Sessions)).ShouldBe([("a", 1), ("b", 0)]);
+    }
+
+    [Fact]
+    public void Place_OnTie_StaysHere()
+    {
+        var a = CreateDirectory("a", 5000);
+        var b = CreateDirectory("b", 6000);
+        a.Announce();
+        b.Announce();
+
+        a.Place().Name.ShouldBe("a");
+        b.Place().Name.ShouldBe("b");
+    }
+
+    [Fact]
+    public void Live_LeavesOutInstancesNotHeardFrom()
+    {
+        var a = CreateDirectory("a", 5000);
+        var b = CreateDirectory("b", 6000);
+        b.Announce();
+        a.Claim("s1");
+
+        _clock.Now += TimeSpan.FromSeconds(31);
+
+        a.Live().Select(i => i.Name).ShouldBe(["a"]);
+        a.Place().Name.ShouldBe("a");
+    }
+
+    [Fact]
+    public void Recover_ReleasesOnlyThisInstancesSessions()
+    {
+        var a = CreateDirectory("a", 5000);
+        var b = CreateDirectory("b", 6000);
+        a.Claim("s1");
+        b.Claim("s2");
+
+        CreateDirectory("a", 5000).Recover().ShouldBe(1);
+
+        a.OwnerOf("s1").ShouldBeNull();
+        a.OwnerOf("s2").ShouldBe("b");
+    }
+}
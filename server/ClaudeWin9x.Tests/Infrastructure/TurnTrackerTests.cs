@@ -0,0 +1,83 @@
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+
+namespace ClaudeWin9xServer.Tests.Infrastructure;
+
+public class TurnTrackerTests
+{
+    private readonly TurnTracker _tracker = new();
+
+    [Fact]
+    public void Current_BeforeAnyInput_IsIdleAtZero()
+    {
+        _tracker.Current.ShouldBe(new TurnInfo(TurnState.Idle, 0));
+    }
+
+    [Fact]
+    public void Observe_BeforeAnyInput_StaysIdle()
+    {
+        _tracker.Observe(TurnState.Thinking);
+        _tracker.Observe(TurnState.Done);
+
+        _tracker.Current.ShouldBe(new TurnInfo(TurnState.Idle, 0));
+    }
+
+    [Fact]
+    public void BeginTurn_ThenToolAndResult_FollowsTurnToDone()
+    {
+        _tracker.BeginTurn();
+        _tracker.Current.ShouldBe(new TurnInfo(TurnState.Thinking, 1));
+
+        _tracker.Observe(TurnState.ToolRunning);
+        _tracker.Current.State.ShouldBe(TurnState.ToolRunning);
+
+        _tracker.Observe(TurnState.Thinking);
+        _tracker.Observe(TurnState.Done);
+        _tracker.Current.ShouldBe(new TurnInfo(TurnState.Done, 1));
+    }
+
+    [Fact]
+    public void Observe_WhenSecondInputQueued_StaysBusyUntilLastResult()
+    {
+        _tracker.BeginTurn();
+        _tracker.BeginTurn();
+
+        _tracker.Observe(TurnState.Done);
+        _tracker.Current.ShouldBe(new TurnInfo(TurnState.Thinking, 2));
+
+        _tracker.Observe(TurnState.Done);
+        _tracker.Current.ShouldBe(new TurnInfo(TurnState.Done, 2));
+    }
+
+    [Fact]
+    public void Observe_AfterResult_IgnoresStrayEvents()
+    {
+        _tracker.BeginTurn();
+        _tracker.Observe(TurnState.Done);
+
+        _tracker.Observe(TurnState.Thinking);
+
+        _tracker.Current.State.ShouldBe(TurnState.Done);
+    }
+
+    [Fact]
+    public void End_WhileTurnRunning_MarksDone()
+    {
+        _tracker.BeginTurn();
+        _tracker.Observe(TurnState.ToolRunning);
+
+        _tracker.End();
+
+        _tracker.Current.ShouldBe(new TurnInfo(TurnState.Done, 1));
+    }
+
+    [Fact]
+    public void WithPendingApproval_WhileToolRunning_ReportsAwaitingApproval()
+    {
+        var running = new TurnInfo(TurnState.ToolRunning, 3);
+
+        running.WithPendingApproval(true).ShouldBe(new TurnInfo(TurnState.AwaitingApproval, 3));
+        running.WithPendingApproval(false).ShouldBe(running);
+        new TurnInfo(TurnState.Done, 3).WithPendingApproval(true).State.ShouldBe(TurnState.Done);
+    }
+}
@@ -0,0 +1,100 @@
+using System.Diagnostics;
+using Microsoft.Extensions.Logging;
+using NSubstitute;
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+using ClaudeWin9xServer.Services;
+
+namespace ClaudeWin9xServer.Tests.Infrastructure;
+
+[Collection(nameof(FakeClaudeCli))]
+public class WarmPoolTests : IDisposable
+{
+    private static readonly TimeSpan Loaded = TimeSpan.FromSeconds(3);
+
+    private readonly ILogger<SessionService> _logger = Substitute.For<ILogger<SessionService>>();
+    private readonly FakeClaudeCli _cli = new();
+
+    public void Dispose() => _cli.Dispose();
+
+    private WarmPool CreatePool(int size) =>
+        new(size, () => new ClaudeSession(Guid.NewGuid().ToString("N")[..8], _cli.Directory, null, _logger), _logger);
+
+    private static async Task WaitForReady(WarmPool pool, int count)
+    {
+        var started = Stopwatch.StartNew();
+        while (pool.Ready < count && started.Elapsed < Loaded)
+        {
+            await Task.Delay(10);
+        }
+    }
+
+    [Fact]
+    public async Task TryTake_WhenFilled_ReturnsRunningSession()
+    {
+        using var pool = CreatePool(2);
+        pool.TryTake().ShouldBeNull();
+
+        pool.Fill(room: 5);
+        await WaitForReady(pool, 2);
+
+        using var session = pool.TryTake();
+        session.ShouldNotBeNull();
+        session.IsRunning.ShouldBeTrue();
+        pool.Ready.ShouldBe(1);
+    }
+
+    [Fact]
+    public async Task Fill_WithLessRoom_StopsSurplus()
+    {
+        using var pool = CreatePool(3);
+        pool.Fill(room: 3);
+        await WaitForReady(pool, 3);
+
+        pool.Fill(room: 1);
+        pool.Ready.ShouldBe(1);
+
+        pool.Fill(room: 0);
+        pool.TryTake().ShouldBeNull();
+    }
+
+    [Fact]
+    public async Task StartSession_FromPool_IsReadyFasterAndStillGetsWindowsVersion()
+    {
+        var cold = await TimeToReady(warmPoolSize: 0);
+        var (warm, reply) = await TimeToReadyWithReply(warmPoolSize: 1);
+
+        // Cold pays the CLI's load time; warm only the round trip through the process
+        cold.ShouldBeGreaterThan(FakeClaudeCli.LoadTime);
+        warm.ShouldBeLessThan(cold / 4);
+        reply.ShouldContain("Operating System: Windows 98");
+        reply.ShouldContain("hello");
+    }
+
+    private async Task<TimeSpan> TimeToReady(int warmPoolSize) => (await TimeToReadyWithReply(warmPoolSize)).Took;
+
+    // From /start to the reply to the first message
+    private async Task<(TimeSpan Took, string Reply)> TimeToReadyWithReply(int warmPoolSize)
+    {
+        using var service = new SessionService(_logger, warmPoolSize: warmPoolSize);
+        await service.StartAsync(CancellationToken.None);
+        if (warmPoolSize > 0)
+        {
+            await Task.Delay(Loaded);
+        }
+
+        var started = Stopwatch.StartNew();
+        var (sessionId, _, _, _) = service.StartSession(null, "Windows 98");
+        await service.SendInput(sessionId, "hello");
+
+        var reply = "";
+        while (!reply.Contains("hello") && started.Elapsed < TimeSpan.FromSeconds(10))
+        {
+            reply += (await service.GetOutputAsync(sessionId, TimeSpan.FromSeconds(1)))?.Output.Text;
+        }
+        var took = started.Elapsed;
+
+        await service.StopAsync(CancellationToken.None);
+        return (took, reply);
+    }
+}
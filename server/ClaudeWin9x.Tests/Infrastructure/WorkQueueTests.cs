@@ -0,0 +1,317 @@
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+using ClaudeWin9xServer.Models.Requests;
+using ClaudeWin9xServer.Services;
+
+namespace ClaudeWin9xServer.Tests.Infrastructure;
+
+public class WorkQueueTests
+{
+    private sealed record Work(string Id, string? Channel, string Status, int Priority = 0);
+
+    private sealed class ManualClock : TimeProvider
+    {
+        public long Ticks { get; set; }
+
+        public override long TimestampFrequency => TimeSpan.TicksPerSecond;
+
+        public override long GetTimestamp() => Ticks;
+
+        public void Advance(TimeSpan by) => Ticks += by.Ticks;
+    }
+
+    private readonly ManualClock _clock = new();
+
+    private static WorkQueue<Work> CreateQueue() => new(w => w.Status == "pending", w => w.Channel);
+
+    private WorkQueue<Work> CreatePriorityQueue(bool prioritize = true) =>
+        new(w => w.Status == "pending", w => w.Channel, prioritize ? w => w.Priority : null, TimeSpan.FromSeconds(2), _clock);
+
+    private static Work? Take(WorkQueue<Work> queue, string? channel = null) =>
+        queue.Dispatch(channel, w => w with { Status = "dispatched" });
+
+    [Fact]
+    public void Dispatch_ReturnsItemsInArrivalOrderNotIdOrder()
+    {
+        var queue = CreateQueue();
+        queue.TryAdd("c", new Work("c", null, "pending"));
+        queue.TryAdd("a", new Work("a", null, "pending"));
+        queue.TryAdd("b", new Work("b", null, "pending"));
+
+        Take(queue)!.Id.ShouldBe("c");
+        Take(queue)!.Id.ShouldBe("a");
+        Take(queue)!.Id.ShouldBe("b");
+        Take(queue).ShouldBeNull();
+    }
+
+    [Fact]
+    public void Dispatch_KeepsItemIndexedWithNewStatus()
+    {
+        var queue = CreateQueue();
+        queue.TryAdd("a", new Work("a", null, "pending"));
+
+        Take(queue);
+
+        queue.ContainsKey("a").ShouldBeTrue();
+        queue["a"].Status.ShouldBe("dispatched");
+    }
+
+    [Fact]
+    public void Dispatch_ByChannel_OnlyTakesThatChannel()
+    {
+        var queue = CreateQueue();
+        queue.TryAdd("a", new Work("a", "s1", "pending"));
+        queue.TryAdd("b", new Work("b", "s2", "pending"));
+
+        Take(queue, "s2")!.Id.ShouldBe("b");
+        Take(queue, "s2").ShouldBeNull();
+        Take(queue, "s3").ShouldBeNull();
+        Take(queue, "s1")!.Id.ShouldBe("a");
+    }
+
+    [Fact]
+    public void Dispatch_AnyChannel_TakesOldestAcrossChannels()
+    {
+        var queue = CreateQueue();
+        queue.TryAdd("a", new Work("a", "s1", "pending"));
+        queue.TryAdd("b", new Work("b", "s2", "pending"));
+        queue.TryAdd("c", new Work("c", "s1", "pending"));
+
+        Take(queue)!.Id.ShouldBe("a");
+        Take(queue)!.Id.ShouldBe("b");
+        Take(queue)!.Id.ShouldBe("c");
+    }
+
+    [Fact]
+    public void TryUpdate_WhenItemBecomesReady_QueuesBehindEarlierItems()
+    {
+        var queue = CreateQueue();
+        var held = new Work("held", null, "awaiting_approval");
+        queue.TryAdd("held", held);
+        queue.TryAdd("next", new Work("next", null, "pending"));
+
+        queue.TryUpdate("held", held with { Status = "pending" }, held).ShouldBeTrue();
+
+        Take(queue)!.Id.ShouldBe("next");
+        Take(queue)!.Id.ShouldBe("held");
+    }
+
+    [Fact]
+    public void TryUpdate_WhenComparisonIsStale_ReturnsFalse()
+    {
+        var queue = CreateQueue();
+        queue.TryAdd("a", new Work("a", null, "pending"));
+
+        queue.TryUpdate("a", new Work("a", null, "dispatched"), new Work("a", null, "awaiting_approval")).ShouldBeFalse();
+
+        queue["a"].Status.ShouldBe("pending");
+    }
+
+    [Fact]
+    public void Peek_SkipsRemovedAndNoLongerReadyItems()
+    {
+        var queue = CreateQueue();
+        var answered = new Work("answered", "s1", "pending");
+        queue.TryAdd("removed", new Work("removed", "s1", "pending"));
+        queue.TryAdd("answered", answered);
+        queue.TryAdd("open", new Work("open", "s1", "pending"));
+
+        queue.TryRemove("removed", out _).ShouldBeTrue();
+        queue.TryUpdate("answered", answered with { Status = "approved" }, answered);
+
+        queue.Peek("s1")!.Id.ShouldBe("open");
+        queue.Peek("s1")!.Id.ShouldBe("open");
+        queue.Count.ShouldBe(2);
+    }
+
+    [Fact]
+    public void TryAdd_AfterRemovingSameId_QueuesOnlyTheNewItem()
+    {
+        var queue = CreateQueue();
+        queue.TryAdd("a", new Work("a", null, "pending"));
+        queue.TryRemove("a", out _);
+        queue.TryAdd("a", new Work("a", null, "pending"));
+
+        Take(queue)!.Id.ShouldBe("a");
+        Take(queue).ShouldBeNull();
+    }
+
+    [Fact]
+    public void ChannelCount_DropsChannelOnceNothingInItIsReady()
+    {
+        var queue = CreateQueue();
+        queue.TryAdd("a", new Work("a", "s1", "pending"));
+        queue.TryAdd("b", new Work("b", "s2", "pending"));
+        queue.ChannelCount.ShouldBe(2);
+
+        queue.TryRemove("a", out _);
+        Take(queue, "s2");
+
+        queue.ChannelCount.ShouldBe(0);
+        queue.Count.ShouldBe(1);
+    }
+
+    [Fact]
+    public async Task TryAdd_WhileJournalWrites_LookupsDoNotWaitAndItemAppearsOnlyOnceWritten()
+    {
+        using var writing = new ManualResetEventSlim();
+        using var release = new ManualResetEventSlim();
+        using var store = new HookedWorkStore();
+        store.BeforePut = () =>
+        {
+            writing.Set();
+            release.Wait();
+        };
+        var queue = CommandService.CreateQueue(store.Journal<CommandRequest>("command"));
+
+        var add = Task.Run(() => queue.TryAdd("cmd1", new CommandRequest { Id = "cmd1", Command = "dir", Status = "pending" }));
+        writing.Wait();
+
+        // Bounded only so a lookup stuck behind the write fails the test instead of hanging it
+        var lookup = Task.Run(() => (queue.ContainsKey("cmd1"), queue.Peek()));
+        try
+        {
+            lookup.Wait(TimeSpan.FromSeconds(10)).ShouldBeTrue();
+        }
+        finally
+        {
+            release.Set();
+        }
+        lookup.Result.ShouldBe((false, null));
+
+        (await add).ShouldBeTrue();
+        queue.Peek()!.Id.ShouldBe("cmd1");
+    }
+
+    [Fact]
+    public void TryRemove_WhenJournalRefuses_KeepsTheItem()
+    {
+        using var store = new HookedWorkStore { BeforeRemove = () => throw new IOException("disk full") };
+        var queue = CommandService.CreateQueue(store.Journal<CommandRequest>("command"));
+        queue.TryAdd("cmd1", new CommandRequest { Id = "cmd1", Command = "dir", Status = "pending" });
+
+        Should.Throw<IOException>(() => queue.TryRemove("cmd1", out _));
+
+        queue.Peek()!.Id.ShouldBe("cmd1");
+    }
+
+    [Fact]
+    public void Dispatch_ServesMoreUrgentClassFirst()
+    {
+        var queue = CreatePriorityQueue();
+        queue.TryAdd("build", new Work("build", "s1", "pending", WorkPriority.Long));
+        queue.TryAdd("write", new Work("write", "s1", "pending", WorkPriority.Write));
+        queue.TryAdd("list", new Work("list", "s1", "pending", WorkPriority.Small));
+        queue.TryAdd("read", new Work("read", "s1", "pending", WorkPriority.Small));
+
+        Take(queue, "s1")!.Id.ShouldBe("list");
+        Take(queue, "s1")!.Id.ShouldBe("read");
+        Take(queue, "s1")!.Id.ShouldBe("write");
+        Take(queue, "s1")!.Id.ShouldBe("build");
+    }
+
+    [Fact]
+    public void Dispatch_AgedItemOvertakesFresherUrgentOnes()
+    {
+        var queue = CreatePriorityQueue();
+        queue.TryAdd("build", new Work("build", null, "pending", WorkPriority.Long));
+
+        _clock.Advance(TimeSpan.FromSeconds(4));
+        queue.TryAdd("list", new Work("list", null, "pending", WorkPriority.Small));
+
+        // Two steps of waiting bring the build level with the listing, and it came first
+        Take(queue)!.Id.ShouldBe("build");
+        Take(queue)!.Id.ShouldBe("list");
+    }
+
+    [Fact]
+    public void Dispatch_HandsOverTheClassAfterAgeing()
+    {
+        var queue = CreatePriorityQueue();
+        queue.TryAdd("build", new Work("build", null, "pending", WorkPriority.Long));
+        queue.TryAdd("write", new Work("write", null, "pending", WorkPriority.Write));
+
+        var taken = new List<int>();
+        queue.Dispatch(null, (w, priority) => { taken.Add(priority); return w with { Status = "dispatched" }; });
+        _clock.Advance(TimeSpan.FromSeconds(5));
+        queue.PeekPriority().ShouldBe(WorkPriority.Long - 2);
+        queue.Dispatch(null, (w, priority) => { taken.Add(priority); return w with { Status = "dispatched" }; });
+
+        // The build waited two steps, so it goes out one class ahead of a fresh write
+        taken.ShouldBe([WorkPriority.Write, WorkPriority.Long - 2]);
+        queue.PeekPriority().ShouldBeNull();
+    }
+
+    [Fact]
+    public void Dispatch_AnyChannel_ComparesClassesAcrossChannels()
+    {
+        var queue = CreatePriorityQueue();
+        queue.TryAdd("build", new Work("build", "s1", "pending", WorkPriority.Long));
+        queue.TryAdd("read", new Work("read", "s2", "pending", WorkPriority.Small));
+
+        Take(queue)!.Id.ShouldBe("read");
+        Take(queue)!.Id.ShouldBe("build");
+    }
+
+    [Fact]
+    public void MixedLoad_PrioritiesCutSmallOpP95AndStillServeEverything()
+    {
+        var fifo = SimulateMixedLoad(prioritize: false);
+        var classed = SimulateMixedLoad(prioritize: true);
+
+        classed.Served.ShouldBe(fifo.Served);
+        classed.SmallP95.ShouldBeLessThan(fifo.SmallP95 / 3);
+        classed.LongestWait.ShouldBeLessThan(TimeSpan.FromSeconds(3));
+    }
+
+    // One client working through a stream of listings, writes and commands, one at a time
+    private (TimeSpan SmallP95, TimeSpan LongestWait, int Served) SimulateMixedLoad(bool prioritize)
+    {
+        var queue = CreatePriorityQueue(prioritize);
+        var random = new Random(17);
+        var arrived = new Dictionary<string, long>();
+        var cost = new Dictionary<string, TimeSpan>();
+        var smallLatency = new List<TimeSpan>();
+        var longestWait = TimeSpan.Zero;
+        var busyUntil = 0L;
+        var served = 0;
+        var start = _clock.Ticks;
+
+        for (var ms = 0; ms < 120_000 || !queue.IsEmpty; ms++)
+        {
+            if (ms < 120_000 && ms % 40 == 0)
+            {
+                var roll = random.Next(10);
+                var (priority, took) = roll switch
+                {
+                    < 7 => (WorkPriority.Small, TimeSpan.FromMilliseconds(2)),
+                    < 9 => (WorkPriority.Write, TimeSpan.FromMilliseconds(40)),
+                    _ => (WorkPriority.Long, TimeSpan.FromMilliseconds(200))
+                };
+                var id = $"w{ms}";
+                arrived[id] = _clock.Ticks;
+                cost[id] = took;
+                queue.TryAdd(id, new Work(id, "s1", "pending", priority));
+            }
+
+            if (_clock.Ticks >= busyUntil && Take(queue, "s1") is { } work)
+            {
+                var waited = TimeSpan.FromTicks(_clock.Ticks - arrived[work.Id]);
+                longestWait = waited > longestWait ? waited : longestWait;
+                if (work.Priority == WorkPriority.Small)
+                {
+                    smallLatency.Add(waited + cost[work.Id]);
+                }
+                busyUntil = _clock.Ticks + cost[work.Id].Ticks;
+                queue.TryRemove(work.Id, out _);
+                served++;
+            }
+
+            _clock.Advance(TimeSpan.FromMilliseconds(1));
+        }
+
+        smallLatency.Sort();
+        _clock.Ticks = start;
+        return (smallLatency[(int)(smallLatency.Count * 0.95)], longestWait, served);
+    }
+}
@@ -0,0 +1,50 @@
+using System.Text;
+using System.Text.Json;
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+
+namespace ClaudeWin9xServer.Tests.Integration;
+
+/// <summary>
+/// Runs two real server processes over one shared journal.
+/// </summary>
+public sealed class MultiProcessTests : IDisposable
+{
+    private readonly ServerProcesses _fleet = new();
+
+    public void Dispose() => _fleet.Dispose();
+
+    [Fact]
+    public async Task TwoProcesses_ShareDirectoryAndPlaceSessionsOnTheLessLoadedOne()
+    {
+        // Left behind by an earlier run of "a", and a session "a" is already running
+        using (var journal = new JournalWorkStore(Path.Combine(_fleet.Directory, "state")))
+        {
+            journal.Put("command/a", "lost", "{\"id\":\"lost\",\"command\":\"dir\",\"status\":\"dispatched\"}");
+        }
+
+        var a = await _fleet.StartAsync("a");
+        var b = await _fleet.StartAsync("b");
+
+        using (var journal = new JournalWorkStore(Path.Combine(_fleet.Directory, "state")))
+        {
+            journal.Put("session", "busy", "{\"owner\":\"a\",\"started\":\"2026-01-01T00:00:00Z\"}");
+        }
+
+        var fleet = await _fleet.GetAsync(a, "/sessions/instances");
+        fleet.GetProperty("self").GetString().ShouldBe("a");
+        fleet.GetProperty("instances").EnumerateArray()
+            .Select(i => (i.GetProperty("name").GetString(), i.GetProperty("sessions").GetInt32()))
+            .ShouldBe([("a", 1), ("b", 0)]);
+
+        var start = await _fleet.Http.PostAsync($"http://127.0.0.1:{a}/start",
+            new StringContent("{\"windows_version\":\"Windows 98\"}", Encoding.UTF8, "application/json"));
+        var moved = JsonDocument.Parse(await start.Content.ReadAsStringAsync()).RootElement;
+        moved.GetProperty("status").GetString().ShouldBe("moved");
+        moved.GetProperty("api_port").GetInt32().ShouldBe(b);
+
+        var lost = await _fleet.GetAsync(a, "/cmd/status?command_id=lost");
+        lost.GetProperty("status").GetString().ShouldBe("completed");
+        lost.GetProperty("exit_code").GetInt32().ShouldBe(-1);
+    }
+}
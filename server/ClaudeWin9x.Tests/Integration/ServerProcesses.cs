@@ -0,0 +1,96 @@
+using System.Diagnostics;
+using System.Net;
+using System.Net.Sockets;
+using System.Text.Json;
+using ClaudeWin9xServer.Infrastructure;
+
+namespace ClaudeWin9xServer.Tests.Integration;
+
+/// <summary>
+/// Real server processes started from the test build, with their config and state under one temp directory.
+/// </summary>
+public sealed class ServerProcesses : IDisposable
+{
+    private readonly List<Process> _servers = [];
+
+    public string Directory { get; } = Path.Combine(Path.GetTempPath(), $"fleet_{Guid.NewGuid():N}");
+
+    public HttpClient Http { get; } = new() { Timeout = TimeSpan.FromSeconds(10) };
+
+    public ServerProcesses()
+    {
+        System.IO.Directory.CreateDirectory(Directory);
+        Http.DefaultRequestHeaders.Add("X-API-Key", IniConfig.ApiKey);
+    }
+
+    public void Dispose()
+    {
+        foreach (var server in _servers)
+        {
+            if (!server.HasExited)
+            {
+                server.Kill(entireProcessTree: true);
+                server.WaitForExit(5000);
+            }
+            server.Dispose();
+        }
+        Http.Dispose();
+        System.IO.Directory.Delete(Directory, recursive: true);
+    }
+
+    private static int FreePort()
+    {
+        using var listener = new TcpListener(IPAddress.Loopback, 0);
+        listener.Start();
+        return ((IPEndPoint)listener.LocalEndpoint).Port;
+    }
+
+    /// <summary>
+    /// Starts instance <paramref name="name"/> and returns its API port once it answers.
+    /// </summary>
+    public async Task<int> StartAsync(string name)
+    {
+        var apiPort = FreePort();
+        var ini = Path.Combine(Directory, $"{name}.ini");
+        File.WriteAllText(ini, $"""
+            [server]
+            api_port = {apiPort}
+            download_port = {FreePort()}
+            upload_port = {FreePort()}
+            frame_port = 0
+            state_dir = {Path.Combine(Directory, "state")}
+            instance_name = {name}
+            warm_pool_size = 0
+            """);
+
+        var server = Process.Start(new ProcessStartInfo("dotnet")
+        {
+            ArgumentList = { Path.Combine(AppContext.BaseDirectory, "ClaudeWin9x-Server.dll"), "--config", ini },
+            RedirectStandardOutput = true,
+            RedirectStandardError = true,
+            UseShellExecute = false
+        })!;
+        _servers.Add(server);
+        server.OutputDataReceived += (_, _) => { };
+        server.ErrorDataReceived += (_, _) => { };
+        server.BeginOutputReadLine();
+        server.BeginErrorReadLine();
+
+        var started = Stopwatch.StartNew();
+        while (true)
+        {
+            try
+            {
+                await Http.GetStringAsync($"http://127.0.0.1:{apiPort}/");
+                return apiPort;
+            }
+            catch (HttpRequestException) when (started.Elapsed < TimeSpan.FromSeconds(30) && !server.HasExited)
+            {
+                await Task.Delay(100);
+            }
+        }
+    }
+
+    public async Task<JsonElement> GetAsync(int port, string path) =>
+        JsonDocument.Parse(await Http.GetStringAsync($"http://127.0.0.1:{port}{path}")).RootElement;
+}
@@ -0,0 +1,54 @@
+using System.Net;
+using System.Text;
+using System.Text.Json;
+using Shouldly;
+using ClaudeWin9xServer.Tests.Infrastructure;
+
+namespace ClaudeWin9xServer.Tests.Integration;
+
+/// <summary>
+/// Work sent without a session id while one server runs several sessions.
+/// </summary>
+[Collection(nameof(FakeClaudeCli))]
+public sealed class SessionBindingTests : IDisposable
+{
+    private readonly FakeClaudeCli _cli = new();
+    private readonly ServerProcesses _fleet = new();
+
+    public void Dispose()
+    {
+        _fleet.Dispose();
+        _cli.Dispose();
+    }
+
+    private async Task<string> StartSessionAsync(int port)
+    {
+        var start = await _fleet.Http.PostAsync($"http://127.0.0.1:{port}/start",
+            new StringContent("{\"windows_version\":\"Windows 98\"}", Encoding.UTF8, "application/json"));
+        var session = JsonDocument.Parse(await start.Content.ReadAsStringAsync()).RootElement;
+        session.GetProperty("status").GetString().ShouldBe("running");
+        return session.GetProperty("session_id").GetString()!;
+    }
+
+    [Fact]
+    public async Task WorkWithoutSessionId_WithTwoLiveSessions_IsRefusedAtOnce()
+    {
+        var port = await _fleet.StartAsync("solo");
+        await StartSessionAsync(port);
+        await StartSessionAsync(port);
+
+        var queue = await _fleet.Http.PostAsync($"http://127.0.0.1:{port}/cmd/queue",
+            new StringContent("{\"command\":\"dir\"}", Encoding.UTF8, "application/json"));
+        var write = await _fleet.Http.PostAsync($"http://127.0.0.1:{port}/fs/write",
+            new StringContent("{\"path\":\"C:\\\\A.TXT\",\"content\":\"a\"}", Encoding.UTF8, "application/json"));
+        var list = await _fleet.Http.GetAsync($"http://127.0.0.1:{port}/fs/list?path=C:\\");
+        var read = await _fleet.Http.GetAsync($"http://127.0.0.1:{port}/fs/read?path=C:\\A.TXT");
+
+        foreach (var response in new[] { queue, write, list, read })
+        {
+            response.StatusCode.ShouldBe(HttpStatusCode.BadRequest);
+            var error = JsonDocument.Parse(await response.Content.ReadAsStringAsync()).RootElement;
+            error.GetProperty("error").GetString()!.ShouldContain("session_id");
+        }
+    }
+}
@@ -2,6 +2,7 @@ using System.Collections.Concurrent;
 using Microsoft.Extensions.Logging;
 using NSubstitute;
 using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
 using ClaudeWin9xServer.Models.Responses;
 using ClaudeWin9xServer.Services;
 
@@ -9,7 +10,7 @@ namespace ClaudeWin9xServer.Tests.Services;
 
 public class ApprovalServiceTests
 {
-    private readonly ConcurrentDictionary<string, ToolApprovalRequest> _pendingApprovals = new();
+    private readonly WorkQueue<ToolApprovalRequest> _pendingApprovals = ApprovalService.CreateQueue();
     private readonly ConcurrentDictionary<string, TaskCompletionSource<bool>> _approvalWaiters = new();
     private readonly ILogger<ApprovalService> _logger = Substitute.For<ILogger<ApprovalService>>();
 
@@ -221,7 +222,7 @@ public class ApprovalServiceTests
             TimeSpan.FromMilliseconds(100));
 
         result.ShouldBeFalse();
-        _pendingApprovals.ShouldBeEmpty();
+        _pendingApprovals.IsEmpty.ShouldBeTrue();
         _approvalWaiters.ShouldBeEmpty();
     }
 
@@ -263,7 +264,7 @@ public class ApprovalServiceTests
         service.SubmitResponse(pending.Id, approved: true);
         await approvalTask;
 
-        _pendingApprovals.ShouldBeEmpty();
+        _pendingApprovals.IsEmpty.ShouldBeTrue();
         _approvalWaiters.ShouldBeEmpty();
     }
 
@@ -1,24 +1,34 @@
 using System.Collections.Concurrent;
+using System.Diagnostics;
 using Microsoft.Extensions.Logging;
 using NSubstitute;
 using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
 using ClaudeWin9xServer.Models.Requests;
 using ClaudeWin9xServer.Models.Responses;
 using ClaudeWin9xServer.Services;
 using ClaudeWin9xServer.Services.Interfaces;
+using ClaudeWin9xServer.Tests.Infrastructure;
+using Xunit.Abstractions;
 
 namespace ClaudeWin9xServer.Tests.Services;
 
-public class CommandServiceTests
+public class CommandServiceTests(ITestOutputHelper output)
 {
-    private readonly ConcurrentDictionary<string, CommandRequest> _pendingCommands = new();
-    private readonly ConcurrentDictionary<string, CommandResult> _commandResults = new();
+    private readonly WorkQueue<CommandRequest> _pendingCommands = CommandService.CreateQueue();
+    private readonly LatencyEstimator _latency = new(TimeSpan.FromMilliseconds(50), TimeSpan.FromMilliseconds(50), TimeSpan.FromSeconds(10))
+    {
+        RenewedLeaseFloor = TimeSpan.FromMilliseconds(150),
+        RenewedLeaseCeiling = TimeSpan.FromMilliseconds(150)
+    };
+    private readonly LeaseTable _leases = new();
+    private readonly CommandResultStore _commandResults = new(1024 * 1024, TimeSpan.FromMinutes(30));
     private readonly ConcurrentDictionary<string, TaskCompletionSource<CommandResult>> _commandWaiters = new();
     private readonly IApprovalService _approvalService = Substitute.For<IApprovalService>();
     private readonly ILogger<CommandService> _logger = Substitute.For<ILogger<CommandService>>();
 
     private CommandService CreateService(TimeSpan? timeout = null) =>
-        new(_pendingCommands, _commandResults, _commandWaiters, _approvalService, _logger, timeout);
+        new(_pendingCommands, _commandResults, _commandWaiters, _latency, _leases, _approvalService, _logger, timeout);
 
     [Fact]
     public void PollPendingCommand_WhenPendingCommandExists_ReturnsAndDispatchesCommand()
@@ -91,8 +101,8 @@ public class CommandServiceTests
         };
         service.SubmitResult(result);
 
-        _commandResults.ShouldContainKey("cmd1");
-        _pendingCommands.ShouldNotContainKey("cmd1");
+        _commandResults.TryGet("cmd1").ShouldNotBeNull();
+        _pendingCommands.ContainsKey("cmd1").ShouldBeFalse();
     }
 
     [Fact]
@@ -106,7 +116,7 @@ public class CommandServiceTests
             Stdout = "output",
             Stderr = "error"
         };
-        _commandResults.TryAdd("cmd1", expected);
+        _commandResults.Add("cmd1", expected);
 
         var result = service.GetCommandStatus("cmd1");
 
@@ -178,6 +188,36 @@ public class CommandServiceTests
         commandResult.Stdout.ShouldBe("file1.txt\nfile2.txt");
     }
 
+    [Fact]
+    public async Task PollPendingCommandAsync_WhenCommandQueuedDuringWait_ReturnsCommand()
+    {
+        var service = CreateService(timeout: TimeSpan.FromSeconds(2));
+
+        var pollTask = service.PollPendingCommandAsync(TimeSpan.FromSeconds(5));
+        await Task.Delay(50);
+        pollTask.IsCompleted.ShouldBeFalse();
+
+        var queueTask = service.QueueCommandAsync("dir", null);
+
+        var pending = await pollTask.WaitAsync(TimeSpan.FromSeconds(2));
+        pending.ShouldNotBeNull();
+        pending.Command.ShouldBe("dir");
+        pending.Status.ShouldBe("dispatched");
+
+        service.SubmitResult(new CommandResult { CommandId = pending.Id, ExitCode = 0 });
+        (await queueTask).ShouldNotBeNull();
+    }
+
+    [Fact]
+    public async Task PollPendingCommandAsync_WhenNothingQueued_ReturnsNullAfterWait()
+    {
+        var service = CreateService();
+
+        var pending = await service.PollPendingCommandAsync(TimeSpan.FromMilliseconds(100));
+
+        pending.ShouldBeNull();
+    }
+
     [Fact]
     public async Task QueueCommandAsync_WhenApproved_QueuesCommandAndReturnsResult()
     {
@@ -189,14 +229,15 @@ public class CommandServiceTests
             Arg.Any<string>(),
             Arg.Any<string>(),
             Arg.Any<TimeSpan>(),
-            Arg.Any<CancellationToken>())
+            Arg.Any<CancellationToken>(),
+            Arg.Any<string?>())
             .Returns(Task.FromResult(true));
 
         var service = CreateService(timeout: TimeSpan.FromSeconds(2));
         var queueTask = service.QueueCommandAsync("dir", null, sessionId);
 
         // Wait for command to be queued and poll it
-        var pendingCommand = await WaitForPendingCommandAsync(service);
+        var pendingCommand = await WaitForPendingCommandAsync(service, sessionId);
         pendingCommand.ShouldNotBeNull();
         pendingCommand!.Id.ShouldNotBeNull();
 
@@ -218,7 +259,8 @@ public class CommandServiceTests
             "Bash",
             "dir",
             Arg.Any<TimeSpan>(),
-            Arg.Any<CancellationToken>());
+            Arg.Any<CancellationToken>(),
+            Arg.Any<string?>());
     }
 
     [Fact]
@@ -232,7 +274,8 @@ public class CommandServiceTests
             Arg.Any<string>(),
             Arg.Any<string>(),
             Arg.Any<TimeSpan>(),
-            Arg.Any<CancellationToken>())
+            Arg.Any<CancellationToken>(),
+            Arg.Any<string?>())
             .Returns(Task.FromResult(false));
 
         var service = CreateService(timeout: TimeSpan.FromSeconds(2));
@@ -241,7 +284,39 @@ public class CommandServiceTests
         result.ShouldNotBeNull();
         result.ExitCode.ShouldBe(-1);
         result.Stderr.ShouldBe("Command rejected by user");
-        _pendingCommands.ShouldBeEmpty();
+        _pendingCommands.IsEmpty.ShouldBeTrue();
+    }
+
+    [Fact]
+    public async Task DispatchApproved_WhileAwaitingApproval_HandsOverCommandOnce()
+    {
+        var approval = new TaskCompletionSource<bool>();
+        _approvalService.RequestApprovalAsync(
+            Arg.Any<string>(),
+            Arg.Any<string>(),
+            Arg.Any<string>(),
+            Arg.Any<TimeSpan>(),
+            Arg.Any<CancellationToken>(),
+            Arg.Any<string?>())
+            .Returns(approval.Task);
+
+        var service = CreateService(timeout: TimeSpan.FromSeconds(2));
+        var queueTask = service.QueueCommandAsync("dir", null, "session1");
+
+        var cmdId = _pendingCommands.Keys.Single();
+        service.PollPendingCommand().ShouldBeNull();
+
+        var dispatched = service.DispatchApproved(cmdId);
+        approval.SetResult(true);
+
+        dispatched.ShouldNotBeNull();
+        dispatched.Command.ShouldBe("dir");
+        dispatched.Status.ShouldBe("dispatched");
+        service.DispatchApproved(cmdId).ShouldBeNull();
+        (await service.PollPendingCommandAsync(TimeSpan.FromMilliseconds(100))).ShouldBeNull();
+
+        service.SubmitResult(new CommandResult { CommandId = cmdId, ExitCode = 0, Stdout = "ok" });
+        (await queueTask)!.Stdout.ShouldBe("ok");
     }
 
     [Fact]
@@ -252,15 +327,233 @@ public class CommandServiceTests
         var result = await service.QueueCommandAsync("dir", null);
 
         result.ShouldBeNull();
-        _pendingCommands.ShouldBeEmpty();
+        _pendingCommands.IsEmpty.ShouldBeTrue();
+    }
+
+    [Fact]
+    public async Task QueueCommandAsync_WhenJournalRefusesTheCommand_LeavesNothingBehind()
+    {
+        using var store = new HookedWorkStore { BeforePut = () => throw new IOException("disk full") };
+        var pending = CommandService.CreateQueue(store.Journal<CommandRequest>("command"));
+        var service = new CommandService(pending, _commandResults, _commandWaiters, _latency, _leases, _approvalService, _logger, null);
+
+        await Should.ThrowAsync<IOException>(() => service.QueueCommandAsync("dir", null));
+
+        pending.IsEmpty.ShouldBeTrue();
+        _commandWaiters.ShouldBeEmpty();
+    }
+
+    [Fact]
+    public void PollPendingCommand_With10kQueued_DispatchesAllInArrivalOrder()
+    {
+        var service = CreateService();
+        var ids = Enumerable.Range(0, 10_000).Select(i => $"{Guid.NewGuid():N}"[..4] + i.ToString("x4")).ToList();
+        foreach (var id in ids)
+        {
+            _pendingCommands.TryAdd(id, new CommandRequest { Id = id, Command = "dir", Status = "pending" });
+        }
+
+        var order = new List<string>();
+        while (service.PollPendingCommand() is { } command)
+        {
+            order.Add(command.Id!);
+        }
+
+        order.ShouldBe(ids);
+    }
+
+    [Fact]
+    public void PollPendingCommand_With10kQueued_ReportsDispatchRate()
+    {
+        const int count = 10_000;
+        var service = CreateService();
+
+        var elapsed = Stopwatch.StartNew();
+        for (var i = 0; i < count; i++)
+        {
+            _pendingCommands.TryAdd($"cmd{i}", new CommandRequest { Id = $"cmd{i}", Command = "dir", Status = "pending" });
+        }
+        var queueTime = elapsed.Elapsed;
+
+        // Measured, not asserted: the figure is for comparing runs on one machine
+        elapsed.Restart();
+        for (var i = 0; i < count; i++)
+        {
+            service.PollPendingCommand().ShouldNotBeNull();
+        }
+        var dispatchTime = elapsed.Elapsed;
+
+        output.WriteLine($"queued {count} in {queueTime.TotalMilliseconds:F1} ms ({count / queueTime.TotalSeconds:N0}/s), " +
+            $"dispatched in {dispatchTime.TotalMilliseconds:F1} ms ({count / dispatchTime.TotalSeconds:N0}/s)");
+    }
+
+    [Fact]
+    public async Task SubmitResult_100kCommands_StaysWithinStoreBudgetThroughout()
+    {
+        const int count = 100_000;
+        var service = CreateService(timeout: TimeSpan.FromSeconds(5));
+        var stdout = new string('x', 4096);
+        var peak = 0L;
+
+        var before = GC.GetTotalMemory(true);
+        for (var i = 0; i < count; i++)
+        {
+            var queued = service.QueueCommandAsync("make", null);
+            var pending = service.PollPendingCommand()!;
+            service.SubmitResult(new CommandResult { CommandId = pending.Id, ExitCode = 0, Stdout = stdout });
+            await queued;
+            peak = Math.Max(peak, _commandResults.ResidentBytes);
+        }
+        var after = GC.GetTotalMemory(true);
+
+        // 100k results of 4 KB would be 400 MB; the 1 MB store keeps at most 256 of them alive
+        peak.ShouldBeLessThanOrEqualTo(_commandResults.MaxBytes);
+        (after - before).ShouldBeLessThan(32L * 1024 * 1024);
+        _commandResults.Evictions.ShouldBeGreaterThanOrEqualTo(count - _commandResults.MaxBytes / stdout.Length);
+        _pendingCommands.IsEmpty.ShouldBeTrue();
+        _commandWaiters.ShouldBeEmpty();
+    }
+
+    [Fact]
+    public async Task PollPendingCommand_WhenDispatchIsLost_OffersCommandAgainAfterLease()
+    {
+        var service = CreateService(timeout: TimeSpan.FromSeconds(5));
+
+        var queued = service.QueueCommandAsync("dir", null);
+        var lost = await WaitForPendingCommandAsync(service);
+        lost!.LeaseMs.ShouldBe(150);
+
+        var again = await WaitForPendingCommandAsync(service, attempts: 100);
+        again.ShouldNotBeNull();
+        again.Id.ShouldBe(lost.Id);
+
+        service.SubmitResult(new CommandResult { CommandId = again.Id, ExitCode = 0, Stdout = "ok" });
+        (await queued)!.Stdout.ShouldBe("ok");
+        _leases.Expired.ShouldBe(1);
+    }
+
+    [Fact]
+    public async Task RenewLease_WhileCommandRuns_KeepsItFromBeingOfferedAgain()
+    {
+        var service = CreateService(timeout: TimeSpan.FromSeconds(5));
+
+        var queued = service.QueueCommandAsync("compile.bat", null);
+        var running = await WaitForPendingCommandAsync(service);
+
+        for (var i = 0; i < 8; i++)
+        {
+            await Task.Delay(50);
+            service.RenewLease(running!.Id!).ShouldBeTrue();
+            service.PollPendingCommand().ShouldBeNull();
+        }
+
+        service.SubmitResult(new CommandResult { CommandId = running!.Id, ExitCode = 0, Stdout = "built" });
+        (await queued)!.Stdout.ShouldBe("built");
+        service.RenewLease(running.Id!).ShouldBeFalse();
+        _leases.Expired.ShouldBe(0);
+    }
+
+    [Fact]
+    public async Task RenewLease_PastTheCeiling_StopsHoldingTheCommand()
+    {
+        var latency = new LatencyEstimator(TimeSpan.FromMilliseconds(50), TimeSpan.FromMilliseconds(50), TimeSpan.FromMilliseconds(400))
+        {
+            RenewedLeaseFloor = TimeSpan.FromMilliseconds(150),
+            RenewedLeaseCeiling = TimeSpan.FromMilliseconds(150)
+        };
+        var service = new CommandService(_pendingCommands, _commandResults, _commandWaiters, latency, _leases, _approvalService, _logger, TimeSpan.FromMilliseconds(300));
+
+        var queued = service.QueueCommandAsync("compile.bat", null);
+        var running = await WaitForPendingCommandAsync(service);
+
+        // Each renewal alone would hold it 300 ms more, for as long as the client kept at it
+        var renewing = Stopwatch.StartNew();
+        while (!queued.IsCompleted && renewing.Elapsed < TimeSpan.FromSeconds(5))
+        {
+            await Task.Delay(50);
+            service.RenewLease(running!.Id!);
+        }
+
+        queued.IsCompleted.ShouldBeTrue();
+        (await queued).ShouldBeNull();
+        renewing.Elapsed.ShouldBeLessThan(TimeSpan.FromSeconds(2));
+    }
+
+    [Fact]
+    public async Task RenewLease_AfterLeaseRanOut_TakesCommandBackIfNobodyElseHasIt()
+    {
+        var service = CreateService(timeout: TimeSpan.FromSeconds(5));
+
+        var queued = service.QueueCommandAsync("compile.bat", null);
+        var running = await WaitForPendingCommandAsync(service);
+        await Task.Delay(400);
+
+        service.RenewLease(running!.Id!).ShouldBeTrue();
+
+        service.PollPendingCommand().ShouldBeNull();
+        service.SubmitResult(new CommandResult { CommandId = running.Id, ExitCode = 0, Stdout = "built" });
+        (await queued)!.Stdout.ShouldBe("built");
+    }
+
+    [Fact]
+    public async Task PollPendingCommand_AfterLastDelivery_StopsOfferingIt()
+    {
+        var service = CreateService(timeout: TimeSpan.FromMilliseconds(600));
+
+        var queued = service.QueueCommandAsync("dir", null);
+        for (var i = 0; i < LeaseTable.MaxDeliveries; i++)
+        {
+            (await WaitForPendingCommandAsync(service, attempts: 100)).ShouldNotBeNull();
+        }
+
+        await Task.Delay(400);
+        service.PollPendingCommand().ShouldBeNull();
+        (await queued).ShouldBeNull();
+    }
+
+    [Fact]
+    public void PollPendingCommand_OnlyReturnsCommandsForThatSession()
+    {
+        var service = CreateService();
+        _pendingCommands.TryAdd("cmd1", new CommandRequest { Id = "cmd1", Command = "dir", SessionId = "machineA", Status = "pending" });
+        _pendingCommands.TryAdd("cmd2", new CommandRequest { Id = "cmd2", Command = "ver", SessionId = "machineB", Status = "pending" });
+
+        service.PollPendingCommand().ShouldBeNull();
+        service.PollPendingCommand("machineB")!.Id.ShouldBe("cmd2");
+        service.PollPendingCommand("machineB").ShouldBeNull();
+        service.PollPendingCommand("machineA")!.Id.ShouldBe("cmd1");
+    }
+
+    [Fact]
+    public async Task QueueCommandAsync_WhenSessionEnds_GivesUpAtOnce()
+    {
+        _approvalService.RequestApprovalAsync(
+            Arg.Any<string>(),
+            Arg.Any<string>(),
+            Arg.Any<string>(),
+            Arg.Any<TimeSpan>(),
+            Arg.Any<CancellationToken>(),
+            Arg.Any<string?>())
+            .Returns(Task.FromResult(true));
+
+        using var ended = new CancellationTokenSource();
+        var service = CreateService(timeout: TimeSpan.FromSeconds(30));
+        var queueTask = service.QueueCommandAsync("dir", null, "session1", ended.Token);
+        (await WaitForPendingCommandAsync(service, "session1")).ShouldNotBeNull();
+
+        ended.Cancel();
+
+        (await queueTask.WaitAsync(TimeSpan.FromSeconds(2))).ShouldBeNull();
+        _pendingCommands.IsEmpty.ShouldBeTrue();
+        _commandWaiters.IsEmpty.ShouldBeTrue();
     }
 
 
-    private static async Task<CommandRequest?> WaitForPendingCommandAsync(CommandService service, int attempts = 50, int delayMs = 10)
+    private static async Task<CommandRequest?> WaitForPendingCommandAsync(CommandService service, string? sessionId = null, int attempts = 50, int delayMs = 10)
     {
         for (var i = 0; i < attempts; i++)
         {
-            var pending = service.PollPendingCommand();
+            var pending = service.PollPendingCommand(sessionId);
             if (pending != null)
             {
                 return pending;
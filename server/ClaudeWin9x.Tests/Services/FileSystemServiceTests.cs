@@ -2,6 +2,7 @@ using System.Collections.Concurrent;
 using Microsoft.Extensions.Logging;
 using NSubstitute;
 using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
 using ClaudeWin9xServer.Models.Responses;
 using ClaudeWin9xServer.Services;
 using ClaudeWin9xServer.Services.Interfaces;
@@ -10,13 +11,26 @@ namespace ClaudeWin9xServer.Tests.Services;
 
 public class FileSystemServiceTests
 {
-    private readonly ConcurrentDictionary<string, FileOperation> _pendingFileOps = new();
+    private sealed class ManualClock : TimeProvider
+    {
+        public long Ticks { get; set; }
+
+        public override long TimestampFrequency => TimeSpan.TicksPerSecond;
+
+        public override long GetTimestamp() => Ticks;
+
+        public void Advance(TimeSpan by) => Ticks += by.Ticks;
+    }
+
+    private readonly WorkQueue<FileOperation> _pendingFileOps = FileSystemService.CreateQueue();
     private readonly ConcurrentDictionary<string, TaskCompletionSource<FileOpResult>> _fileOpWaiters = new();
+    private readonly LatencyEstimator _latency = new(TimeSpan.FromMilliseconds(50), TimeSpan.FromMilliseconds(50), TimeSpan.FromSeconds(10));
+    private readonly LeaseTable _leases = new();
     private readonly IApprovalService _approvalService = Substitute.For<IApprovalService>();
     private readonly ILogger<FileSystemService> _logger = Substitute.For<ILogger<FileSystemService>>();
 
-    private FileSystemService CreateService(TimeSpan? readTimeout = null, TimeSpan? writeTimeout = null) =>
-        new(_pendingFileOps, _fileOpWaiters, _approvalService, _logger, readTimeout, writeTimeout);
+    private FileSystemService CreateService(TimeSpan? readTimeout = null, TimeSpan? writeTimeout = null, LatencyEstimator? latency = null) =>
+        new(_pendingFileOps, _fileOpWaiters, latency ?? _latency, _leases, _approvalService, _logger, readTimeout, writeTimeout);
 
     [Fact]
     public void PollPendingOperation_WhenPendingOpExists_ReturnsAndDispatchesOp()
@@ -70,6 +84,17 @@ public class FileSystemServiceTests
         result.Id.ShouldBe("op2");
     }
 
+    [Fact]
+    public void PollPendingOperation_ServesReadsAndListingsAheadOfWrites()
+    {
+        var service = CreateService();
+        _pendingFileOps.TryAdd("write", new FileOperation { Id = "write", Operation = "write", Path = "C:\\big.txt", Content = new string('x', 50_000), Status = "pending" });
+        _pendingFileOps.TryAdd("list", new FileOperation { Id = "list", Operation = "list", Path = "C:\\", Status = "pending" });
+
+        service.PollPendingOperation()!.Id.ShouldBe("list");
+        service.PollPendingOperation()!.Id.ShouldBe("write");
+    }
+
     [Fact]
     public void SubmitResult_AddsResultAndRemovesPendingOp()
     {
@@ -93,7 +118,7 @@ public class FileSystemServiceTests
         };
         service.SubmitResult(result);
 
-        _pendingFileOps.ShouldNotContainKey("op1");
+        _pendingFileOps.ContainsKey("op1").ShouldBeFalse();
     }
 
     [Fact]
@@ -209,13 +234,14 @@ public class FileSystemServiceTests
             Arg.Any<string>(),
             Arg.Any<string>(),
             Arg.Any<TimeSpan>(),
-            Arg.Any<CancellationToken>())
+            Arg.Any<CancellationToken>(),
+            Arg.Any<string?>())
             .Returns(Task.FromResult(true));
 
         var service = CreateService(writeTimeout: TimeSpan.FromSeconds(2));
         var writeTask = service.WriteFileAsync("C:\\test.txt", "new content", sessionId);
 
-        var pendingOp = await WaitForPendingOperationAsync(service);
+        var pendingOp = await WaitForPendingOperationAsync(service, sessionId);
         pendingOp.ShouldNotBeNull();
         pendingOp!.Operation.ShouldBe("write");
         pendingOp.Content.ShouldBe("new content");
@@ -236,7 +262,8 @@ public class FileSystemServiceTests
             "Write",
             Arg.Is<string>(s => s.Contains("C:\\test.txt")),
             Arg.Any<TimeSpan>(),
-            Arg.Any<CancellationToken>());
+            Arg.Any<CancellationToken>(),
+            Arg.Any<string?>());
     }
 
     [Fact]
@@ -250,14 +277,45 @@ public class FileSystemServiceTests
             Arg.Any<string>(),
             Arg.Any<string>(),
             Arg.Any<TimeSpan>(),
-            Arg.Any<CancellationToken>())
+            Arg.Any<CancellationToken>(),
+            Arg.Any<string?>())
             .Returns(Task.FromResult(false));
 
         var service = CreateService(writeTimeout: TimeSpan.FromSeconds(2));
         var writeResult = await service.WriteFileAsync("C:\\test.txt", "new content", sessionId);
 
         writeResult.ShouldBeFalse();
-        _pendingFileOps.ShouldBeEmpty();
+        _pendingFileOps.IsEmpty.ShouldBeTrue();
+    }
+
+    [Fact]
+    public async Task DispatchApproved_WhileWriteAwaitsApproval_HandsOverOperation()
+    {
+        var approval = new TaskCompletionSource<bool>();
+        _approvalService.RequestApprovalAsync(
+            Arg.Any<string>(),
+            Arg.Any<string>(),
+            Arg.Any<string>(),
+            Arg.Any<TimeSpan>(),
+            Arg.Any<CancellationToken>(),
+            Arg.Any<string?>())
+            .Returns(approval.Task);
+
+        var service = CreateService(writeTimeout: TimeSpan.FromSeconds(2));
+        var writeTask = service.WriteFileAsync("C:\\test.txt", "new content", "session1");
+
+        var opId = _pendingFileOps.Keys.Single();
+        service.PollPendingOperation().ShouldBeNull();
+
+        var dispatched = service.DispatchApproved(opId);
+        approval.SetResult(true);
+
+        dispatched.ShouldNotBeNull();
+        dispatched.Content.ShouldBe("new content");
+        (await service.PollPendingOperationAsync(TimeSpan.FromMilliseconds(100))).ShouldBeNull();
+
+        service.SubmitResult(new FileOpResult { OpId = opId });
+        (await writeTask).ShouldBeTrue();
     }
 
     [Fact]
@@ -276,6 +334,49 @@ public class FileSystemServiceTests
         readResult.ShouldBeNull();
     }
 
+    [Fact]
+    public async Task ListDirectoryAsync_OnceClientIsKnownFast_JudgesHungOpByMeasuredDeadline()
+    {
+        var clock = new ManualClock();
+        var latency = new LatencyEstimator(TimeSpan.FromMilliseconds(50), TimeSpan.FromMilliseconds(50), TimeSpan.FromSeconds(10), clock);
+        var readTimeout = TimeSpan.FromSeconds(30);
+        var service = CreateService(readTimeout, latency: latency);
+
+        // One 20 ms round trip: mean 20, deviation 10, so the bound is 20 + 4 * 10
+        var first = service.ListDirectoryAsync("C:\\", "s1");
+        var pending = await WaitForPendingOperationAsync(service, "s1");
+        clock.Advance(TimeSpan.FromMilliseconds(20));
+        service.SubmitResult(new FileOpResult { OpId = pending!.Id, Entries = [] });
+        (await first).ShouldNotBeNull();
+
+        var measured = latency.Deadline("s1", LatencyEstimator.WorkKind.FileOp);
+        measured.ShouldBe(TimeSpan.FromMilliseconds(60));
+        measured!.Value.ShouldBeLessThan(readTimeout);
+
+        var hung = service.ListDirectoryAsync("C:\\", "s1");
+        (await WaitForPendingOperationAsync(service, "s1")).ShouldNotBeNull();
+        (await hung).ShouldBeNull();
+
+        // Timed out against the estimate, which then backs off: the mean doubles to 40
+        latency.Snapshot().Single().Timeouts.ShouldBe(1);
+        latency.Deadline("s1", LatencyEstimator.WorkKind.FileOp).ShouldBe(TimeSpan.FromMilliseconds(80));
+    }
+
+    [Fact]
+    public async Task ReadFileAsync_WhenDispatchIsLost_OffersItAgainBeforeTimingOut()
+    {
+        var service = CreateService(readTimeout: TimeSpan.FromMilliseconds(600));
+
+        var read = service.ReadFileAsync("C:\\CONFIG.SYS");
+        var lost = await WaitForPendingOperationAsync(service);
+
+        var again = await WaitForPendingOperationAsync(service, attempts: 100);
+        again!.Id.ShouldBe(lost!.Id);
+        service.SubmitResult(new FileOpResult { OpId = again.Id, Content = "FILES=40" });
+
+        (await read)!.Value.Content.ShouldBe("FILES=40");
+    }
+
     [Fact]
     public async Task ListDirectoryAsync_WhenTimeout_ReturnsNull()
     {
@@ -287,11 +388,42 @@ public class FileSystemServiceTests
     }
 
 
-    private static async Task<FileOperation?> WaitForPendingOperationAsync(FileSystemService service, int attempts = 50, int delayMs = 10)
+    [Fact]
+    public async Task PollPendingOperation_OnlyReturnsOperationsForThatSession()
+    {
+        var service = CreateService(readTimeout: TimeSpan.FromMilliseconds(300));
+
+        var listTask = service.ListDirectoryAsync("C:\\", "machineA");
+        (await WaitForPendingOperationAsync(service, "machineA")).ShouldNotBeNull();
+
+        var readTask = service.ReadFileAsync("C:\\AUTOEXEC.BAT", sessionId: "machineB");
+        service.PollPendingOperation().ShouldBeNull();
+        service.PollPendingOperation("machineA").ShouldBeNull();
+        var pending = await WaitForPendingOperationAsync(service, "machineB");
+        pending.ShouldNotBeNull();
+        pending.Operation.ShouldBe("read");
+        pending.SessionId.ShouldBe("machineB");
+
+        (await listTask).ShouldBeNull();
+        (await readTask).ShouldBeNull();
+    }
+
+    [Fact]
+    public async Task WriteFileAsync_WhenTimeout_ReturnsFalse()
+    {
+        var service = CreateService(writeTimeout: TimeSpan.FromMilliseconds(100));
+
+        var result = await service.WriteFileAsync("C:\\test.txt", "content");
+
+        result.ShouldBeFalse();
+        _pendingFileOps.IsEmpty.ShouldBeTrue();
+    }
+
+    private static async Task<FileOperation?> WaitForPendingOperationAsync(FileSystemService service, string? sessionId = null, int attempts = 50, int delayMs = 10)
     {
         for (var i = 0; i < attempts; i++)
         {
-            var pending = service.PollPendingOperation();
+            var pending = service.PollPendingOperation(sessionId);
             if (pending != null)
             {
                 return pending;
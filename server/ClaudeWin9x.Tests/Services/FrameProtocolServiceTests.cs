@@ -0,0 +1,200 @@
+using System.Net;
+using System.Net.Sockets;
+using Microsoft.Extensions.Logging;
+using NSubstitute;
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+using ClaudeWin9xServer.Models.Requests;
+using ClaudeWin9xServer.Models.Responses;
+using ClaudeWin9xServer.Services;
+using ClaudeWin9xServer.Services.Interfaces;
+
+namespace ClaudeWin9xServer.Tests.Services;
+
+public class FrameProtocolServiceTests : IAsyncLifetime
+{
+    private readonly string _tempDir = Path.Combine(Path.GetTempPath(), $"frame_{Guid.NewGuid()}");
+    private readonly ISyncService _syncService = Substitute.For<ISyncService>();
+    private readonly ISessionService _sessionService = Substitute.For<ISessionService>();
+    private readonly IFileSystemService _fileSystemService = Substitute.For<IFileSystemService>();
+    private readonly ICommandService _commandService = Substitute.For<ICommandService>();
+    private FrameProtocolService _service = null!;
+    private TcpClient? _client;
+
+    public async Task InitializeAsync()
+    {
+        Directory.CreateDirectory(_tempDir);
+
+        var fileTransferService = new FileTransferService(0, 0, Substitute.For<ILogger<FileTransferService>>(), _tempDir);
+        _service = new FrameProtocolService(0, _syncService, _sessionService, _fileSystemService,
+            _commandService, fileTransferService, Substitute.For<ILogger<FrameProtocolService>>());
+        await _service.StartAsync(CancellationToken.None);
+    }
+
+    public async Task DisposeAsync()
+    {
+        _client?.Dispose();
+        await _service.StopAsync(CancellationToken.None);
+
+        if (Directory.Exists(_tempDir))
+        {
+            Directory.Delete(_tempDir, recursive: true);
+        }
+    }
+
+    private async Task<NetworkStream> ConnectAsync(string apiKey = IniConfig.ApiKey)
+    {
+        _client = new TcpClient();
+        await _client.ConnectAsync(IPAddress.Loopback, _service.LocalPort);
+        var stream = _client.GetStream();
+
+        await SendAsync(stream, FrameType.Hello, 0, new FramePayloadWriter().Add(apiKey).Add("session1"));
+        return stream;
+    }
+
+    private static Task SendAsync(NetworkStream stream, FrameType type, ushort streamId, FramePayloadWriter payload) =>
+        FrameCodec.WriteAsync(stream, new Frame(type, FramePriority.Control, streamId, payload.ToArray()), CancellationToken.None).AsTask();
+
+    private static async Task<Frame> ReadAsync(NetworkStream stream)
+    {
+        var frame = await FrameCodec.ReadAsync(stream, CancellationToken.None).WaitAsync(TimeSpan.FromSeconds(5));
+        frame.ShouldNotBeNull();
+        return frame.Value;
+    }
+
+    [Fact]
+    public async Task Hello_WithWrongApiKey_RepliesUnauthorized()
+    {
+        var stream = await ConnectAsync("wrong-key");
+
+        var reply = await ReadAsync(stream);
+
+        reply.Type.ShouldBe(FrameType.Error);
+        new FramePayloadReader(reply.Payload).ReadString().ShouldBe("Unauthorized");
+    }
+
+    [Fact]
+    public async Task Sync_WhenCommandPending_SendsOutputCommandAndEnd()
+    {
+        var command = new CommandRequest { Id = "cmd1", Command = "dir", WorkingDirectory = "C:\\" };
+        _syncService.SyncAsync("session1", Arg.Any<TimeSpan>(), Arg.Any<bool>(), Arg.Any<long?>(), Arg.Any<int?>(), Arg.Any<CancellationToken>())
+            .Returns(Task.FromResult<(OutputPage, string, TurnInfo, FileOperation?, CommandRequest?, ToolApprovalRequest?)?>(
+                (new OutputPage("hello", 10, 15), "running", new TurnInfo(TurnState.ToolRunning, 2), null, command, null)));
+        var stream = await ConnectAsync();
+        (await ReadAsync(stream)).Type.ShouldBe(FrameType.HelloOk);
+
+        await SendAsync(stream, FrameType.Sync, 7, new FramePayloadWriter().Add(1000).Add(1));
+
+        var output = await ReadAsync(stream);
+        output.Type.ShouldBe(FrameType.Output);
+        output.Stream.ShouldBe((ushort)7);
+        new FramePayloadReader(output.Payload).ReadString().ShouldBe("hello");
+
+        var commandFrame = await ReadAsync(stream);
+        commandFrame.Type.ShouldBe(FrameType.Command);
+        var fields = new FramePayloadReader(commandFrame.Payload);
+        fields.ReadString().ShouldBe("cmd1");
+        fields.ReadString().ShouldBe("dir");
+        fields.ReadString().ShouldBe("C:\\");
+
+        var end = await ReadAsync(stream);
+        end.Type.ShouldBe(FrameType.SyncEnd);
+        var endFields = new FramePayloadReader(end.Payload);
+        endFields.ReadString().ShouldBe("running");
+        endFields.ReadString().ShouldBe("tool_running");
+        endFields.ReadInt().ShouldBe(2);
+        endFields.ReadInt().ShouldBe(10);
+        endFields.ReadInt().ShouldBe(15);
+    }
+
+    [Fact]
+    public async Task ApprovalResponse_WithDispatch_SendsReleasedCommandBeforeAck()
+    {
+        var command = new CommandRequest { Id = "cmd2", Command = "ver", WorkingDirectory = null };
+        _syncService.AnswerApproval("app1", true, true)
+            .Returns(((FileOperation?)null, (CommandRequest?)command));
+        var stream = await ConnectAsync();
+        (await ReadAsync(stream)).Type.ShouldBe(FrameType.HelloOk);
+
+        await SendAsync(stream, FrameType.ApprovalResponse, 5, new FramePayloadWriter().Add("app1").Add(1).Add(1));
+
+        var commandFrame = await ReadAsync(stream);
+        commandFrame.Type.ShouldBe(FrameType.Command);
+        commandFrame.Stream.ShouldBe((ushort)5);
+        new FramePayloadReader(commandFrame.Payload).ReadString().ShouldBe("cmd2");
+        (await ReadAsync(stream)).Type.ShouldBe(FrameType.Ack);
+    }
+
+    [Fact]
+    public async Task Lease_RenewsThroughCommandService()
+    {
+        _commandService.RenewLease("cmd1").Returns(true);
+        var stream = await ConnectAsync();
+        (await ReadAsync(stream)).Type.ShouldBe(FrameType.HelloOk);
+
+        await SendAsync(stream, FrameType.Lease, 4, new FramePayloadWriter().Add("cmd1"));
+
+        var reply = await ReadAsync(stream);
+        reply.Type.ShouldBe(FrameType.Ack);
+        reply.Stream.ShouldBe((ushort)4);
+        _commandService.Received().RenewLease("cmd1");
+    }
+
+    [Fact]
+    public async Task Input_WhenSessionNotFound_RepliesError()
+    {
+        var stream = await ConnectAsync();
+        (await ReadAsync(stream)).Type.ShouldBe(FrameType.HelloOk);
+
+        await SendAsync(stream, FrameType.Input, 3, new FramePayloadWriter().Add("hi\n"));
+
+        var reply = await ReadAsync(stream);
+        reply.Type.ShouldBe(FrameType.Error);
+        reply.Stream.ShouldBe((ushort)3);
+    }
+
+    [Fact]
+    public async Task Upload_ThenDownload_RoundTripsFile()
+    {
+        var content = new byte[FrameCodec.DataChunkSize + 100];
+        new Random(1).NextBytes(content);
+        var stream = await ConnectAsync();
+        (await ReadAsync(stream)).Type.ShouldBe(FrameType.HelloOk);
+
+        await SendAsync(stream, FrameType.Upload, 1, new FramePayloadWriter().Add("sub/data.bin").Add(content.Length));
+        await FrameCodec.WriteAsync(stream, new Frame(FrameType.Data, FramePriority.Bulk, 1, content[..FrameCodec.DataChunkSize]), CancellationToken.None);
+        await FrameCodec.WriteAsync(stream, new Frame(FrameType.Data, FramePriority.Bulk, 1, content[FrameCodec.DataChunkSize..]), CancellationToken.None);
+        await FrameCodec.WriteAsync(stream, new Frame(FrameType.DataEnd, FramePriority.Bulk, 1, []), CancellationToken.None);
+
+        (await ReadAsync(stream)).Type.ShouldBe(FrameType.Ack);
+        File.ReadAllBytes(Path.Combine(_tempDir, "sub", "data.bin")).ShouldBe(content);
+
+        await SendAsync(stream, FrameType.Download, 2, new FramePayloadWriter().Add("sub/data.bin"));
+
+        var begin = await ReadAsync(stream);
+        begin.Type.ShouldBe(FrameType.DataBegin);
+        new FramePayloadReader(begin.Payload).ReadInt().ShouldBe(content.Length);
+
+        var received = new List<byte>();
+        Frame frame;
+        while ((frame = await ReadAsync(stream)).Type == FrameType.Data)
+        {
+            received.AddRange(frame.Payload);
+        }
+        frame.Type.ShouldBe(FrameType.DataEnd);
+        received.ToArray().ShouldBe(content);
+    }
+
+    [Fact]
+    public async Task Upload_OutsideTransferRoot_RepliesError()
+    {
+        var stream = await ConnectAsync();
+        (await ReadAsync(stream)).Type.ShouldBe(FrameType.HelloOk);
+
+        await SendAsync(stream, FrameType.Upload, 4, new FramePayloadWriter().Add("../escape.txt").Add(3));
+
+        var reply = await ReadAsync(stream);
+        reply.Type.ShouldBe(FrameType.Error);
+        new FramePayloadReader(reply.Payload).ReadString().ShouldBe("Path not allowed");
+    }
+}
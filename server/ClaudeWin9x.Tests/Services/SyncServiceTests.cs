@@ -0,0 +1,111 @@
+using System.Collections.Concurrent;
+using Microsoft.Extensions.Logging;
+using NSubstitute;
+using Shouldly;
+using ClaudeWin9xServer.Infrastructure;
+using ClaudeWin9xServer.Models.Requests;
+using ClaudeWin9xServer.Models.Responses;
+using ClaudeWin9xServer.Services;
+using ClaudeWin9xServer.Services.Interfaces;
+
+namespace ClaudeWin9xServer.Tests.Services;
+
+public class SyncServiceTests
+{
+    private sealed class ManualClock : TimeProvider
+    {
+        public long Ticks { get; set; }
+
+        public override long TimestampFrequency => TimeSpan.TicksPerSecond;
+
+        public override long GetTimestamp() => Ticks;
+
+        public void Advance(TimeSpan by) => Ticks += by.Ticks;
+    }
+
+    private readonly ManualClock _clock = new();
+    private readonly LatencyEstimator _latency = new(TimeSpan.FromMilliseconds(50), TimeSpan.FromMilliseconds(50), TimeSpan.FromSeconds(10));
+    private readonly LeaseTable _leases = new();
+    private readonly ISessionService _sessionService = Substitute.For<ISessionService>();
+    private readonly IApprovalService _approvalService = Substitute.For<IApprovalService>();
+    private readonly CommandService _commandService;
+    private readonly FileSystemService _fileSystemService;
+    private readonly SyncService _syncService;
+
+    public SyncServiceTests()
+    {
+        _commandService = new CommandService(
+            new WorkQueue<CommandRequest>(c => c.Status == "pending", c => c.SessionId, CommandService.PriorityOf, timeProvider: _clock),
+            new CommandResultStore(1024 * 1024, TimeSpan.FromMinutes(30)),
+            new ConcurrentDictionary<string, TaskCompletionSource<CommandResult>>(),
+            _latency,
+            _leases,
+            _approvalService,
+            Substitute.For<ILogger<CommandService>>());
+        _fileSystemService = new FileSystemService(
+            new WorkQueue<FileOperation>(op => op.Status == "pending", op => op.SessionId, FileSystemService.PriorityOf, timeProvider: _clock),
+            new ConcurrentDictionary<string, TaskCompletionSource<FileOpResult>>(),
+            _latency,
+            _leases,
+            _approvalService,
+            Substitute.For<ILogger<FileSystemService>>());
+        _syncService = new SyncService(_sessionService, _fileSystemService, _commandService, _approvalService);
+
+        _sessionService.GetOutput(Arg.Any<string>(), Arg.Any<long?>(), Arg.Any<int?>())
+            .Returns((new OutputPage("", 0, 0), "running", new TurnInfo(TurnState.ToolRunning, 1)));
+        _approvalService.RequestApprovalAsync(
+            Arg.Any<string>(),
+            Arg.Any<string>(),
+            Arg.Any<string>(),
+            Arg.Any<TimeSpan>(),
+            Arg.Any<CancellationToken>(),
+            Arg.Any<string?>())
+            .Returns(Task.FromResult(true));
+    }
+
+    [Fact]
+    public async Task SyncAsync_WithCommandAndFileOpQueued_HandsOutOneAndTheOtherOutlastsIt()
+    {
+        // The client answers file ops quickly, so one it held would be judged by the 50 ms floor
+        _latency.Dispatched("warmup", "s1", LatencyEstimator.WorkKind.FileOp);
+        _latency.Completed("warmup");
+
+        // Aged past the listing queued after it, the build goes out first
+        var build = _commandService.QueueCommandAsync("make", null, "s1");
+        _clock.Advance(3 * WorkPriority.AgingStep);
+        var list = _fileSystemService.ListDirectoryAsync("C:\\", "s1");
+
+        var first = await _syncService.SyncAsync("s1", TimeSpan.Zero, includeApproval: false);
+        var command = first!.Value.Command;
+        command.ShouldNotBeNull();
+        first.Value.FileOp.ShouldBeNull();
+
+        // The build runs well past the floor; the listing still waits under its queued bound
+        await Task.Delay(300);
+        _commandService.SubmitResult(new CommandResult { CommandId = command.Id, ExitCode = 0 });
+        (await build).ShouldNotBeNull();
+
+        var second = await _syncService.SyncAsync("s1", TimeSpan.Zero, includeApproval: false);
+        var fileOp = second!.Value.FileOp;
+        fileOp.ShouldNotBeNull();
+        _fileSystemService.SubmitResult(new FileOpResult { OpId = fileOp.Id, Entries = [] });
+
+        (await list).ShouldNotBeNull();
+        _latency.Snapshot().Single().Timeouts.ShouldBe(0);
+    }
+
+    [Fact]
+    public async Task SyncAsync_WithCommandAndFileOpQueuedTogether_HandsOutTheFileOpFirst()
+    {
+        _ = _commandService.QueueCommandAsync("make", null, "s1");
+        _ = _fileSystemService.ListDirectoryAsync("C:\\", "s1");
+
+        var first = await _syncService.SyncAsync("s1", TimeSpan.Zero, includeApproval: false);
+        first!.Value.FileOp.ShouldNotBeNull();
+        first.Value.Command.ShouldBeNull();
+
+        var second = await _syncService.SyncAsync("s1", TimeSpan.Zero, includeApproval: false);
+        second!.Value.FileOp.ShouldBeNull();
+        second.Value.Command.ShouldNotBeNull();
+    }
+}
@@ -1,6 +1,8 @@
 using Microsoft.AspNetCore.Http.HttpResults;
+using ClaudeWin9xServer.Infrastructure;
 using ClaudeWin9xServer.Models.Requests;
 using ClaudeWin9xServer.Models.Responses;
+using ClaudeWin9xServer.Services;
 using ClaudeWin9xServer.Services.Interfaces;
 using System.Diagnostics.CodeAnalysis;
 
@@ -8,6 +10,11 @@ namespace ClaudeWin9xServer.Endpoints;
 
 public static class EndpointMappings
 {
+    // How often a client waiting for a session slot asks again; each ask also keeps its ticket alive
+    private const int StartRetryMs = 2000;
+
+    private static readonly ErrorResponse AmbiguousSession = new() { Error = "session_id is required while more than one session is running" };
+
     [RequiresUnreferencedCode("ASP.NET Core minimal APIs may require types that cannot be statically analyzed")]
     [RequiresDynamicCode("ASP.NET Core minimal APIs may require runtime code generation")]
     public static void MapEndpoints(this WebApplication app)
@@ -21,18 +28,51 @@ public static class EndpointMappings
         app.MapFilesystemEndpoints();
 
         app.MapApprovalEndpoints();
+
+        app.MapSyncEndpoints();
     }
 
     [RequiresUnreferencedCode("Calls Microsoft.AspNetCore.Builder.EndpointRouteBuilderExtensions.MapPost(String, Delegate)")]
     [RequiresDynamicCode("Calls Microsoft.AspNetCore.Builder.EndpointRouteBuilderExtensions.MapPost(String, Delegate)")]
     private static void MapSessionEndpoints(this WebApplication app)
     {
-        app.MapPost("/start", Results<Ok<SessionStartResponse>, StatusCodeHttpResult> (StartRequest request, ISessionService sessionService) =>
+        app.MapPost("/start", Results<Ok<SessionStartResponse>, StatusCodeHttpResult> (StartRequest request, ISessionService sessionService, SessionDirectory directory) =>
         {
+            // Another instance is running fewer sessions; the client starts over there
+            if (request.Placed != true && directory.Place() is var target && target.Name != directory.Self.Name)
+            {
+                return TypedResults.Ok(new SessionStartResponse
+                {
+                    SessionId = "",
+                    Status = "moved",
+                    Host = target.Host,
+                    ApiPort = target.ApiPort,
+                    DownloadPort = target.DownloadPort,
+                    UploadPort = target.UploadPort
+                });
+            }
+
             try
             {
-                var (sessionId, status) = sessionService.StartSession(request.WorkingDirectory, request.WindowsVersion);
-                return TypedResults.Ok(new SessionStartResponse { SessionId = sessionId, Status = status });
+                var (sessionId, status, ticket, position) = sessionService.StartSession(request.WorkingDirectory, request.WindowsVersion, request.Ticket);
+                if (status == "queued")
+                {
+                    return TypedResults.Ok(new SessionStartResponse
+                    {
+                        SessionId = "",
+                        Status = status,
+                        Ticket = ticket,
+                        Position = position,
+                        RetryMs = StartRetryMs
+                    });
+                }
+
+                return TypedResults.Ok(new SessionStartResponse
+                {
+                    SessionId = sessionId,
+                    Status = status,
+                    FramePort = request.FrameProtocol == true && IniConfig.FramePort != 0 ? IniConfig.FramePort : null
+                });
             }
             catch (InvalidOperationException)
             {
@@ -56,15 +96,31 @@ public static class EndpointMappings
             return TypedResults.Ok(new StatusResponse { Status = "ok" });
         });
 
-        app.MapGet("/output", Results<Ok<OutputResponse>, NotFound<ErrorResponse>> (string session_id, ISessionService sessionService) =>
+        app.MapGet("/output", async Task<Results<Ok<OutputResponse>, NotFound<ErrorResponse>>> (
+            string session_id,
+            int? wait_ms,
+            long? since,
+            int? max_bytes,
+            ISessionService sessionService,
+            IApprovalService approvalService,
+            CancellationToken cancellationToken) =>
         {
-            var result = sessionService.GetOutput(session_id);
+            var result = await sessionService.GetOutputAsync(session_id, LongPoll.ClampWait(wait_ms), since, max_bytes, cancellationToken);
             if (result == null)
             {
                 return TypedResults.NotFound(new ErrorResponse { Error = "Session not found" });
             }
 
-            return TypedResults.Ok(new OutputResponse { Output = result.Value.Output, Status = result.Value.Status });
+            var turn = result.Value.Turn.WithPendingApproval(approvalService.PollPendingApproval(session_id) != null);
+            return TypedResults.Ok(new OutputResponse
+            {
+                Output = result.Value.Output.Text,
+                Offset = result.Value.Output.Offset,
+                Next = result.Value.Output.Next,
+                Status = result.Value.Status,
+                TurnState = turn.State.ToWireName(),
+                TurnSeq = turn.Seq
+            });
         });
 
         app.MapPost("/stop", Results<Ok<StatusResponse>, NotFound<ErrorResponse>> (SessionIdRequest request, ISessionService sessionService) =>
@@ -77,30 +133,51 @@ public static class EndpointMappings
             return TypedResults.Ok(new StatusResponse { Status = "stopped" });
         });
 
-        app.MapGet("/sessions", (ISessionService sessionService) =>
+        app.MapGet("/sessions", (ISessionService sessionService, SessionAdmission admission) =>
         {
             var sessions = sessionService.ListSessions();
-            return TypedResults.Ok(new SessionsListResponse { Sessions = sessions });
+            return TypedResults.Ok(new SessionsListResponse
+            {
+                Sessions = sessions,
+                MaxSessions = admission.MaxRunning,
+                Waiting = admission.Waiting,
+                Hibernated = sessions.Count(s => s.Status == "hibernated"),
+                HibernatedMb = sessions.Sum(s => s.HibernatedMb)
+            });
         });
 
+        app.MapGet("/sessions/latency", (LatencyEstimator latency, LeaseTable leases) =>
+            TypedResults.Ok(new LatencyResponse { Sessions = latency.Snapshot(), Leases = leases.Count, LeaseExpiries = leases.Expired }));
+
+        app.MapGet("/sessions/instances", (SessionDirectory directory) =>
+            TypedResults.Ok(new InstancesResponse { Self = directory.Self.Name, Instances = directory.Live() }));
+
     }
 
     [RequiresDynamicCode("Calls Microsoft.AspNetCore.Builder.EndpointRouteBuilderExtensions.MapPost(String, Delegate)")]
     [RequiresUnreferencedCode("Calls Microsoft.AspNetCore.Builder.EndpointRouteBuilderExtensions.MapPost(String, Delegate)")]
     private static void MapCommandEndpoints(this WebApplication app)
     {
-        app.MapPost("/cmd/queue", async Task<Results<Ok<CommandQueueResponse>, BadRequest<ErrorResponse>, StatusCodeHttpResult>> (CommandRequest request, ICommandService commandService) =>
+        app.MapPost("/cmd/queue", async Task<Results<Ok<CommandQueueResponse>, BadRequest<ErrorResponse>, NotFound<ErrorResponse>, StatusCodeHttpResult>> (CommandRequest request, ICommandService commandService, ISessionService sessionService) =>
         {
             if (string.IsNullOrEmpty(request.Command))
             {
                 return TypedResults.BadRequest(new ErrorResponse { Error = "Command is required" });
             }
 
-            var result = await commandService.QueueCommandAsync(request.Command, request.WorkingDirectory, request.SessionId);
+            if (!TryBindSession(request.SessionId, sessionService, out var sessionId))
+            {
+                return TypedResults.BadRequest(AmbiguousSession);
+            }
+
+            var ended = SessionEnded(sessionId, sessionService);
+            var result = await commandService.QueueCommandAsync(request.Command, request.WorkingDirectory, sessionId, ended);
 
             if (result == null)
             {
-                return TypedResults.StatusCode(504);
+                return ended.IsCancellationRequested
+                    ? TypedResults.NotFound(new ErrorResponse { Error = "Session not found" })
+                    : TypedResults.StatusCode(504);
             }
 
             return TypedResults.Ok(new CommandQueueResponse
@@ -113,23 +190,8 @@ public static class EndpointMappings
             });
         });
 
-        app.MapGet("/cmd/poll", (ICommandService commandService) =>
-        {
-            var pending = commandService.PollPendingCommand();
-
-            if (pending == null)
-            {
-                return TypedResults.Ok(new CommandPollResponse { HasPending = false });
-            }
-
-            return TypedResults.Ok(new CommandPollResponse
-            {
-                HasPending = true,
-                CmdId = pending.Id,
-                Command = pending.Command,
-                WorkingDirectory = pending.WorkingDirectory
-            });
-        });
+        app.MapGet("/cmd/poll", async (string? session_id, int? wait_ms, ICommandService commandService, CancellationToken cancellationToken) =>
+            TypedResults.Ok(ToPollResponse(await commandService.PollPendingCommandAsync(LongPoll.ClampWait(wait_ms), session_id, cancellationToken))));
 
         app.MapPost("/cmd/result", Results<Ok<StatusResponse>, BadRequest<ErrorResponse>> (CommandResult result, ICommandService commandService) =>
         {
@@ -142,6 +204,18 @@ public static class EndpointMappings
             return TypedResults.Ok(new StatusResponse { Status = "ok" });
         });
 
+        app.MapPost("/cmd/lease", Results<Ok<StatusResponse>, BadRequest<ErrorResponse>, NotFound<ErrorResponse>> (LeaseRequest request, ICommandService commandService) =>
+        {
+            if (string.IsNullOrEmpty(request.CmdId))
+            {
+                return TypedResults.BadRequest(new ErrorResponse { Error = "cmd_id is required" });
+            }
+
+            return commandService.RenewLease(request.CmdId)
+                ? TypedResults.Ok(new StatusResponse { Status = "renewed" })
+                : TypedResults.NotFound(new ErrorResponse { Error = "Command not dispatched" });
+        });
+
         app.MapGet("/cmd/status", Results<Ok<CommandStatusResponse>, NotFound<CommandStatusResponse>> (string command_id, ICommandService commandService) =>
         {
             var result = commandService.GetCommandStatus(command_id);
@@ -164,6 +238,15 @@ public static class EndpointMappings
 
             return TypedResults.NotFound(new CommandStatusResponse { Status = "not_found" });
         });
+
+        app.MapGet("/cmd/stats", (CommandResultStore results) => TypedResults.Ok(new CommandStatsResponse
+        {
+            Results = results.Count,
+            ResidentBytes = results.ResidentBytes,
+            MaxBytes = results.MaxBytes,
+            Evictions = results.Evictions,
+            Expirations = results.Expirations
+        }));
     }
 
     [RequiresDynamicCode("Calls Microsoft.AspNetCore.Builder.EndpointRouteBuilderExtensions.MapPost(String, Delegate)")]
@@ -201,13 +284,21 @@ public static class EndpointMappings
             });
         });
 
-        app.MapGet("/fs/list", async Task<Results<Ok<DirectoryListResponse>, StatusCodeHttpResult>> (string path, IFileSystemService fileSystemService) =>
+        app.MapGet("/fs/list", async Task<Results<Ok<DirectoryListResponse>, BadRequest<ErrorResponse>, NotFound<ErrorResponse>, StatusCodeHttpResult>> (string path, string? session_id, IFileSystemService fileSystemService, ISessionService sessionService) =>
         {
-            var result = await fileSystemService.ListDirectoryAsync(path);
+            if (!TryBindSession(session_id, sessionService, out var sessionId))
+            {
+                return TypedResults.BadRequest(AmbiguousSession);
+            }
+
+            var ended = SessionEnded(sessionId, sessionService);
+            var result = await fileSystemService.ListDirectoryAsync(path, sessionId, ended);
 
             if (result == null)
             {
-                return TypedResults.StatusCode(504);
+                return ended.IsCancellationRequested
+                    ? TypedResults.NotFound(new ErrorResponse { Error = "Session not found" })
+                    : TypedResults.StatusCode(504);
             }
 
             if (result.Error != null)
@@ -218,13 +309,21 @@ public static class EndpointMappings
             return TypedResults.Ok(new DirectoryListResponse { Path = path, Entries = result.Entries ?? [] });
         });
 
-        app.MapGet("/fs/read", async Task<Results<Ok<FileReadResponse>, StatusCodeHttpResult>> (string path, int? maxSize, IFileSystemService fileSystemService) =>
+        app.MapGet("/fs/read", async Task<Results<Ok<FileReadResponse>, BadRequest<ErrorResponse>, NotFound<ErrorResponse>, StatusCodeHttpResult>> (string path, int? maxSize, string? session_id, IFileSystemService fileSystemService, ISessionService sessionService) =>
         {
-            var result = await fileSystemService.ReadFileAsync(path, maxSize);
+            if (!TryBindSession(session_id, sessionService, out var sessionId))
+            {
+                return TypedResults.BadRequest(AmbiguousSession);
+            }
+
+            var ended = SessionEnded(sessionId, sessionService);
+            var result = await fileSystemService.ReadFileAsync(path, maxSize, sessionId, ended);
 
             if (result == null)
             {
-                return TypedResults.StatusCode(504);
+                return ended.IsCancellationRequested
+                    ? TypedResults.NotFound(new ErrorResponse { Error = "Session not found" })
+                    : TypedResults.StatusCode(504);
             }
 
             return TypedResults.Ok(new FileReadResponse
@@ -236,42 +335,34 @@ public static class EndpointMappings
             });
         });
 
-        app.MapPost("/fs/write", async Task<Results<Ok<FileWriteResponse>, BadRequest<ErrorResponse>, StatusCodeHttpResult>> (FileWriteRequest request, IFileSystemService fileSystemService) =>
+        app.MapPost("/fs/write", async Task<Results<Ok<FileWriteResponse>, BadRequest<ErrorResponse>, NotFound<ErrorResponse>, StatusCodeHttpResult>> (FileWriteRequest request, IFileSystemService fileSystemService, ISessionService sessionService) =>
         {
             if (string.IsNullOrEmpty(request.Path) || request.Content == null)
             {
                 return TypedResults.BadRequest(new ErrorResponse { Error = "path and content are required" });
             }
 
-            var success = await fileSystemService.WriteFileAsync(request.Path, request.Content, request.SessionId);
-
-            if (!success)
+            if (!TryBindSession(request.SessionId, sessionService, out var sessionId))
             {
-                return TypedResults.StatusCode(504);
+                return TypedResults.BadRequest(AmbiguousSession);
             }
 
-            return TypedResults.Ok(new FileWriteResponse { Status = "ok", Path = request.Path, BytesWritten = request.Content.Length });
-        });
-
-        app.MapGet("/fs/poll", (IFileSystemService fileSystemService) =>
-        {
-            var pending = fileSystemService.PollPendingOperation();
+            var ended = SessionEnded(sessionId, sessionService);
+            var success = await fileSystemService.WriteFileAsync(request.Path, request.Content, sessionId, ended);
 
-            if (pending == null)
+            if (!success)
             {
-                return TypedResults.Ok(new FileOpPollResponse { HasPending = false });
+                return ended.IsCancellationRequested
+                    ? TypedResults.NotFound(new ErrorResponse { Error = "Session not found" })
+                    : TypedResults.StatusCode(504);
             }
 
-            return TypedResults.Ok(new FileOpPollResponse
-            {
-                HasPending = true,
-                OpId = pending.Id,
-                Operation = pending.Operation,
-                Path = pending.Path,
-                Content = pending.Content
-            });
+            return TypedResults.Ok(new FileWriteResponse { Status = "ok", Path = request.Path, BytesWritten = request.Content.Length });
         });
 
+        app.MapGet("/fs/poll", async (string? session_id, int? wait_ms, IFileSystemService fileSystemService, CancellationToken cancellationToken) =>
+            TypedResults.Ok(ToPollResponse(await fileSystemService.PollPendingOperationAsync(LongPoll.ClampWait(wait_ms), session_id, cancellationToken))));
+
         app.MapPost("/fs/result", Results<Ok<StatusResponse>, BadRequest<ErrorResponse>> (FileOpResult result, IFileSystemService fileSystemService) =>
         {
             if (string.IsNullOrEmpty(result.OpId))
@@ -288,44 +379,133 @@ public static class EndpointMappings
     [RequiresUnreferencedCode("Calls Microsoft.AspNetCore.Builder.EndpointRouteBuilderExtensions.MapGet(String, Delegate)")]
     private static void MapApprovalEndpoints(this WebApplication app)
     {
-        app.MapGet("/approval/poll", Results<Ok<ApprovalPollResponse>, BadRequest<ErrorResponse>> (string session_id, IApprovalService approvalService) =>
+        app.MapGet("/approval/poll", async Task<Results<Ok<ApprovalPollResponse>, BadRequest<ErrorResponse>>> (string session_id, int? wait_ms, IApprovalService approvalService, CancellationToken cancellationToken) =>
         {
             if (string.IsNullOrEmpty(session_id))
             {
                 return TypedResults.BadRequest(new ErrorResponse { Error = "session_id is required" });
             }
 
-            var pending = approvalService.PollPendingApproval(session_id);
-
-            if (pending == null)
-            {
-                return TypedResults.Ok(new ApprovalPollResponse { HasPending = false });
-            }
-
-            return TypedResults.Ok(new ApprovalPollResponse
-            {
-                HasPending = true,
-                ApprovalId = pending.Id,
-                ToolName = pending.ToolName,
-                ToolInput = pending.ToolInput
-            });
+            var pending = await approvalService.PollPendingApprovalAsync(session_id, LongPoll.ClampWait(wait_ms), cancellationToken);
+            return TypedResults.Ok(ToPollResponse(pending));
         });
 
-        app.MapPost("/approval/respond", Results<Ok<StatusResponse>, BadRequest<ErrorResponse>, NotFound<ErrorResponse>> (ApprovalResponse response, IApprovalService approvalService) =>
+        // With dispatch set, an approved command or file op comes back in the reply,
+        // saving the client a poll before it can run it.
+        app.MapPost("/approval/respond", Results<Ok<ApprovalRespondResponse>, BadRequest<ErrorResponse>, NotFound<ErrorResponse>> (ApprovalResponse response, ISyncService syncService) =>
         {
             if (string.IsNullOrEmpty(response.ApprovalId))
             {
                 return TypedResults.BadRequest(new ErrorResponse { Error = "approval_id is required" });
             }
 
-            var success = approvalService.SubmitResponse(response.ApprovalId, response.Approved);
+            var result = syncService.AnswerApproval(response.ApprovalId, response.Approved, response.Dispatch);
 
-            if (!success)
+            if (result == null)
             {
                 return TypedResults.NotFound(new ErrorResponse { Error = "Approval request not found" });
             }
 
-            return TypedResults.Ok(new StatusResponse { Status = "ok" });
+            var (fileOp, command) = result.Value;
+            return TypedResults.Ok(new ApprovalRespondResponse
+            {
+                Status = "ok",
+                FileOp = fileOp != null ? ToPollResponse(fileOp) : null,
+                Command = command != null ? ToPollResponse(command) : null
+            });
+        });
+    }
+
+    [RequiresDynamicCode("Calls Microsoft.AspNetCore.Builder.EndpointRouteBuilderExtensions.MapGet(String, Delegate)")]
+    [RequiresUnreferencedCode("Calls Microsoft.AspNetCore.Builder.EndpointRouteBuilderExtensions.MapGet(String, Delegate)")]
+    private static void MapSyncEndpoints(this WebApplication app)
+    {
+        // One round trip for output plus the next approval and the next file op or command.
+        // With wait_ms the request is held open until any of them has something.
+        app.MapGet("/sync", async Task<Results<Ok<SyncResponse>, NotFound<ErrorResponse>>> (
+            string session_id,
+            int? wait_ms,
+            int? approval,
+            long? since,
+            int? max_bytes,
+            ISyncService syncService,
+            CancellationToken cancellationToken) =>
+        {
+            var result = await syncService.SyncAsync(session_id, LongPoll.ClampWait(wait_ms), approval != 0, since, max_bytes, cancellationToken);
+            if (result == null)
+            {
+                return TypedResults.NotFound(new ErrorResponse { Error = "Session not found" });
+            }
+
+            var (output, status, turn, fileOp, command, pendingApproval) = result.Value;
+            return TypedResults.Ok(new SyncResponse
+            {
+                Output = output.Text,
+                Offset = output.Offset,
+                Next = output.Next,
+                Status = status,
+                TurnState = turn.State.ToWireName(),
+                TurnSeq = turn.Seq,
+                FileOp = fileOp != null ? ToPollResponse(fileOp) : null,
+                Command = command != null ? ToPollResponse(command) : null,
+                Approval = pendingApproval != null ? ToPollResponse(pendingApproval) : null
+            });
         });
     }
+
+    /// <summary>
+    /// Work is routed to the client of the session it names. Callers that name none (older
+    /// prompts, scripts) get the only live session, or the legacy channel when there is none;
+    /// with two or more nobody would poll it, so this returns false and the caller must name one.
+    /// </summary>
+    private static bool TryBindSession(string? sessionId, ISessionService sessionService, out string? bound)
+    {
+        bound = sessionId;
+        if (!string.IsNullOrEmpty(sessionId))
+        {
+            return true;
+        }
+
+        var sessions = sessionService.ListSessions();
+        bound = sessions.Length == 1 ? sessions[0].SessionId : null;
+        return sessions.Length <= 1;
+    }
+
+    private static CancellationToken SessionEnded(string? sessionId, ISessionService sessionService) =>
+        sessionId != null ? sessionService.SessionEnded(sessionId) : CancellationToken.None;
+
+    private static FileOpPollResponse ToPollResponse(FileOperation? pending) => pending == null
+        ? new FileOpPollResponse { HasPending = false }
+        : new FileOpPollResponse
+        {
+            HasPending = true,
+            OpId = pending.Id,
+            Operation = pending.Operation,
+            Path = pending.Path,
+            Content = pending.Content,
+            Priority = pending.Priority
+        };
+
+    private static CommandPollResponse ToPollResponse(CommandRequest? pending) => pending == null
+        ? new CommandPollResponse { HasPending = false }
+        : new CommandPollResponse
+        {
+            HasPending = true,
+            CmdId = pending.Id,
+            Command = pending.Command,
+            WorkingDirectory = pending.WorkingDirectory,
+            Priority = pending.Priority,
+            LeaseMs = pending.LeaseMs
+        };
+
+    private static ApprovalPollResponse ToPollResponse(ToolApprovalRequest? pending) => pending == null
+        ? new ApprovalPollResponse { HasPending = false }
+        : new ApprovalPollResponse
+        {
+            HasPending = true,
+            ApprovalId = pending.Id,
+            ToolName = pending.ToolName,
+            ToolInput = pending.ToolInput,
+            Priority = WorkPriority.Approval
+        };
 }
@@ -24,10 +24,19 @@ namespace ClaudeWin9xServer.Infrastructure;
 [JsonSerializable(typeof(SessionStartResponse))]
 [JsonSerializable(typeof(StatusResponse))]
 [JsonSerializable(typeof(OutputResponse))]
+[JsonSerializable(typeof(SyncResponse))]
 [JsonSerializable(typeof(SessionsListResponse))]
 [JsonSerializable(typeof(CommandQueueResponse))]
 [JsonSerializable(typeof(CommandPollResponse))]
 [JsonSerializable(typeof(CommandStatusResponse))]
+[JsonSerializable(typeof(CommandStatsResponse))]
+[JsonSerializable(typeof(LatencyResponse))]
+[JsonSerializable(typeof(LeaseRequest))]
+[JsonSerializable(typeof(SessionLatency))]
+[JsonSerializable(typeof(InstanceInfo))]
+[JsonSerializable(typeof(InstancesResponse))]
+[JsonSerializable(typeof(SessionRecord))]
+[JsonSerializable(typeof(JournalEntry))]
 [JsonSerializable(typeof(BundleResponse))]
 [JsonSerializable(typeof(DirectoryListResponse))]
 [JsonSerializable(typeof(FileReadResponse))]
@@ -35,6 +44,7 @@ namespace ClaudeWin9xServer.Infrastructure;
 [JsonSerializable(typeof(FileOpPollResponse))]
 [JsonSerializable(typeof(ApprovalPollResponse))]
 [JsonSerializable(typeof(ApprovalResponse))]
+[JsonSerializable(typeof(ApprovalRespondResponse))]
 [JsonSerializable(typeof(ToolApprovalRequest))]
 [JsonSerializable(typeof(SessionInfo))]
 [JsonSerializable(typeof(SessionInfo[]))]
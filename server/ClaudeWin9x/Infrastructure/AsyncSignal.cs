@@ -0,0 +1,18 @@
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Wakes long-poll requests when something they wait on changes. Waiters must take <see cref="Next"/>
+/// before checking their condition, so a <see cref="Pulse"/> that lands in between is not lost.
+/// </summary>
+public sealed class AsyncSignal
+{
+    private TaskCompletionSource _tcs = new(TaskCreationOptions.RunContinuationsAsynchronously);
+
+    public Task Next => Volatile.Read(ref _tcs).Task;
+
+    public void Pulse()
+    {
+        var next = new TaskCompletionSource(TaskCreationOptions.RunContinuationsAsynchronously);
+        Interlocked.Exchange(ref _tcs, next).TrySetResult();
+    }
+}
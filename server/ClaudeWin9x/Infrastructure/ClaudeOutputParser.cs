@@ -6,7 +6,13 @@ public class ClaudeOutputParser
 {
     private bool _initShown;
 
-    public record ParseResult(string? Text, bool AppendNewline);
+    /// <summary>
+    /// The CLI's own id for the conversation, from the last event that carried one; what <c>--resume</c> takes.
+    /// </summary>
+    public string? ConversationId { get; private set; }
+
+    /// <param name="Turn">Where the event leaves the current turn, or null if it says nothing about it.</param>
+    public record ParseResult(string? Text, bool AppendNewline, TurnState? Turn = null);
 
     public static ParseResult Empty => new(null, false);
     public static ParseResult Text(string text) => new(text, true);
@@ -30,14 +36,20 @@ public class ClaudeOutputParser
                 return Empty;
             }
 
+            if (root.TryGetProperty("session_id", out var conversation) && conversation.ValueKind == JsonValueKind.String)
+            {
+                ConversationId = conversation.GetString();
+            }
+
             return typeElem.GetString() switch
             {
                 "system" => ParseSystem(root),
                 "assistant" => ParseAssistant(root),
+                "user" => Empty with { Turn = TurnState.Thinking },
                 "content_block_delta" => ParseContentBlockDelta(root),
                 "content_block_stop" => Newline,
-                "result" => ParseResultMessage(root),
-                "tool_result" => ParseToolResult(root),
+                "result" => ParseResultMessage(root) with { Turn = TurnState.Done },
+                "tool_result" => ParseToolResult(root) with { Turn = TurnState.Thinking },
                 _ => Empty
             };
         }
@@ -84,6 +96,7 @@ public class ClaudeOutputParser
     private static ParseResult ParseContentArray(JsonElement content)
     {
         var texts = new List<string>();
+        var turn = TurnState.Thinking;
 
         foreach (var item in content.EnumerateArray())
         {
@@ -105,10 +118,11 @@ public class ClaudeOutputParser
             else if (typeStr == "tool_use" && item.TryGetProperty("name", out var toolName))
             {
                 texts.Add($"[Using tool: {toolName.GetString() ?? "unknown"}]");
+                turn = TurnState.ToolRunning;
             }
         }
 
-        return texts.Count > 0 ? Text(string.Join("\n", texts)) : Empty;
+        return (texts.Count > 0 ? Text(string.Join("\n", texts)) : Empty) with { Turn = turn };
     }
 
     private static ParseResult ParseContentBlockDelta(JsonElement root)
@@ -8,29 +8,116 @@ namespace ClaudeWin9xServer.Infrastructure;
 public class ClaudeSession(
     string sessionId,
     string workingDirectory,
-    string windowsVersion,
-    ILogger logger) : IDisposable
+    string? windowsVersion,
+    ILogger logger,
+    long outputSpillBytes = 0) : IDisposable
 {
     private const int MaxBufferSize = 1024 * 1024;
 
     private Process? _process;
     private readonly string _workingDirectory = workingDirectory;
     private readonly string _sessionId = sessionId;
-    private readonly string _windowsVersion = windowsVersion;
+    private string? _windowsVersion = windowsVersion;
+    private bool _contextSent;
     private readonly StringBuilder _outputBuffer = new();
-    private readonly StringBuilder _parsedOutputBuffer = new();
+    private readonly OutputLog _parsedOutput = new(
+        MaxBufferSize,
+        spillDirectory: outputSpillBytes > 0 ? Path.GetTempPath() : null,
+        spillBytes: outputSpillBytes);
     private readonly ClaudeOutputParser _parser = new();
     private readonly object _lock = new();
 
+    // Held while the process is started, hibernated or stopped, and while input begins a turn
+    private readonly object _lifecycle = new();
+    private long _resumedAt;
+    private readonly AsyncSignal _outputChanged = new();
+    private readonly TurnTracker _turn = new();
+    private readonly CancellationTokenSource _ended = new();
+
     public DateTime LastActivity { get; private set; } = DateTime.UtcNow;
 
+    /// <summary>
+    /// When the user last sent input; heartbeats and polls don't count.
+    /// </summary>
+    public DateTime LastInput { get; private set; } = DateTime.UtcNow;
+
+    /// <summary>
+    /// No turn in progress, so stopping the process loses nothing Claude was working on.
+    /// </summary>
+    public bool IsIdle => _turn.Current.State is TurnState.Idle or TurnState.Done;
+
     public bool IsRunning => _process is { HasExited: false };
 
+    /// <summary>
+    /// The process was stopped to save memory; the next input resumes the conversation in a new one.
+    /// </summary>
+    public bool IsHibernated { get; private set; }
+
+    /// <summary>
+    /// Still serving its client: running, or hibernated and ready to resume.
+    /// </summary>
+    public bool IsAlive => IsRunning || IsHibernated;
+
+    /// <summary>
+    /// Working set of the process that hibernating stopped, while hibernated.
+    /// </summary>
+    public long HibernatedBytes { get; private set; }
+
+    /// <summary>
+    /// From the input that woke the session last to the resumed process's first output.
+    /// </summary>
+    public TimeSpan? ResumeLatency { get; private set; }
+
+    public string? ConversationId
+    {
+        get
+        {
+            lock (_lock)
+            {
+                return _parser.ConversationId;
+            }
+        }
+    }
+
     public string SessionId => _sessionId;
 
     public string WorkingDirectory => _workingDirectory;
 
-    private string GetSystemPrompt() => SystemPromptTemplate.Generate(_windowsVersion, _sessionId);
+    public TurnInfo Turn => _turn.Current;
+
+    /// <summary>
+    /// Completes the next time parsed output is appended, the turn state moves or the process exits.
+    /// </summary>
+    public Task OutputChanged => _outputChanged.Next;
+
+    /// <summary>
+    /// Cancelled by <see cref="Stop"/>, so work still waiting on this session's client gives up.
+    /// </summary>
+    public CancellationToken Ended => _ended.Token;
+
+    public bool HasParsedOutput => _parsedOutput.HasAfter(null);
+
+    /// <summary>
+    /// Unread output pushed out of memory to the session's spill file.
+    /// </summary>
+    public long SpilledOutputBytes => _parsedOutput.Spilled * sizeof(char);
+
+    /// <summary>
+    /// Parsed output written past <paramref name="since"/>, or past the last destructive read when null.
+    /// </summary>
+    public bool HasOutputAfter(long? since) => _parsedOutput.HasAfter(since);
+
+    private string GetSystemPrompt() => SystemPromptTemplate.Generate(_sessionId);
+
+    /// <summary>
+    /// Hands a session started ahead of time (see <see cref="WarmPool"/>) to the client that
+    /// connected; its Windows version goes to Claude with the first message.
+    /// </summary>
+    public void Bind(string windowsVersion)
+    {
+        _windowsVersion = windowsVersion;
+        LastActivity = LastInput = DateTime.UtcNow;
+    }
 
     private static string BuildPath()
     {
@@ -99,6 +186,14 @@ public class ClaudeSession(
     public void UpdateHeartbeat() => LastActivity = DateTime.UtcNow;
 
     public void Start()
+    {
+        lock (_lifecycle)
+        {
+            StartProcess(resume: null);
+        }
+    }
+
+    private void StartProcess(string? resume)
     {
         var escapedPrompt = GetSystemPrompt().Replace("\"", "\\\"").Replace("\n", " ").Replace("\r", "");
 
@@ -107,7 +202,12 @@ public class ClaudeSession(
             ? (envCliPath.EndsWith(".js") ? "node" : envCliPath, envCliPath.EndsWith(".js") ? envCliPath : null)
             : FindClaudeCli();
 
-        var cliArgs = "--input-format stream-json --output-format stream-json --print --verbose --dangerously-skip-permissions --append-system-prompt";
+        var cliArgs = "--input-format stream-json --output-format stream-json --print --verbose --dangerously-skip-permissions";
+        if (resume != null)
+        {
+            cliArgs += $" --resume {resume}";
+        }
+        cliArgs += " --append-system-prompt";
         var arguments = scriptPath != null
             ? $"\"{scriptPath}\" {cliArgs} \"{escapedPrompt}\""
             : $"{cliArgs} \"{escapedPrompt}\"";
@@ -130,7 +230,17 @@ public class ClaudeSession(
             }
         };
 
-        _process = new Process { StartInfo = startInfo };
+        _process = new Process { StartInfo = startInfo, EnableRaisingEvents = true };
+        _process.Exited += (s, e) =>
+        {
+            // A process hibernated or stopped on purpose is no longer _process
+            if (s != _process)
+            {
+                return;
+            }
+            _turn.End();
+            _outputChanged.Pulse();
+        };
 
         _process.OutputDataReceived += (s, e) =>
         {
@@ -144,7 +254,15 @@ public class ClaudeSession(
                         _outputBuffer.AppendLine(e.Data);
                     }
                     ParseJsonLine(e.Data);
+
+                    if (_resumedAt != 0)
+                    {
+                        ResumeLatency = Stopwatch.GetElapsedTime(_resumedAt);
+                        _resumedAt = 0;
+                        logger.LogInformation("Session {SessionId} resumed in {Ms:F0} ms", _sessionId, ResumeLatency.Value.TotalMilliseconds);
+                    }
                 }
+                _outputChanged.Pulse();
             }
         };
 
@@ -153,13 +271,8 @@ public class ClaudeSession(
             if (e.Data != null)
             {
                 logger.LogWarning("Claude stderr: {Data}", e.Data);
-                lock (_lock)
-                {
-                    if (_parsedOutputBuffer.Length < MaxBufferSize)
-                    {
-                        _parsedOutputBuffer.AppendLine($"[ERR] {e.Data}");
-                    }
-                }
+                _parsedOutput.Append($"[ERR] {e.Data}{Environment.NewLine}");
+                _outputChanged.Pulse();
             }
         };
 
@@ -169,33 +282,23 @@ public class ClaudeSession(
         _process.BeginErrorReadLine();
     }
 
-    private void AppendParsedOutput(string? text)
-    {
-        if (text != null && _parsedOutputBuffer.Length < MaxBufferSize)
-        {
-            _parsedOutputBuffer.Append(text);
-        }
-    }
+    private void AppendParsedOutput(string? text) => _parsedOutput.Append(text);
 
     private void AppendParsedOutputLine(string? text = null)
     {
-        if (_parsedOutputBuffer.Length < MaxBufferSize)
-        {
-            if (text != null)
-            {
-                _parsedOutputBuffer.AppendLine(text);
-            }
-            else
-            {
-                _parsedOutputBuffer.AppendLine();
-            }
-        }
+        _parsedOutput.Append(text);
+        _parsedOutput.Append(Environment.NewLine);
     }
 
     private void ParseJsonLine(string line)
     {
         var result = _parser.Parse(line);
 
+        if (result.Turn is { } turn)
+        {
+            _turn.Observe(turn);
+        }
+
         if (result.Text != null)
         {
             if (result.AppendNewline)
@@ -215,50 +318,136 @@ public class ClaudeSession(
 
     public async Task SendInput(string text)
     {
-        if (_process?.StandardInput != null && IsRunning)
+        Process? process;
+        lock (_lifecycle)
         {
-            var escapedContent = JsonSerializer.Serialize(text, AppJsonSerializerContext.Default.String);
-            var json = $"{{\"type\":\"user\",\"message\":{{\"role\":\"user\",\"content\":{escapedContent}}}}}\n";
-            await _process.StandardInput.WriteAsync(json);
-            await _process.StandardInput.FlushAsync();
+            process = _process;
+            if (process?.StandardInput == null || !IsRunning)
+            {
+                return;
+            }
+
+            if (!_contextSent && _windowsVersion != null)
+            {
+                text = SystemPromptTemplate.SessionContext(_windowsVersion) + text;
+                _contextSent = true;
+            }
+
+            // Begun under the lock, so the session is no longer idle by the time Hibernate can look
+            LastInput = DateTime.UtcNow;
+            _turn.BeginTurn();
         }
+
+        var escapedContent = JsonSerializer.Serialize(text, AppJsonSerializerContext.Default.String);
+        var json = $"{{\"type\":\"user\",\"message\":{{\"role\":\"user\",\"content\":{escapedContent}}}}}\n";
+        _outputChanged.Pulse();
+        await process.StandardInput.WriteAsync(json);
+        await process.StandardInput.FlushAsync();
     }
 
-    public string GetOutput()
+    /// <summary>
+    /// Stops the process of an idle session but keeps the session, its output and the CLI's
+    /// conversation id, so <see cref="Resume"/> can carry on where it left off. Returns false if
+    /// the session is busy or has no live process.
+    /// </summary>
+    public bool Hibernate()
     {
-        lock (_lock)
+        lock (_lifecycle)
         {
-            var output = _outputBuffer.ToString();
-            _outputBuffer.Clear();
-            return output;
+            if (_process is not { HasExited: false } process || !IsIdle)
+            {
+                return false;
+            }
+
+            process.Refresh();
+            HibernatedBytes = process.WorkingSet64;
+            _process = null;
+            try
+            {
+                process.Kill(entireProcessTree: true);
+            }
+            catch (Exception ex)
+            {
+                logger.LogError(ex, "Error stopping Claude process");
+            }
+            process.Dispose();
+            IsHibernated = true;
+            return true;
         }
     }
 
-    public string GetParsedOutput()
+    /// <summary>
+    /// Starts a new process for a hibernated session, resuming its conversation. Returns false if
+    /// the session wasn't hibernated (another input may have resumed it first).
+    /// </summary>
+    public bool Resume()
+    {
+        lock (_lifecycle)
+        {
+            if (!IsHibernated)
+            {
+                return false;
+            }
+
+            _resumedAt = Stopwatch.GetTimestamp();
+            StartProcess(ConversationId);
+            IsHibernated = false;
+            HibernatedBytes = 0;
+            LastInput = DateTime.UtcNow;
+            return true;
+        }
+    }
+
+    public string GetOutput()
     {
         lock (_lock)
         {
-            var output = _parsedOutputBuffer.ToString();
-            _parsedOutputBuffer.Clear();
+            var output = _outputBuffer.ToString();
+            _outputBuffer.Clear();
             return output;
         }
     }
 
-    public void Stop()
+    /// <summary>
+    /// Everything written since the last call; what callers without a cursor get.
+    /// </summary>
+    public string GetParsedOutput() => _parsedOutput.Read(null).Text;
+
+    /// <summary>
+    /// A page of parsed output from a client's cursor; see <see cref="OutputLog.Read"/>.
+    /// </summary>
+    public OutputPage ReadParsedOutput(long? since, int maxBytes = int.MaxValue) => _parsedOutput.Read(since, maxBytes);
+
+    /// <summary>
+    /// Ends the session. Returns false if it was hibernated, and so had no process to stop.
+    /// </summary>
+    public bool Stop()
     {
-        if (_process is { HasExited: false })
+        bool hadProcess;
+        lock (_lifecycle)
         {
-            try
-            {
-                _process.Kill(entireProcessTree: true);
-            }
-            catch (Exception ex)
+            var process = _process;
+            _process = null;
+            if (process is { HasExited: false })
             {
-                logger.LogError(ex, "Error stopping Claude process");
+                try
+                {
+                    process.Kill(entireProcessTree: true);
+                }
+                catch (Exception ex)
+                {
+                    logger.LogError(ex, "Error stopping Claude process");
+                }
             }
+            process?.Dispose();
+            hadProcess = !IsHibernated;
+            IsHibernated = false;
         }
-        _process?.Dispose();
-        _process = null;
+        _parsedOutput.Dispose();
+        _turn.End();
+        _ended.Cancel();
+        _outputChanged.Pulse();
+        return hadProcess;
     }
 
     public void Dispose() => Stop();
@@ -0,0 +1,112 @@
+using ClaudeWin9xServer.Models.Responses;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Finished command results kept for <c>/cmd/status</c>. Bounded two ways: results older than the
+/// TTL are dropped, and once the output held passes the byte limit the least recently used go
+/// first. A busy build session would otherwise keep every stdout it ever produced.
+/// </summary>
+public sealed class CommandResultStore(long maxBytes, TimeSpan ttl, TimeProvider? timeProvider = null)
+{
+    // Rough cost of an entry besides its text: the record, its node and the index slot
+    private const int EntryOverhead = 160;
+
+    private sealed record Entry(string Id, CommandResult Result, long Bytes, DateTimeOffset Stored);
+
+    private readonly TimeProvider _time = timeProvider ?? TimeProvider.System;
+    private readonly object _lock = new();
+    private readonly Dictionary<string, LinkedListNode<Entry>> _index = [];
+    private readonly LinkedList<Entry> _lru = new();
+    private long _residentBytes;
+    private long _evictions;
+    private long _expirations;
+
+    public long MaxBytes => maxBytes;
+
+    public int Count
+    {
+        get
+        {
+            lock (_lock)
+            {
+                return _index.Count;
+            }
+        }
+    }
+
+    public long ResidentBytes => Interlocked.Read(ref _residentBytes);
+
+    /// <summary>
+    /// Results dropped to stay under <see cref="MaxBytes"/>.
+    /// </summary>
+    public long Evictions => Interlocked.Read(ref _evictions);
+
+    /// <summary>
+    /// Results dropped for outliving the TTL.
+    /// </summary>
+    public long Expirations => Interlocked.Read(ref _expirations);
+
+    public void Add(string commandId, CommandResult result)
+    {
+        var now = _time.GetUtcNow();
+        var entry = new Entry(commandId, result, SizeOf(result), now);
+
+        lock (_lock)
+        {
+            if (_index.TryGetValue(commandId, out var existing))
+            {
+                Remove(existing);
+            }
+
+            _index[commandId] = _lru.AddFirst(entry);
+            Interlocked.Add(ref _residentBytes, entry.Bytes);
+
+            // Results read since they were stored are warmer but just as old; TryGet drops those
+            while (_lru.Last is { } oldest && oldest.Value.Stored + ttl <= now)
+            {
+                Remove(oldest);
+                Interlocked.Increment(ref _expirations);
+            }
+
+            // Keep the newest even if it alone is over the limit
+            while (_residentBytes > maxBytes && _lru.Last is { } coldest && coldest != _lru.First)
+            {
+                Remove(coldest);
+                Interlocked.Increment(ref _evictions);
+            }
+        }
+    }
+
+    public CommandResult? TryGet(string commandId)
+    {
+        lock (_lock)
+        {
+            if (!_index.TryGetValue(commandId, out var node))
+            {
+                return null;
+            }
+
+            if (node.Value.Stored + ttl <= _time.GetUtcNow())
+            {
+                Remove(node);
+                Interlocked.Increment(ref _expirations);
+                return null;
+            }
+
+            _lru.Remove(node);
+            _lru.AddFirst(node);
+            return node.Value.Result;
+        }
+    }
+
+    private void Remove(LinkedListNode<Entry> node)
+    {
+        _lru.Remove(node);
+        _index.Remove(node.Value.Id);
+        Interlocked.Add(ref _residentBytes, -node.Value.Bytes);
+    }
+
+    private static long SizeOf(CommandResult result) =>
+        EntryOverhead + sizeof(char) * ((long)(result.Stdout?.Length ?? 0) + (result.Stderr?.Length ?? 0) + (result.CommandId?.Length ?? 0));
+}
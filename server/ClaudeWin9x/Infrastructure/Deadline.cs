@@ -0,0 +1,75 @@
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// A timeout that can be moved while it runs, so work can wait on a fixed bound while queued and
+/// on an estimate for its client once dispatched. Expiry surfaces as <see cref="TimeoutException"/>,
+/// like <see cref="Task.WaitAsync(TimeSpan)"/>.
+/// </summary>
+public sealed class Deadline : IDisposable
+{
+    private readonly object _lock = new();
+    private readonly TimeProvider _time;
+    private readonly CancellationTokenSource _cts;
+    private long _due;
+    private bool _disposed;
+
+    public Deadline(TimeSpan initial, TimeProvider? timeProvider = null)
+    {
+        _time = timeProvider ?? TimeProvider.System;
+        _cts = new CancellationTokenSource(initial, _time);
+        _due = _time.GetTimestamp() + ToTimestamp(initial);
+    }
+
+    /// <summary>
+    /// Restarts the countdown at <paramref name="after"/> from now; ignored once expired or disposed.
+    /// </summary>
+    public void Reset(TimeSpan after)
+    {
+        lock (_lock)
+        {
+            if (!_disposed)
+            {
+                _cts.CancelAfter(after);
+                _due = _time.GetTimestamp() + ToTimestamp(after);
+            }
+        }
+    }
+
+    /// <summary>
+    /// Like <see cref="Reset"/>, but only ever moves the deadline later.
+    /// </summary>
+    public void Extend(TimeSpan atLeast)
+    {
+        lock (_lock)
+        {
+            if (!_disposed && _time.GetTimestamp() + ToTimestamp(atLeast) > _due)
+            {
+                Reset(atLeast);
+            }
+        }
+    }
+
+    public async Task<T> WaitAsync<T>(Task<T> task, CancellationToken cancellationToken)
+    {
+        using var linked = CancellationTokenSource.CreateLinkedTokenSource(cancellationToken, _cts.Token);
+        try
+        {
+            return await task.WaitAsync(linked.Token);
+        }
+        catch (OperationCanceledException) when (_cts.IsCancellationRequested && !cancellationToken.IsCancellationRequested)
+        {
+            throw new TimeoutException();
+        }
+    }
+
+    public void Dispose()
+    {
+        lock (_lock)
+        {
+            _disposed = true;
+            _cts.Dispose();
+        }
+    }
+
+    private long ToTimestamp(TimeSpan span) => (long)(span.TotalSeconds * _time.TimestampFrequency);
+}
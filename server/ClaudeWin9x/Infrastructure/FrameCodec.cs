@@ -0,0 +1,110 @@
+using System.Buffers.Binary;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+public enum FrameType : byte
+{
+    Hello = 0x01,
+    HelloOk = 0x02,
+    Ack = 0x03,
+    Sync = 0x10,
+    Output = 0x11,
+    FileOp = 0x12,
+    Command = 0x13,
+    Approval = 0x14,
+    SyncEnd = 0x15,
+    FileResult = 0x20,
+    CommandResult = 0x21,
+    ApprovalResponse = 0x22,
+    Input = 0x23,
+    Lease = 0x24,
+    Download = 0x30,
+    Upload = 0x31,
+    DataBegin = 0x32,
+    Data = 0x33,
+    DataEnd = 0x34,
+    Error = 0x7F
+}
+
+/// <summary>
+/// Control frames are always written before queued bulk data, so output and tool traffic
+/// keep flowing while a file transfer is in progress on the same connection.
+/// </summary>
+public enum FramePriority : byte
+{
+    Control = 0,
+    Bulk = 1
+}
+
+public readonly record struct Frame(FrameType Type, FramePriority Priority, ushort Stream, byte[] Payload);
+
+/// <summary>
+/// Wire format shared with client/frame.c: an 8-byte little-endian header
+/// (type, priority, stream id, payload length) followed by the payload.
+/// </summary>
+public static class FrameCodec
+{
+    public const int HeaderSize = 8;
+    public const int MaxPayloadSize = 1024 * 1024;
+    public const int DataChunkSize = 16 * 1024;
+
+    public static byte[] Encode(Frame frame)
+    {
+        var buffer = new byte[HeaderSize + frame.Payload.Length];
+        buffer[0] = (byte)frame.Type;
+        buffer[1] = (byte)frame.Priority;
+        BinaryPrimitives.WriteUInt16LittleEndian(buffer.AsSpan(2), frame.Stream);
+        BinaryPrimitives.WriteInt32LittleEndian(buffer.AsSpan(4), frame.Payload.Length);
+        frame.Payload.CopyTo(buffer, HeaderSize);
+        return buffer;
+    }
+
+    public static ValueTask WriteAsync(Stream stream, Frame frame, CancellationToken cancellationToken) =>
+        stream.WriteAsync(Encode(frame), cancellationToken);
+
+    /// <summary>
+    /// Reads the next frame, or returns null if the peer closed the connection between frames.
+    /// </summary>
+    public static async Task<Frame?> ReadAsync(Stream stream, CancellationToken cancellationToken)
+    {
+        var header = new byte[HeaderSize];
+        if (!await ReadExactlyAsync(stream, header, allowEof: true, cancellationToken))
+        {
+            return null;
+        }
+
+        var length = BinaryPrimitives.ReadInt32LittleEndian(header.AsSpan(4));
+        if (length is < 0 or > MaxPayloadSize)
+        {
+            throw new InvalidDataException($"Frame payload length {length} out of range");
+        }
+
+        var payload = new byte[length];
+        await ReadExactlyAsync(stream, payload, allowEof: false, cancellationToken);
+
+        return new Frame(
+            (FrameType)header[0],
+            (FramePriority)header[1],
+            BinaryPrimitives.ReadUInt16LittleEndian(header.AsSpan(2)),
+            payload);
+    }
+
+    private static async Task<bool> ReadExactlyAsync(Stream stream, byte[] buffer, bool allowEof, CancellationToken cancellationToken)
+    {
+        var total = 0;
+        while (total < buffer.Length)
+        {
+            var read = await stream.ReadAsync(buffer.AsMemory(total), cancellationToken);
+            if (read == 0)
+            {
+                if (allowEof && total == 0)
+                {
+                    return false;
+                }
+                throw new EndOfStreamException("Connection closed mid-frame");
+            }
+            total += read;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,72 @@
+using System.Buffers.Binary;
+using System.Text;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Builds a frame payload from fields: strings and byte blocks are a 4-byte length followed by the
+/// bytes, integers are 4 bytes. Fields carry no tags; each frame type has a fixed field order.
+/// </summary>
+public sealed class FramePayloadWriter
+{
+    private readonly MemoryStream _buffer = new();
+
+    public FramePayloadWriter Add(string? value) => Add(Encoding.UTF8.GetBytes(value ?? ""));
+
+    public FramePayloadWriter Add(ReadOnlySpan<byte> value)
+    {
+        Add(value.Length);
+        _buffer.Write(value);
+        return this;
+    }
+
+    public FramePayloadWriter Add(int value)
+    {
+        Span<byte> bytes = stackalloc byte[4];
+        BinaryPrimitives.WriteInt32LittleEndian(bytes, value);
+        _buffer.Write(bytes);
+        return this;
+    }
+
+    public byte[] ToArray() => _buffer.ToArray();
+}
+
+public sealed class FramePayloadReader(byte[] payload)
+{
+    private int _offset;
+
+    public bool HasMore => _offset < payload.Length;
+
+    public int ReadInt()
+    {
+        if (payload.Length - _offset < 4)
+        {
+            throw new InvalidDataException("Frame payload ended inside an integer field");
+        }
+
+        var value = BinaryPrimitives.ReadInt32LittleEndian(payload.AsSpan(_offset));
+        _offset += 4;
+        return value;
+    }
+
+    public ReadOnlySpan<byte> ReadBytes()
+    {
+        var length = ReadInt();
+        if (length < 0 || payload.Length - _offset < length)
+        {
+            throw new InvalidDataException("Frame payload ended inside a field");
+        }
+
+        var span = payload.AsSpan(_offset, length);
+        _offset += length;
+        return span;
+    }
+
+    public string ReadString() => Encoding.UTF8.GetString(ReadBytes());
+
+    public string? ReadOptionalString()
+    {
+        var value = ReadString();
+        return value.Length > 0 ? value : null;
+    }
+}
@@ -0,0 +1,48 @@
+using System.Threading.Channels;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Serialises frames from concurrent request handlers onto one connection. Control frames go
+/// ahead of queued bulk data; the bulk queue is bounded so a download can't buffer a whole file.
+/// </summary>
+public sealed class FrameWriter(Stream stream)
+{
+    private const int BulkQueueDepth = 4;
+
+    private readonly Channel<Frame> _control = Channel.CreateUnbounded<Frame>();
+    private readonly Channel<Frame> _bulk = Channel.CreateBounded<Frame>(BulkQueueDepth);
+    private readonly SemaphoreSlim _queued = new(0);
+
+    public async ValueTask SendAsync(Frame frame, CancellationToken cancellationToken = default)
+    {
+        var queue = frame.Priority == FramePriority.Control ? _control : _bulk;
+        await queue.Writer.WriteAsync(frame, cancellationToken);
+        _queued.Release();
+    }
+
+    /// <summary>
+    /// Stops <see cref="RunAsync"/> once the frames already queued have been written.
+    /// </summary>
+    public void Complete()
+    {
+        _control.Writer.TryComplete();
+        _bulk.Writer.TryComplete();
+        _queued.Release();
+    }
+
+    public async Task RunAsync(CancellationToken cancellationToken)
+    {
+        while (true)
+        {
+            await _queued.WaitAsync(cancellationToken);
+
+            if (!_control.Reader.TryRead(out var frame) && !_bulk.Reader.TryRead(out frame))
+            {
+                return;
+            }
+
+            await FrameCodec.WriteAsync(stream, frame, cancellationToken);
+        }
+    }
+}
@@ -0,0 +1,160 @@
+using System.Buffers;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Response body that holds a small reply until it is complete, so it goes out with a
+/// Content-Length: the client frames replies by length to keep its connection open, and Kestrel
+/// would chunk them otherwise. A reply that grows past <c>limit</c> bytes stops being held; what
+/// is held and everything after it is written through unframed, and the connection closes after
+/// it, as every reply did before keep-alive.
+/// </summary>
+public sealed class FramedResponseBody(HttpResponse response, Stream inner, int limit) : Stream
+{
+    private byte[]? _buffer;
+    private int _length;
+    private bool _streaming;
+
+    public override bool CanRead => false;
+    public override bool CanSeek => false;
+    public override bool CanWrite => true;
+    public override long Length => throw new NotSupportedException();
+    public override long Position
+    {
+        get => throw new NotSupportedException();
+        set => throw new NotSupportedException();
+    }
+
+    /// <summary>
+    /// True once the reply outgrew the limit and is being written through.
+    /// </summary>
+    public bool Streaming => _streaming;
+
+    public override void Write(byte[] buffer, int offset, int count) => Write(buffer.AsSpan(offset, count));
+
+    public override void Write(ReadOnlySpan<byte> buffer)
+    {
+        if (!_streaming && Hold(buffer))
+        {
+            return;
+        }
+        StartStreaming();
+        if (_length > 0)
+        {
+            inner.Write(_buffer.AsSpan(0, _length));
+            Release();
+        }
+        inner.Write(buffer);
+    }
+
+    public override Task WriteAsync(byte[] buffer, int offset, int count, CancellationToken cancellationToken) =>
+        WriteAsync(buffer.AsMemory(offset, count), cancellationToken).AsTask();
+
+    public override async ValueTask WriteAsync(ReadOnlyMemory<byte> buffer, CancellationToken cancellationToken = default)
+    {
+        if (!_streaming && Hold(buffer.Span))
+        {
+            return;
+        }
+        StartStreaming();
+        if (_length > 0)
+        {
+            await inner.WriteAsync(_buffer.AsMemory(0, _length), cancellationToken);
+            Release();
+        }
+        await inner.WriteAsync(buffer, cancellationToken);
+    }
+
+    // A held reply isn't flushed until it is complete; flushing would send the headers without a length
+    public override void Flush()
+    {
+        if (_streaming)
+        {
+            inner.Flush();
+        }
+    }
+
+    public override Task FlushAsync(CancellationToken cancellationToken) =>
+        _streaming ? inner.FlushAsync(cancellationToken) : Task.CompletedTask;
+
+    /// <summary>
+    /// Sends a held reply with its length. Call once the endpoint has written everything.
+    /// </summary>
+    public async Task CompleteAsync(CancellationToken cancellationToken)
+    {
+        if (_streaming)
+        {
+            return;
+        }
+
+        if (!response.HasStarted)
+        {
+            response.ContentLength = _length;
+        }
+        if (_length > 0)
+        {
+            await inner.WriteAsync(_buffer.AsMemory(0, _length), cancellationToken);
+        }
+        Release();
+    }
+
+    private bool Hold(ReadOnlySpan<byte> data)
+    {
+        var needed = _length + data.Length;
+        if (needed > limit)
+        {
+            return false;
+        }
+
+        if (_buffer == null || needed > _buffer.Length)
+        {
+            var grown = ArrayPool<byte>.Shared.Rent(Math.Min(limit, Math.Max(needed, (_buffer?.Length ?? 2048) * 2)));
+            _buffer?.AsSpan(0, _length).CopyTo(grown);
+            if (_buffer != null)
+            {
+                ArrayPool<byte>.Shared.Return(_buffer);
+            }
+            _buffer = grown;
+        }
+
+        data.CopyTo(_buffer.AsSpan(_length));
+        _length = needed;
+        return true;
+    }
+
+    private void StartStreaming()
+    {
+        if (_streaming)
+        {
+            return;
+        }
+        _streaming = true;
+
+        // An unchunked reply of unknown length can only end by closing the connection
+        if (!response.HasStarted)
+        {
+            response.Headers.Connection = "close";
+            response.Headers.TransferEncoding = "";
+        }
+    }
+
+    private void Release()
+    {
+        if (_buffer != null)
+        {
+            ArrayPool<byte>.Shared.Return(_buffer);
+            _buffer = null;
+        }
+        _length = 0;
+    }
+
+    protected override void Dispose(bool disposing)
+    {
+        Release();
+        base.Dispose(disposing);
+    }
+
+    public override int Read(byte[] buffer, int offset, int count) => throw new NotSupportedException();
+    public override long Seek(long offset, SeekOrigin origin) => throw new NotSupportedException();
+    public override void SetLength(long value) => throw new NotSupportedException();
+}
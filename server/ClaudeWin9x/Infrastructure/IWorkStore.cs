@@ -0,0 +1,18 @@
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Where registries keep records that must outlive a request: work in flight, sessions and the
+/// instances serving them. Records are JSON text grouped by kind and keyed by id. The memory
+/// store is private to one process; a shared store lets several server processes see each
+/// other's instances and sessions, and lets a restarted process find the work it left behind.
+/// </summary>
+public interface IWorkStore : IDisposable
+{
+    void Put(string kind, string id, string json);
+
+    void Remove(string kind, string id);
+
+    string? Get(string kind, string id);
+
+    IReadOnlyDictionary<string, string> List(string kind);
+}
@@ -33,6 +33,155 @@ public static class IniConfig
             : throw new ArgumentOutOfRangeException(nameof(value), $"Port must be between {MinPort} and {MaxPort}");
     } = 5002;
 
+    /// <summary>
+    /// Port for the binary frame protocol; 0 disables it and clients stay on HTTP.
+    /// </summary>
+    public static int FramePort
+    {
+        get;
+        private set => field = value is 0 or (>= MinPort and <= MaxPort)
+            ? value
+            : throw new ArgumentOutOfRangeException(nameof(value), $"Port must be 0 or between {MinPort} and {MaxPort}");
+    } = 5003;
+
+    /// <summary>
+    /// Output of finished commands kept for /cmd/status, in MB; least recently used goes first.
+    /// </summary>
+    public static int ResultStoreMb
+    {
+        get;
+        private set => field = value > 0
+            ? value
+            : throw new ArgumentOutOfRangeException(nameof(value), "result_store_mb must be positive");
+    } = 64;
+
+    /// <summary>
+    /// Minutes a finished command's result stays available for /cmd/status.
+    /// </summary>
+    public static int ResultTtlMinutes
+    {
+        get;
+        private set => field = value > 0
+            ? value
+            : throw new ArgumentOutOfRangeException(nameof(value), "result_ttl_minutes must be positive");
+    } = 30;
+
+    /// <summary>
+    /// Shortest deadline a file operation gets from a client's measured latency, in seconds.
+    /// </summary>
+    public static int DeadlineFloorSeconds
+    {
+        get;
+        private set => field = value > 0
+            ? value
+            : throw new ArgumentOutOfRangeException(nameof(value), "deadline_floor_seconds must be positive");
+    } = 5;
+
+    /// <summary>
+    /// Shortest deadline a command gets from the client's past command times, in seconds.
+    /// </summary>
+    public static int CommandDeadlineFloorSeconds
+    {
+        get;
+        private set => field = value > 0
+            ? value
+            : throw new ArgumentOutOfRangeException(nameof(value), "command_deadline_floor_seconds must be positive");
+    } = 30;
+
+    /// <summary>
+    /// Longest deadline any estimate may give, in seconds.
+    /// </summary>
+    public static int DeadlineCeilingSeconds
+    {
+        get;
+        private set => field = value > 0
+            ? value
+            : throw new ArgumentOutOfRangeException(nameof(value), "deadline_ceiling_seconds must be positive");
+    } = 600;
+
+    /// <summary>
+    /// Claude CLI processes allowed to run at once; further /start requests wait in line.
+    /// </summary>
+    public static int MaxSessions
+    {
+        get;
+        private set => field = value > 0
+            ? value
+            : throw new ArgumentOutOfRangeException(nameof(value), "max_sessions must be positive");
+    } = 8;
+
+    /// <summary>
+    /// Minutes without input after which a session may be stopped for a waiting client or to free memory.
+    /// </summary>
+    public static int IdleEvictMinutes
+    {
+        get;
+        private set => field = value > 0
+            ? value
+            : throw new ArgumentOutOfRangeException(nameof(value), "idle_evict_minutes must be positive");
+    } = 15;
+
+    /// <summary>
+    /// Minutes without input after which a session's process is stopped until its next input; 0 turns it off.
+    /// </summary>
+    public static int HibernateMinutes
+    {
+        get;
+        private set => field = value >= 0
+            ? value
+            : throw new ArgumentOutOfRangeException(nameof(value), "hibernate_minutes must not be negative");
+    } = 60;
+
+    /// <summary>
+    /// Share of physical memory in use, in percent, above which idle sessions are stopped.
+    /// </summary>
+    public static int MemoryPressurePercent
+    {
+        get;
+        private set => field = value is > 0 and <= 100
+            ? value
+            : throw new ArgumentOutOfRangeException(nameof(value), "memory_pressure_percent must be between 1 and 100");
+    } = 90;
+
+    /// <summary>
+    /// Claude CLI processes kept started ahead of time so a new session need not wait for one; 0 turns it off.
+    /// </summary>
+    public static int WarmPoolSize
+    {
+        get;
+        private set => field = value >= 0
+            ? value
+            : throw new ArgumentOutOfRangeException(nameof(value), "warm_pool_size must not be negative");
+    } = 1;
+
+    /// <summary>
+    /// Disk, in MB, each session may use for output its client hasn't read yet once memory is full; 0 turns it off.
+    /// </summary>
+    public static int OutputSpillMb
+    {
+        get;
+        private set => field = value >= 0
+            ? value
+            : throw new ArgumentOutOfRangeException(nameof(value), "output_spill_mb must not be negative");
+    } = 64;
+
+    /// <summary>
+    /// Directory holding the journal that server processes working together share; empty keeps
+    /// every registry in this process.
+    /// </summary>
+    public static string StateDir { get; private set; } = "";
+
+    /// <summary>
+    /// This process's name among those sharing <see cref="StateDir"/>; empty means host name and API port.
+    /// </summary>
+    public static string InstanceName { get; private set; } = "";
+
+    /// <summary>
+    /// Address other instances send clients to when a session is placed here; empty means the
+    /// address the client already uses.
+    /// </summary>
+    public static string PublicHost { get; private set; } = "";
+
     public static void Load(string filename = "server.ini")
     {
         var path = Path.Combine(AppContext.BaseDirectory, filename);
@@ -64,9 +213,84 @@ public static class IniConfig
             UploadPort = ulPort;
         }
 
+        if (config.TryGetValue("frame_port", out var fp) && int.TryParse(fp, out var framePort))
+        {
+            FramePort = framePort;
+        }
+
+        if (config.TryGetValue("result_store_mb", out var rs) && int.TryParse(rs, out var resultStoreMb))
+        {
+            ResultStoreMb = resultStoreMb;
+        }
+        if (config.TryGetValue("result_ttl_minutes", out var rt) && int.TryParse(rt, out var resultTtl))
+        {
+            ResultTtlMinutes = resultTtl;
+        }
+
+        if (config.TryGetValue("deadline_floor_seconds", out var df) && int.TryParse(df, out var deadlineFloor))
+        {
+            DeadlineFloorSeconds = deadlineFloor;
+        }
+        if (config.TryGetValue("command_deadline_floor_seconds", out var cf) && int.TryParse(cf, out var commandFloor))
+        {
+            CommandDeadlineFloorSeconds = commandFloor;
+        }
+        if (config.TryGetValue("deadline_ceiling_seconds", out var dc) && int.TryParse(dc, out var deadlineCeiling))
+        {
+            DeadlineCeilingSeconds = deadlineCeiling;
+        }
+
+        if (config.TryGetValue("max_sessions", out var ms) && int.TryParse(ms, out var maxSessions))
+        {
+            MaxSessions = maxSessions;
+        }
+        if (config.TryGetValue("idle_evict_minutes", out var ie) && int.TryParse(ie, out var idleEvict))
+        {
+            IdleEvictMinutes = idleEvict;
+        }
+        if (config.TryGetValue("hibernate_minutes", out var hm) && int.TryParse(hm, out var hibernate))
+        {
+            HibernateMinutes = hibernate;
+        }
+        if (config.TryGetValue("memory_pressure_percent", out var mp) && int.TryParse(mp, out var memoryPressure))
+        {
+            MemoryPressurePercent = memoryPressure;
+        }
+        if (config.TryGetValue("warm_pool_size", out var wp) && int.TryParse(wp, out var warmPool))
+        {
+            WarmPoolSize = warmPool;
+        }
+        if (config.TryGetValue("output_spill_mb", out var os) && int.TryParse(os, out var outputSpill))
+        {
+            OutputSpillMb = outputSpill;
+        }
+
+        if (config.TryGetValue("state_dir", out var sd))
+        {
+            StateDir = sd;
+        }
+        if (config.TryGetValue("instance_name", out var name))
+        {
+            InstanceName = name;
+        }
+        if (config.TryGetValue("public_host", out var ph))
+        {
+            PublicHost = ph;
+        }
+
         if (ApiPort == DownloadPort || ApiPort == UploadPort || DownloadPort == UploadPort)
         {
             throw new InvalidOperationException("api_port, download_port, and upload_port must all be different");
         }
+
+        if (FramePort != 0 && (FramePort == ApiPort || FramePort == DownloadPort || FramePort == UploadPort))
+        {
+            throw new InvalidOperationException("frame_port must differ from the other ports");
+        }
+
+        if (DeadlineFloorSeconds > DeadlineCeilingSeconds || CommandDeadlineFloorSeconds > DeadlineCeilingSeconds)
+        {
+            throw new InvalidOperationException("deadline floors must not exceed deadline_ceiling_seconds");
+        }
     }
 }
@@ -0,0 +1,21 @@
+using System.Text.Json.Serialization;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// One line of a <see cref="JournalWorkStore"/> journal: a record put or removed.
+/// </summary>
+public record JournalEntry
+{
+    [JsonPropertyName("op")]
+    public required string Op { get; init; }
+
+    [JsonPropertyName("kind")]
+    public required string Kind { get; init; }
+
+    [JsonPropertyName("id")]
+    public required string Id { get; init; }
+
+    [JsonPropertyName("data")]
+    public string? Data { get; init; }
+}
@@ -0,0 +1,233 @@
+using System.Text;
+using System.Text.Json;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Records kept in an append-only journal file that any number of server processes may share.
+/// Every change is one JSON line, synced to disk before the call returns, so what a process wrote
+/// is there after it crashes. Each access takes an exclusive lock on a side file, reads whatever
+/// the other processes appended since last time, then appends its own line; a line cut short by a
+/// crash is dropped by the next process to take the lock. Once superseded lines outnumber live
+/// records the journal is rewritten under a new generation, which tells the others to reread it.
+/// </summary>
+public sealed class JournalWorkStore : IWorkStore
+{
+    // Superseded lines tolerated beyond the live records before rewriting
+    private const int CompactSlack = 1024;
+    private const string GenerationPrefix = "#generation ";
+
+    private static readonly TimeSpan LockTimeout = TimeSpan.FromSeconds(10);
+
+    private readonly string _path;
+    private readonly string _lockPath;
+    private readonly object _lock = new();
+    private readonly Dictionary<string, Dictionary<string, string>> _kinds = [];
+    private long _generation = -1;
+    private long _offset;
+    private int _lines;
+
+    public JournalWorkStore(string directory)
+    {
+        Directory.CreateDirectory(directory);
+        _path = Path.Combine(directory, "work.journal");
+        _lockPath = _path + ".lock";
+    }
+
+    public void Put(string kind, string id, string json) =>
+        Append(new JournalEntry { Op = "put", Kind = kind, Id = id, Data = json });
+
+    public void Remove(string kind, string id) =>
+        Append(new JournalEntry { Op = "remove", Kind = kind, Id = id });
+
+    public string? Get(string kind, string id)
+    {
+        lock (_lock)
+        {
+            using var fileLock = AcquireFileLock();
+            CatchUp();
+            return _kinds.TryGetValue(kind, out var records) && records.TryGetValue(id, out var json) ? json : null;
+        }
+    }
+
+    public IReadOnlyDictionary<string, string> List(string kind)
+    {
+        lock (_lock)
+        {
+            using var fileLock = AcquireFileLock();
+            CatchUp();
+            return _kinds.TryGetValue(kind, out var records) ? new Dictionary<string, string>(records) : [];
+        }
+    }
+
+    private void Append(JournalEntry entry)
+    {
+        var line = Encoding.UTF8.GetBytes(JsonSerializer.Serialize(entry, AppJsonSerializerContext.Default.JournalEntry) + "\n");
+
+        lock (_lock)
+        {
+            using var fileLock = AcquireFileLock();
+            CatchUp();
+
+            using (var journal = new FileStream(_path, FileMode.Open, FileAccess.Write, FileShare.ReadWrite))
+            {
+                journal.Seek(_offset, SeekOrigin.Begin);
+                journal.Write(line);
+                journal.Flush(flushToDisk: true);
+            }
+
+            _offset += line.Length;
+            _lines++;
+            Apply(entry);
+
+            if (_lines > 2 * _kinds.Values.Sum(r => r.Count) + CompactSlack)
+            {
+                Compact();
+            }
+        }
+    }
+
+    // Other processes hold the same lock, so nobody writes while we read or append
+    private FileStream AcquireFileLock()
+    {
+        var started = Environment.TickCount64;
+        while (true)
+        {
+            try
+            {
+                return new FileStream(_lockPath, FileMode.OpenOrCreate, FileAccess.ReadWrite, FileShare.None);
+            }
+            catch (IOException) when (Environment.TickCount64 - started < LockTimeout.TotalMilliseconds)
+            {
+                Thread.Sleep(1);
+            }
+        }
+    }
+
+    private void CatchUp()
+    {
+        if (!File.Exists(_path))
+        {
+            _kinds.Clear();
+            WriteGeneration(DateTime.UtcNow.Ticks, []);
+            return;
+        }
+
+        using var journal = new FileStream(_path, FileMode.Open, FileAccess.ReadWrite, FileShare.ReadWrite);
+        var header = ReadHeader(journal, out var headerLength);
+        if (header != _generation)
+        {
+            _kinds.Clear();
+            _generation = header;
+            _offset = headerLength;
+            _lines = 0;
+        }
+
+        if (journal.Length <= _offset)
+        {
+            return;
+        }
+
+        var tail = new byte[journal.Length - _offset];
+        journal.Seek(_offset, SeekOrigin.Begin);
+        journal.ReadExactly(tail);
+
+        var start = 0;
+        for (var newline = Array.IndexOf(tail, (byte)'\n'); newline >= 0; newline = Array.IndexOf(tail, (byte)'\n', start))
+        {
+            if (Parse(tail.AsSpan(start, newline - start)) is { } entry)
+            {
+                Apply(entry);
+            }
+            _lines++;
+            start = newline + 1;
+        }
+
+        _offset += start;
+
+        // The writer of an unfinished line died holding the lock; appending after it would glue lines together
+        if (start < tail.Length)
+        {
+            journal.SetLength(_offset);
+        }
+    }
+
+    private void Compact()
+    {
+        var records = _kinds
+            .SelectMany(k => k.Value.Select(r => new JournalEntry { Op = "put", Kind = k.Key, Id = r.Key, Data = r.Value }))
+            .ToList();
+        WriteGeneration(_generation + 1, records);
+    }
+
+    private void WriteGeneration(long generation, List<JournalEntry> records)
+    {
+        var temp = _path + ".tmp";
+        var header = Encoding.UTF8.GetBytes($"{GenerationPrefix}{generation}\n");
+
+        using (var journal = new FileStream(temp, FileMode.Create, FileAccess.Write, FileShare.None))
+        {
+            journal.Write(header);
+            foreach (var record in records)
+            {
+                journal.Write(Encoding.UTF8.GetBytes(JsonSerializer.Serialize(record, AppJsonSerializerContext.Default.JournalEntry) + "\n"));
+            }
+            journal.Flush(flushToDisk: true);
+            _offset = journal.Length;
+        }
+
+        File.Move(temp, _path, overwrite: true);
+        _generation = generation;
+        _lines = records.Count;
+    }
+
+    private static long ReadHeader(FileStream journal, out int length)
+    {
+        var buffer = new byte[64];
+        var read = journal.Read(buffer);
+        var newline = Array.IndexOf(buffer, (byte)'\n', 0, read);
+        var text = newline > 0 ? Encoding.UTF8.GetString(buffer, 0, newline) : "";
+
+        if (!text.StartsWith(GenerationPrefix, StringComparison.Ordinal) || !long.TryParse(text.AsSpan(GenerationPrefix.Length), out var generation))
+        {
+            throw new InvalidDataException($"{journal.Name} is not a work journal");
+        }
+
+        length = newline + 1;
+        return generation;
+    }
+
+    private static JournalEntry? Parse(ReadOnlySpan<byte> line)
+    {
+        try
+        {
+            return JsonSerializer.Deserialize(line, AppJsonSerializerContext.Default.JournalEntry);
+        }
+        catch (JsonException)
+        {
+            return null;
+        }
+    }
+
+    private void Apply(JournalEntry entry)
+    {
+        if (!_kinds.TryGetValue(entry.Kind, out var records))
+        {
+            records = [];
+            _kinds[entry.Kind] = records;
+        }
+
+        if (entry.Op == "put" && entry.Data != null)
+        {
+            records[entry.Id] = entry.Data;
+        }
+        else
+        {
+            records.Remove(entry.Id);
+        }
+    }
+
+    public void Dispose()
+    {
+    }
+}
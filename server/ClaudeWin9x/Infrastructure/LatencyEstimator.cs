@@ -0,0 +1,262 @@
+using System.Collections.Concurrent;
+using ClaudeWin9xServer.Models.Responses;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Per-session estimates of how long a client takes from dispatch to result, used to size
+/// deadlines for that client's work. File operations are modelled as a round trip plus payload
+/// over throughput; the round trip is smoothed TCP-style (mean and mean deviation) from small
+/// operations, throughput from large ones. Commands run for however long they run, so they
+/// get their own smoothed duration. With no samples yet there is no estimate and callers keep
+/// their fixed timeout.
+/// </summary>
+public sealed class LatencyEstimator(TimeSpan floor, TimeSpan commandFloor, TimeSpan ceiling, TimeProvider? timeProvider = null)
+{
+    public enum WorkKind
+    {
+        FileOp,
+        Command
+    }
+
+    // Payloads from here up measure throughput rather than round trip
+    public const long ThroughputMinBytes = 16 * 1024;
+
+
+    private sealed class Smoothed
+    {
+        public double Mean;
+        public double Deviation;
+        public int Samples;
+
+        public void Add(double value)
+        {
+            if (Samples++ == 0)
+            {
+                Mean = value;
+                Deviation = value / 2;
+                return;
+            }
+
+            Deviation += (Math.Abs(Mean - value) - Deviation) / 4;
+            Mean += (value - Mean) / 8;
+        }
+
+        public double Bound => Mean + 4 * Deviation;
+    }
+
+    private sealed class Estimates
+    {
+        public readonly Smoothed OpRtt = new();
+        public readonly Smoothed Command = new();
+        public double BytesPerSecond;
+        public int Timeouts;
+    }
+
+    private readonly record struct InFlight(string SessionKey, WorkKind Kind, long Bytes, long Started);
+
+    private readonly TimeProvider _time = timeProvider ?? TimeProvider.System;
+    private readonly object _lock = new();
+    private readonly Dictionary<string, Estimates> _sessions = [];
+    private readonly ConcurrentDictionary<string, InFlight> _inFlight = new();
+
+    /// <summary>
+    /// Bounds on leases a client renews while it works; short enough that a lost dispatch is
+    /// noticed in seconds.
+    /// </summary>
+    public TimeSpan RenewedLeaseFloor { get; init; } = TimeSpan.FromSeconds(2);
+    public TimeSpan RenewedLeaseCeiling { get; init; } = TimeSpan.FromSeconds(15);
+
+    public TimeSpan Floor => floor;
+    public TimeSpan CommandFloor => commandFloor;
+    public TimeSpan Ceiling => ceiling;
+
+    /// <summary>
+    /// Deadline for work of <paramref name="kind"/> moving <paramref name="bytes"/> either way,
+    /// measured from dispatch, or null while this session has nothing to base one on.
+    /// </summary>
+    public TimeSpan? Deadline(string? sessionId, WorkKind kind, long bytes = 0)
+    {
+        lock (_lock)
+        {
+            if (!_sessions.TryGetValue(sessionId ?? "", out var estimates))
+            {
+                return null;
+            }
+
+            double ms;
+            if (kind == WorkKind.Command)
+            {
+                if (estimates.Command.Samples == 0)
+                {
+                    return null;
+                }
+                ms = estimates.Command.Bound;
+            }
+            else
+            {
+                if (estimates.OpRtt.Samples == 0 || (bytes >= ThroughputMinBytes && estimates.BytesPerSecond <= 0))
+                {
+                    return null;
+                }
+
+                // Twice the expected transfer: throughput swings more than round trips do
+                ms = estimates.OpRtt.Bound;
+                if (estimates.BytesPerSecond > 0)
+                {
+                    ms += 2 * 1000.0 * bytes / estimates.BytesPerSecond;
+                }
+            }
+
+            var min = kind == WorkKind.Command ? commandFloor : floor;
+            return TimeSpan.FromMilliseconds(Math.Clamp(ms, min.TotalMilliseconds, ceiling.TotalMilliseconds));
+        }
+    }
+
+    /// <summary>
+    /// Lease for work the client renews while it runs (commands): a few round trips, so a
+    /// renewal can be late once without losing it.
+    /// </summary>
+    public TimeSpan RenewedLease(string? sessionId)
+    {
+        lock (_lock)
+        {
+            if (!_sessions.TryGetValue(sessionId ?? "", out var estimates) || estimates.OpRtt.Samples == 0)
+            {
+                return RenewedLeaseCeiling;
+            }
+
+            return TimeSpan.FromMilliseconds(Math.Clamp(4 * estimates.OpRtt.Bound,
+                RenewedLeaseFloor.TotalMilliseconds, RenewedLeaseCeiling.TotalMilliseconds));
+        }
+    }
+
+    /// <summary>
+    /// Starts timing <paramref name="id"/>, just handed to its client.
+    /// </summary>
+    public void Dispatched(string id, string? sessionId, WorkKind kind, long bytes = 0) =>
+        _inFlight[id] = new InFlight(sessionId ?? "", kind, bytes, _time.GetTimestamp());
+
+    /// <summary>
+    /// Takes a sample from <paramref name="id"/>, whose result just came back carrying
+    /// <paramref name="bytes"/>. Ignored for work never seen dispatched.
+    /// </summary>
+    public void Completed(string id, long bytes = 0)
+    {
+        if (!_inFlight.TryRemove(id, out var flight))
+        {
+            return;
+        }
+
+        var ms = _time.GetElapsedTime(flight.Started).TotalMilliseconds;
+        var total = flight.Bytes + bytes;
+
+        lock (_lock)
+        {
+            var estimates = For(flight.SessionKey);
+            if (flight.Kind == WorkKind.Command)
+            {
+                estimates.Command.Add(ms);
+            }
+            else if (total < ThroughputMinBytes)
+            {
+                estimates.OpRtt.Add(ms);
+            }
+            else
+            {
+                var transferMs = ms - estimates.OpRtt.Mean;
+                if (transferMs > 0)
+                {
+                    var rate = total * 1000.0 / transferMs;
+                    estimates.BytesPerSecond = estimates.BytesPerSecond > 0
+                        ? estimates.BytesPerSecond + (rate - estimates.BytesPerSecond) / 4
+                        : rate;
+                }
+            }
+        }
+    }
+
+    /// <summary>
+    /// <paramref name="id"/> ran out of time after dispatch. The estimates it was judged by
+    /// were too tight, so they back off: the next deadline doubles, as a TCP retransmit timer does.
+    /// </summary>
+    public void TimedOut(string id)
+    {
+        if (!_inFlight.TryRemove(id, out var flight))
+        {
+            return;
+        }
+
+        lock (_lock)
+        {
+            var estimates = For(flight.SessionKey);
+            estimates.Timeouts++;
+            var smoothed = flight.Kind == WorkKind.Command ? estimates.Command : estimates.OpRtt;
+            smoothed.Mean = Math.Min(smoothed.Mean * 2, ceiling.TotalMilliseconds);
+            if (flight.Kind == WorkKind.FileOp && flight.Bytes >= ThroughputMinBytes)
+            {
+                estimates.BytesPerSecond /= 2;
+            }
+        }
+    }
+
+    /// <summary>
+    /// What is left of the ceiling for <paramref name="id"/> since it was dispatched, or null if it
+    /// is not being timed.
+    /// </summary>
+    public TimeSpan? Remaining(string id) =>
+        _inFlight.TryGetValue(id, out var flight) ? ceiling - _time.GetElapsedTime(flight.Started) : null;
+
+    /// <summary>
+    /// Stops timing <paramref name="id"/> without a sample (cancelled, or never answered).
+    /// </summary>
+    public void Forget(string id) => _inFlight.TryRemove(id, out _);
+
+    /// <summary>
+    /// Drops all that was learned about <paramref name="sessionId"/>, which has ended, along with
+    /// its work still being timed, so a late result cannot bring it back.
+    /// </summary>
+    public void ForgetSession(string sessionId)
+    {
+        foreach (var (id, flight) in _inFlight)
+        {
+            if (flight.SessionKey == sessionId)
+            {
+                _inFlight.TryRemove(id, out _);
+            }
+        }
+
+        lock (_lock)
+        {
+            _sessions.Remove(sessionId);
+        }
+    }
+
+    public SessionLatency[] Snapshot()
+    {
+        lock (_lock)
+        {
+            return [.. _sessions.Select(s => new SessionLatency
+            {
+                SessionId = s.Key,
+                OpRttMs = s.Value.OpRtt.Samples > 0 ? Math.Round(s.Value.OpRtt.Mean, 1) : null,
+                OpRttVarMs = s.Value.OpRtt.Samples > 0 ? Math.Round(s.Value.OpRtt.Deviation, 1) : null,
+                BytesPerSecond = s.Value.BytesPerSecond > 0 ? Math.Round(s.Value.BytesPerSecond) : null,
+                CommandMs = s.Value.Command.Samples > 0 ? Math.Round(s.Value.Command.Mean, 1) : null,
+                CommandVarMs = s.Value.Command.Samples > 0 ? Math.Round(s.Value.Command.Deviation, 1) : null,
+                Samples = s.Value.OpRtt.Samples + s.Value.Command.Samples,
+                Timeouts = s.Value.Timeouts
+            })];
+        }
+    }
+
+    private Estimates For(string sessionKey)
+    {
+        if (!_sessions.TryGetValue(sessionKey, out var estimates))
+        {
+            estimates = new Estimates();
+            _sessions[sessionKey] = estimates;
+        }
+        return estimates;
+    }
+}
@@ -0,0 +1,124 @@
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Leases on work handed to a client. A dispatch that is lost on the way (dropped poll reply,
+/// truncated read, crashed client, failed result post) would otherwise leave Claude waiting
+/// out the whole deadline; when a lease runs out the owner queues the work again instead.
+/// Clients answer a repeat from their result cache, so redelivering work that was in fact
+/// done costs a round trip, not a second run. A client still working renews its lease.
+/// </summary>
+public sealed class LeaseTable(TimeProvider? timeProvider = null)
+{
+    /// <summary>
+    /// Deliveries an item gets in all; the last one has no lease and is left to its deadline.
+    /// </summary>
+    public const int MaxDeliveries = 3;
+
+    private sealed class Lease
+    {
+        public ITimer? Timer;
+        public int Deliveries;
+    }
+
+    private readonly TimeProvider _time = timeProvider ?? TimeProvider.System;
+    private readonly object _lock = new();
+    private readonly Dictionary<string, Lease> _leases = [];
+    private long _expired;
+
+    /// <summary>
+    /// Leases that ran out and sent their work back to the queue.
+    /// </summary>
+    public long Expired => Interlocked.Read(ref _expired);
+
+    public int Count
+    {
+        get
+        {
+            lock (_lock)
+            {
+                return _leases.Count(l => l.Value.Timer != null);
+            }
+        }
+    }
+
+    /// <summary>
+    /// Counts a delivery of <paramref name="id"/> and, unless it was the last one allowed,
+    /// leases it for <paramref name="length"/>; <paramref name="expired"/> runs if the lease
+    /// is neither renewed nor released in time. Returns whether a lease was granted.
+    /// </summary>
+    public bool Grant(string id, TimeSpan length, Action<string> expired)
+    {
+        lock (_lock)
+        {
+            if (!_leases.TryGetValue(id, out var lease))
+            {
+                lease = new Lease();
+                _leases[id] = lease;
+            }
+
+            lease.Timer?.Dispose();
+            lease.Timer = null;
+            if (++lease.Deliveries >= MaxDeliveries)
+            {
+                return false;
+            }
+
+            ITimer? timer = null;
+            timer = _time.CreateTimer(_ => Expire(id, timer!, expired), null, length, Timeout.InfiniteTimeSpan);
+            lease.Timer = timer;
+            return true;
+        }
+    }
+
+    /// <summary>
+    /// Pushes the lease on <paramref name="id"/> to <paramref name="length"/> from now.
+    /// Returns false if it holds no live lease.
+    /// </summary>
+    public bool Renew(string id, TimeSpan length)
+    {
+        lock (_lock)
+        {
+            return _leases.TryGetValue(id, out var lease) && lease.Timer != null && lease.Timer.Change(length, Timeout.InfiniteTimeSpan);
+        }
+    }
+
+    public int Deliveries(string id)
+    {
+        lock (_lock)
+        {
+            return _leases.TryGetValue(id, out var lease) ? lease.Deliveries : 0;
+        }
+    }
+
+    /// <summary>
+    /// Forgets <paramref name="id"/>, answered or abandoned.
+    /// </summary>
+    public void Release(string id)
+    {
+        lock (_lock)
+        {
+            if (_leases.Remove(id, out var lease))
+            {
+                lease.Timer?.Dispose();
+            }
+        }
+    }
+
+    private void Expire(string id, ITimer timer, Action<string> expired)
+    {
+        lock (_lock)
+        {
+            // Renewed into a new timer, or released, since this one fired
+            if (!_leases.TryGetValue(id, out var lease) || lease.Timer != timer)
+            {
+                return;
+            }
+
+            lease.Timer = null;
+            timer.Dispose();
+        }
+
+        Interlocked.Increment(ref _expired);
+        expired(id);
+    }
+}
@@ -0,0 +1,51 @@
+using System.Diagnostics;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+public static class LongPoll
+{
+    public static readonly TimeSpan MaxWait = TimeSpan.FromSeconds(30);
+
+    public static TimeSpan ClampWait(int? waitMs) => waitMs is > 0
+        ? TimeSpan.FromMilliseconds(Math.Min(waitMs.Value, MaxWait.TotalMilliseconds))
+        : TimeSpan.Zero;
+
+    /// <summary>
+    /// Runs <paramref name="poll"/> until it yields a value, re-checking only when the task from
+    /// <paramref name="changed"/> completes. Returns null once <paramref name="wait"/> elapses or the
+    /// request is aborted.
+    /// </summary>
+    public static async Task<T?> WaitAsync<T>(Func<T?> poll, Func<Task> changed, TimeSpan wait, CancellationToken cancellationToken) where T : class
+    {
+        var start = Stopwatch.GetTimestamp();
+
+        while (true)
+        {
+            var signal = changed();
+            var result = poll();
+            if (result != null)
+            {
+                return result;
+            }
+
+            var remaining = wait - Stopwatch.GetElapsedTime(start);
+            if (remaining <= TimeSpan.Zero)
+            {
+                return null;
+            }
+
+            try
+            {
+                await signal.WaitAsync(remaining, cancellationToken);
+            }
+            catch (TimeoutException)
+            {
+                return poll();
+            }
+            catch (OperationCanceledException)
+            {
+                return null;
+            }
+        }
+    }
+}
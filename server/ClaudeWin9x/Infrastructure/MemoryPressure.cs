@@ -0,0 +1,52 @@
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// How much of the machine's physical memory is in use, for deciding when to shed idle sessions.
+/// Each Claude CLI is a separate node process, so the server's own heap says little about it.
+/// </summary>
+public static class MemoryPressure
+{
+    /// <summary>
+    /// Fraction of physical memory in use, 0 to 1; 0 if it can't be told.
+    /// </summary>
+    public static double Load()
+    {
+        if (OperatingSystem.IsLinux() && ReadMeminfo() is { } meminfo)
+        {
+            return 1 - (double)meminfo.Available / meminfo.Total;
+        }
+
+        // Refreshed at each collection, which is often enough for a check every few seconds
+        var info = GC.GetGCMemoryInfo();
+        return info.TotalAvailableMemoryBytes > 0 ? (double)info.MemoryLoadBytes / info.TotalAvailableMemoryBytes : 0;
+    }
+
+    private static (long Total, long Available)? ReadMeminfo()
+    {
+        long total = 0, available = 0;
+        try
+        {
+            foreach (var line in File.ReadLines("/proc/meminfo"))
+            {
+                var parts = line.Split(' ', StringSplitOptions.RemoveEmptyEntries);
+                if (parts.Length >= 2 && long.TryParse(parts[1], out var kb))
+                {
+                    if (parts[0] == "MemTotal:")
+                    {
+                        total = kb;
+                    }
+                    else if (parts[0] == "MemAvailable:")
+                    {
+                        available = kb;
+                    }
+                }
+            }
+        }
+        catch (IOException)
+        {
+            return null;
+        }
+
+        return total > 0 ? (total, available) : null;
+    }
+}
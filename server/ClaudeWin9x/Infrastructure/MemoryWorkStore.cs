@@ -0,0 +1,32 @@
+using System.Collections.Concurrent;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Records held in this process only; nothing survives a restart.
+/// </summary>
+public sealed class MemoryWorkStore : IWorkStore
+{
+    private readonly ConcurrentDictionary<string, ConcurrentDictionary<string, string>> _kinds = new();
+
+    public void Put(string kind, string id, string json) =>
+        _kinds.GetOrAdd(kind, _ => new ConcurrentDictionary<string, string>())[id] = json;
+
+    public void Remove(string kind, string id)
+    {
+        if (_kinds.TryGetValue(kind, out var records))
+        {
+            records.TryRemove(id, out _);
+        }
+    }
+
+    public string? Get(string kind, string id) =>
+        _kinds.TryGetValue(kind, out var records) && records.TryGetValue(id, out var json) ? json : null;
+
+    public IReadOnlyDictionary<string, string> List(string kind) =>
+        _kinds.TryGetValue(kind, out var records) ? new Dictionary<string, string>(records) : [];
+
+    public void Dispose()
+    {
+    }
+}
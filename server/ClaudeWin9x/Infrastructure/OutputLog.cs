@@ -0,0 +1,345 @@
+using System.Runtime.InteropServices;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Text read from a session's output log. <see cref="Offset"/> is where it starts, past
+/// <c>since</c> if older output was dropped in between; <see cref="Next"/> is the cursor to read
+/// from next.
+/// </summary>
+public readonly record struct OutputPage(string Text, long Offset, long Next);
+
+/// <summary>
+/// A session's parsed output as an append-only log. Every character keeps the offset it was
+/// written at, counted from the start of the session, so a client reads a page from its cursor
+/// and, if the reply is lost or too big for it, asks for the same page again. Text lives in
+/// fixed-size segments; reading from an offset acknowledges everything before it, and segments
+/// wholly acknowledged are dropped. A client that falls more than <c>capacity</c> characters
+/// behind loses the oldest segments anyway, and its next page starts after the gap.
+/// <para>
+/// Given a <c>spillDirectory</c>, unacknowledged segments pushed out of memory go to a file
+/// there instead, and a client catching up reads them back from it a page at a time. The file is
+/// a ring of <c>spillBytes</c>, so a client further behind than that still loses the oldest
+/// output. It is created on the first spill, emptied once its text is acknowledged, and deleted
+/// when the log is disposed, or by the OS if the process dies.
+/// </para>
+/// </summary>
+public sealed class OutputLog(
+    int capacity = 1024 * 1024,
+    int segmentSize = 16 * 1024,
+    string? spillDirectory = null,
+    long spillBytes = 0) : IDisposable
+{
+    private readonly object _lock = new();
+    private readonly List<char[]> _segments = [];
+    private long _start;
+    private long _end;
+    private long _acknowledged;
+
+    // Characters the spill file holds, whole segments only; the file covers [_spillStart, _start)
+    private long _spillCapacity = spillDirectory == null ? 0 : spillBytes / sizeof(char) / segmentSize * segmentSize;
+    private FileStream? _spill;
+    private long _spillStart;
+
+    public long End
+    {
+        get
+        {
+            lock (_lock)
+            {
+                return _end;
+            }
+        }
+    }
+
+    /// <summary>
+    /// Characters held in memory, acknowledged or not.
+    /// </summary>
+    public long Buffered
+    {
+        get
+        {
+            lock (_lock)
+            {
+                return _end - _start;
+            }
+        }
+    }
+
+    /// <summary>
+    /// Characters still readable from the spill file.
+    /// </summary>
+    public long Spilled
+    {
+        get
+        {
+            lock (_lock)
+            {
+                return _start - _spillStart;
+            }
+        }
+    }
+
+    /// <summary>
+    /// The spill file, once there is one; for tests.
+    /// </summary>
+    public string? SpillPath
+    {
+        get
+        {
+            lock (_lock)
+            {
+                return _spill?.Name;
+            }
+        }
+    }
+
+    public void Append(ReadOnlySpan<char> text)
+    {
+        lock (_lock)
+        {
+            while (text.Length > 0)
+            {
+                var used = (int)((_end - _start) % segmentSize);
+                if (used == 0 && (_segments.Count == 0 || _end > _start))
+                {
+                    _segments.Add(new char[segmentSize]);
+                }
+
+                var take = Math.Min(text.Length, segmentSize - used);
+                text[..take].CopyTo(_segments[^1].AsSpan(used));
+                text = text[take..];
+                _end += take;
+            }
+
+            while (_end - _start > capacity && _segments.Count > 1)
+            {
+                SpillFirst();
+                DropFirst();
+            }
+        }
+    }
+
+    /// <summary>
+    /// True if there is output past <paramref name="since"/>, or past what was last read when null.
+    /// </summary>
+    public bool HasAfter(long? since)
+    {
+        lock (_lock)
+        {
+            return (since ?? _acknowledged) < _end;
+        }
+    }
+
+    /// <summary>
+    /// Output from <paramref name="since"/>, as much as fits in <paramref name="maxBytes"/> once
+    /// JSON-encoded (at least one character, so a reader always moves on). Reading acknowledges
+    /// everything before <paramref name="since"/>. Without <paramref name="since"/> the read carries
+    /// on from the last one and acknowledges what it returns, as a destructive read would.
+    /// </summary>
+    public OutputPage Read(long? since, int maxBytes = int.MaxValue)
+    {
+        lock (_lock)
+        {
+            var from = Math.Clamp(since ?? _acknowledged, _spillStart, _end);
+            Acknowledge(Math.Min(since ?? _acknowledged, _end));
+
+            string text;
+            if (from < _start)
+            {
+                text = ReadSpilled(from, maxBytes);
+            }
+            else
+            {
+                var length = Fit(from, maxBytes);
+                text = length == 0 ? "" : string.Create(length, from, Copy);
+            }
+
+            if (since == null)
+            {
+                Acknowledge(from + text.Length);
+            }
+            return new OutputPage(text, from, from + text.Length);
+        }
+    }
+
+    private void Acknowledge(long offset)
+    {
+        _acknowledged = Math.Max(_acknowledged, offset);
+
+        // The last segment is kept while it has room, so appending never allocates for a few bytes
+        while (_segments.Count > 1 && _start + segmentSize <= _acknowledged)
+        {
+            DropFirst();
+        }
+
+        if (_spillStart < _start && _acknowledged >= _start)
+        {
+            _spillStart = _start;
+            try
+            {
+                _spill?.SetLength(0);
+            }
+            catch (IOException)
+            {
+                CloseSpill();
+            }
+        }
+    }
+
+    // Writes the first segment to the spill file, unless it was read already or nothing spills
+    private void SpillFirst()
+    {
+        if (_spillCapacity == 0)
+        {
+            return;
+        }
+        if (_start + segmentSize <= _acknowledged)
+        {
+            _spillStart = _start + segmentSize;
+            return;
+        }
+
+        try
+        {
+            _spill ??= new FileStream(
+                Path.Combine(spillDirectory!, $"output_{Guid.NewGuid():N}.spill"),
+                FileMode.CreateNew, FileAccess.ReadWrite, FileShare.None, bufferSize: 0,
+                FileOptions.DeleteOnClose);
+            _spill.Position = _start % _spillCapacity * sizeof(char);
+            _spill.Write(MemoryMarshal.AsBytes(_segments[0].AsSpan()));
+            _spillStart = Math.Max(_spillStart, _start + segmentSize - _spillCapacity);
+        }
+        catch (Exception ex) when (ex is IOException or UnauthorizedAccessException)
+        {
+            // Without a file to spill to, output is dropped as it would be with none configured
+            CloseSpill();
+        }
+    }
+
+    private void DropFirst()
+    {
+        _segments.RemoveAt(0);
+        _start += segmentSize;
+        if (_spillCapacity == 0)
+        {
+            _spillStart = _start;
+        }
+    }
+
+    private void CloseSpill()
+    {
+        _spill?.Dispose();
+        _spill = null;
+        _spillCapacity = 0;
+        _spillStart = _start;
+    }
+
+    // A page from the spill file: at most one memory's worth, and never more characters than the
+    // budget has bytes, as each costs at least one (plus one, to finish a surrogate pair)
+    private string ReadSpilled(long from, int maxBytes)
+    {
+        var count = (int)Math.Min(Math.Min(_start - from, capacity), maxBytes + 2L);
+        var chars = new char[count + 1];
+        try
+        {
+            var at = from % _spillCapacity;
+            var first = (int)Math.Min(count, _spillCapacity - at);
+            _spill!.Position = at * sizeof(char);
+            _spill.ReadExactly(MemoryMarshal.AsBytes(chars.AsSpan(0, first)));
+            if (first < count)
+            {
+                _spill.Position = 0;
+                _spill.ReadExactly(MemoryMarshal.AsBytes(chars.AsSpan(first, count - first)));
+            }
+        }
+        catch (IOException)
+        {
+            CloseSpill();
+            return "";
+        }
+
+        // A surrogate pair can straddle the file and memory
+        if (from + count == _start && _start < _end && char.IsHighSurrogate(chars[count - 1]))
+        {
+            chars[count++] = CharAt(_start);
+        }
+
+        var length = 0;
+        var bytes = 0L;
+        while (length < count && (length == 0 || bytes + JsonCost(chars[length]) <= maxBytes))
+        {
+            bytes += JsonCost(chars[length]);
+            length++;
+        }
+        if (from + length < _end && char.IsHighSurrogate(chars[length - 1]))
+        {
+            length += length > 1 ? -1 : 1;
+        }
+        return new string(chars, 0, length);
+    }
+
+    // Characters from `from` whose JSON encoding fits the budget, never ending inside a surrogate pair
+    private int Fit(long from, int maxBytes)
+    {
+        if (maxBytes == int.MaxValue)
+        {
+            return (int)(_end - from);
+        }
+
+        var length = 0;
+        var bytes = 0L;
+        for (var offset = from; offset < _end; offset++)
+        {
+            var c = CharAt(offset);
+            bytes += JsonCost(c);
+            if (bytes > maxBytes && length > 0)
+            {
+                break;
+            }
+            length++;
+        }
+
+        if (length > 0 && from + length < _end && char.IsHighSurrogate(CharAt(from + length - 1)))
+        {
+            length += length > 1 ? -1 : 1;
+        }
+        return length;
+    }
+
+    private char CharAt(long offset)
+    {
+        var index = offset - _start;
+        return _segments[(int)(index / segmentSize)][index % segmentSize];
+    }
+
+    private void Copy(Span<char> destination, long from)
+    {
+        var index = from - _start;
+        while (destination.Length > 0)
+        {
+            var segment = _segments[(int)(index / segmentSize)];
+            var at = (int)(index % segmentSize);
+            var take = Math.Min(destination.Length, segmentSize - at);
+            segment.AsSpan(at, take).CopyTo(destination);
+            destination = destination[take..];
+            index += take;
+        }
+    }
+
+    // Bytes the serializer's default escaping turns the character into
+    private static int JsonCost(char c) => c switch
+    {
+        '\\' or '\n' or '\r' or '\t' or '\b' or '\f' => 2,
+        < ' ' or > '~' or '"' or '<' or '>' or '&' or '\'' or '+' or '`' => 6,
+        _ => 1
+    };
+
+    public void Dispose()
+    {
+        lock (_lock)
+        {
+            CloseSpill();
+        }
+    }
+}
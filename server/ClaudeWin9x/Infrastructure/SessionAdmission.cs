@@ -0,0 +1,132 @@
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Caps how many Claude CLI processes run at once. A <c>/start</c> beyond the cap joins a line and
+/// gets a ticket; the client retries with the ticket and is admitted once everyone ahead of it is.
+/// A ticket not retried within <c>ticketTtl</c> is dropped, so clients that gave up don't hold the
+/// line, and one that comes back late rejoins at the back.
+/// </summary>
+public sealed class SessionAdmission(int maxRunning, TimeSpan ticketTtl, TimeProvider? timeProvider = null)
+{
+    public readonly record struct Decision(bool Admitted, string? Ticket, int Position);
+
+    private sealed class Waiter(string ticket, long seen)
+    {
+        public readonly string Ticket = ticket;
+        public long Seen = seen;
+    }
+
+    private readonly TimeProvider _time = timeProvider ?? TimeProvider.System;
+    private readonly object _lock = new();
+    private readonly LinkedList<Waiter> _line = new();
+    private readonly Dictionary<string, LinkedListNode<Waiter>> _tickets = [];
+    private int _running;
+
+    public int MaxRunning => maxRunning;
+
+    public int Running
+    {
+        get
+        {
+            lock (_lock)
+            {
+                return _running;
+            }
+        }
+    }
+
+    public int Waiting
+    {
+        get
+        {
+            lock (_lock)
+            {
+                DropExpired(_time.GetTimestamp());
+                return _line.Count;
+            }
+        }
+    }
+
+    /// <summary>
+    /// Takes a slot if the caller is at the front of the line (or there is none) and one is free;
+    /// otherwise returns its ticket and 1-based place in line. An admitted caller must
+    /// <see cref="Release"/> the slot when its session ends.
+    /// </summary>
+    public Decision TryAdmit(string? ticket = null)
+    {
+        lock (_lock)
+        {
+            var now = _time.GetTimestamp();
+            DropExpired(now);
+
+            if (ticket == null || !_tickets.TryGetValue(ticket, out var node))
+            {
+                if (_line.Count == 0 && _running < maxRunning)
+                {
+                    _running++;
+                    return new Decision(true, null, 0);
+                }
+
+                node = _line.AddLast(new Waiter(IdGenerator.NewId(), now));
+                _tickets[node.Value.Ticket] = node;
+            }
+
+            node.Value.Seen = now;
+
+            var position = 0;
+            for (var ahead = node.Previous; ahead != null; ahead = ahead.Previous)
+            {
+                position++;
+            }
+
+            // Slots freed while the front was away are kept for it, not taken by those behind
+            if (position < maxRunning - _running)
+            {
+                _line.Remove(node);
+                _tickets.Remove(node.Value.Ticket);
+                _running++;
+                return new Decision(true, node.Value.Ticket, 0);
+            }
+
+            return new Decision(false, node.Value.Ticket, position + 1);
+        }
+    }
+
+    public void Release()
+    {
+        lock (_lock)
+        {
+            if (_running > 0)
+            {
+                _running--;
+            }
+        }
+    }
+
+    /// <summary>
+    /// Takes a slot back for a hibernated session that is resuming, without waiting in line and
+    /// even if none is free. <see cref="Running"/> then shows the overshoot until an idle session
+    /// is hibernated or ends.
+    /// </summary>
+    public void Reclaim()
+    {
+        lock (_lock)
+        {
+            _running++;
+        }
+    }
+
+    private void DropExpired(long now)
+    {
+        for (var node = _line.First; node != null;)
+        {
+            var next = node.Next;
+            if (_time.GetElapsedTime(node.Value.Seen, now) > ticketTtl)
+            {
+                _line.Remove(node);
+                _tickets.Remove(node.Value.Ticket);
+            }
+            node = next;
+        }
+    }
+}
@@ -0,0 +1,102 @@
+using System.Text.Json;
+using System.Text.Json.Serialization.Metadata;
+using ClaudeWin9xServer.Models.Responses;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Which server instance runs which session, for instances sharing an <see cref="IWorkStore"/>.
+/// A session's Claude process, its queues and its client connection all live in one instance, so
+/// a new session is placed on the live instance running the fewest and its client is sent there.
+/// Instances announce themselves periodically; one not heard from for <c>staleAfter</c> is left
+/// out of placement and its sessions stop counting.
+/// </summary>
+public sealed class SessionDirectory(IWorkStore store, InstanceInfo self, TimeSpan staleAfter, TimeProvider? timeProvider = null)
+{
+    private const string InstanceKind = "instance";
+    private const string SessionKind = "session";
+
+    private readonly TimeProvider _time = timeProvider ?? TimeProvider.System;
+
+    public InstanceInfo Self => self;
+
+    public TimeSpan StaleAfter => staleAfter;
+
+    public void Announce() =>
+        store.Put(InstanceKind, self.Name, JsonSerializer.Serialize(self with { Seen = _time.GetUtcNow().ToString("o") }, AppJsonSerializerContext.Default.InstanceInfo));
+
+    public void Claim(string sessionId) =>
+        store.Put(SessionKind, sessionId, JsonSerializer.Serialize(new SessionRecord { Owner = self.Name, Started = _time.GetUtcNow().ToString("o") }, AppJsonSerializerContext.Default.SessionRecord));
+
+    public void Release(string sessionId) => store.Remove(SessionKind, sessionId);
+
+    public string? OwnerOf(string sessionId) =>
+        store.Get(SessionKind, sessionId) is { } json ? Deserialize(json, AppJsonSerializerContext.Default.SessionRecord)?.Owner : null;
+
+    /// <summary>
+    /// Drops the sessions this instance claimed before it last stopped; their Claude processes
+    /// went with it. Returns how many there were.
+    /// </summary>
+    public int Recover()
+    {
+        var stale = Claims().Where(c => c.Owner == self.Name).ToList();
+        foreach (var (sessionId, _) in stale)
+        {
+            store.Remove(SessionKind, sessionId);
+        }
+        return stale.Count;
+    }
+
+    /// <summary>
+    /// Takes this instance out of placement; its sessions are released as they stop.
+    /// </summary>
+    public void Retire() => store.Remove(InstanceKind, self.Name);
+
+    /// <summary>
+    /// Live instances, this one always among them, with the sessions each runs.
+    /// </summary>
+    public InstanceInfo[] Live()
+    {
+        var now = _time.GetUtcNow();
+        var live = new Dictionary<string, InstanceInfo> { [self.Name] = self };
+
+        foreach (var json in store.List(InstanceKind).Values)
+        {
+            if (Deserialize(json, AppJsonSerializerContext.Default.InstanceInfo) is { } instance &&
+                instance.Name != self.Name &&
+                DateTimeOffset.TryParse(instance.Seen, out var seen) && now - seen < staleAfter)
+            {
+                live[instance.Name] = instance;
+            }
+        }
+
+        var counts = Claims().GroupBy(c => c.Owner).ToDictionary(g => g.Key, g => g.Count());
+        return [.. live.Values
+            .Select(i => i with { Sessions = counts.GetValueOrDefault(i.Name) })
+            .OrderBy(i => i.Name, StringComparer.Ordinal)];
+    }
+
+    /// <summary>
+    /// Where a new session should run: the live instance with the fewest sessions, this one on a tie.
+    /// </summary>
+    public InstanceInfo Place() =>
+        Live().OrderBy(i => i.Sessions).ThenBy(i => i.Name == self.Name ? 0 : 1).First();
+
+    private IEnumerable<(string SessionId, string Owner)> Claims() =>
+        store.List(SessionKind)
+            .Select(r => (r.Key, Deserialize(r.Value, AppJsonSerializerContext.Default.SessionRecord)?.Owner))
+            .Where(c => c.Owner != null)
+            .Select(c => (c.Key, c.Owner!));
+
+    private static T? Deserialize<T>(string json, JsonTypeInfo<T> typeInfo) where T : class
+    {
+        try
+        {
+            return JsonSerializer.Deserialize(json, typeInfo);
+        }
+        catch (JsonException)
+        {
+            return null;
+        }
+    }
+}
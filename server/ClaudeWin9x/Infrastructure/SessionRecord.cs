@@ -0,0 +1,15 @@
+using System.Text.Json.Serialization;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// A session's entry in the <see cref="SessionDirectory"/>: which instance runs it.
+/// </summary>
+public record SessionRecord
+{
+    [JsonPropertyName("owner")]
+    public required string Owner { get; init; }
+
+    [JsonPropertyName("started")]
+    public required string Started { get; init; }
+}
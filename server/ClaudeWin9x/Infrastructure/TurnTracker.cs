@@ -0,0 +1,102 @@
+namespace ClaudeWin9xServer.Infrastructure;
+
+public enum TurnState
+{
+    Idle,
+    Thinking,
+    ToolRunning,
+    AwaitingApproval,
+    Done
+}
+
+public static class TurnStateExtensions
+{
+    public static string ToWireName(this TurnState state) => state switch
+    {
+        TurnState.Thinking => "thinking",
+        TurnState.ToolRunning => "tool_running",
+        TurnState.AwaitingApproval => "awaiting_approval",
+        TurnState.Done => "done",
+        _ => "idle"
+    };
+}
+
+/// <summary>
+/// Turn state as seen by a poll. <see cref="Seq"/> counts inputs sent to the session, so a client
+/// can tell "done" for the turn it is waiting on from "done" left over from the previous one.
+/// </summary>
+public readonly record struct TurnInfo(TurnState State, int Seq)
+{
+    /// <summary>
+    /// Claude's own events can't show a tool blocked on the user; the approval queue can.
+    /// </summary>
+    public TurnInfo WithPendingApproval(bool pending) =>
+        pending && State == TurnState.ToolRunning ? this with { State = TurnState.AwaitingApproval } : this;
+}
+
+/// <summary>
+/// Follows a session from input to Claude's <c>result</c> event. Inputs sent while a turn is still
+/// running queue behind it in the CLI, so the session is only done once every one has a result.
+/// </summary>
+public sealed class TurnTracker
+{
+    private readonly object _lock = new();
+    private TurnState _state = TurnState.Idle;
+    private int _seq;
+    private int _pending;
+
+    public TurnInfo Current
+    {
+        get
+        {
+            lock (_lock)
+            {
+                return new TurnInfo(_state, _seq);
+            }
+        }
+    }
+
+    public void BeginTurn()
+    {
+        lock (_lock)
+        {
+            _seq++;
+            _pending++;
+            _state = TurnState.Thinking;
+        }
+    }
+
+    public void Observe(TurnState state)
+    {
+        lock (_lock)
+        {
+            // Output outside a turn (the init banner, stray stderr) says nothing about one
+            if (_pending == 0)
+            {
+                return;
+            }
+
+            if (state == TurnState.Done)
+            {
+                _pending--;
+                _state = _pending > 0 ? TurnState.Thinking : TurnState.Done;
+            }
+            else
+            {
+                _state = state;
+            }
+        }
+    }
+
+    public void End()
+    {
+        lock (_lock)
+        {
+            _pending = 0;
+            if (_state != TurnState.Idle)
+            {
+                _state = TurnState.Done;
+            }
+        }
+    }
+}
@@ -0,0 +1,146 @@
+using Microsoft.Extensions.Logging;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Claude CLI processes started before anyone asks for one. Loading the CLI takes seconds, and a
+/// <c>/start</c> that finds a process here skips that wait. The pool holds up to <c>size</c>,
+/// but never more than the room <see cref="Fill"/> is given, so warm processes and running
+/// sessions together stay within <c>max_sessions</c>. A process that exits while it waits is
+/// dropped and replaced on the next fill.
+/// </summary>
+public sealed class WarmPool(int size, Func<ClaudeSession> create, ILogger logger) : IDisposable
+{
+    private readonly object _lock = new();
+    private readonly Queue<ClaudeSession> _ready = new();
+    private int _target;
+    private int _starting;
+    private bool _disposed;
+
+    public int Size => size;
+
+    public int Ready
+    {
+        get
+        {
+            lock (_lock)
+            {
+                return _ready.Count;
+            }
+        }
+    }
+
+    /// <summary>
+    /// A started session nobody has used yet, or null if none is ready. The caller owns it and
+    /// must <see cref="ClaudeSession.Bind"/> it to its client.
+    /// </summary>
+    public ClaudeSession? TryTake()
+    {
+        lock (_lock)
+        {
+            while (_ready.TryDequeue(out var session))
+            {
+                if (session.IsRunning)
+                {
+                    return session;
+                }
+                session.Dispose();
+            }
+            return null;
+        }
+    }
+
+    /// <summary>
+    /// Starts processes in the background until the pool holds <c>size</c>, or <paramref name="room"/>
+    /// if that is less, and stops the oldest ones beyond <paramref name="room"/>.
+    /// </summary>
+    public void Fill(int room)
+    {
+        int missing;
+        lock (_lock)
+        {
+            if (_disposed)
+            {
+                return;
+            }
+
+            _target = Math.Clamp(room, 0, size);
+            var running = new List<ClaudeSession>();
+            while (_ready.TryDequeue(out var session))
+            {
+                if (session.IsRunning)
+                {
+                    running.Add(session);
+                }
+                else
+                {
+                    session.Dispose();
+                }
+            }
+
+            // Oldest first, so those stopped for lack of room are the ones that waited longest
+            var surplus = Math.Max(0, running.Count - _target);
+            foreach (var session in running[..surplus])
+            {
+                session.Dispose();
+            }
+            foreach (var session in running[surplus..])
+            {
+                _ready.Enqueue(session);
+            }
+
+            missing = _target - _ready.Count - _starting;
+            if (missing <= 0)
+            {
+                return;
+            }
+            _starting += missing;
+        }
+
+        for (var i = 0; i < missing; i++)
+        {
+            _ = Task.Run(StartOne);
+        }
+    }
+
+    private void StartOne()
+    {
+        ClaudeSession? session = null;
+        try
+        {
+            session = create();
+            session.Start();
+        }
+        catch (Exception ex)
+        {
+            logger.LogWarning(ex, "Could not start a warm Claude process");
+            session?.Dispose();
+            session = null;
+        }
+
+        lock (_lock)
+        {
+            _starting--;
+
+            // The room may have shrunk while it was starting
+            if (session != null && !_disposed && _ready.Count < _target)
+            {
+                _ready.Enqueue(session);
+                return;
+            }
+        }
+        session?.Dispose();
+    }
+
+    public void Dispose()
+    {
+        lock (_lock)
+        {
+            _disposed = true;
+            while (_ready.TryDequeue(out var session))
+            {
+                session.Dispose();
+            }
+        }
+    }
+}
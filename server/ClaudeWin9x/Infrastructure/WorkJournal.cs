@@ -0,0 +1,54 @@
+using System.Text.Json;
+using System.Text.Json.Serialization.Metadata;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Write-ahead log of one process's <see cref="WorkQueue{T}"/> in an <see cref="IWorkStore"/>, so
+/// what it had in flight is still known after it stops. It is not a queue other processes share:
+/// each process logs under its own kind, and nothing is reloaded into a queue. Every item has a
+/// waiter (a Claude tool call or an HTTP request) in the process that queued it, and that waiter
+/// does not survive a restart; running the work again would repeat a write or a command for nobody.
+/// At startup the log is drained and only used to report how the work ended.
+/// </summary>
+public sealed class WorkJournal<T>(IWorkStore store, string kind, JsonTypeInfo<T> typeInfo)
+{
+    public void Put(string id, T item) => store.Put(kind, id, JsonSerializer.Serialize(item, typeInfo));
+
+    public void Remove(string id) => store.Remove(kind, id);
+
+    /// <summary>
+    /// Everything journaled and not yet removed; unreadable records are skipped.
+    /// </summary>
+    public IReadOnlyDictionary<string, T> Load()
+    {
+        var items = new Dictionary<string, T>();
+        foreach (var (id, json) in store.List(kind))
+        {
+            try
+            {
+                if (JsonSerializer.Deserialize(json, typeInfo) is { } item)
+                {
+                    items[id] = item;
+                }
+            }
+            catch (JsonException)
+            {
+            }
+        }
+        return items;
+    }
+
+    /// <summary>
+    /// Loads and removes everything journaled, for work left behind by an earlier run.
+    /// </summary>
+    public IReadOnlyDictionary<string, T> Drain()
+    {
+        var items = Load();
+        foreach (var id in items.Keys)
+        {
+            Remove(id);
+        }
+        return items;
+    }
+}
@@ -0,0 +1,21 @@
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Classes a client is served work in, most urgent first. Claude blocks on approvals and on
+/// small reads; writes and commands can wait behind them, but only for as long as
+/// <see cref="WorkQueue{T}"/> ageing allows.
+/// </summary>
+public static class WorkPriority
+{
+    public const int Approval = 0;
+    public const int Small = 1;
+    public const int Write = 2;
+    public const int Long = 3;
+
+    public const int Classes = 4;
+
+    /// <summary>
+    /// How long an item waits before it counts as one class more urgent.
+    /// </summary>
+    public static readonly TimeSpan AgingStep = TimeSpan.FromSeconds(2);
+}
@@ -0,0 +1,338 @@
+using System.Diagnostics.CodeAnalysis;
+
+namespace ClaudeWin9xServer.Infrastructure;
+
+/// <summary>
+/// Work waiting for a client (commands, file operations, approvals), indexed by id for status
+/// lookups and queued per channel (a session, or none) in the order it became ready. An item is
+/// queued whenever it turns ready and skipped lazily once it is removed or no longer ready, so
+/// adding, updating and taking the oldest item are all O(1) amortised. A channel is dropped as
+/// soon as nothing in it is ready, so ended sessions leave nothing behind.
+/// Within a channel the most urgent <see cref="WorkPriority"/> class goes first, but an item
+/// counts as one class more urgent for every <c>agingStep</c> it has waited, so a busy class
+/// above it only delays it, never starves it.
+/// With a <see cref="WorkJournal{T}"/> every change is written to its store first, outside the lock
+/// lookups take, and only applied here once written; a change the store refuses is not made.
+/// </summary>
+public sealed class WorkQueue<T>(
+    Func<T, bool> isReady,
+    Func<T, string?> channelOf,
+    Func<T, int>? priorityOf = null,
+    TimeSpan? agingStep = null,
+    TimeProvider? timeProvider = null,
+    WorkJournal<T>? journal = null) where T : class
+{
+    private sealed class Slot(T item)
+    {
+        public T Item = item;
+
+        // Sequence number of the queue entry that is still live, or -1 when not queued
+        public long QueuedSeq = -1;
+        public string Channel = "";
+    }
+
+    private readonly record struct Entry(long Seq, string Id, int Priority, long ReadyAt);
+
+    private sealed class Lane
+    {
+        // One queue per priority class, each in arrival order
+        public readonly Queue<Entry>[] Classes = new Queue<Entry>[WorkPriority.Classes];
+        public int Live;
+    }
+
+    private readonly TimeProvider _time = timeProvider ?? TimeProvider.System;
+    private readonly long _agingTicks = (agingStep ?? WorkPriority.AgingStep).Ticks;
+    private readonly object _lock = new();
+
+    // Held by every change while it is journaled and then applied, so the journal sees changes in
+    // the order memory does; lookups and polls take only _lock and never wait on the journal's disk
+    private readonly object _writeLock = new();
+    private readonly Dictionary<string, Slot> _items = [];
+    private readonly Dictionary<string, Lane> _ready = [];
+    private long _nextSeq;
+
+    public int ChannelCount
+    {
+        get
+        {
+            lock (_lock)
+            {
+                return _ready.Count;
+            }
+        }
+    }
+
+    public int Count
+    {
+        get
+        {
+            lock (_lock)
+            {
+                return _items.Count;
+            }
+        }
+    }
+
+    public bool IsEmpty => Count == 0;
+
+    public IReadOnlyList<string> Keys
+    {
+        get
+        {
+            lock (_lock)
+            {
+                return [.. _items.Keys];
+            }
+        }
+    }
+
+    public T this[string id] => TryGetValue(id, out var item) ? item : throw new KeyNotFoundException(id);
+
+    public bool ContainsKey(string id)
+    {
+        lock (_lock)
+        {
+            return _items.ContainsKey(id);
+        }
+    }
+
+    public bool TryGetValue(string id, [MaybeNullWhen(false)] out T item)
+    {
+        lock (_lock)
+        {
+            if (_items.TryGetValue(id, out var slot))
+            {
+                item = slot.Item;
+                return true;
+            }
+
+            item = null;
+            return false;
+        }
+    }
+
+    public bool TryAdd(string id, T item)
+    {
+        lock (_writeLock)
+        {
+            if (ContainsKey(id))
+            {
+                return false;
+            }
+
+            journal?.Put(id, item);
+            lock (_lock)
+            {
+                var slot = new Slot(item);
+                _items.Add(id, slot);
+                if (isReady(item))
+                {
+                    Enqueue(id, slot);
+                }
+            }
+            return true;
+        }
+    }
+
+    /// <summary>
+    /// Replaces the item if it still equals <paramref name="comparison"/>. An item that becomes
+    /// ready goes to the back of its channel.
+    /// </summary>
+    public bool TryUpdate(string id, T newItem, T comparison)
+    {
+        lock (_writeLock)
+        {
+            if (!TryGetValue(id, out var current) || !EqualityComparer<T>.Default.Equals(current, comparison))
+            {
+                return false;
+            }
+
+            Replace(id, newItem);
+            return true;
+        }
+    }
+
+    public bool TryRemove(string id, [MaybeNullWhen(false)] out T item)
+    {
+        lock (_writeLock)
+        {
+            if (!ContainsKey(id))
+            {
+                item = null;
+                return false;
+            }
+
+            journal?.Remove(id);
+            lock (_lock)
+            {
+                var slot = _items[id];
+                _items.Remove(id);
+                Unqueue(slot);
+                item = slot.Item;
+                return true;
+            }
+        }
+    }
+
+    /// <summary>
+    /// The oldest ready item in <paramref name="channel"/>, or in any channel if null, left in place.
+    /// </summary>
+    public T? Peek(string? channel = null)
+    {
+        lock (_lock)
+        {
+            return Head(channel) is { } head ? _items[head.Id].Item : null;
+        }
+    }
+
+    /// <summary>
+    /// The class the item <see cref="Peek"/> would return is due in after ageing, or null if none is ready.
+    /// </summary>
+    public int? PeekPriority(string? channel = null)
+    {
+        lock (_lock)
+        {
+            return Head(channel) is { } head ? Rank(head, _time.GetTimestamp()) : null;
+        }
+    }
+
+    /// <summary>
+    /// Takes the oldest ready item in <paramref name="channel"/> (any channel if null) and stores
+    /// <paramref name="dispatch"/> of it in its place, returning the stored value.
+    /// </summary>
+    public T? Dispatch(string? channel, Func<T, T> dispatch) => Dispatch(channel, (item, _) => dispatch(item));
+
+    /// <summary>
+    /// Like <see cref="Dispatch(string?, Func{T, T})"/>, but <paramref name="dispatch"/> is also given
+    /// the class the item was taken in after ageing, so a client serving items from several queues
+    /// can rank them the same way.
+    /// </summary>
+    public T? Dispatch(string? channel, Func<T, int, T> dispatch)
+    {
+        lock (_writeLock)
+        {
+            string id;
+            T dispatched;
+            lock (_lock)
+            {
+                if (Head(channel) is not { } head)
+                {
+                    return null;
+                }
+
+                id = head.Id;
+                dispatched = dispatch(_items[id].Item, Rank(head, _time.GetTimestamp()));
+            }
+
+            Replace(id, dispatched);
+            return dispatched;
+        }
+    }
+
+    // Under _writeLock, with the item known to be there
+    private void Replace(string id, T newItem)
+    {
+        journal?.Put(id, newItem);
+
+        lock (_lock)
+        {
+            var slot = _items[id];
+            slot.Item = newItem;
+            if (!isReady(newItem))
+            {
+                Unqueue(slot);
+            }
+            else if (slot.QueuedSeq < 0)
+            {
+                Enqueue(id, slot);
+            }
+        }
+    }
+
+    private void Enqueue(string id, Slot slot)
+    {
+        slot.Channel = channelOf(slot.Item) ?? "";
+        if (!_ready.TryGetValue(slot.Channel, out var lane))
+        {
+            lane = new Lane();
+            _ready[slot.Channel] = lane;
+        }
+
+        var priority = Math.Clamp(priorityOf?.Invoke(slot.Item) ?? 0, 0, WorkPriority.Classes - 1);
+        slot.QueuedSeq = _nextSeq++;
+        (lane.Classes[priority] ??= new Queue<Entry>()).Enqueue(new Entry(slot.QueuedSeq, id, priority, _time.GetTimestamp()));
+        lane.Live++;
+    }
+
+    // Its queue entry goes stale and is skipped when it reaches the front
+    private void Unqueue(Slot slot)
+    {
+        if (slot.QueuedSeq < 0)
+        {
+            return;
+        }
+
+        slot.QueuedSeq = -1;
+        if (--_ready[slot.Channel].Live == 0)
+        {
+            _ready.Remove(slot.Channel);
+        }
+    }
+
+    // Entry to serve next in the channel (or in all channels): the most urgent once aged, then the oldest
+    private Entry? Head(string? channel)
+    {
+        var now = _time.GetTimestamp();
+        if (channel != null)
+        {
+            return _ready.TryGetValue(channel, out var lane) ? Best(lane, now, null) : null;
+        }
+
+        Entry? best = null;
+        foreach (var lane in _ready.Values)
+        {
+            best = Best(lane, now, best);
+        }
+        return best;
+    }
+
+    private Entry? Best(Lane lane, long now, Entry? best)
+    {
+        var bestRank = best is { } b ? Rank(b, now) : int.MaxValue;
+        for (var priority = 0; priority < WorkPriority.Classes; priority++)
+        {
+            if (lane.Classes[priority] is not { } entries || Trim(entries) is not { } head)
+            {
+                continue;
+            }
+
+            var rank = Rank(head, now);
+            if (best == null || rank < bestRank || (rank == bestRank && head.Seq < best.Value.Seq))
+            {
+                best = head;
+                bestRank = rank;
+            }
+        }
+        return best;
+    }
+
+    private int Rank(Entry entry, long now)
+    {
+        var waited = _time.GetElapsedTime(entry.ReadyAt, now).Ticks;
+        return (int)Math.Max(0, entry.Priority - waited / _agingTicks);
+    }
+
+    // Front live entry of one class, dropping stale ones on the way
+    private Entry? Trim(Queue<Entry> entries)
+    {
+        while (entries.TryPeek(out var entry))
+        {
+            if (_items.TryGetValue(entry.Id, out var slot) && slot.QueuedSeq == entry.Seq)
+            {
+                return entry;
+            }
+            entries.Dequeue();
+        }
+        return null;
+    }
+}
@@ -9,4 +9,7 @@ public record ApprovalResponse
 
     [JsonPropertyName("approved")]
     public bool Approved { get; init; }
+
+    [JsonPropertyName("dispatch")]
+    public bool Dispatch { get; init; }
 }
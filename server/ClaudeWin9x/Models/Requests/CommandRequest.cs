@@ -18,4 +18,16 @@ public record CommandRequest
 
     [JsonPropertyName("status")]
     public string? Status { get; init; }
+
+    /// <summary>
+    /// Lease the command was dispatched with; set by the server, never read from a request.
+    /// </summary>
+    [JsonIgnore]
+    public int LeaseMs { get; init; }
+
+    /// <summary>
+    /// Class the command was dispatched in after ageing; set by the server, never read from a request.
+    /// </summary>
+    [JsonIgnore]
+    public int Priority { get; init; }
 }
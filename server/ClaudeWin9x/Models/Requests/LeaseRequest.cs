@@ -0,0 +1,9 @@
+using System.Text.Json.Serialization;
+
+namespace ClaudeWin9xServer.Models.Requests;
+
+public record LeaseRequest
+{
+    [JsonPropertyName("cmd_id")]
+    public string? CmdId { get; init; }
+}
@@ -9,4 +9,19 @@ public record StartRequest
 
     [JsonPropertyName("windows_version")]
     public string? WindowsVersion { get; init; }
+
+    [JsonPropertyName("frame_protocol")]
+    public bool? FrameProtocol { get; init; }
+
+    /// <summary>
+    /// Set by a client another instance sent here, so the session starts here whatever the load.
+    /// </summary>
+    [JsonPropertyName("placed")]
+    public bool? Placed { get; init; }
+
+    /// <summary>
+    /// Ticket from an earlier "queued" reply, to keep the client's place in line.
+    /// </summary>
+    [JsonPropertyName("ticket")]
+    public string? Ticket { get; init; }
 }
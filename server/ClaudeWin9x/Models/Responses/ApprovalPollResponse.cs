@@ -15,4 +15,7 @@ public record ApprovalPollResponse
 
     [JsonPropertyName("tool_input")]
     public string? ToolInput { get; init; }
+
+    [JsonPropertyName("priority")]
+    public int Priority { get; init; }
 }
@@ -0,0 +1,15 @@
+using System.Text.Json.Serialization;
+
+namespace ClaudeWin9xServer.Models.Responses;
+
+public record ApprovalRespondResponse
+{
+    [JsonPropertyName("status")]
+    public required string Status { get; init; }
+
+    [JsonPropertyName("file_op")]
+    public FileOpPollResponse? FileOp { get; init; }
+
+    [JsonPropertyName("command")]
+    public CommandPollResponse? Command { get; init; }
+}
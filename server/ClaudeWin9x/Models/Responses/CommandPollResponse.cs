@@ -15,4 +15,10 @@ public record CommandPollResponse
 
     [JsonPropertyName("working_directory")]
     public string? WorkingDirectory { get; init; }
+
+    [JsonPropertyName("priority")]
+    public int Priority { get; init; }
+
+    [JsonPropertyName("lease_ms")]
+    public int LeaseMs { get; init; }
 }
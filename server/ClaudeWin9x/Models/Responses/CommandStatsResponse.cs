@@ -0,0 +1,21 @@
+using System.Text.Json.Serialization;
+
+namespace ClaudeWin9xServer.Models.Responses;
+
+public record CommandStatsResponse
+{
+    [JsonPropertyName("results")]
+    public required int Results { get; init; }
+
+    [JsonPropertyName("resident_bytes")]
+    public required long ResidentBytes { get; init; }
+
+    [JsonPropertyName("max_bytes")]
+    public required long MaxBytes { get; init; }
+
+    [JsonPropertyName("evictions")]
+    public required long Evictions { get; init; }
+
+    [JsonPropertyName("expirations")]
+    public required long Expirations { get; init; }
+}
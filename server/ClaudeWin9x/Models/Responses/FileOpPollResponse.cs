@@ -18,4 +18,7 @@ public record FileOpPollResponse
 
     [JsonPropertyName("content")]
     public string? Content { get; init; }
+
+    [JsonPropertyName("priority")]
+    public int Priority { get; init; }
 }
@@ -18,4 +18,13 @@ public record FileOperation
 
     [JsonPropertyName("status")]
     public required string Status { get; init; }
+
+    [JsonPropertyName("session_id")]
+    public string? SessionId { get; init; }
+
+    /// <summary>
+    /// Class the op was dispatched in after ageing; set by the server, never read from a request.
+    /// </summary>
+    [JsonIgnore]
+    public int Priority { get; init; }
 }
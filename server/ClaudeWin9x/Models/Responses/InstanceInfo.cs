@@ -0,0 +1,33 @@
+using System.Text.Json.Serialization;
+
+namespace ClaudeWin9xServer.Models.Responses;
+
+public record InstanceInfo
+{
+    [JsonPropertyName("name")]
+    public required string Name { get; init; }
+
+    /// <summary>
+    /// Address clients should use for this instance; null means the one they already use.
+    /// </summary>
+    [JsonPropertyName("host")]
+    public string? Host { get; init; }
+
+    [JsonPropertyName("api_port")]
+    public required int ApiPort { get; init; }
+
+    [JsonPropertyName("download_port")]
+    public required int DownloadPort { get; init; }
+
+    [JsonPropertyName("upload_port")]
+    public required int UploadPort { get; init; }
+
+    [JsonPropertyName("frame_port")]
+    public int? FramePort { get; init; }
+
+    [JsonPropertyName("sessions")]
+    public int Sessions { get; init; }
+
+    [JsonPropertyName("seen")]
+    public string? Seen { get; init; }
+}
@@ -0,0 +1,12 @@
+using System.Text.Json.Serialization;
+
+namespace ClaudeWin9xServer.Models.Responses;
+
+public record InstancesResponse
+{
+    [JsonPropertyName("self")]
+    public required string Self { get; init; }
+
+    [JsonPropertyName("instances")]
+    public required InstanceInfo[] Instances { get; init; }
+}
@@ -0,0 +1,15 @@
+using System.Text.Json.Serialization;
+
+namespace ClaudeWin9xServer.Models.Responses;
+
+public record LatencyResponse
+{
+    [JsonPropertyName("sessions")]
+    public required SessionLatency[] Sessions { get; init; }
+
+    [JsonPropertyName("leases")]
+    public int Leases { get; init; }
+
+    [JsonPropertyName("lease_expiries")]
+    public long LeaseExpiries { get; init; }
+}
@@ -5,4 +5,7 @@ public record SessionInfo
     public required string SessionId { get; init; }
     public required string Status { get; init; }
     public required string LastActivity { get; init; }
+    public long HibernatedMb { get; init; }
+    public long? ResumeMs { get; init; }
+    public long SpilledKb { get; init; }
 }
@@ -0,0 +1,30 @@
+using System.Text.Json.Serialization;
+
+namespace ClaudeWin9xServer.Models.Responses;
+
+public record SessionLatency
+{
+    [JsonPropertyName("session_id")]
+    public required string SessionId { get; init; }
+
+    [JsonPropertyName("op_rtt_ms")]
+    public double? OpRttMs { get; init; }
+
+    [JsonPropertyName("op_rtt_var_ms")]
+    public double? OpRttVarMs { get; init; }
+
+    [JsonPropertyName("bytes_per_second")]
+    public double? BytesPerSecond { get; init; }
+
+    [JsonPropertyName("command_ms")]
+    public double? CommandMs { get; init; }
+
+    [JsonPropertyName("command_var_ms")]
+    public double? CommandVarMs { get; init; }
+
+    [JsonPropertyName("samples")]
+    public required int Samples { get; init; }
+
+    [JsonPropertyName("timeouts")]
+    public required int Timeouts { get; init; }
+}
@@ -9,4 +9,34 @@ public record SessionStartResponse
 
     [JsonPropertyName("status")]
     public required string Status { get; init; }
+
+    [JsonPropertyName("frame_port")]
+    public int? FramePort { get; init; }
+
+    /// <summary>
+    /// With status "moved": the instance the client should start its session on instead.
+    /// </summary>
+    [JsonPropertyName("host")]
+    public string? Host { get; init; }
+
+    [JsonPropertyName("api_port")]
+    public int? ApiPort { get; init; }
+
+    [JsonPropertyName("download_port")]
+    public int? DownloadPort { get; init; }
+
+    [JsonPropertyName("upload_port")]
+    public int? UploadPort { get; init; }
+
+    /// <summary>
+    /// With status "queued": what to send back on the retry, the place in line and when to retry.
+    /// </summary>
+    [JsonPropertyName("ticket")]
+    public string? Ticket { get; init; }
+
+    [JsonPropertyName("position")]
+    public int? Position { get; init; }
+
+    [JsonPropertyName("retry_ms")]
+    public int? RetryMs { get; init; }
 }
@@ -3,4 +3,8 @@ namespace ClaudeWin9xServer.Models.Responses;
 public record SessionsListResponse
 {
     public required SessionInfo[] Sessions { get; init; }
+    public int MaxSessions { get; init; }
+    public int Waiting { get; init; }
+    public int Hibernated { get; init; }
+    public long HibernatedMb { get; init; }
 }
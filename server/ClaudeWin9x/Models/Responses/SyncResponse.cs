@@ -0,0 +1,39 @@
+using System.Text.Json.Serialization;
+
+namespace ClaudeWin9xServer.Models.Responses;
+
+public record SyncResponse
+{
+    [JsonPropertyName("output")]
+    public required string Output { get; init; }
+
+    /// <summary>
+    /// Log offset the output starts at; past the requested <c>since</c> if older output was dropped.
+    /// </summary>
+    [JsonPropertyName("offset")]
+    public long Offset { get; init; }
+
+    /// <summary>
+    /// Cursor to pass as <c>since</c> on the next call.
+    /// </summary>
+    [JsonPropertyName("next")]
+    public long Next { get; init; }
+
+    [JsonPropertyName("status")]
+    public required string Status { get; init; }
+
+    [JsonPropertyName("turn_state")]
+    public string TurnState { get; init; } = "idle";
+
+    [JsonPropertyName("turn_seq")]
+    public int TurnSeq { get; init; }
+
+    [JsonPropertyName("file_op")]
+    public FileOpPollResponse? FileOp { get; init; }
+
+    [JsonPropertyName("command")]
+    public CommandPollResponse? Command { get; init; }
+
+    [JsonPropertyName("approval")]
+    public ApprovalPollResponse? Approval { get; init; }
+}
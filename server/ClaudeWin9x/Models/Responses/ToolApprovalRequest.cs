@@ -18,4 +18,10 @@ public record ToolApprovalRequest
 
     [JsonPropertyName("status")]
     public required string Status { get; init; }
+
+    /// <summary>
+    /// Id of the command or file operation held back until this is answered.
+    /// </summary>
+    [JsonIgnore]
+    public string? WorkId { get; init; }
 }
@@ -8,7 +8,7 @@ using ClaudeWin9xServer.Models.Responses;
 using ClaudeWin9xServer.Services;
 using ClaudeWin9xServer.Services.Interfaces;
 
-IniConfig.Load();
+IniConfig.Load(args is ["--config", var configFile, ..] ? configFile : "server.ini");
 
 var builder = WebApplication.CreateSlimBuilder(args);
 
@@ -20,16 +20,49 @@ builder.Services.ConfigureHttpJsonOptions(options =>
     options.SerializerOptions.TypeInfoResolverChain.Insert(0, AppJsonSerializerContext.Default);
 });
 
-var pendingCommands = new ConcurrentDictionary<string, CommandRequest>();
-var commandResults = new ConcurrentDictionary<string, CommandResult>();
+IWorkStore store = IniConfig.StateDir != "" ? new JournalWorkStore(IniConfig.StateDir) : new MemoryWorkStore();
+var instance = new InstanceInfo
+{
+    Name = IniConfig.InstanceName != "" ? IniConfig.InstanceName : $"{Environment.MachineName}:{IniConfig.ApiPort}",
+    Host = IniConfig.PublicHost != "" ? IniConfig.PublicHost : null,
+    ApiPort = IniConfig.ApiPort,
+    DownloadPort = IniConfig.DownloadPort,
+    UploadPort = IniConfig.UploadPort,
+    FramePort = IniConfig.FramePort != 0 ? IniConfig.FramePort : null
+};
+var directory = new SessionDirectory(store, instance, TimeSpan.FromSeconds(30));
+
+// Each instance logs only its own work, and a restart does not resume it: the callers waiting on it
+// went with the old process. What a previous run left behind is settled before serving. Without a
+// state_dir there is no previous run to settle, so work is not journaled at all
+var durable = IniConfig.StateDir != "";
+var commandJournal = durable ? new WorkJournal<CommandRequest>(store, $"command/{instance.Name}", AppJsonSerializerContext.Default.CommandRequest) : null;
+var fileOpJournal = durable ? new WorkJournal<FileOperation>(store, $"file_op/{instance.Name}", AppJsonSerializerContext.Default.FileOperation) : null;
+var approvalJournal = durable ? new WorkJournal<ToolApprovalRequest>(store, $"approval/{instance.Name}", AppJsonSerializerContext.Default.ToolApprovalRequest) : null;
+
+var pendingCommands = CommandService.CreateQueue(commandJournal);
+var commandResults = new CommandResultStore(IniConfig.ResultStoreMb * 1024L * 1024, TimeSpan.FromMinutes(IniConfig.ResultTtlMinutes));
+var latency = new LatencyEstimator(
+    TimeSpan.FromSeconds(IniConfig.DeadlineFloorSeconds),
+    TimeSpan.FromSeconds(IniConfig.CommandDeadlineFloorSeconds),
+    TimeSpan.FromSeconds(IniConfig.DeadlineCeilingSeconds));
 var commandWaiters = new ConcurrentDictionary<string, TaskCompletionSource<CommandResult>>();
-var pendingFileOps = new ConcurrentDictionary<string, FileOperation>();
+var pendingFileOps = FileSystemService.CreateQueue(fileOpJournal);
 var fileOpWaiters = new ConcurrentDictionary<string, TaskCompletionSource<FileOpResult>>();
-var pendingApprovals = new ConcurrentDictionary<string, ToolApprovalRequest>();
+var pendingApprovals = ApprovalService.CreateQueue(approvalJournal);
+
+var abandonedSessions = directory.Recover();
+var abandonedCommands = commandJournal != null ? CommandService.FailAbandoned(commandJournal, commandResults) : 0;
+var abandonedOther = (fileOpJournal?.Drain().Count ?? 0) + (approvalJournal?.Drain().Count ?? 0);
 var approvalWaiters = new ConcurrentDictionary<string, TaskCompletionSource<bool>>();
 
+builder.Services.AddSingleton(store);
+builder.Services.AddSingleton(directory);
+builder.Services.AddSingleton(new SessionAdmission(IniConfig.MaxSessions, TimeSpan.FromSeconds(30)));
 builder.Services.AddSingleton(pendingCommands);
 builder.Services.AddSingleton(commandResults);
+builder.Services.AddSingleton(latency);
+builder.Services.AddSingleton(new LeaseTable());
 builder.Services.AddSingleton(commandWaiters);
 builder.Services.AddSingleton(pendingFileOps);
 builder.Services.AddSingleton(fileOpWaiters);
@@ -37,28 +70,40 @@ builder.Services.AddSingleton(pendingApprovals);
 builder.Services.AddSingleton(approvalWaiters);
 
 builder.Services.AddSingleton(sp => new SessionService(
-    sp.GetRequiredService<ILogger<SessionService>>()
+    sp.GetRequiredService<ILogger<SessionService>>(),
+    directory: sp.GetRequiredService<SessionDirectory>(),
+    admission: sp.GetRequiredService<SessionAdmission>(),
+    idleAfter: TimeSpan.FromMinutes(IniConfig.IdleEvictMinutes),
+    underPressure: () => MemoryPressure.Load() * 100 >= IniConfig.MemoryPressurePercent,
+    warmPoolSize: IniConfig.WarmPoolSize,
+    hibernateAfter: IniConfig.HibernateMinutes > 0 ? TimeSpan.FromMinutes(IniConfig.HibernateMinutes) : null,
+    outputSpillBytes: IniConfig.OutputSpillMb * 1024L * 1024,
+    latency: sp.GetRequiredService<LatencyEstimator>()
 ));
 builder.Services.AddSingleton<ISessionService>(sp => sp.GetRequiredService<SessionService>());
 builder.Services.AddHostedService(sp => sp.GetRequiredService<SessionService>());
 
 builder.Services.AddSingleton<IApprovalService>(sp => new ApprovalService(
-    sp.GetRequiredService<ConcurrentDictionary<string, ToolApprovalRequest>>(),
+    sp.GetRequiredService<WorkQueue<ToolApprovalRequest>>(),
     sp.GetRequiredService<ConcurrentDictionary<string, TaskCompletionSource<bool>>>(),
     sp.GetRequiredService<ILogger<ApprovalService>>()
 ));
 
 builder.Services.AddSingleton<ICommandService>(sp => new CommandService(
-    sp.GetRequiredService<ConcurrentDictionary<string, CommandRequest>>(),
-    sp.GetRequiredService<ConcurrentDictionary<string, CommandResult>>(),
+    sp.GetRequiredService<WorkQueue<CommandRequest>>(),
+    sp.GetRequiredService<CommandResultStore>(),
     sp.GetRequiredService<ConcurrentDictionary<string, TaskCompletionSource<CommandResult>>>(),
+    sp.GetRequiredService<LatencyEstimator>(),
+    sp.GetRequiredService<LeaseTable>(),
     sp.GetRequiredService<IApprovalService>(),
     sp.GetRequiredService<ILogger<CommandService>>()
 ));
 
 builder.Services.AddSingleton<IFileSystemService>(sp => new FileSystemService(
-    sp.GetRequiredService<ConcurrentDictionary<string, FileOperation>>(),
+    sp.GetRequiredService<WorkQueue<FileOperation>>(),
     sp.GetRequiredService<ConcurrentDictionary<string, TaskCompletionSource<FileOpResult>>>(),
+    sp.GetRequiredService<LatencyEstimator>(),
+    sp.GetRequiredService<LeaseTable>(),
     sp.GetRequiredService<IApprovalService>(),
     sp.GetRequiredService<ILogger<FileSystemService>>()
 ));
@@ -71,13 +116,47 @@ builder.Services.AddSingleton(sp => new FileTransferService(
 ));
 builder.Services.AddHostedService(sp => sp.GetRequiredService<FileTransferService>());
 
+builder.Services.AddSingleton<ISyncService>(sp => new SyncService(
+    sp.GetRequiredService<ISessionService>(),
+    sp.GetRequiredService<IFileSystemService>(),
+    sp.GetRequiredService<ICommandService>(),
+    sp.GetRequiredService<IApprovalService>()
+));
+
+if (IniConfig.FramePort != 0)
+{
+    builder.Services.AddHostedService(sp => new FrameProtocolService(
+        IniConfig.FramePort,
+        sp.GetRequiredService<ISyncService>(),
+        sp.GetRequiredService<ISessionService>(),
+        sp.GetRequiredService<IFileSystemService>(),
+        sp.GetRequiredService<ICommandService>(),
+        sp.GetRequiredService<FileTransferService>(),
+        sp.GetRequiredService<ILogger<FrameProtocolService>>()
+    ));
+}
+
 var app = builder.Build();
 
-// Disable chunked transfer encoding for compatibility
+// Small replies are held so they carry Content-Length instead of chunked encoding; the client
+// frames replies by length to keep its connection alive. Nothing is held while a long poll waits,
+// and a reply past 64 KB is written through as it is produced.
 app.Use(async (context, next) =>
 {
-    context.Response.Headers["Transfer-Encoding"] = "";
-    await next();
+    var body = context.Response.Body;
+    await using var framed = new FramedResponseBody(context.Response, body, 64 * 1024);
+    context.Response.Body = framed;
+
+    try
+    {
+        await next();
+    }
+    finally
+    {
+        context.Response.Body = body;
+    }
+
+    await framed.CompleteAsync(context.RequestAborted);
 });
 
 app.Use(async (context, next) =>
@@ -109,16 +188,32 @@ Console.WriteLine("Config:");
 Console.WriteLine($"  api_port:         {IniConfig.ApiPort}");
 Console.WriteLine($"  download_port:    {IniConfig.DownloadPort}");
 Console.WriteLine($"  upload_port:      {IniConfig.UploadPort}");
+Console.WriteLine($"  frame_port:       {(IniConfig.FramePort != 0 ? IniConfig.FramePort : "disabled")}");
+Console.WriteLine($"  result_store_mb:  {IniConfig.ResultStoreMb}");
+Console.WriteLine($"  result_ttl_min:   {IniConfig.ResultTtlMinutes}");
+Console.WriteLine($"  deadlines:        {IniConfig.DeadlineFloorSeconds}s-{IniConfig.DeadlineCeilingSeconds}s (commands from {IniConfig.CommandDeadlineFloorSeconds}s)");
 Console.WriteLine($"  temp_dir:         {Path.GetTempPath()}");
+Console.WriteLine($"  max_sessions:     {IniConfig.MaxSessions} (idle ones hibernated after {IniConfig.IdleEvictMinutes} min when needed, or above {IniConfig.MemoryPressurePercent}% memory)");
+Console.WriteLine($"  hibernate:        {(IniConfig.HibernateMinutes != 0 ? $"after {IniConfig.HibernateMinutes} min idle" : "disabled")}");
+Console.WriteLine($"  warm_pool_size:   {(IniConfig.WarmPoolSize != 0 ? IniConfig.WarmPoolSize : "disabled")}");
+Console.WriteLine($"  output_spill:     {(IniConfig.OutputSpillMb != 0 ? $"{IniConfig.OutputSpillMb} MB per session" : "disabled")}");
+Console.WriteLine($"  instance:         {instance.Name}");
+Console.WriteLine($"  state:            {(IniConfig.StateDir != "" ? $"journal in {Path.GetFullPath(IniConfig.StateDir)}" : "in memory")}");
 Console.WriteLine();
 
+if (abandonedSessions + abandonedCommands + abandonedOther > 0)
+{
+    Console.WriteLine($"Recovered from the last run: {abandonedSessions} sessions released, {abandonedCommands} commands marked failed, {abandonedOther} file ops and approvals dropped.");
+    Console.WriteLine();
+}
+
 Console.WriteLine("Note: Claude CLI runs with --dangerously-skip-permissions.");
 Console.WriteLine("      Commands to client are still gated for approval.");
 Console.WriteLine();
 
 Console.WriteLine("Endpoints:");
-Console.WriteLine("  Claude Code: /start, /input, /output, /stop, /sessions, /heartbeat");
-Console.WriteLine("  Commands:    /cmd/queue, /cmd/poll, /cmd/result, /cmd/status");
+Console.WriteLine("  Claude Code: /start, /input, /output, /sync, /stop, /sessions, /sessions/latency, /sessions/instances, /heartbeat");
+Console.WriteLine("  Commands:    /cmd/queue, /cmd/poll, /cmd/result, /cmd/lease, /cmd/status, /cmd/stats");
 Console.WriteLine("  Filesystem:  /fs/list, /fs/read, /fs/write, /fs/poll, /fs/result");
 Console.WriteLine("  Approvals:   /approval/poll, /approval/respond");
 Console.WriteLine();
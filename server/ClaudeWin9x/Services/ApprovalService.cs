@@ -6,11 +6,21 @@ using ClaudeWin9xServer.Services.Interfaces;
 namespace ClaudeWin9xServer.Services;
 
 public class ApprovalService(
-    ConcurrentDictionary<string, ToolApprovalRequest> pendingApprovals,
+    WorkQueue<ToolApprovalRequest> pendingApprovals,
     ConcurrentDictionary<string, TaskCompletionSource<bool>> approvalWaiters,
     ILogger<ApprovalService> logger) : IApprovalService
 {
-    public async Task<bool> RequestApprovalAsync(string sessionId, string toolName, string toolInput, TimeSpan timeout, CancellationToken cancellationToken = default)
+    private readonly AsyncSignal _queued = new();
+
+    public Task NextQueued => _queued.Next;
+
+    /// <summary>
+    /// Approvals are shown while pending, oldest first per session.
+    /// </summary>
+    public static WorkQueue<ToolApprovalRequest> CreateQueue(WorkJournal<ToolApprovalRequest>? journal = null) =>
+        new(a => a.Status == "pending", a => a.SessionId, journal: journal);
+
+    public async Task<bool> RequestApprovalAsync(string sessionId, string toolName, string toolInput, TimeSpan timeout, CancellationToken cancellationToken = default, string? workId = null)
     {
         var approvalId = IdGenerator.NewId();
 
@@ -20,7 +30,8 @@ public class ApprovalService(
             SessionId = sessionId,
             ToolName = toolName,
             ToolInput = toolInput,
-            Status = "pending"
+            Status = "pending",
+            WorkId = workId
         };
 
         if (!pendingApprovals.TryAdd(approvalId, request))
@@ -29,6 +40,7 @@ public class ApprovalService(
             return false;
         }
 
+        _queued.Pulse();
         logger.LogInformation("Queued approval {ApprovalId}: {ToolName} - {ToolInput}",
             approvalId, toolName, toolInput.Length > 100 ? toolInput[..100] + "..." : toolInput);
 
@@ -61,11 +73,13 @@ public class ApprovalService(
         }
     }
 
-    public ToolApprovalRequest? PollPendingApproval(string sessionId)
-    {
-        return pendingApprovals.Values
-            .FirstOrDefault(a => a.SessionId == sessionId && a.Status == "pending");
-    }
+    public ToolApprovalRequest? GetApproval(string approvalId) =>
+        pendingApprovals.TryGetValue(approvalId, out var approval) ? approval : null;
+
+    public ToolApprovalRequest? PollPendingApproval(string sessionId) => pendingApprovals.Peek(sessionId);
+
+    public Task<ToolApprovalRequest?> PollPendingApprovalAsync(string sessionId, TimeSpan wait, CancellationToken cancellationToken = default) =>
+        LongPoll.WaitAsync(() => PollPendingApproval(sessionId), () => NextQueued, wait, cancellationToken);
 
     public bool SubmitResponse(string approvalId, bool approved)
     {
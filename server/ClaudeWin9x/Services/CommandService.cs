@@ -7,48 +7,65 @@ using ClaudeWin9xServer.Services.Interfaces;
 namespace ClaudeWin9xServer.Services;
 
 public class CommandService(
-    ConcurrentDictionary<string, CommandRequest> pendingCommands,
-    ConcurrentDictionary<string, CommandResult> commandResults,
+    WorkQueue<CommandRequest> pendingCommands,
+    CommandResultStore commandResults,
     ConcurrentDictionary<string, TaskCompletionSource<CommandResult>> commandWaiters,
+    LatencyEstimator latency,
+    LeaseTable leases,
     IApprovalService approvalService,
     ILogger<CommandService> logger,
     TimeSpan? timeout = null) : ICommandService
 {
     private readonly TimeSpan _timeout = timeout ?? TimeSpan.FromSeconds(120);
+    private readonly AsyncSignal _queued = new();
+    private readonly ConcurrentDictionary<string, Deadline> _deadlines = new();
 
-    public async Task<CommandResult?> QueueCommandAsync(string command, string? workingDirectory, string? sessionId = null, CancellationToken cancellationToken = default)
+    public Task NextQueued => _queued.Next;
+
+    /// <summary>
+    /// Commands become pollable once pending, queued per session in that order.
+    /// </summary>
+    public static WorkQueue<CommandRequest> CreateQueue(WorkJournal<CommandRequest>? journal = null) =>
+        new(c => c.Status == "pending", c => c.SessionId, PriorityOf, journal: journal);
+
+    /// <summary>
+    /// Commands an earlier run of this server queued and never saw finish. Whoever waited on
+    /// them is gone, so they are not run again; <c>/cmd/status</c> reports them as failed
+    /// instead of unknown.
+    /// </summary>
+    public static int FailAbandoned(WorkJournal<CommandRequest> journal, CommandResultStore results)
     {
-        if (sessionId != null)
+        var abandoned = journal.Drain();
+        foreach (var id in abandoned.Keys)
         {
-            var approved = await approvalService.RequestApprovalAsync(
-                sessionId,
-                "Bash",
-                command,
-                _timeout,
-                cancellationToken);
-
-            if (!approved)
+            results.Add(id, new CommandResult
             {
-                logger.LogWarning("Command rejected by user: {Command}", command);
-                return new CommandResult
-                {
-                    CommandId = "rejected",
-                    ExitCode = -1,
-                    Stdout = "",
-                    Stderr = "Command rejected by user"
-                };
-            }
+                CommandId = id,
+                ExitCode = -1,
+                Stdout = "",
+                Stderr = "Server restarted before the command finished"
+            });
         }
+        return abandoned.Count;
+    }
+
+    /// <summary>
+    /// How long a command runs can't be told from its text, so all of them rank as long.
+    /// </summary>
+    public static int PriorityOf(CommandRequest command) => WorkPriority.Long;
 
+    public async Task<CommandResult?> QueueCommandAsync(string command, string? workingDirectory, string? sessionId = null, CancellationToken cancellationToken = default)
+    {
         var cmdId = IdGenerator.NewId();
 
+        // Held out of polls until approved, so the approval answer can carry it instead
         var request = new CommandRequest
         {
             Id = cmdId,
             Command = command,
             WorkingDirectory = workingDirectory,
             SessionId = sessionId,
-            Status = "pending"
+            Status = sessionId != null ? "awaiting_approval" : "pending"
         };
 
         var tcs = new TaskCompletionSource<CommandResult>(TaskCreationOptions.RunContinuationsAsynchronously);
@@ -58,24 +75,65 @@ public class CommandService(
             return null;
         }
 
-        if (!pendingCommands.TryAdd(cmdId, request))
+        // Inside the try, so a journal write that fails still leaves no waiter behind
+        try
         {
-            commandWaiters.TryRemove(cmdId, out _);
-            logger.LogError("Failed to queue command {CommandId} (duplicate)", cmdId);
-            return null;
-        }
+            if (!pendingCommands.TryAdd(cmdId, request))
+            {
+                logger.LogError("Failed to queue command {CommandId} (duplicate)", cmdId);
+                return null;
+            }
 
-        logger.LogInformation("Queued command {CommandId}: {Command}", cmdId, command);
+            if (sessionId != null)
+            {
+                var approved = await approvalService.RequestApprovalAsync(
+                    sessionId,
+                    "Bash",
+                    command,
+                    _timeout,
+                    cancellationToken,
+                    cmdId);
 
-        try
-        {
-            var result = await tcs.Task.WaitAsync(_timeout, cancellationToken);
+                if (!approved)
+                {
+                    // The session ended while asking; nobody is left to answer or run it
+                    if (cancellationToken.IsCancellationRequested)
+                    {
+                        return null;
+                    }
+
+                    logger.LogWarning("Command rejected by user: {Command}", command);
+                    return new CommandResult
+                    {
+                        CommandId = "rejected",
+                        ExitCode = -1,
+                        Stdout = "",
+                        Stderr = "Command rejected by user"
+                    };
+                }
+
+                ReleaseApproved(cmdId);
+            }
+
+            // Fixed bound while queued; the client's own estimate takes over once it has the command
+            using var deadline = new Deadline(_timeout);
+            _deadlines[cmdId] = deadline;
+            if (pendingCommands.TryGetValue(cmdId, out var current) && current.Status == "dispatched")
+            {
+                deadline.Reset(DeadlineFor(current));
+            }
+
+            _queued.Pulse();
+            logger.LogInformation("Queued command {CommandId}: {Command}", cmdId, command);
+
+            var result = await deadline.WaitAsync(tcs.Task, cancellationToken);
             logger.LogInformation("Command {CommandId} completed: exit={ExitCode}, stdout={StdoutLength} chars",
                 cmdId, result.ExitCode, result.Stdout?.Length ?? 0);
             return result;
         }
         catch (TimeoutException)
         {
+            latency.TimedOut(cmdId);
             logger.LogWarning("Timeout waiting for command {CommandId}", cmdId);
             return null;
         }
@@ -86,34 +144,129 @@ public class CommandService(
         }
         finally
         {
+            _deadlines.TryRemove(cmdId, out _);
+            leases.Release(cmdId);
+            latency.Forget(cmdId);
             commandWaiters.TryRemove(cmdId, out _);
             pendingCommands.TryRemove(cmdId, out _);
         }
     }
 
-    public CommandRequest? PollPendingCommand()
+    private void ReleaseApproved(string cmdId)
     {
-        var pending = pendingCommands.Values
-            .Where(c => c.Status == "pending")
-            .OrderBy(c => c.Id)
-            .FirstOrDefault();
+        // Fails if the approval answer already took it to the client, which is fine
+        if (pendingCommands.TryGetValue(cmdId, out var held) && held.Status == "awaiting_approval")
+        {
+            pendingCommands.TryUpdate(cmdId, held with { Status = "pending" }, held);
+        }
+    }
+
+    private TimeSpan DeadlineFor(CommandRequest command) =>
+        latency.Deadline(command.SessionId, LatencyEstimator.WorkKind.Command) ?? _timeout;
 
-        if (pending == null)
+    // Commands go out with a short lease the client keeps renewing while they run
+    private CommandRequest Dispatch(CommandRequest command, int priority) => command with
+    {
+        Status = "dispatched",
+        LeaseMs = (int)latency.RenewedLease(command.SessionId).TotalMilliseconds,
+        Priority = priority
+    };
+
+    private void OnDispatched(CommandRequest command)
+    {
+        latency.Dispatched(command.Id!, command.SessionId, LatencyEstimator.WorkKind.Command);
+        leases.Grant(command.Id!, TimeSpan.FromMilliseconds(command.LeaseMs), Redeliver);
+        if (_deadlines.TryGetValue(command.Id!, out var deadline))
         {
-            return null;
+            deadline.Reset(DeadlineFor(command));
+        }
+    }
+
+    private void Redeliver(string commandId)
+    {
+        if (pendingCommands.TryGetValue(commandId, out var current) && current.Status == "dispatched" &&
+            pendingCommands.TryUpdate(commandId, current with { Status = "pending" }, current))
+        {
+            logger.LogWarning("Lease on command {CommandId} expired, queueing it again", commandId);
+            _queued.Pulse();
+        }
+    }
+
+    public bool RenewLease(string commandId)
+    {
+        while (pendingCommands.TryGetValue(commandId, out var current))
+        {
+            var lease = TimeSpan.FromMilliseconds(current.LeaseMs);
+            if (current.Status == "dispatched")
+            {
+                leases.Renew(commandId, lease);
+            }
+            else if (current.Status == "pending" && leases.Deliveries(commandId) > 0)
+            {
+                // The renewal was late and the lease ran out, but nobody took the command since:
+                // the client still running it keeps it
+                if (!pendingCommands.TryUpdate(commandId, current with { Status = "dispatched" }, current))
+                {
+                    continue;
+                }
+                leases.Grant(commandId, lease, Redeliver);
+                logger.LogInformation("Command {CommandId} reclaimed by a late lease renewal", commandId);
+            }
+            else
+            {
+                return false;
+            }
+
+            // A client still at work keeps the command, but no longer than the ceiling from dispatch
+            if (_deadlines.TryGetValue(commandId, out var deadline))
+            {
+                var extension = 2 * lease;
+                if (latency.Remaining(commandId) is { } left && left < extension)
+                {
+                    extension = left > TimeSpan.Zero ? left : TimeSpan.Zero;
+                }
+                deadline.Extend(extension);
+            }
+            return true;
         }
 
-        var dispatched = pending with { Status = "dispatched" };
-        if (!pendingCommands.TryUpdate(pending.Id!, dispatched, pending))
+        return false;
+    }
+
+    public CommandRequest? PollPendingCommand(string? sessionId = null)
+    {
+        var dispatched = pendingCommands.Dispatch(sessionId ?? "", Dispatch);
+        if (dispatched == null)
         {
-            logger.LogWarning("Failed to dispatch command {CommandId} (concurrent modification)", pending.Id);
             return null;
         }
 
-        logger.LogInformation("Dispatched command {CommandId} to client: {Command}", pending.Id, pending.Command);
+        OnDispatched(dispatched);
+        logger.LogInformation("Dispatched command {CommandId} to client: {Command}", dispatched.Id, dispatched.Command);
         return dispatched;
     }
 
+    public Task<CommandRequest?> PollPendingCommandAsync(TimeSpan wait, string? sessionId = null, CancellationToken cancellationToken = default) =>
+        LongPoll.WaitAsync(() => PollPendingCommand(sessionId), () => NextQueued, wait, cancellationToken);
+
+    public int? PendingPriority(string? sessionId = null) => pendingCommands.PeekPriority(sessionId ?? "");
+
+    public CommandRequest? DispatchApproved(string commandId)
+    {
+        while (pendingCommands.TryGetValue(commandId, out var current) && current.Status is "awaiting_approval" or "pending")
+        {
+            var dispatched = Dispatch(current, PriorityOf(current));
+            if (pendingCommands.TryUpdate(commandId, dispatched, current))
+            {
+                OnDispatched(dispatched);
+                logger.LogInformation("Dispatched command {CommandId} with its approval: {Command}", commandId, current.Command);
+                return dispatched;
+            }
+        }
+
+        return null;
+    }
+
     public void SubmitResult(CommandResult result)
     {
         if (string.IsNullOrEmpty(result.CommandId))
@@ -123,7 +276,9 @@ public class CommandService(
 
         logger.LogInformation("Result received for {CommandId}: exit={ExitCode}", result.CommandId, result.ExitCode);
 
-        commandResults.TryAdd(result.CommandId, result);
+        commandResults.Add(result.CommandId, result);
+        latency.Completed(result.CommandId);
+        leases.Release(result.CommandId);
 
         if (commandWaiters.TryRemove(result.CommandId, out var tcs))
         {
@@ -134,7 +289,7 @@ public class CommandService(
     }
 
     public CommandResult? GetCommandStatus(string commandId) =>
-        commandResults.TryGetValue(commandId, out var result) ? result : null;
+        commandResults.TryGet(commandId);
 
     public bool IsPending(string commandId) => pendingCommands.ContainsKey(commandId);
 
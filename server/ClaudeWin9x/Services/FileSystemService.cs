@@ -7,8 +7,10 @@ using ClaudeWin9xServer.Services.Interfaces;
 namespace ClaudeWin9xServer.Services;
 
 public class FileSystemService(
-    ConcurrentDictionary<string, FileOperation> pendingFileOps,
+    WorkQueue<FileOperation> pendingFileOps,
     ConcurrentDictionary<string, TaskCompletionSource<FileOpResult>> fileOpWaiters,
+    LatencyEstimator latency,
+    LeaseTable leases,
     IApprovalService approvalService,
     ILogger<FileSystemService> logger,
     TimeSpan? readTimeout = null,
@@ -16,8 +18,30 @@ public class FileSystemService(
 {
     private readonly TimeSpan _readTimeout = readTimeout ?? TimeSpan.FromSeconds(120);
     private readonly TimeSpan _writeTimeout = writeTimeout ?? TimeSpan.FromSeconds(60);
+    private readonly AsyncSignal _queued = new();
+    private readonly ConcurrentDictionary<string, Deadline> _deadlines = new();
 
-    private async Task<FileOpResult?> QueueOperationAsync(FileOperation op, TimeSpan timeout, CancellationToken cancellationToken)
+    // The client sends at most this much of a file back
+    private const long ReadReplyBytes = 64 * 1024;
+
+    // Rough size of one listing entry on the wire
+    private const long EntryBytes = 48;
+
+    public Task NextQueued => _queued.Next;
+
+    /// <summary>
+    /// File operations become pollable once pending, in that order, with reads and listings
+    /// ahead of writes.
+    /// </summary>
+    public static WorkQueue<FileOperation> CreateQueue(WorkJournal<FileOperation>? journal = null) =>
+        new(op => op.Status == "pending", op => op.SessionId, PriorityOf, journal: journal);
+
+    public static int PriorityOf(FileOperation op) => op.Operation == "write" ? WorkPriority.Write : WorkPriority.Small;
+
+    private async Task<FileOpResult?> QueueOperationAsync(
+        FileOperation op,
+        CancellationToken cancellationToken,
+        Func<Task<bool>>? approve = null)
     {
         var tcs = new TaskCompletionSource<FileOpResult>(TaskCreationOptions.RunContinuationsAsynchronously);
         if (!fileOpWaiters.TryAdd(op.Id, tcs))
@@ -26,21 +50,50 @@ public class FileSystemService(
             return null;
         }
 
-        if (!pendingFileOps.TryAdd(op.Id, op))
-        {
-            fileOpWaiters.TryRemove(op.Id, out _);
-            logger.LogError("Failed to queue operation {OpId} (duplicate)", op.Id);
-            return null;
-        }
-
-        logger.LogInformation("Queued {Operation} {OpId}: {Path}", op.Operation, op.Id, op.Path);
+        // Held out of polls until approved, so the approval answer can carry it instead
+        var queued = approve != null ? op with { Status = "awaiting_approval" } : op;
 
+        // Inside the try, so a journal write that fails still leaves no waiter behind
         try
         {
-            return await tcs.Task.WaitAsync(timeout, cancellationToken);
+            if (!pendingFileOps.TryAdd(op.Id, queued))
+            {
+                logger.LogError("Failed to queue operation {OpId} (duplicate)", op.Id);
+                return null;
+            }
+
+            if (approve != null)
+            {
+                if (!await approve())
+                {
+                    // The session ended while asking; nobody is left to answer or run it
+                    if (cancellationToken.IsCancellationRequested)
+                    {
+                        return null;
+                    }
+
+                    return new FileOpResult { OpId = op.Id, Error = "Rejected by user" };
+                }
+
+                ReleaseApproved(op.Id);
+            }
+
+            // Fixed bound while queued; the client's own estimate takes over once it has the op
+            using var deadline = new Deadline(FixedTimeout(op));
+            _deadlines[op.Id] = deadline;
+            if (pendingFileOps.TryGetValue(op.Id, out var current) && current.Status == "dispatched")
+            {
+                deadline.Reset(DeadlineFor(current));
+            }
+
+            _queued.Pulse();
+            logger.LogInformation("Queued {Operation} {OpId}: {Path}", op.Operation, op.Id, op.Path);
+
+            return await deadline.WaitAsync(tcs.Task, cancellationToken);
         }
         catch (TimeoutException)
         {
+            latency.TimedOut(op.Id);
             logger.LogWarning("Timeout waiting for {Operation} operation {OpId}", op.Operation, op.Id);
             return null;
         }
@@ -51,12 +104,60 @@ public class FileSystemService(
         }
         finally
         {
+            _deadlines.TryRemove(op.Id, out _);
+            leases.Release(op.Id);
+            latency.Forget(op.Id);
             fileOpWaiters.TryRemove(op.Id, out _);
             pendingFileOps.TryRemove(op.Id, out _);
         }
     }
 
-    public Task<FileOpResult?> ListDirectoryAsync(string path, CancellationToken cancellationToken = default)
+    private static long PayloadOf(FileOperation op) => op.Operation switch
+    {
+        "write" => op.Content?.Length ?? 0,
+        "read" => ReadReplyBytes,
+        _ => 0
+    };
+
+    private TimeSpan FixedTimeout(FileOperation op) => op.Operation == "write" ? _writeTimeout : _readTimeout;
+
+    private TimeSpan DeadlineFor(FileOperation op) =>
+        latency.Deadline(op.SessionId, LatencyEstimator.WorkKind.FileOp, PayloadOf(op)) ?? FixedTimeout(op);
+
+    private void OnDispatched(FileOperation op)
+    {
+        // Reads are timed by what actually comes back, not by the worst case
+        latency.Dispatched(op.Id, op.SessionId, LatencyEstimator.WorkKind.FileOp, op.Operation == "write" ? PayloadOf(op) : 0);
+
+        // File ops are safe to repeat, so the lease can be half the deadline: a lost one gets a second try
+        var deadline = DeadlineFor(op);
+        leases.Grant(op.Id, deadline / 2, Redeliver);
+        if (_deadlines.TryGetValue(op.Id, out var waiting))
+        {
+            waiting.Reset(deadline);
+        }
+    }
+
+    private void Redeliver(string opId)
+    {
+        if (pendingFileOps.TryGetValue(opId, out var current) && current.Status == "dispatched" &&
+            pendingFileOps.TryUpdate(opId, current with { Status = "pending" }, current))
+        {
+            logger.LogWarning("Lease on {Operation} {OpId} expired, queueing it again", current.Operation, opId);
+            _queued.Pulse();
+        }
+    }
+
+    private void ReleaseApproved(string opId)
+    {
+        // Fails if the approval answer already took it to the client, which is fine
+        if (pendingFileOps.TryGetValue(opId, out var held) && held.Status == "awaiting_approval")
+        {
+            pendingFileOps.TryUpdate(opId, held with { Status = "pending" }, held);
+        }
+    }
+
+    public Task<FileOpResult?> ListDirectoryAsync(string path, string? sessionId = null, CancellationToken cancellationToken = default)
     {
         var op = new FileOperation
         {
@@ -64,12 +165,13 @@ public class FileSystemService(
             Operation = "list",
             Path = path,
             Content = null,
-            Status = "pending"
+            Status = "pending",
+            SessionId = sessionId
         };
-        return QueueOperationAsync(op, _readTimeout, cancellationToken);
+        return QueueOperationAsync(op, cancellationToken);
     }
 
-    public async Task<(string? Content, bool Truncated, int TotalSize)?> ReadFileAsync(string path, int? maxSize = null, CancellationToken cancellationToken = default)
+    public async Task<(string? Content, bool Truncated, int TotalSize)?> ReadFileAsync(string path, int? maxSize = null, string? sessionId = null, CancellationToken cancellationToken = default)
     {
         var op = new FileOperation
         {
@@ -77,10 +179,11 @@ public class FileSystemService(
             Operation = "read",
             Path = path,
             Content = null,
-            Status = "pending"
+            Status = "pending",
+            SessionId = sessionId
         };
 
-        var result = await QueueOperationAsync(op, _readTimeout, cancellationToken);
+        var result = await QueueOperationAsync(op, cancellationToken);
         if (result == null || result.Error != null)
         {
             return null;
@@ -96,57 +199,73 @@ public class FileSystemService(
 
     public async Task<bool> WriteFileAsync(string path, string content, string? sessionId = null, CancellationToken cancellationToken = default)
     {
-        if (sessionId != null)
-        {
-            var description = $"Write {content.Length} bytes to {path}";
-            var approved = await approvalService.RequestApprovalAsync(
-                sessionId,
-                "Write",
-                description,
-                _writeTimeout,
-                cancellationToken);
-
-            if (!approved)
-            {
-                logger.LogWarning("Write rejected by user: {Path}", path);
-                return false;
-            }
-        }
-
         var op = new FileOperation
         {
             Id = IdGenerator.NewId(),
             Operation = "write",
             Path = path,
             Content = content,
-            Status = "pending"
+            Status = "pending",
+            SessionId = sessionId
         };
 
-        var result = await QueueOperationAsync(op, _writeTimeout, cancellationToken);
-        return result?.Error == null;
+        Func<Task<bool>>? approve = null;
+        if (sessionId != null)
+        {
+            approve = async () =>
+            {
+                var approved = await approvalService.RequestApprovalAsync(
+                    sessionId,
+                    "Write",
+                    $"Write {content.Length} bytes to {path}",
+                    _writeTimeout,
+                    cancellationToken,
+                    op.Id);
+
+                if (!approved)
+                {
+                    logger.LogWarning("Write rejected by user: {Path}", path);
+                }
+                return approved;
+            };
+        }
+
+        var result = await QueueOperationAsync(op, cancellationToken, approve);
+        return result != null && result.Error == null;
     }
 
-    public FileOperation? PollPendingOperation()
+    public FileOperation? PollPendingOperation(string? sessionId = null)
     {
-        var pending = pendingFileOps.Values
-            .Where(op => op.Status == "pending")
-            .OrderBy(op => op.Id)
-            .FirstOrDefault();
-
-        if (pending == null)
+        var dispatched = pendingFileOps.Dispatch(sessionId ?? "", (op, priority) => op with { Status = "dispatched", Priority = priority });
+        if (dispatched == null)
         {
             return null;
         }
 
-        var dispatched = pending with { Status = "dispatched" };
-        if (!pendingFileOps.TryUpdate(pending.Id, dispatched, pending))
+        OnDispatched(dispatched);
+        logger.LogInformation("Dispatched {OpId} to client: {Operation} {Path}", dispatched.Id, dispatched.Operation, dispatched.Path);
+        return dispatched;
+    }
+
+    public Task<FileOperation?> PollPendingOperationAsync(TimeSpan wait, string? sessionId = null, CancellationToken cancellationToken = default) =>
+        LongPoll.WaitAsync(() => PollPendingOperation(sessionId), () => NextQueued, wait, cancellationToken);
+
+    public int? PendingPriority(string? sessionId = null) => pendingFileOps.PeekPriority(sessionId ?? "");
+
+    public FileOperation? DispatchApproved(string opId)
+    {
+        while (pendingFileOps.TryGetValue(opId, out var current) && current.Status is "awaiting_approval" or "pending")
         {
-            logger.LogWarning("Failed to dispatch file operation {OpId} (concurrent modification)", pending.Id);
-            return null;
+            var dispatched = current with { Status = "dispatched", Priority = PriorityOf(current) };
+            if (pendingFileOps.TryUpdate(opId, dispatched, current))
+            {
+                OnDispatched(dispatched);
+                logger.LogInformation("Dispatched {OpId} with its approval: {Operation} {Path}", opId, current.Operation, current.Path);
+                return dispatched;
+            }
         }
 
-        logger.LogInformation("Dispatched {OpId} to client: {Operation} {Path}", pending.Id, pending.Operation, pending.Path);
-        return dispatched;
+        return null;
     }
 
     public void SubmitResult(FileOpResult result)
@@ -158,6 +277,9 @@ public class FileSystemService(
 
         logger.LogInformation("Result received for {OpId}: error={Error}", result.OpId, result.Error ?? "none");
 
+        latency.Completed(result.OpId, (result.Content?.Length ?? 0) + (result.Entries?.Count ?? 0) * EntryBytes);
+        leases.Release(result.OpId);
+
         if (fileOpWaiters.TryRemove(result.OpId, out var tcs))
         {
             tcs.TrySetResult(result);
@@ -46,6 +46,46 @@ public class FileTransferService(
         return Task.CompletedTask;
     }
 
+    public long MaxFileSize => _maxFileSize;
+
+    /// <summary>
+    /// Maps a requested download to a file under the transfer root, or a bundle in the temp directory.
+    /// Returns null if neither exists.
+    /// </summary>
+    public string? ResolveDownloadPath(string filename)
+    {
+        var fullPath = Path.GetFullPath(Path.Combine(_fileTransferRoot, filename));
+        var normalizedRoot = Path.GetFullPath(_fileTransferRoot + Path.DirectorySeparatorChar);
+        var tempDir = Path.GetFullPath(Path.GetTempPath());
+        var tempPath = Path.GetFullPath(Path.Combine(tempDir, Path.GetFileName(filename)));
+
+        if (fullPath.StartsWith(normalizedRoot, StringComparison.OrdinalIgnoreCase) && File.Exists(fullPath))
+        {
+            return fullPath;
+        }
+
+        if (tempPath.StartsWith(tempDir, StringComparison.OrdinalIgnoreCase) &&
+            Path.GetDirectoryName(tempPath) == tempDir.TrimEnd(Path.DirectorySeparatorChar) &&
+            File.Exists(tempPath))
+        {
+            logger.LogDebug("Serving from temp: {TempPath}", tempPath);
+            return tempPath;
+        }
+
+        return null;
+    }
+
+    /// <summary>
+    /// Maps an upload target under the transfer root, or returns null if it would escape it.
+    /// </summary>
+    public string? ResolveUploadPath(string filename)
+    {
+        var fullPath = Path.GetFullPath(Path.Combine(_fileTransferRoot, filename));
+        var normalizedRoot = Path.GetFullPath(_fileTransferRoot + Path.DirectorySeparatorChar);
+
+        return fullPath.StartsWith(normalizedRoot, StringComparison.OrdinalIgnoreCase) ? fullPath : null;
+    }
+
     private static string ReadLine(NetworkStream stream)
     {
         var bytes = new List<byte>();
@@ -121,24 +161,7 @@ public class FileTransferService(
 
             logger.LogInformation("Download request: {Filename}", filename);
 
-            var fullPath = Path.GetFullPath(Path.Combine(_fileTransferRoot, filename));
-            var normalizedRoot = Path.GetFullPath(_fileTransferRoot + Path.DirectorySeparatorChar);
-            var tempDir = Path.GetFullPath(Path.GetTempPath());
-            var tempPath = Path.GetFullPath(Path.Combine(tempDir, Path.GetFileName(filename)));
-
-            string? actualPath = null;
-
-            if (fullPath.StartsWith(normalizedRoot, StringComparison.OrdinalIgnoreCase) && File.Exists(fullPath))
-            {
-                actualPath = fullPath;
-            }
-            else if (tempPath.StartsWith(tempDir, StringComparison.OrdinalIgnoreCase) &&
-                     Path.GetDirectoryName(tempPath) == tempDir.TrimEnd(Path.DirectorySeparatorChar) &&
-                     File.Exists(tempPath))
-            {
-                actualPath = tempPath;
-                logger.LogDebug("Serving from temp: {TempPath}", tempPath);
-            }
+            var actualPath = ResolveDownloadPath(filename);
 
             if (actualPath == null)
             {
@@ -262,10 +285,9 @@ public class FileTransferService(
             var fileSizeInt = (int)fileSize;
             logger.LogInformation("Upload receiving: {Filename} ({Size} bytes)", filename, fileSizeInt);
 
-            var fullPath = Path.GetFullPath(Path.Combine(_fileTransferRoot, filename));
-            var normalizedRoot = Path.GetFullPath(_fileTransferRoot + Path.DirectorySeparatorChar);
+            var fullPath = ResolveUploadPath(filename);
 
-            if (!fullPath.StartsWith(normalizedRoot, StringComparison.OrdinalIgnoreCase))
+            if (fullPath == null)
             {
                 logger.LogWarning("Upload rejected (path escape): {Filename}", filename);
                 var errMsg = "ERROR Path not allowed\n"u8.ToArray();
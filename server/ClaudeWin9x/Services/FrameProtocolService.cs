@@ -0,0 +1,468 @@
+using System.Net;
+using System.Net.Sockets;
+using ClaudeWin9xServer.Infrastructure;
+using ClaudeWin9xServer.Models.Requests;
+using ClaudeWin9xServer.Models.Responses;
+using ClaudeWin9xServer.Services.Interfaces;
+
+namespace ClaudeWin9xServer.Services;
+
+/// <summary>
+/// Optional binary protocol (see <see cref="FrameCodec"/>) carrying sync, tool results, input and file
+/// transfers over one connection per client. Requests on different stream ids run concurrently, so a
+/// long-polling sync does not hold up an approval response or a download sent behind it.
+/// </summary>
+public class FrameProtocolService(
+    int port,
+    ISyncService syncService,
+    ISessionService sessionService,
+    IFileSystemService fileSystemService,
+    ICommandService commandService,
+    FileTransferService fileTransferService,
+    ILogger<FrameProtocolService> logger) : IHostedService
+{
+    private const int OutputChunkChars = 64 * 1024;
+
+    private TcpListener? _server;
+    private CancellationTokenSource? _cts;
+
+    public int LocalPort => (_server?.LocalEndpoint as IPEndPoint)?.Port ?? port;
+
+    public Task StartAsync(CancellationToken cancellationToken)
+    {
+        _cts = CancellationTokenSource.CreateLinkedTokenSource(cancellationToken);
+
+        _server = new TcpListener(IPAddress.Any, port);
+        _server.Start();
+        logger.LogInformation("Frame protocol server started on TCP port {Port}", LocalPort);
+
+        _ = RunServerAsync(_cts.Token);
+
+        return Task.CompletedTask;
+    }
+
+    public Task StopAsync(CancellationToken cancellationToken)
+    {
+        _cts?.Cancel();
+        _server?.Stop();
+        return Task.CompletedTask;
+    }
+
+    private async Task RunServerAsync(CancellationToken cancellationToken)
+    {
+        while (!cancellationToken.IsCancellationRequested)
+        {
+            try
+            {
+                var client = await _server!.AcceptTcpClientAsync(cancellationToken);
+                _ = HandleClientAsync(client, cancellationToken);
+            }
+            catch (OperationCanceledException)
+            {
+                break;
+            }
+            catch (SocketException ex)
+            {
+                logger.LogError("Frame accept socket error: {ErrorCode} - {Message}", ex.SocketErrorCode, ex.Message);
+            }
+            catch (ObjectDisposedException)
+            {
+                break;
+            }
+        }
+    }
+
+    private async Task HandleClientAsync(TcpClient client, CancellationToken cancellationToken)
+    {
+        using var cts = CancellationTokenSource.CreateLinkedTokenSource(cancellationToken);
+        FrameWriter? writer = null;
+        Task? writerTask = null;
+
+        try
+        {
+            client.NoDelay = true;
+            var stream = client.GetStream();
+
+            var hello = await FrameCodec.ReadAsync(stream, cts.Token);
+            if (hello is not { Type: FrameType.Hello } helloFrame)
+            {
+                return;
+            }
+
+            var helloPayload = new FramePayloadReader(helloFrame.Payload);
+            var providedKey = helloPayload.ReadString();
+            var sessionId = helloPayload.ReadString();
+
+            if (providedKey != IniConfig.ApiKey)
+            {
+                logger.LogWarning("Frame auth failed: invalid API key");
+                await FrameCodec.WriteAsync(stream, ErrorFrame(helloFrame.Stream, "Unauthorized"), cts.Token);
+                return;
+            }
+
+            await FrameCodec.WriteAsync(stream, new Frame(FrameType.HelloOk, FramePriority.Control, helloFrame.Stream, []), cts.Token);
+            logger.LogInformation("Frame client connected for session {SessionId}", sessionId);
+
+            writer = new FrameWriter(stream);
+            writerTask = writer.RunAsync(cts.Token);
+
+            var uploads = new Dictionary<ushort, FrameUpload>();
+
+            while (await FrameCodec.ReadAsync(stream, cts.Token) is { } frame)
+            {
+                switch (frame.Type)
+                {
+                    case FrameType.Sync:
+                        Dispatch(HandleSyncAsync(frame, sessionId, writer, cts.Token));
+                        break;
+                    case FrameType.Input:
+                        Dispatch(HandleInputAsync(frame, sessionId, writer, cts.Token));
+                        break;
+                    case FrameType.Download:
+                        Dispatch(HandleDownloadAsync(frame, writer, cts.Token));
+                        break;
+                    case FrameType.FileResult:
+                        await HandleFileResultAsync(frame, writer, cts.Token);
+                        break;
+                    case FrameType.CommandResult:
+                        await HandleCommandResultAsync(frame, writer, cts.Token);
+                        break;
+                    case FrameType.ApprovalResponse:
+                        await HandleApprovalResponseAsync(frame, writer, cts.Token);
+                        break;
+                    case FrameType.Lease:
+                        await HandleLeaseAsync(frame, writer, cts.Token);
+                        break;
+                    case FrameType.Upload:
+                        await BeginUploadAsync(frame, uploads, writer, cts.Token);
+                        break;
+                    case FrameType.Data:
+                        await ContinueUploadAsync(frame, uploads, writer, cts.Token);
+                        break;
+                    case FrameType.DataEnd:
+                        await FinishUploadAsync(frame, uploads, writer, cts.Token);
+                        break;
+                    default:
+                        await writer.SendAsync(ErrorFrame(frame.Stream, $"Unknown frame type {(byte)frame.Type}"), cts.Token);
+                        break;
+                }
+            }
+        }
+        catch (OperationCanceledException)
+        {
+        }
+        catch (InvalidDataException ex)
+        {
+            logger.LogWarning("Frame protocol error: {Message}", ex.Message);
+        }
+        catch (IOException ex)
+        {
+            logger.LogDebug("Frame connection closed: {Message}", ex.Message);
+        }
+        catch (SocketException ex)
+        {
+            logger.LogError("Frame socket error: {ErrorCode} - {Message}", ex.SocketErrorCode, ex.Message);
+        }
+        finally
+        {
+            await cts.CancelAsync();
+            writer?.Complete();
+            if (writerTask != null)
+            {
+                try
+                {
+                    await writerTask;
+                }
+                catch (Exception ex) when (ex is OperationCanceledException or IOException or ObjectDisposedException)
+                {
+                }
+            }
+            client.Close();
+        }
+    }
+
+    private void Dispatch(Task task)
+    {
+        _ = task.ContinueWith(
+            t => logger.LogError(t.Exception, "Frame request failed"),
+            CancellationToken.None,
+            TaskContinuationOptions.OnlyOnFaulted,
+            TaskScheduler.Default);
+    }
+
+    private async Task HandleSyncAsync(Frame frame, string sessionId, FrameWriter writer, CancellationToken cancellationToken)
+    {
+        var payload = new FramePayloadReader(frame.Payload);
+        var wait = LongPoll.ClampWait(payload.ReadInt());
+        var includeApproval = payload.ReadInt() != 0;
+
+        // Cursor and page size are optional trailing fields; a negative cursor means none
+        var since = payload.HasMore ? payload.ReadInt() : -1;
+        var maxBytes = payload.HasMore ? payload.ReadInt() : 0;
+
+        var result = await syncService.SyncAsync(sessionId, wait, includeApproval,
+            since >= 0 ? since : null, maxBytes > 0 ? maxBytes : null, cancellationToken);
+        if (result == null)
+        {
+            await writer.SendAsync(ErrorFrame(frame.Stream, "Session not found"), cancellationToken);
+            return;
+        }
+
+        var (output, status, turn, fileOp, command, approval) = result.Value;
+
+        for (var offset = 0; offset < output.Text.Length; offset += OutputChunkChars)
+        {
+            var chunk = output.Text.Substring(offset, Math.Min(OutputChunkChars, output.Text.Length - offset));
+            await writer.SendAsync(ControlFrame(FrameType.Output, frame.Stream, new FramePayloadWriter().Add(chunk)), cancellationToken);
+        }
+
+        await SendWorkAsync(frame.Stream, fileOp, command, writer, cancellationToken);
+
+        if (approval != null)
+        {
+            await writer.SendAsync(ControlFrame(FrameType.Approval, frame.Stream, new FramePayloadWriter()
+                .Add(approval.Id)
+                .Add(approval.ToolName)
+                .Add(approval.ToolInput)), cancellationToken);
+        }
+
+        await writer.SendAsync(ControlFrame(FrameType.SyncEnd, frame.Stream,
+            new FramePayloadWriter().Add(status).Add(turn.State.ToWireName()).Add(turn.Seq)
+                .Add((int)output.Offset).Add((int)output.Next)), cancellationToken);
+    }
+
+    private async Task HandleInputAsync(Frame frame, string sessionId, FrameWriter writer, CancellationToken cancellationToken)
+    {
+        var text = new FramePayloadReader(frame.Payload).ReadString();
+
+        var reply = await sessionService.SendInput(sessionId, text)
+            ? AckFrame(frame.Stream)
+            : ErrorFrame(frame.Stream, "Session not found");
+        await writer.SendAsync(reply, cancellationToken);
+    }
+
+    private async Task HandleFileResultAsync(Frame frame, FrameWriter writer, CancellationToken cancellationToken)
+    {
+        var payload = new FramePayloadReader(frame.Payload);
+        var opId = payload.ReadString();
+        var error = payload.ReadOptionalString();
+        var content = payload.ReadOptionalString();
+        var entryCount = payload.ReadInt();
+
+        List<FileEntry>? entries = null;
+        if (entryCount >= 0)
+        {
+            entries = new List<FileEntry>(Math.Min(entryCount, 4096));
+            for (var i = 0; i < entryCount; i++)
+            {
+                entries.Add(new FileEntry
+                {
+                    Name = payload.ReadString(),
+                    Type = payload.ReadString(),
+                    Size = (uint)payload.ReadInt()
+                });
+            }
+        }
+
+        fileSystemService.SubmitResult(new FileOpResult { OpId = opId, Error = error, Content = content, Entries = entries });
+        await writer.SendAsync(AckFrame(frame.Stream), cancellationToken);
+    }
+
+    private async Task HandleCommandResultAsync(Frame frame, FrameWriter writer, CancellationToken cancellationToken)
+    {
+        var payload = new FramePayloadReader(frame.Payload);
+
+        commandService.SubmitResult(new CommandResult
+        {
+            CommandId = payload.ReadString(),
+            ExitCode = payload.ReadInt(),
+            Stdout = payload.ReadString(),
+            Stderr = payload.ReadString()
+        });
+        await writer.SendAsync(AckFrame(frame.Stream), cancellationToken);
+    }
+
+    private async Task HandleLeaseAsync(Frame frame, FrameWriter writer, CancellationToken cancellationToken)
+    {
+        var commandId = new FramePayloadReader(frame.Payload).ReadString();
+
+        var reply = commandService.RenewLease(commandId)
+            ? AckFrame(frame.Stream)
+            : ErrorFrame(frame.Stream, "Command not dispatched");
+        await writer.SendAsync(reply, cancellationToken);
+    }
+
+    private async Task HandleApprovalResponseAsync(Frame frame, FrameWriter writer, CancellationToken cancellationToken)
+    {
+        var payload = new FramePayloadReader(frame.Payload);
+        var approvalId = payload.ReadString();
+        var approved = payload.ReadInt() != 0;
+        var dispatch = payload.HasMore && payload.ReadInt() != 0;
+
+        var result = syncService.AnswerApproval(approvalId, approved, dispatch);
+        if (result == null)
+        {
+            await writer.SendAsync(ErrorFrame(frame.Stream, "Approval request not found"), cancellationToken);
+            return;
+        }
+
+        // Released work goes out ahead of the ACK that ends the call
+        await SendWorkAsync(frame.Stream, result.Value.FileOp, result.Value.Command, writer, cancellationToken);
+        await writer.SendAsync(AckFrame(frame.Stream), cancellationToken);
+    }
+
+    private static async Task SendWorkAsync(ushort stream, FileOperation? fileOp, CommandRequest? command, FrameWriter writer, CancellationToken cancellationToken)
+    {
+        if (fileOp != null)
+        {
+            await writer.SendAsync(ControlFrame(FrameType.FileOp, stream, new FramePayloadWriter()
+                .Add(fileOp.Id)
+                .Add(fileOp.Operation)
+                .Add(fileOp.Path)
+                .Add(fileOp.Content)
+                .Add(fileOp.Priority)), cancellationToken);
+        }
+
+        if (command != null)
+        {
+            await writer.SendAsync(ControlFrame(FrameType.Command, stream, new FramePayloadWriter()
+                .Add(command.Id)
+                .Add(command.Command)
+                .Add(command.WorkingDirectory)
+                .Add(command.Priority)
+                .Add(command.LeaseMs)), cancellationToken);
+        }
+    }
+
+    private async Task HandleDownloadAsync(Frame frame, FrameWriter writer, CancellationToken cancellationToken)
+    {
+        var filename = new FramePayloadReader(frame.Payload).ReadString();
+        logger.LogInformation("Frame download request: {Filename}", filename);
+
+        var actualPath = string.IsNullOrEmpty(filename) ? null : fileTransferService.ResolveDownloadPath(filename);
+        if (actualPath == null)
+        {
+            logger.LogWarning("Download file not found: {Filename}", filename);
+            await writer.SendAsync(ErrorFrame(frame.Stream, $"File not found: {filename}"), cancellationToken);
+            return;
+        }
+
+        await using var file = File.OpenRead(actualPath);
+        if (file.Length > fileTransferService.MaxFileSize)
+        {
+            await writer.SendAsync(ErrorFrame(frame.Stream,
+                $"File too large ({file.Length} bytes, max {fileTransferService.MaxFileSize})"), cancellationToken);
+            return;
+        }
+
+        await writer.SendAsync(new Frame(FrameType.DataBegin, FramePriority.Bulk, frame.Stream,
+            new FramePayloadWriter().Add((int)file.Length).ToArray()), cancellationToken);
+
+        var buffer = new byte[FrameCodec.DataChunkSize];
+        int read;
+        while ((read = await file.ReadAsync(buffer, cancellationToken)) > 0)
+        {
+            await writer.SendAsync(new Frame(FrameType.Data, FramePriority.Bulk, frame.Stream, buffer[..read]), cancellationToken);
+        }
+
+        await writer.SendAsync(new Frame(FrameType.DataEnd, FramePriority.Bulk, frame.Stream, []), cancellationToken);
+        logger.LogInformation("Frame download sent {Size} bytes: {Filename}", file.Length, filename);
+    }
+
+    private async Task BeginUploadAsync(Frame frame, Dictionary<ushort, FrameUpload> uploads, FrameWriter writer, CancellationToken cancellationToken)
+    {
+        var payload = new FramePayloadReader(frame.Payload);
+        var filename = payload.ReadString();
+        var size = payload.ReadInt();
+
+        var fullPath = string.IsNullOrEmpty(filename) ? null : fileTransferService.ResolveUploadPath(filename);
+        string? error = null;
+
+        if (fullPath == null)
+        {
+            error = "Path not allowed";
+        }
+        else if (size < 0 || size > fileTransferService.MaxFileSize)
+        {
+            error = $"Invalid file size ({size} bytes, max {fileTransferService.MaxFileSize})";
+        }
+
+        if (error != null)
+        {
+            logger.LogWarning("Frame upload rejected: {Filename} - {Error}", filename, error);
+            await writer.SendAsync(ErrorFrame(frame.Stream, error), cancellationToken);
+            return;
+        }
+
+        uploads[frame.Stream] = new FrameUpload(fullPath!, new byte[size]);
+        logger.LogInformation("Frame upload receiving: {Filename} ({Size} bytes)", filename, size);
+    }
+
+    private async Task ContinueUploadAsync(Frame frame, Dictionary<ushort, FrameUpload> uploads, FrameWriter writer, CancellationToken cancellationToken)
+    {
+        if (!uploads.TryGetValue(frame.Stream, out var upload))
+        {
+            return;
+        }
+
+        if (upload.Received + frame.Payload.Length > upload.Buffer.Length)
+        {
+            uploads.Remove(frame.Stream);
+            await writer.SendAsync(ErrorFrame(frame.Stream, "Upload exceeds declared size"), cancellationToken);
+            return;
+        }
+
+        frame.Payload.CopyTo(upload.Buffer, upload.Received);
+        upload.Received += frame.Payload.Length;
+    }
+
+    private async Task FinishUploadAsync(Frame frame, Dictionary<ushort, FrameUpload> uploads, FrameWriter writer, CancellationToken cancellationToken)
+    {
+        if (!uploads.Remove(frame.Stream, out var upload))
+        {
+            return;
+        }
+
+        if (upload.Received != upload.Buffer.Length)
+        {
+            await writer.SendAsync(ErrorFrame(frame.Stream,
+                $"Incomplete transfer ({upload.Received}/{upload.Buffer.Length} bytes)"), cancellationToken);
+            return;
+        }
+
+        try
+        {
+            var dir = Path.GetDirectoryName(upload.Path);
+            if (!string.IsNullOrEmpty(dir) && !Directory.Exists(dir))
+            {
+                Directory.CreateDirectory(dir);
+            }
+
+            await File.WriteAllBytesAsync(upload.Path, upload.Buffer, cancellationToken);
+        }
+        catch (Exception ex) when (ex is IOException or UnauthorizedAccessException)
+        {
+            logger.LogError(ex, "Frame upload failed for {Path}", upload.Path);
+            await writer.SendAsync(ErrorFrame(frame.Stream, "Could not write file"), cancellationToken);
+            return;
+        }
+
+        logger.LogInformation("Frame upload saved {Size} bytes: {Path}", upload.Received, upload.Path);
+        await writer.SendAsync(AckFrame(frame.Stream), cancellationToken);
+    }
+
+    private static Frame ControlFrame(FrameType type, ushort stream, FramePayloadWriter payload) =>
+        new(type, FramePriority.Control, stream, payload.ToArray());
+
+    private static Frame AckFrame(ushort stream) => new(FrameType.Ack, FramePriority.Control, stream, []);
+
+    private static Frame ErrorFrame(ushort stream, string message) =>
+        ControlFrame(FrameType.Error, stream, new FramePayloadWriter().Add(message));
+
+    private sealed class FrameUpload(string path, byte[] buffer)
+    {
+        public string Path { get; } = path;
+        public byte[] Buffer { get; } = buffer;
+        public int Received { get; set; }
+    }
+}
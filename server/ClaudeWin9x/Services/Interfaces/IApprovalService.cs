@@ -4,7 +4,10 @@ namespace ClaudeWin9xServer.Services.Interfaces;
 
 public interface IApprovalService
 {
-    Task<bool> RequestApprovalAsync(string sessionId, string toolName, string toolInput, TimeSpan timeout, CancellationToken cancellationToken = default);
+    Task<bool> RequestApprovalAsync(string sessionId, string toolName, string toolInput, TimeSpan timeout, CancellationToken cancellationToken = default, string? workId = null);
+    ToolApprovalRequest? GetApproval(string approvalId);
     ToolApprovalRequest? PollPendingApproval(string sessionId);
+    Task<ToolApprovalRequest?> PollPendingApprovalAsync(string sessionId, TimeSpan wait, CancellationToken cancellationToken = default);
+    Task NextQueued { get; }
     bool SubmitResponse(string approvalId, bool approved);
 }
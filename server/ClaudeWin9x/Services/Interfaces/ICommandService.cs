@@ -6,7 +6,32 @@ namespace ClaudeWin9xServer.Services.Interfaces;
 public interface ICommandService
 {
     Task<CommandResult?> QueueCommandAsync(string command, string? workingDirectory, string? sessionId = null, CancellationToken cancellationToken = default);
-    CommandRequest? PollPendingCommand();
+
+    /// <summary>
+    /// Takes the oldest pending command for <paramref name="sessionId"/>, or with no session one
+    /// queued without a session. Never another session's.
+    /// </summary>
+    CommandRequest? PollPendingCommand(string? sessionId = null);
+    Task<CommandRequest?> PollPendingCommandAsync(TimeSpan wait, string? sessionId = null, CancellationToken cancellationToken = default);
+
+    /// <summary>
+    /// The class, after ageing, of the command <see cref="PollPendingCommand"/> would take next,
+    /// or null if none is pending.
+    /// </summary>
+    int? PendingPriority(string? sessionId = null);
+
+    /// <summary>
+    /// Hands an approved command straight to the client that answered the approval, unless a
+    /// poll already took it. Returns null if there is nothing left to dispatch.
+    /// </summary>
+    CommandRequest? DispatchApproved(string commandId);
+
+    /// <summary>
+    /// Called by a client still running <paramref name="commandId"/>, so it is not queued again
+    /// or timed out under it. False if the command is no longer out with a client.
+    /// </summary>
+    bool RenewLease(string commandId);
+    Task NextQueued { get; }
     void SubmitResult(CommandResult result);
     CommandResult? GetCommandStatus(string commandId);
     bool IsPending(string commandId);
@@ -4,10 +4,29 @@ namespace ClaudeWin9xServer.Services.Interfaces;
 
 public interface IFileSystemService
 {
-    Task<FileOpResult?> ListDirectoryAsync(string path, CancellationToken cancellationToken = default);
-    Task<(string? Content, bool Truncated, int TotalSize)?> ReadFileAsync(string path, int? maxSize = null, CancellationToken cancellationToken = default);
+    Task<FileOpResult?> ListDirectoryAsync(string path, string? sessionId = null, CancellationToken cancellationToken = default);
+    Task<(string? Content, bool Truncated, int TotalSize)?> ReadFileAsync(string path, int? maxSize = null, string? sessionId = null, CancellationToken cancellationToken = default);
     Task<bool> WriteFileAsync(string path, string content, string? sessionId = null, CancellationToken cancellationToken = default);
-    FileOperation? PollPendingOperation();
+
+    /// <summary>
+    /// Takes the oldest pending operation for <paramref name="sessionId"/>, or with no session one
+    /// queued without a session. Never another session's.
+    /// </summary>
+    FileOperation? PollPendingOperation(string? sessionId = null);
+    Task<FileOperation?> PollPendingOperationAsync(TimeSpan wait, string? sessionId = null, CancellationToken cancellationToken = default);
+
+    /// <summary>
+    /// The class, after ageing, of the operation <see cref="PollPendingOperation"/> would take next,
+    /// or null if none is pending.
+    /// </summary>
+    int? PendingPriority(string? sessionId = null);
+
+    /// <summary>
+    /// Hands an approved operation straight to the client that answered the approval, unless a
+    /// poll already took it. Returns null if there is nothing left to dispatch.
+    /// </summary>
+    FileOperation? DispatchApproved(string opId);
+    Task NextQueued { get; }
     void SubmitResult(FileOpResult result);
     (string ZipPath, long Size)? CreateBundle(string sourcePath, string? outputName, string? allowedBasePath = null);
 }
@@ -1,13 +1,30 @@
+using ClaudeWin9xServer.Infrastructure;
 using ClaudeWin9xServer.Models.Responses;
 
 namespace ClaudeWin9xServer.Services.Interfaces;
 
 public interface ISessionService
 {
-    (string SessionId, string Status) StartSession(string? workingDirectory, string? windowsVersion);
+    /// <summary>
+    /// Starts a session, or with every slot taken returns status "queued" with a ticket and place in
+    /// line; calling again with the ticket keeps that place.
+    /// </summary>
+    (string SessionId, string Status, string? Ticket, int Position) StartSession(string? workingDirectory, string? windowsVersion, string? ticket = null);
     Task<bool> SendInput(string sessionId, string text);
-    (string Output, string Status)? GetOutput(string sessionId);
+
+    /// <summary>
+    /// Output from the client's cursor <paramref name="since"/>, at most <paramref name="maxBytes"/>
+    /// once JSON-encoded. Without a cursor, whatever the last call didn't return.
+    /// </summary>
+    (OutputPage Output, string Status, TurnInfo Turn)? GetOutput(string sessionId, long? since = null, int? maxBytes = null);
+    Task<(OutputPage Output, string Status, TurnInfo Turn)?> GetOutputAsync(string sessionId, TimeSpan wait, long? since = null, int? maxBytes = null, CancellationToken cancellationToken = default);
+    Task OutputChanged(string sessionId);
     bool StopSession(string sessionId);
+
+    /// <summary>
+    /// Cancelled once the session is stopped or times out; already cancelled if there is no such session.
+    /// </summary>
+    CancellationToken SessionEnded(string sessionId);
     SessionInfo[] ListSessions();
     string? GetWorkingDirectory(string sessionId);
 }
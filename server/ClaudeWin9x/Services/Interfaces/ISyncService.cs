@@ -0,0 +1,23 @@
+using ClaudeWin9xServer.Infrastructure;
+using ClaudeWin9xServer.Models.Requests;
+using ClaudeWin9xServer.Models.Responses;
+
+namespace ClaudeWin9xServer.Services.Interfaces;
+
+public interface ISyncService
+{
+    Task<(OutputPage Output, string Status, TurnInfo Turn, FileOperation? FileOp, CommandRequest? Command, ToolApprovalRequest? Approval)?> SyncAsync(
+        string sessionId,
+        TimeSpan wait,
+        bool includeApproval,
+        long? since = null,
+        int? maxBytes = null,
+        CancellationToken cancellationToken = default);
+
+    /// <summary>
+    /// Records the user's answer. With <paramref name="dispatch"/>, an approved command or file
+    /// operation is returned for the client to run at once instead of on its next poll.
+    /// Null if the approval is unknown.
+    /// </summary>
+    (FileOperation? FileOp, CommandRequest? Command)? AnswerApproval(string approvalId, bool approved, bool dispatch);
+}
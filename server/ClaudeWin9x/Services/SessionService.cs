@@ -7,32 +7,82 @@ namespace ClaudeWin9xServer.Services;
 
 public class SessionService(
     ILogger<SessionService> logger,
-    int heartbeatTimeoutSeconds = 180) : ISessionService, IHostedService, IDisposable
+    int heartbeatTimeoutSeconds = 180,
+    SessionDirectory? directory = null,
+    SessionAdmission? admission = null,
+    TimeSpan? idleAfter = null,
+    Func<bool>? underPressure = null,
+    int warmPoolSize = 0,
+    TimeSpan? hibernateAfter = null,
+    long outputSpillBytes = 0,
+    LatencyEstimator? latency = null) : ISessionService, IHostedService, IDisposable
 {
     private readonly ConcurrentDictionary<string, ClaudeSession> _sessions = new();
+    private readonly WarmPool? _pool = warmPoolSize > 0
+        ? new WarmPool(warmPoolSize, () => new ClaudeSession(NewSessionId(), Path.GetTempPath(), null, logger, outputSpillBytes), logger)
+        : null;
     private readonly int _heartbeatTimeoutSeconds = heartbeatTimeoutSeconds;
+    private readonly TimeSpan _idleAfter = idleAfter ?? TimeSpan.FromMinutes(15);
     private CancellationTokenSource? _cleanupCts;
     private Task? _cleanupTask;
 
     public ConcurrentDictionary<string, ClaudeSession> Sessions => _sessions;
 
-    public (string SessionId, string Status) StartSession(string? workingDirectory, string? windowsVersion)
+    public (string SessionId, string Status, string? Ticket, int Position) StartSession(string? workingDirectory, string? windowsVersion, string? ticket = null)
     {
         var workingDir = workingDirectory ?? Path.GetTempPath();
         var winVersion = windowsVersion ?? "Unknown Windows";
 
+        var decision = admission?.TryAdmit(ticket) ?? new SessionAdmission.Decision(true, null, 0);
+        if (!decision.Admitted && HibernateIdle(1, _idleAfter) > 0)
+        {
+            decision = admission!.TryAdmit(decision.Ticket);
+        }
+        if (!decision.Admitted)
+        {
+            logger.LogInformation("Client {WindowsVersion} waiting to start, position {Position} ({Running}/{Max} running)",
+                winVersion, decision.Position, admission!.Running, admission.MaxRunning);
+            return ("", "queued", decision.Ticket, decision.Position);
+        }
+
         logger.LogInformation("Client connecting: {WindowsVersion}", winVersion);
 
-        var sessionId = Guid.NewGuid().ToString("N")[..8];
-        var session = new ClaudeSession(sessionId, workingDir, winVersion, logger);
+        // Warm processes run in the temp directory, so only sessions wanting that can take one
+        var session = workingDirectory == null ? _pool?.TryTake() : null;
+        var warm = session != null;
+        if (session != null)
+        {
+            session.Bind(winVersion);
+        }
+        else
+        {
+            session = new ClaudeSession(NewSessionId(), workingDir, winVersion, logger, outputSpillBytes);
+        }
+        var sessionId = session.SessionId;
 
         if (_sessions.TryAdd(sessionId, session))
         {
-            session.Start();
-            logger.LogInformation("Session {SessionId} started for {WindowsVersion}", sessionId, winVersion);
-            return (sessionId, "running");
+            directory?.Claim(sessionId);
+            try
+            {
+                if (!warm)
+                {
+                    session.Start();
+                }
+            }
+            catch
+            {
+                _sessions.TryRemove(sessionId, out _);
+                End(sessionId, session);
+                throw;
+            }
+            logger.LogInformation("Session {SessionId} started for {WindowsVersion}{Warm}", sessionId, winVersion, warm ? " from the warm pool" : "");
+            Warm();
+            return (sessionId, "running", null, 0);
         }
 
+        admission?.Release();
+        session.Dispose();
         logger.LogError("Failed to create session (duplicate ID): {SessionId}", sessionId);
         throw new InvalidOperationException("Failed to create session");
     }
@@ -44,11 +94,19 @@ public class SessionService(
             return false;
         }
 
+        // A resumed session takes its slot back even over the limit: its client is mid-conversation,
+        // and the cleanup loop hibernates another idle session to make up for it
+        if (session.Resume())
+        {
+            admission?.Reclaim();
+            logger.LogInformation("Session {SessionId} resuming conversation {ConversationId}", sessionId, session.ConversationId ?? "(new)");
+        }
+
         await session.SendInput(text);
         return true;
     }
 
-    public (string Output, string Status)? GetOutput(string sessionId)
+    public (OutputPage Output, string Status, TurnInfo Turn)? GetOutput(string sessionId, long? since = null, int? maxBytes = null)
     {
         if (!_sessions.TryGetValue(sessionId, out var session))
         {
@@ -56,11 +114,40 @@ public class SessionService(
         }
 
         session.UpdateHeartbeat();
-        var output = session.GetParsedOutput();
-        var status = session.IsRunning ? "running" : "stopped";
-        return (output, status);
+        var output = session.ReadParsedOutput(since, maxBytes ?? int.MaxValue);
+        var status = session.IsAlive ? "running" : "stopped";
+        return (output, status, session.Turn);
+    }
+
+    public async Task<(OutputPage Output, string Status, TurnInfo Turn)?> GetOutputAsync(
+        string sessionId,
+        TimeSpan wait,
+        long? since = null,
+        int? maxBytes = null,
+        CancellationToken cancellationToken = default)
+    {
+        if (!_sessions.TryGetValue(sessionId, out var session))
+        {
+            return null;
+        }
+
+        var turn = session.Turn;
+
+        await LongPoll.WaitAsync(
+            () => session.HasOutputAfter(since) || !session.IsAlive || session.Turn != turn ? session : null,
+            () => session.OutputChanged,
+            wait,
+            cancellationToken);
+
+        return GetOutput(sessionId, since, maxBytes);
     }
 
+    public Task OutputChanged(string sessionId) =>
+        _sessions.TryGetValue(sessionId, out var session) ? session.OutputChanged : Task.CompletedTask;
+
+    public CancellationToken SessionEnded(string sessionId) =>
+        _sessions.TryGetValue(sessionId, out var session) ? session.Ended : new CancellationToken(true);
+
     public bool StopSession(string sessionId)
     {
         if (!_sessions.TryRemove(sessionId, out var session))
@@ -68,18 +155,80 @@ public class SessionService(
             return false;
         }
 
-        session.Stop();
+        End(sessionId, session);
         logger.LogInformation("Session {SessionId} stopped", sessionId);
         return true;
     }
 
+    private static string NewSessionId() => Guid.NewGuid().ToString("N")[..8];
+
+    // For a session already taken out of _sessions
+    private void End(string sessionId, ClaudeSession session)
+    {
+        directory?.Release(sessionId);
+        latency?.ForgetSession(sessionId);
+        if (session.Stop())
+        {
+            admission?.Release();
+        }
+        Warm();
+    }
+
+    // Warm processes only use slots no session or waiting client wants, and none while memory is short
+    private void Warm()
+    {
+        if (_pool == null)
+        {
+            return;
+        }
+
+        var room = admission == null ? _pool.Size : admission.MaxRunning - admission.Running - admission.Waiting;
+        _pool.Fill(underPressure?.Invoke() == true ? 0 : room);
+    }
+
+    /// <summary>
+    /// Hibernates up to <paramref name="wanted"/> sessions that have had no input for
+    /// <paramref name="quietFor"/> and no turn in progress, longest idle first, so their slots and
+    /// memory go to someone else. Their clients keep their sessions.
+    /// </summary>
+    private int HibernateIdle(int wanted, TimeSpan quietFor)
+    {
+        if (wanted <= 0)
+        {
+            return 0;
+        }
+
+        var now = DateTime.UtcNow;
+        var idle = _sessions
+            .Where(s => s.Value.IsRunning && s.Value.IsIdle && now - s.Value.LastInput >= quietFor)
+            .OrderBy(s => s.Value.LastInput)
+            .Take(wanted)
+            .ToList();
+
+        var hibernated = 0;
+        foreach (var (sessionId, session) in idle)
+        {
+            if (session.Hibernate())
+            {
+                logger.LogInformation("Session {SessionId} idle since {LastInput:o}, hibernated, freeing {Mb} MB",
+                    sessionId, session.LastInput, session.HibernatedBytes / (1024 * 1024));
+                admission?.Release();
+                hibernated++;
+            }
+        }
+        return hibernated;
+    }
+
     public SessionInfo[] ListSessions()
     {
         return [.. _sessions.Select(s => new SessionInfo
         {
             SessionId = s.Key,
-            Status = s.Value.IsRunning ? "running" : "stopped",
-            LastActivity = s.Value.LastActivity.ToString("o")
+            Status = s.Value.IsHibernated ? "hibernated" : s.Value.IsRunning ? "running" : "stopped",
+            LastActivity = s.Value.LastActivity.ToString("o"),
+            HibernatedMb = s.Value.HibernatedBytes / (1024 * 1024),
+            ResumeMs = s.Value.ResumeLatency is { } resume ? (long)resume.TotalMilliseconds : null,
+            SpilledKb = s.Value.SpilledOutputBytes / 1024
         })];
     }
 
@@ -96,6 +245,8 @@ public class SessionService(
 
     public Task StartAsync(CancellationToken cancellationToken)
     {
+        directory?.Announce();
+        Warm();
         _cleanupCts = CancellationTokenSource.CreateLinkedTokenSource(cancellationToken);
         _cleanupTask = RunCleanupAsync(_cleanupCts.Token);
         return Task.CompletedTask;
@@ -110,9 +261,11 @@ public class SessionService(
             await _cleanupTask;
         }
 
-        foreach (var session in _sessions.Values)
+        directory?.Retire();
+        _pool?.Dispose();
+        foreach (var (sessionId, session) in _sessions)
         {
-            session.Stop();
+            End(sessionId, session);
         }
         _sessions.Clear();
     }
@@ -124,6 +277,7 @@ public class SessionService(
             try
             {
                 await Task.Delay(TimeSpan.FromSeconds(10), cancellationToken);
+                Announce();
 
                 var now = DateTime.UtcNow;
                 var stale = _sessions
@@ -136,9 +290,19 @@ public class SessionService(
                     {
                         logger.LogWarning("Session {SessionId} timed out (no heartbeat for {TimeoutSeconds}s), stopping",
                             s.Key, _heartbeatTimeoutSeconds);
-                        session.Stop();
+                        End(s.Key, session);
                     }
                 }
+
+                // Clients waiting for a slot, a machine short of memory and resumes over the limit come before idle sessions
+                var wanted = (admission?.Waiting ?? 0) + (underPressure?.Invoke() == true ? 1 : 0) +
+                    Math.Max(0, (admission?.Running ?? 0) - (admission?.MaxRunning ?? 0));
+                HibernateIdle(wanted, _idleAfter);
+                if (hibernateAfter is { } quietFor)
+                {
+                    HibernateIdle(int.MaxValue, quietFor);
+                }
+                Warm();
             }
             catch (OperationCanceledException)
             {
@@ -147,10 +311,24 @@ public class SessionService(
         }
     }
 
+    // A store that is briefly unavailable must not stop the cleanup loop
+    private void Announce()
+    {
+        try
+        {
+            directory?.Announce();
+        }
+        catch (IOException ex)
+        {
+            logger.LogWarning(ex, "Could not announce this instance in the shared store");
+        }
+    }
+
     public void Dispose()
     {
         _cleanupCts?.Cancel();
         _cleanupCts?.Dispose();
+        _pool?.Dispose();
 
         foreach (var session in _sessions.Values)
         {
@@ -0,0 +1,100 @@
+using System.Diagnostics;
+using ClaudeWin9xServer.Infrastructure;
+using ClaudeWin9xServer.Models.Requests;
+using ClaudeWin9xServer.Models.Responses;
+using ClaudeWin9xServer.Services.Interfaces;
+
+namespace ClaudeWin9xServer.Services;
+
+/// <summary>
+/// Collects output from the client's cursor plus the session's next approval and its next file op or
+/// command, whichever is more urgent after ageing, holding the call open for up to <c>wait</c> until
+/// any of them has something or the turn state moves.
+/// Also takes approval answers, which can carry the work they release. Shared by the HTTP
+/// endpoints and the frame protocol.
+/// </summary>
+public class SyncService(
+    ISessionService sessionService,
+    IFileSystemService fileSystemService,
+    ICommandService commandService,
+    IApprovalService approvalService) : ISyncService
+{
+    public async Task<(OutputPage Output, string Status, TurnInfo Turn, FileOperation? FileOp, CommandRequest? Command, ToolApprovalRequest? Approval)?> SyncAsync(
+        string sessionId,
+        TimeSpan wait,
+        bool includeApproval,
+        long? since = null,
+        int? maxBytes = null,
+        CancellationToken cancellationToken = default)
+    {
+        var start = Stopwatch.GetTimestamp();
+        TurnInfo? firstTurn = null;
+
+        while (true)
+        {
+            var changed = Task.WhenAny(
+                sessionService.OutputChanged(sessionId),
+                fileSystemService.NextQueued,
+                commandService.NextQueued,
+                approvalService.NextQueued);
+
+            var output = sessionService.GetOutput(sessionId, since, maxBytes);
+            if (output == null)
+            {
+                return null;
+            }
+
+            // The client runs one item at a time, so it is handed one. A second would sit behind the
+            // first with its deadline already running; it waits here under its queued bound instead
+            var commandPriority = commandService.PendingPriority(sessionId);
+            var fileOp = !(commandPriority < fileSystemService.PendingPriority(sessionId))
+                ? fileSystemService.PollPendingOperation(sessionId)
+                : null;
+            var command = fileOp == null ? commandService.PollPendingCommand(sessionId) : null;
+            var approval = includeApproval ? approvalService.PollPendingApproval(sessionId) : null;
+
+            var turn = output.Value.Turn.WithPendingApproval(
+                (approval ?? approvalService.PollPendingApproval(sessionId)) != null);
+            firstTurn ??= turn;
+
+            var idle = output.Value.Output.Text.Length == 0 && output.Value.Status == "running" && turn == firstTurn
+                && fileOp == null && command == null && approval == null;
+            var remaining = wait - Stopwatch.GetElapsedTime(start);
+
+            if (!idle || remaining <= TimeSpan.Zero || cancellationToken.IsCancellationRequested)
+            {
+                return (output.Value.Output, output.Value.Status, turn, fileOp, command, approval);
+            }
+
+            try
+            {
+                await changed.WaitAsync(remaining, cancellationToken);
+            }
+            catch (TimeoutException)
+            {
+            }
+            catch (OperationCanceledException)
+            {
+            }
+        }
+    }
+
+    public (FileOperation? FileOp, CommandRequest? Command)? AnswerApproval(string approvalId, bool approved, bool dispatch)
+    {
+        var workId = approvalService.GetApproval(approvalId)?.WorkId;
+
+        if (!approvalService.SubmitResponse(approvalId, approved))
+        {
+            return null;
+        }
+
+        if (!approved || !dispatch || workId == null)
+        {
+            return (null, null);
+        }
+
+        var command = commandService.DispatchApproved(workId);
+        var fileOp = command == null ? fileSystemService.DispatchApproved(workId) : null;
+        return (fileOp, command);
+    }
+}